@@ -219,6 +219,7 @@ CAIRO_PERF_DECL (tessellate);
 CAIRO_PERF_DECL (text);
 CAIRO_PERF_DECL (glyphs);
 CAIRO_PERF_DECL (hash_table);
+CAIRO_PERF_DECL (hash_table_ops);
 CAIRO_PERF_DECL (pattern_create_radial);
 CAIRO_PERF_DECL (zrusin);
 CAIRO_PERF_DECL (world_map);
@@ -250,5 +251,6 @@ CAIRO_PERF_DECL (a1_pixel);
 CAIRO_PERF_DECL (sierpinski);
 CAIRO_PERF_DECL (fill_clip);
 CAIRO_PERF_DECL (tiger);
+CAIRO_PERF_DECL (recording_replay);
 
 #endif
@@ -0,0 +1,138 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Unlike hash-table, which goes through the scaled font map, these
+ * exercise the private hash table directly so that the cost of the
+ * probing itself is not hidden behind font creation.
+ */
+
+#include "cairo-perf.h"
+
+#include <assert.h>
+
+/* rudely reuse bits of the library... */
+#include "../../src/cairo-hash-private.h"
+
+#define NUM_ENTRIES 4096
+
+typedef struct _entry {
+    cairo_hash_entry_t base;
+    void *value;
+} entry_t;
+
+static entry_t entries[2 * NUM_ENTRIES];
+
+static void
+init_entries (void)
+{
+    int i;
+
+    /* Use glyph-index-like keys, half of which are never inserted so
+     * that lookups are a mix of hits and misses. */
+    for (i = 0; i < 2 * NUM_ENTRIES; i++)
+	entries[i].base.hash = i;
+}
+
+static cairo_time_t
+do_hash_table_insert (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_hash_table_t *table;
+    int i;
+
+    table = _cairo_hash_table_create (NULL);
+    if (table == NULL)
+	return 0;
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	for (i = 0; i < NUM_ENTRIES; i++) {
+	    if (_cairo_hash_table_insert (table, &entries[2 * i].base))
+		break;
+	}
+	while (i--)
+	    _cairo_hash_table_remove (table, &entries[2 * i].base);
+    }
+
+    cairo_perf_timer_stop ();
+
+    _cairo_hash_table_destroy (table);
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+do_hash_table_lookup (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_hash_table_t *table;
+    int i, n, found;
+
+    table = _cairo_hash_table_create (NULL);
+    if (table == NULL)
+	return 0;
+
+    for (n = 0; n < NUM_ENTRIES; n++) {
+	if (_cairo_hash_table_insert (table, &entries[2 * n].base))
+	    break;
+    }
+    if (n == 0) {
+	_cairo_hash_table_destroy (table);
+	return 0;
+    }
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	/* Stride through the keys so that the lookup cache rarely hits */
+	found = 0;
+	for (i = 0; i < 2 * NUM_ENTRIES; i++) {
+	    cairo_hash_entry_t key;
+
+	    key.hash = (i * 37) & (2 * NUM_ENTRIES - 1);
+	    found += _cairo_hash_table_lookup (table, &key) != NULL;
+	}
+	assert (found == n);
+    }
+
+    cairo_perf_timer_stop ();
+
+    while (n--)
+	_cairo_hash_table_remove (table, &entries[2 * n].base);
+    _cairo_hash_table_destroy (table);
+
+    return cairo_perf_timer_elapsed ();
+}
+
+cairo_bool_t
+hash_table_ops_enabled (cairo_perf_t *perf)
+{
+    return cairo_perf_can_run (perf, "hash-table-ops", NULL);
+}
+
+void
+hash_table_ops (cairo_perf_t *perf, cairo_t *cr, int width, int height)
+{
+    init_entries ();
+
+    cairo_perf_run (perf, "hash-table-ops-insert", do_hash_table_insert, NULL);
+    cairo_perf_run (perf, "hash-table-ops-lookup", do_hash_table_lookup, NULL);
+}
@@ -0,0 +1,218 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Scroll a small viewport over a large recording, as a document viewer
+ * does. Only a handful of the recorded commands are visible each time,
+ * so this measures how quickly the replay finds them.
+ */
+
+#include "cairo-perf.h"
+
+#define RECORDING_SIZE 8192
+#define NUM_COMMANDS 50000
+
+static uint32_t state;
+
+static double
+uniform_random (double minval, double maxval)
+{
+    static uint32_t const poly = 0x9a795537U;
+    uint32_t n = 32;
+    while (n-->0)
+	state = 2*state < state ? (2*state ^ poly) : 2*state;
+    return minval + state * (maxval - minval) / 4294967296.0;
+}
+
+/* A page of small shapes laid out in reading order, over a background */
+static cairo_surface_t *
+record_document (void)
+{
+    cairo_surface_t *recording;
+    cairo_t *cr;
+    int n, cols = RECORDING_SIZE / 32;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						NULL);
+    cr = cairo_create (recording);
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_rectangle (cr, 0, 0, RECORDING_SIZE, RECORDING_SIZE);
+    cairo_fill (cr);
+
+    state = 0xc0ffee;
+    for (n = 0; n < NUM_COMMANDS; n++) {
+	double x = (n % cols) * 32 + uniform_random (0, 8);
+	double y = (n / cols) * 40 + uniform_random (0, 8);
+
+	cairo_set_source_rgb (cr,
+			      uniform_random (0, 1),
+			      uniform_random (0, 1),
+			      uniform_random (0, 1));
+	cairo_rectangle (cr, x, y,
+			 uniform_random (4, 24), uniform_random (4, 24));
+	cairo_fill (cr);
+    }
+
+    cairo_destroy (cr);
+    return recording;
+}
+
+/* The same number of shapes, recorded in no particular spatial order */
+static cairo_surface_t *
+record_scattered (void)
+{
+    cairo_surface_t *recording;
+    cairo_t *cr;
+    int n;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						NULL);
+    cr = cairo_create (recording);
+
+    state = 0xc0ffee;
+    for (n = 0; n < NUM_COMMANDS; n++) {
+	cairo_set_source_rgb (cr,
+			      uniform_random (0, 1),
+			      uniform_random (0, 1),
+			      uniform_random (0, 1));
+	cairo_rectangle (cr,
+			 uniform_random (0, RECORDING_SIZE),
+			 uniform_random (0, RECORDING_SIZE),
+			 uniform_random (4, 24), uniform_random (4, 24));
+	cairo_fill (cr);
+    }
+
+    cairo_destroy (cr);
+    return recording;
+}
+
+/* A bar chart: a long run of fills that differ only in their shape */
+static cairo_surface_t *
+record_chart (int width, int height)
+{
+    cairo_surface_t *recording;
+    cairo_rectangle_t extents;
+    cairo_t *cr;
+    int n, num_bars = width / 2;
+
+    extents.x = extents.y = 0;
+    extents.width = width;
+    extents.height = height;
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						&extents);
+    cr = cairo_create (recording);
+
+    state = 0xc0ffee;
+    cairo_set_source_rgb (cr, 0.2, 0.4, 0.8);
+    for (n = 0; n < num_bars; n++) {
+	double h = uniform_random (0, height);
+
+	cairo_rectangle (cr, n * 2 + .25, height - h, 1.5, h);
+	cairo_fill (cr);
+    }
+
+    cairo_destroy (cr);
+    return recording;
+}
+
+static cairo_time_t
+do_replay_viewport (cairo_t *cr, cairo_surface_t *recording,
+		    int width, int height, int loops)
+{
+    state = 0xdeadbeef;
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	double x = floor (uniform_random (0, RECORDING_SIZE - width));
+	double y = floor (uniform_random (0, RECORDING_SIZE - height));
+
+	cairo_set_source_surface (cr, recording, -x, -y);
+	cairo_paint (cr);
+    }
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+do_replay_viewport_document (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_surface_t *recording;
+    cairo_time_t elapsed;
+
+    recording = record_document ();
+    elapsed = do_replay_viewport (cr, recording, width, height, loops);
+    cairo_surface_destroy (recording);
+
+    return elapsed;
+}
+
+static cairo_time_t
+do_replay_viewport_scattered (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_surface_t *recording;
+    cairo_time_t elapsed;
+
+    recording = record_scattered ();
+    elapsed = do_replay_viewport (cr, recording, width, height, loops);
+    cairo_surface_destroy (recording);
+
+    return elapsed;
+}
+
+static cairo_time_t
+do_replay_chart (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_surface_t *recording;
+
+    recording = record_chart (width, height);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_surface_destroy (recording);
+
+    cairo_perf_timer_start ();
+
+    while (loops--)
+	cairo_paint (cr);
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+cairo_bool_t
+recording_replay_enabled (cairo_perf_t *perf)
+{
+    return cairo_perf_can_run (perf, "recording-replay", NULL);
+}
+
+void
+recording_replay (cairo_perf_t *perf, cairo_t *cr, int width, int height)
+{
+    cairo_perf_run (perf, "recording-replay-viewport-document",
+		    do_replay_viewport_document, NULL);
+    cairo_perf_run (perf, "recording-replay-viewport-scattered",
+		    do_replay_viewport_scattered, NULL);
+    cairo_perf_run (perf, "recording-replay-chart",
+		    do_replay_chart, NULL);
+}
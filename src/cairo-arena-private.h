@@ -0,0 +1,108 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is agent.
+ *
+ * Contributor(s):
+ *	agent <agent@local>
+ */
+
+#ifndef CAIRO_ARENA_PRIVATE_H
+#define CAIRO_ARENA_PRIVATE_H
+
+#include "cairo-compiler-private.h"
+#include "cairo-types-private.h"
+
+CAIRO_BEGIN_DECLS
+
+/* A bump allocator for the temporary arrays built up during a single
+ * drawing operation: the edges of a polygon and its trapezoids.
+ *
+ * A context owns an arena and makes it current for the calling thread
+ * for the duration of a fill or stroke, see _cairo_arena_enter(). All
+ * of it is released at once when the operation leaves the arena, so
+ * memory taken from an arena must never outlive the operation. Hence
+ * nothing uses the arena implicitly: only the polygons and traps that
+ * a compositor builds and finishes within a single fill or stroke opt
+ * in, through _cairo_polygon_use_arena() and _cairo_traps_use_arena().
+ *
+ * Blocks cannot be freed individually. The most recent allocation may
+ * be extended in place, see _cairo_arena_extend(); an array that needs
+ * to grow any further moves to the heap for the rest of its life, so
+ * that each array abandons at most one block to the arena. So does an
+ * array for which the arena fails to allocate a new chunk.
+ *
+ * The arena is only ever used by the thread that entered it. Builds
+ * without real thread support have no thread-local storage to track
+ * the current arena, so none is ever current and everything comes
+ * from malloc as before.
+ */
+typedef struct _cairo_arena_chunk cairo_arena_chunk_t;
+
+struct _cairo_arena {
+    cairo_arena_chunk_t *chunks;
+    cairo_arena_chunk_t *current;
+    void *last;
+    size_t retained;
+    int depth;
+};
+
+cairo_private void
+_cairo_arena_init (cairo_arena_t *arena);
+
+cairo_private void
+_cairo_arena_fini (cairo_arena_t *arena);
+
+cairo_private cairo_arena_t *
+_cairo_arena_get_current (void);
+
+cairo_private cairo_arena_t *
+_cairo_arena_enter (cairo_arena_t *arena);
+
+cairo_private void
+_cairo_arena_leave (cairo_arena_t *arena, cairo_arena_t *previous);
+
+cairo_private void *
+_cairo_arena_alloc (cairo_arena_t *arena, size_t size);
+
+cairo_private cairo_bool_t
+_cairo_arena_extend (cairo_arena_t *arena, void *ptr, size_t new_size);
+
+/* Overflow-checked variants, matching _cairo_malloc_ab() and friends. */
+#define _cairo_arena_alloc_ab(arena, a, size) \
+  ((size) && (unsigned) (a) >= INT32_MAX / (unsigned) (size) ? NULL : \
+   _cairo_arena_alloc (arena, (unsigned) (a) * (unsigned) (size)))
+
+#define _cairo_arena_extend_ab(arena, ptr, a, size) \
+  ((size) && (unsigned) (a) >= INT32_MAX / (unsigned) (size) ? FALSE : \
+   _cairo_arena_extend (arena, ptr, (unsigned) (a) * (unsigned) (size)))
+
+CAIRO_END_DECLS
+
+#endif /* CAIRO_ARENA_PRIVATE_H */
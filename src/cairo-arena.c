@@ -0,0 +1,254 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is agent.
+ *
+ * Contributor(s):
+ *	agent <agent@local>
+ */
+
+#include "cairoint.h"
+
+#include "cairo-arena-private.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_ALIGN_SIZE(size) (((size) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+#define ARENA_MIN_CHUNK_SIZE (16 * 1024)
+#define ARENA_MAX_CHUNK_SIZE (1024 * 1024)
+
+/* Once the arena holds more than this, its chunks (bar the first) are
+ * returned to the system at the end of the operation rather than being
+ * kept around for the next one. */
+#define ARENA_MAX_RETAINED (4 * 1024 * 1024)
+
+struct _cairo_arena_chunk {
+    cairo_arena_chunk_t *next;
+    size_t size;
+    size_t used;
+};
+
+#define CHUNK_HEADER_SIZE ARENA_ALIGN_SIZE (sizeof (cairo_arena_chunk_t))
+#define CHUNK_DATA(chunk) ((uint8_t *) (chunk) + CHUNK_HEADER_SIZE)
+
+#if CAIRO_HAS_REAL_PTHREAD
+
+#include <pthread.h>
+
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t arena_key;
+static cairo_bool_t arena_has_key;
+
+static void
+arena_init_key (void)
+{
+    arena_has_key = pthread_key_create (&arena_key, NULL) == 0;
+}
+
+cairo_arena_t *
+_cairo_arena_get_current (void)
+{
+    pthread_once (&arena_once, arena_init_key);
+    if (unlikely (! arena_has_key))
+	return NULL;
+
+    return pthread_getspecific (arena_key);
+}
+
+static void
+_cairo_arena_set_current (cairo_arena_t *arena)
+{
+    pthread_once (&arena_once, arena_init_key);
+    if (likely (arena_has_key))
+	pthread_setspecific (arena_key, arena);
+}
+
+#else
+
+/* Without thread-local storage we cannot tell whether another thread
+ * is using cairo at the same time, so we never make an arena current. */
+
+cairo_arena_t *
+_cairo_arena_get_current (void)
+{
+    return NULL;
+}
+
+static void
+_cairo_arena_set_current (cairo_arena_t *arena)
+{
+}
+
+#endif
+
+void
+_cairo_arena_init (cairo_arena_t *arena)
+{
+    arena->chunks = NULL;
+    arena->current = NULL;
+    arena->last = NULL;
+    arena->retained = 0;
+    arena->depth = 0;
+}
+
+void
+_cairo_arena_fini (cairo_arena_t *arena)
+{
+    cairo_arena_chunk_t *chunk, *next;
+
+    assert (arena->depth == 0);
+
+    for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+	next = chunk->next;
+	free (chunk);
+    }
+}
+
+static void
+_cairo_arena_reset (cairo_arena_t *arena)
+{
+    cairo_arena_chunk_t *chunk, *next;
+
+    arena->current = arena->chunks;
+    arena->last = NULL;
+    if (arena->current == NULL)
+	return;
+
+    arena->current->used = 0;
+
+    if (unlikely (arena->retained > ARENA_MAX_RETAINED)) {
+	for (chunk = arena->chunks->next; chunk != NULL; chunk = next) {
+	    next = chunk->next;
+	    free (chunk);
+	}
+	arena->chunks->next = NULL;
+	arena->retained = arena->chunks->size;
+    }
+}
+
+cairo_arena_t *
+_cairo_arena_enter (cairo_arena_t *arena)
+{
+    cairo_arena_t *previous;
+
+    previous = _cairo_arena_get_current ();
+    _cairo_arena_set_current (arena);
+    arena->depth++;
+
+    return previous;
+}
+
+void
+_cairo_arena_leave (cairo_arena_t *arena, cairo_arena_t *previous)
+{
+    assert (arena->depth > 0);
+
+    _cairo_arena_set_current (previous);
+    if (--arena->depth == 0)
+	_cairo_arena_reset (arena);
+}
+
+static cairo_arena_chunk_t *
+_cairo_arena_next_chunk (cairo_arena_t *arena, size_t size)
+{
+    cairo_arena_chunk_t *current = arena->current;
+    cairo_arena_chunk_t *chunk;
+    size_t chunk_size;
+
+    /* reuse a chunk retained from an earlier operation */
+    chunk = current ? current->next : NULL;
+    if (chunk != NULL && chunk->size >= size) {
+	chunk->used = 0;
+	return arena->current = chunk;
+    }
+
+    chunk_size = ARENA_MIN_CHUNK_SIZE;
+    if (current != NULL)
+	chunk_size = MIN (2 * current->size, ARENA_MAX_CHUNK_SIZE);
+    if (chunk_size < size)
+	chunk_size = size;
+
+    chunk = _cairo_malloc (CHUNK_HEADER_SIZE + chunk_size);
+    if (unlikely (chunk == NULL))
+	return NULL;
+
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    if (current != NULL) {
+	chunk->next = current->next;
+	current->next = chunk;
+    } else {
+	chunk->next = NULL;
+	arena->chunks = chunk;
+    }
+    arena->retained += chunk_size;
+
+    return arena->current = chunk;
+}
+
+void *
+_cairo_arena_alloc (cairo_arena_t *arena, size_t size)
+{
+    cairo_arena_chunk_t *chunk;
+    void *ptr;
+
+    size = ARENA_ALIGN_SIZE (size);
+
+    chunk = arena->current;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+	chunk = _cairo_arena_next_chunk (arena, size);
+	if (unlikely (chunk == NULL))
+	    return NULL;
+    }
+
+    ptr = CHUNK_DATA (chunk) + chunk->used;
+    chunk->used += size;
+
+    return arena->last = ptr;
+}
+
+/* Grow the most recent allocation in place, if it still fits within
+ * its chunk. Any other block is left alone and FALSE is returned, the
+ * caller then has to move its data elsewhere. */
+cairo_bool_t
+_cairo_arena_extend (cairo_arena_t *arena, void *ptr, size_t new_size)
+{
+    cairo_arena_chunk_t *chunk = arena->current;
+    size_t offset;
+
+    if (ptr == NULL || ptr != arena->last)
+	return FALSE;
+
+    offset = (uint8_t *) ptr - CHUNK_DATA (chunk);
+    if (chunk->size - offset < ARENA_ALIGN_SIZE (new_size))
+	return FALSE;
+
+    chunk->used = offset + ARENA_ALIGN_SIZE (new_size);
+    return TRUE;
+}
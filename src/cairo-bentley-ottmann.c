@@ -42,6 +42,7 @@
 #include "cairo-freelist-private.h"
 #include "cairo-combsort-inline.h"
 #include "cairo-traps-private.h"
+#include "cairo-thread-pool-private.h"
 
 #define DEBUG_PRINT_STATE 0
 #define DEBUG_EVENTS 0
@@ -1679,10 +1680,12 @@ _cairo_bentley_ottmann_tessellate_bo_edges (cairo_bo_event_t   **start_events,
     return status;
 }
 
-cairo_status_t
-_cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t	 *traps,
-					   const cairo_polygon_t *polygon,
-					   cairo_fill_rule_t	  fill_rule)
+static cairo_status_t
+_cairo_bentley_ottmann_tessellate_edges (cairo_traps_t		*traps,
+					 const cairo_edge_t	*edges,
+					 int			 num_edges,
+					 const cairo_box_t	*limit,
+					 cairo_fill_rule_t	 fill_rule)
 {
     int intersections;
     cairo_bo_start_event_t stack_events[CAIRO_STACK_ARRAY_LENGTH (cairo_bo_start_event_t)];
@@ -1694,13 +1697,13 @@ _cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t	 *traps,
     int i, num_events, y, ymin, ymax;
     cairo_status_t status;
 
-    num_events = polygon->num_edges;
+    num_events = num_edges;
     if (unlikely (0 == num_events))
 	return CAIRO_STATUS_SUCCESS;
 
-    if (polygon->num_limits) {
-	ymin = _cairo_fixed_integer_floor (polygon->limit.p1.y);
-	ymax = _cairo_fixed_integer_ceil (polygon->limit.p2.y) - ymin;
+    if (limit) {
+	ymin = _cairo_fixed_integer_floor (limit->p1.y);
+	ymax = _cairo_fixed_integer_ceil (limit->p2.y) - ymin;
 
 	if (ymax > 64)
 	    event_y = _cairo_malloc_ab(sizeof (cairo_bo_event_t*), ymax);
@@ -1724,12 +1727,12 @@ _cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t	 *traps,
 
     for (i = 0; i < num_events; i++) {
 	events[i].type = CAIRO_BO_EVENT_TYPE_START;
-	events[i].point.y = polygon->edges[i].top;
+	events[i].point.y = edges[i].top;
 	events[i].point.x =
-	    _line_compute_intersection_x_for_y (&polygon->edges[i].line,
+	    _line_compute_intersection_x_for_y (&edges[i].line,
 						events[i].point.y);
 
-	events[i].edge.edge = polygon->edges[i];
+	events[i].edge.edge = edges[i];
 	events[i].edge.deferred_trap.right = NULL;
 	events[i].edge.prev = NULL;
 	events[i].edge.next = NULL;
@@ -1762,10 +1765,6 @@ _cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t	 *traps,
     dump_edges (events, num_events, "bo-polygon-edges.txt");
 #endif
 
-    /* XXX: This would be the convenient place to throw in multiple
-     * passes of the Bentley-Ottmann algorithm. It would merely
-     * require storing the results of each pass into a temporary
-     * cairo_traps_t. */
     status = _cairo_bentley_ottmann_tessellate_bo_edges (event_ptrs, num_events,
 							 fill_rule, traps,
 							 &intersections);
@@ -1779,6 +1778,248 @@ _cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t	 *traps,
     return status;
 }
 
+/* Very large polygons may be split into horizontal bands which are
+ * swept independently on the thread pool. The winding of any point
+ * only depends upon the edges crossing its scanline, so sweeping the
+ * edges clipped to each band and concatenating the traps covers
+ * exactly the same area as a single sweep, at the cost of splitting
+ * the trapezoids that cross a band boundary.
+ */
+#define BO_BAND_MIN_EDGES 4096
+#define BO_BAND_MAX_BANDS CAIRO_THREAD_POOL_MAX_THREADS
+#define BO_BAND_HISTOGRAM 256
+
+typedef struct _cairo_bo_band {
+    const cairo_polygon_t *polygon;
+    cairo_fill_rule_t fill_rule;
+    cairo_box_t limit;
+
+    cairo_traps_t traps;
+    cairo_status_t status;
+} cairo_bo_band_t;
+
+static void
+_cairo_bo_band_tessellate (void *closure)
+{
+    cairo_bo_band_t *band = closure;
+    const cairo_polygon_t *polygon = band->polygon;
+    cairo_fixed_t top = band->limit.p1.y;
+    cairo_fixed_t bottom = band->limit.p2.y;
+    cairo_edge_t *edges;
+    int i, num_edges;
+
+    num_edges = 0;
+    for (i = 0; i < polygon->num_edges; i++) {
+	if (polygon->edges[i].top < bottom && polygon->edges[i].bottom > top)
+	    num_edges++;
+    }
+    if (num_edges == 0) {
+	band->status = CAIRO_STATUS_SUCCESS;
+	return;
+    }
+
+    edges = _cairo_malloc_ab (num_edges, sizeof (cairo_edge_t));
+    if (unlikely (edges == NULL)) {
+	band->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	return;
+    }
+
+    num_edges = 0;
+    for (i = 0; i < polygon->num_edges; i++) {
+	const cairo_edge_t *edge = &polygon->edges[i];
+
+	if (edge->top < bottom && edge->bottom > top) {
+	    edges[num_edges] = *edge;
+	    if (edge->top < top)
+		edges[num_edges].top = top;
+	    if (edge->bottom > bottom)
+		edges[num_edges].bottom = bottom;
+	    num_edges++;
+	}
+    }
+
+    band->status = _cairo_bentley_ottmann_tessellate_edges (&band->traps,
+							    edges, num_edges,
+							    &band->limit,
+							    band->fill_rule);
+    free (edges);
+}
+
+static int
+_cairo_bo_num_bands (const cairo_polygon_t *polygon, int max_threads)
+{
+    int num_bands;
+
+    if (max_threads <= 1 || polygon->num_edges < 2 * BO_BAND_MIN_EDGES)
+	return 1;
+
+    num_bands = MIN (max_threads, BO_BAND_MAX_BANDS);
+    if (num_bands > polygon->num_edges / BO_BAND_MIN_EDGES)
+	num_bands = polygon->num_edges / BO_BAND_MIN_EDGES;
+
+    return num_bands;
+}
+
+/* Choose the band boundaries, on whole pixel rows, so that each band
+ * sweeps about the same number of active edges. Returns the number of
+ * bands actually used. */
+static int
+_cairo_bo_band_split (const cairo_polygon_t *polygon,
+		      int num_bands,
+		      cairo_fixed_t *cuts)
+{
+    int64_t histogram[BO_BAND_HISTOGRAM + 1];
+    int64_t total, sum, active;
+    cairo_fixed_t top, bottom;
+    int ymin, ymax, height, bin, i, n;
+
+    top = polygon->edges[0].top;
+    bottom = polygon->edges[0].bottom;
+    for (i = 1; i < polygon->num_edges; i++) {
+	if (polygon->edges[i].top < top)
+	    top = polygon->edges[i].top;
+	if (polygon->edges[i].bottom > bottom)
+	    bottom = polygon->edges[i].bottom;
+    }
+
+    ymin = _cairo_fixed_integer_floor (top);
+    ymax = _cairo_fixed_integer_ceil (bottom);
+    height = ymax - ymin;
+    if (height < num_bands)
+	return 1;
+
+    bin = (height + BO_BAND_HISTOGRAM - 1) / BO_BAND_HISTOGRAM;
+
+    /* Accumulate the start of each edge and, through a difference
+     * array, the number of rows it remains active. */
+    memset (histogram, 0, sizeof (histogram));
+    for (i = 0; i < polygon->num_edges; i++) {
+	const cairo_edge_t *edge = &polygon->edges[i];
+	int first = (_cairo_fixed_integer_floor (edge->top) - ymin) / bin;
+	int last = (_cairo_fixed_integer_ceil (edge->bottom) - ymin + bin - 1) / bin;
+
+	histogram[first]++;
+	histogram[last]--;
+    }
+
+    total = 0;
+    active = 0;
+    for (i = 0; i < BO_BAND_HISTOGRAM; i++) {
+	active += histogram[i];
+	histogram[i] = active;
+	total += active;
+    }
+
+    cuts[0] = top;
+    n = 1;
+    sum = 0;
+    for (i = 0; i < BO_BAND_HISTOGRAM && n < num_bands; i++) {
+	sum += histogram[i];
+	if (sum * num_bands >= total * n) {
+	    int y = ymin + (i + 1) * bin;
+
+	    if (y >= ymax)
+		break;
+
+	    cuts[n++] = _cairo_fixed_from_int (y);
+	}
+    }
+    cuts[n] = bottom;
+
+    return n;
+}
+
+static cairo_status_t
+_cairo_bentley_ottmann_tessellate_bands (cairo_traps_t		*traps,
+					 const cairo_polygon_t	*polygon,
+					 cairo_fill_rule_t	 fill_rule,
+					 int			 num_bands)
+{
+    cairo_bo_band_t bands[BO_BAND_MAX_BANDS];
+    cairo_fixed_t cuts[BO_BAND_MAX_BANDS + 1];
+    cairo_status_t status;
+    int i, j;
+
+    num_bands = _cairo_bo_band_split (polygon, num_bands, cuts);
+    if (num_bands <= 1) {
+	return _cairo_bentley_ottmann_tessellate_edges (traps,
+							polygon->edges,
+							polygon->num_edges,
+							polygon->num_limits ? &polygon->limit : NULL,
+							fill_rule);
+    }
+
+    for (i = 0; i < num_bands; i++) {
+	bands[i].polygon = polygon;
+	bands[i].fill_rule = fill_rule;
+	bands[i].limit.p1.x = polygon->extents.p1.x;
+	bands[i].limit.p1.y = cuts[i];
+	bands[i].limit.p2.x = polygon->extents.p2.x;
+	bands[i].limit.p2.y = cuts[i+1];
+
+	_cairo_traps_init (&bands[i].traps);
+    }
+
+    _cairo_thread_pool_run (_cairo_bo_band_tessellate,
+			    bands, num_bands, sizeof (cairo_bo_band_t));
+
+    status = CAIRO_STATUS_SUCCESS;
+    for (i = 0; i < num_bands; i++) {
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = bands[i].status;
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = bands[i].traps.status;
+
+	if (status == CAIRO_STATUS_SUCCESS) {
+	    for (j = 0; j < bands[i].traps.num_traps; j++) {
+		cairo_trapezoid_t *t = &bands[i].traps.traps[j];
+
+		_cairo_traps_add_trap (traps,
+				       t->top, t->bottom,
+				       &t->left, &t->right);
+	    }
+	    status = traps->status;
+	}
+
+	_cairo_traps_fini (&bands[i].traps);
+    }
+
+    return status;
+}
+
+cairo_status_t
+_cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t	 *traps,
+					   const cairo_polygon_t *polygon,
+					   cairo_fill_rule_t	  fill_rule)
+{
+    return _cairo_bentley_ottmann_tessellate_edges (traps,
+						    polygon->edges,
+						    polygon->num_edges,
+						    polygon->num_limits ? &polygon->limit : NULL,
+						    fill_rule);
+}
+
+/* As _cairo_bentley_ottmann_tessellate_polygon(), but a very large
+ * polygon may be swept in up to @max_threads bands on the thread pool.
+ * The traps come out in a different order and are split at the band
+ * boundaries, so only callers rendering to a surface that opted in to
+ * threads should use this. */
+cairo_status_t
+_cairo_bentley_ottmann_tessellate_polygon_parallel (cairo_traps_t	  *traps,
+						    const cairo_polygon_t *polygon,
+						    cairo_fill_rule_t	   fill_rule,
+						    int			   max_threads)
+{
+    int num_bands;
+
+    num_bands = _cairo_bo_num_bands (polygon, max_threads);
+    if (num_bands > 1)
+	return _cairo_bentley_ottmann_tessellate_bands (traps, polygon,
+							fill_rule, num_bands);
+
+    return _cairo_bentley_ottmann_tessellate_polygon (traps, polygon, fill_rule);
+}
+
 cairo_status_t
 _cairo_bentley_ottmann_tessellate_traps (cairo_traps_t *traps,
 					 cairo_fill_rule_t fill_rule)
@@ -82,12 +82,40 @@
  * will be used exclusively as a "key", (indicated by a parameter name
  * of key). In these cases, the value-related fields of the entry need
  * not be initialized if so desired.
+ *
+ * The remaining fields are private to the cache and are initialized
+ * by _cairo_cache_insert().
  **/
 typedef struct _cairo_cache_entry {
     unsigned long hash;
     unsigned long size;
+
+    cairo_list_t link;
+    unsigned char referenced;
+    unsigned char is_protected;
 } cairo_cache_entry_t;
 
+/**
+ * _cairo_cache_policy:
+ *
+ * How a #cairo_cache_t chooses the entries to eject when it is full.
+ *
+ * %CAIRO_CACHE_POLICY_RANDOM ejects entries at random, and costs nothing
+ * on lookup. %CAIRO_CACHE_POLICY_CLOCK gives every entry that has been
+ * used since the hand last passed it a second chance. With
+ * %CAIRO_CACHE_POLICY_SLRU (segmented LRU), new entries start out on
+ * probation and are only promoted into the protected segment, which
+ * holds up to 80% of the cache, once they are used again; entries are
+ * ejected from the least recently used end of the probationary segment
+ * first. Both keep a steady working set resident where random ejection
+ * would throw away hot entries.
+ **/
+typedef enum _cairo_cache_policy {
+    CAIRO_CACHE_POLICY_RANDOM,
+    CAIRO_CACHE_POLICY_CLOCK,
+    CAIRO_CACHE_POLICY_SLRU
+} cairo_cache_policy_t;
+
 typedef cairo_bool_t (*cairo_cache_predicate_func_t) (const void *entry);
 
 struct _cairo_cache {
@@ -100,6 +128,15 @@ struct _cairo_cache {
     unsigned long size;
 
     int freeze_count;
+
+    cairo_cache_policy_t policy;
+    unsigned long num_entries;
+    cairo_list_t probation;	/* also the ring for CLOCK */
+    cairo_list_t protected_entries;
+    unsigned long protected_size;
+
+    /* Entries ejected to make room, not counting _cairo_cache_remove() */
+    unsigned long evictions;
 };
 
 typedef cairo_bool_t
@@ -119,16 +156,37 @@ _cairo_cache_init (cairo_cache_t *cache,
 cairo_private void
 _cairo_cache_fini (cairo_cache_t *cache);
 
+cairo_private void
+_cairo_cache_set_policy (cairo_cache_t	     *cache,
+			 cairo_cache_policy_t policy);
+
 cairo_private void
 _cairo_cache_freeze (cairo_cache_t *cache);
 
 cairo_private void
 _cairo_cache_thaw (cairo_cache_t *cache);
 
+cairo_private void
+_cairo_cache_set_max_size (cairo_cache_t *cache,
+			   unsigned long  max_size);
+
 cairo_private void *
 _cairo_cache_lookup (cairo_cache_t	  *cache,
 		     cairo_cache_entry_t  *key);
 
+cairo_private void
+_cairo_cache_touch (cairo_cache_t	 *cache,
+		    cairo_cache_entry_t *entry);
+
+/* Marks @entry as used for a %CAIRO_CACHE_POLICY_CLOCK cache. Unlike
+ * _cairo_cache_touch() this only writes to the entry itself, so it may
+ * be called without holding the lock that protects the cache. */
+static inline void
+_cairo_cache_entry_set_referenced (cairo_cache_entry_t *entry)
+{
+    entry->referenced = TRUE;
+}
+
 cairo_private cairo_status_t
 _cairo_cache_insert (cairo_cache_t	 *cache,
 		     cairo_cache_entry_t *entry);
@@ -38,6 +38,11 @@
 
 #include "cairoint.h"
 #include "cairo-error-private.h"
+#include "cairo-list-inline.h"
+
+/* The share of an SLRU cache reserved for entries that have been used
+ * more than once, in percent. */
+#define SLRU_PROTECTED_SHARE 80
 
 static void
 _cairo_cache_shrink_to_accommodate (cairo_cache_t *cache,
@@ -72,8 +77,9 @@ _cairo_cache_entry_is_non_zero (const void *entry)
  * consistent with the units of the size field of cache entries. When
  * adding an entry with _cairo_cache_insert() if the total size of
  * entries in the cache would exceed max_size then entries will be
- * removed at random until the new entry would fit or the cache is
- * empty. Then the new entry is inserted.
+ * removed, at random unless another policy is chosen with
+ * _cairo_cache_set_policy(), until the new entry would fit or the cache
+ * is empty. Then the new entry is inserted.
  *
  * There are cases in which the automatic removal of entries is
  * undesired. If the cache entries have reference counts, then it is a
@@ -106,9 +112,34 @@ _cairo_cache_init (cairo_cache_t		*cache,
 
     cache->freeze_count = 0;
 
+    cache->policy = CAIRO_CACHE_POLICY_RANDOM;
+    cache->num_entries = 0;
+    cairo_list_init (&cache->probation);
+    cairo_list_init (&cache->protected_entries);
+    cache->protected_size = 0;
+
+    cache->evictions = 0;
+
     return CAIRO_STATUS_SUCCESS;
 }
 
+/**
+ * _cairo_cache_set_policy:
+ * @cache: a cache, which must still be empty
+ * @policy: the #cairo_cache_policy_t used to choose entries to eject
+ *
+ * Selects how @cache chooses the entries to remove when it needs to
+ * make room. Caches start out with %CAIRO_CACHE_POLICY_RANDOM.
+ **/
+void
+_cairo_cache_set_policy (cairo_cache_t	      *cache,
+			 cairo_cache_policy_t  policy)
+{
+    assert (cache->num_entries == 0);
+
+    cache->policy = policy;
+}
+
 static void
 _cairo_cache_pluck (void *entry, void *closure)
 {
@@ -179,6 +210,23 @@ _cairo_cache_thaw (cairo_cache_t *cache)
 	_cairo_cache_shrink_to_accommodate (cache, 0);
 }
 
+/**
+ * _cairo_cache_set_max_size:
+ * @cache: a cache
+ * @max_size: the new limit on the sum of the sizes of all entries
+ *
+ * Changes the size limit of @cache. If the cache is not frozen and
+ * now exceeds @max_size, entries are ejected immediately until it fits.
+ **/
+void
+_cairo_cache_set_max_size (cairo_cache_t *cache,
+			   unsigned long  max_size)
+{
+    cache->max_size = max_size;
+    if (cache->freeze_count == 0)
+	_cairo_cache_shrink_to_accommodate (cache, 0);
+}
+
 /**
  * _cairo_cache_lookup:
  * @cache: a cache
@@ -197,8 +245,63 @@ void *
 _cairo_cache_lookup (cairo_cache_t	  *cache,
 		     cairo_cache_entry_t  *key)
 {
-    return _cairo_hash_table_lookup (cache->hash_table,
-				     (cairo_hash_entry_t *) key);
+    cairo_cache_entry_t *entry;
+
+    entry = _cairo_hash_table_lookup (cache->hash_table,
+				      (cairo_hash_entry_t *) key);
+    if (entry == NULL)
+	return NULL;
+
+    _cairo_cache_touch (cache, entry);
+    return entry;
+}
+
+static void
+_cairo_cache_slru_demote (cairo_cache_t *cache)
+{
+    unsigned long limit = cache->max_size / 100 * SLRU_PROTECTED_SHARE +
+			  cache->max_size % 100 * SLRU_PROTECTED_SHARE / 100;
+
+    while (cache->protected_size > limit) {
+	cairo_cache_entry_t *entry;
+
+	entry = cairo_list_first_entry (&cache->protected_entries,
+					cairo_cache_entry_t, link);
+	entry->is_protected = FALSE;
+	cache->protected_size -= entry->size;
+	cairo_list_move_tail (&entry->link, &cache->probation);
+    }
+}
+
+/**
+ * _cairo_cache_touch:
+ * @cache: a cache
+ * @entry: an entry that exists in the cache
+ *
+ * Records a use of @entry that did not go through _cairo_cache_lookup(),
+ * so that the eviction policy of the cache favours keeping it.
+ **/
+void
+_cairo_cache_touch (cairo_cache_t	*cache,
+		    cairo_cache_entry_t *entry)
+{
+    switch (cache->policy) {
+    case CAIRO_CACHE_POLICY_RANDOM:
+	break;
+
+    case CAIRO_CACHE_POLICY_CLOCK:
+	entry->referenced = TRUE;
+	break;
+
+    case CAIRO_CACHE_POLICY_SLRU:
+	if (! entry->is_protected) {
+	    entry->is_protected = TRUE;
+	    cache->protected_size += entry->size;
+	}
+	cairo_list_move_tail (&entry->link, &cache->protected_entries);
+	_cairo_cache_slru_demote (cache);
+	break;
+    }
 }
 
 /**
@@ -225,12 +328,75 @@ _cairo_cache_remove_random (cairo_cache_t *cache)
     return TRUE;
 }
 
+/* Sweeps the hand (the head of the ring) around, clearing the reference
+ * of the entries it passes, until it finds one that has not been used
+ * since its last visit. Entries refused by the predicate are skipped,
+ * so give up after going twice around the ring. */
+static cairo_bool_t
+_cairo_cache_remove_clock (cairo_cache_t *cache)
+{
+    unsigned long n;
+
+    for (n = 2 * cache->num_entries; n--; ) {
+	cairo_cache_entry_t *entry;
+
+	entry = cairo_list_first_entry (&cache->probation,
+					cairo_cache_entry_t, link);
+	cairo_list_move_tail (&entry->link, &cache->probation);
+
+	if (entry->referenced) {
+	    entry->referenced = FALSE;
+	    continue;
+	}
+
+	if (cache->predicate (entry)) {
+	    _cairo_cache_remove (cache, entry);
+	    return TRUE;
+	}
+    }
+
+    return FALSE;
+}
+
+static cairo_bool_t
+_cairo_cache_remove_lru (cairo_cache_t *cache, cairo_list_t *list)
+{
+    cairo_cache_entry_t *entry;
+
+    cairo_list_foreach_entry (entry, cairo_cache_entry_t, list, link) {
+	if (cache->predicate (entry)) {
+	    _cairo_cache_remove (cache, entry);
+	    return TRUE;
+	}
+    }
+
+    return FALSE;
+}
+
+static cairo_bool_t
+_cairo_cache_remove_one (cairo_cache_t *cache)
+{
+    switch (cache->policy) {
+    default:
+    case CAIRO_CACHE_POLICY_RANDOM:
+	return _cairo_cache_remove_random (cache);
+
+    case CAIRO_CACHE_POLICY_CLOCK:
+	return _cairo_cache_remove_clock (cache);
+
+    case CAIRO_CACHE_POLICY_SLRU:
+	return _cairo_cache_remove_lru (cache, &cache->probation) ||
+	       _cairo_cache_remove_lru (cache, &cache->protected_entries);
+    }
+}
+
 /**
  * _cairo_cache_shrink_to_accommodate:
  * @cache: a cache
  * @additional: additional size requested in bytes
  *
- * If cache is not frozen, eject entries randomly until the size of
+ * If cache is not frozen, eject entries according to the policy of the
+ * cache until the size of
  * the cache is at least @additional bytes less than
  * cache->max_size. That is, make enough room to accommodate a new
  * entry of size @additional.
@@ -240,8 +406,9 @@ _cairo_cache_shrink_to_accommodate (cairo_cache_t *cache,
 				    unsigned long  additional)
 {
     while (cache->size + additional > cache->max_size) {
-	if (! _cairo_cache_remove_random (cache))
+	if (! _cairo_cache_remove_one (cache))
 	    return;
+	cache->evictions++;
     }
 }
 
@@ -272,6 +439,12 @@ _cairo_cache_insert (cairo_cache_t	 *cache,
 	return status;
 
     cache->size += entry->size;
+    cache->num_entries++;
+
+    entry->referenced = FALSE;
+    entry->is_protected = FALSE;
+    if (cache->policy != CAIRO_CACHE_POLICY_RANDOM)
+	cairo_list_add_tail (&entry->link, &cache->probation);
 
     return CAIRO_STATUS_SUCCESS;
 }
@@ -288,6 +461,13 @@ _cairo_cache_remove (cairo_cache_t	 *cache,
 		     cairo_cache_entry_t *entry)
 {
     cache->size -= entry->size;
+    cache->num_entries--;
+
+    if (cache->policy != CAIRO_CACHE_POLICY_RANDOM) {
+	if (entry->is_protected)
+	    cache->protected_size -= entry->size;
+	cairo_list_del (&entry->link);
+    }
 
     _cairo_hash_table_remove (cache->hash_table,
 			      (cairo_hash_entry_t *) entry);
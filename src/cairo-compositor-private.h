@@ -294,6 +294,14 @@ struct cairo_traps_compositor {
 				 int				 dst_x,
 				 int				 dst_y,
 				 cairo_composite_glyphs_info_t  *info);
+
+    /* optional: tessellate large polygons in bands in parallel,
+     * returns the maximum number of threads to use for the surface */
+    int (*num_threads) (void *surface);
+
+    /* optional: whether fills onto the surface may be looked up in the
+     * tessellation cache */
+    cairo_bool_t (*cache_fills) (void *surface);
 };
 
 cairo_private extern const cairo_compositor_t __cairo_no_compositor;
@@ -0,0 +1,87 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is agent.
+ *
+ * Contributor(s):
+ *	agent <agent@local>
+ */
+
+#ifndef CAIRO_CONTENT_HASH_PRIVATE_H
+#define CAIRO_CONTENT_HASH_PRIVATE_H
+
+#include "cairo-compiler-private.h"
+#include "cairo-types-private.h"
+
+CAIRO_BEGIN_DECLS
+
+/* A 256-bit digest of what a surface looks like, as opposed to which
+ * surface it is. The digest of an image covers its format, size and
+ * pixels; that of a recording surface covers its extents and every
+ * command recorded, with the glyphs of text reduced to their outlines
+ * and nested surfaces to their own digests. Two surfaces with equal
+ * digests can be assumed to render identically, which lets the
+ * vector backends embed byte-identical sources only once.
+ *
+ * The digest is a SHA-256 over an in-memory representation, so it is
+ * only meaningful within the process that computed it.
+ */
+typedef struct _cairo_content_digest {
+    uint32_t h[8];
+} cairo_content_digest_t;
+
+typedef struct _cairo_content_hash {
+    uint32_t h[8];
+    uint64_t length;
+    unsigned char block[64];
+    unsigned int block_length;
+} cairo_content_hash_t;
+
+cairo_private void
+_cairo_content_hash_init (cairo_content_hash_t *hash);
+
+cairo_private void
+_cairo_content_hash_update (cairo_content_hash_t *hash,
+			    const void		 *data,
+			    size_t		  length);
+
+cairo_private void
+_cairo_content_hash_finish (cairo_content_hash_t   *hash,
+			    cairo_content_digest_t *digest);
+
+/* Returns CAIRO_INT_STATUS_UNSUPPORTED if the content of @surface
+ * cannot be hashed, e.g. for subsurfaces or recordings that use a
+ * raster source pattern. */
+cairo_private cairo_int_status_t
+_cairo_surface_get_content_digest (cairo_surface_t	  *surface,
+				   cairo_content_digest_t *digest);
+
+CAIRO_END_DECLS
+
+#endif /* CAIRO_CONTENT_HASH_PRIVATE_H */
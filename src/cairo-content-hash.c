@@ -0,0 +1,571 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is agent.
+ *
+ * Contributor(s):
+ *	agent <agent@local>
+ */
+
+#include "cairoint.h"
+
+#include "cairo-array-private.h"
+#include "cairo-clip-inline.h"
+#include "cairo-content-hash-private.h"
+#include "cairo-error-private.h"
+#include "cairo-image-surface-private.h"
+#include "cairo-list-inline.h"
+#include "cairo-path-fixed-private.h"
+#include "cairo-pattern-private.h"
+#include "cairo-recording-surface-inline.h"
+#include "cairo-scaled-font-private.h"
+#include "cairo-surface-snapshot-inline.h"
+#include "cairo-surface-subsurface-inline.h"
+
+/* The hash is SHA-256 (FIPS 180-4), fed incrementally. Sources are
+ * shared on nothing more than an equal digest, so unlike the hashes
+ * used for the caches this one must be collision resistant. */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t
+rotr32 (uint32_t x, int r)
+{
+    return (x >> r) | (x << (32 - r));
+}
+
+static void
+_cairo_content_hash_block (cairo_content_hash_t *hash,
+			   const unsigned char	*block)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+	w[i] = ((uint32_t) block[4*i + 0] << 24) |
+	       ((uint32_t) block[4*i + 1] << 16) |
+	       ((uint32_t) block[4*i + 2] <<  8) |
+	       ((uint32_t) block[4*i + 3]);
+    }
+    for (i = 16; i < 64; i++) {
+	uint32_t s0, s1;
+
+	s0 = rotr32 (w[i-15], 7) ^ rotr32 (w[i-15], 18) ^ (w[i-15] >> 3);
+	s1 = rotr32 (w[i-2], 17) ^ rotr32 (w[i-2], 19) ^ (w[i-2] >> 10);
+	w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+
+    a = hash->h[0]; b = hash->h[1]; c = hash->h[2]; d = hash->h[3];
+    e = hash->h[4]; f = hash->h[5]; g = hash->h[6]; h = hash->h[7];
+
+    for (i = 0; i < 64; i++) {
+	uint32_t s0, s1, ch, maj, t1, t2;
+
+	s1 = rotr32 (e, 6) ^ rotr32 (e, 11) ^ rotr32 (e, 25);
+	ch = (e & f) ^ (~e & g);
+	t1 = h + s1 + ch + sha256_k[i] + w[i];
+	s0 = rotr32 (a, 2) ^ rotr32 (a, 13) ^ rotr32 (a, 22);
+	maj = (a & b) ^ (a & c) ^ (b & c);
+	t2 = s0 + maj;
+
+	h = g; g = f; f = e; e = d + t1;
+	d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    hash->h[0] += a; hash->h[1] += b; hash->h[2] += c; hash->h[3] += d;
+    hash->h[4] += e; hash->h[5] += f; hash->h[6] += g; hash->h[7] += h;
+}
+
+void
+_cairo_content_hash_init (cairo_content_hash_t *hash)
+{
+    hash->h[0] = 0x6a09e667;
+    hash->h[1] = 0xbb67ae85;
+    hash->h[2] = 0x3c6ef372;
+    hash->h[3] = 0xa54ff53a;
+    hash->h[4] = 0x510e527f;
+    hash->h[5] = 0x9b05688c;
+    hash->h[6] = 0x1f83d9ab;
+    hash->h[7] = 0x5be0cd19;
+    hash->length = 0;
+    hash->block_length = 0;
+}
+
+void
+_cairo_content_hash_update (cairo_content_hash_t *hash,
+			    const void		 *data,
+			    size_t		  length)
+{
+    const unsigned char *bytes = data;
+
+    if (length == 0)
+	return;
+
+    hash->length += length;
+
+    if (hash->block_length) {
+	size_t n = MIN (length, 64 - hash->block_length);
+
+	memcpy (hash->block + hash->block_length, bytes, n);
+	hash->block_length += n;
+	bytes += n;
+	length -= n;
+
+	if (hash->block_length < 64)
+	    return;
+
+	_cairo_content_hash_block (hash, hash->block);
+	hash->block_length = 0;
+    }
+
+    while (length >= 64) {
+	_cairo_content_hash_block (hash, bytes);
+	bytes += 64;
+	length -= 64;
+    }
+
+    memcpy (hash->block, bytes, length);
+    hash->block_length = length;
+}
+
+void
+_cairo_content_hash_finish (cairo_content_hash_t   *hash,
+			    cairo_content_digest_t *digest)
+{
+    uint64_t bits = hash->length * 8;
+    int i;
+
+    hash->block[hash->block_length++] = 0x80;
+    if (hash->block_length > 56) {
+	memset (hash->block + hash->block_length, 0,
+		64 - hash->block_length);
+	_cairo_content_hash_block (hash, hash->block);
+	hash->block_length = 0;
+    }
+    memset (hash->block + hash->block_length, 0, 56 - hash->block_length);
+    for (i = 0; i < 8; i++)
+	hash->block[56 + i] = bits >> (56 - 8*i);
+    _cairo_content_hash_block (hash, hash->block);
+
+    for (i = 0; i < 8; i++)
+	digest->h[i] = hash->h[i];
+}
+
+static void
+_cairo_content_hash_int (cairo_content_hash_t *hash, int value)
+{
+    _cairo_content_hash_update (hash, &value, sizeof (value));
+}
+
+static void
+_cairo_content_hash_double (cairo_content_hash_t *hash, double value)
+{
+    _cairo_content_hash_update (hash, &value, sizeof (value));
+}
+
+static void
+_cairo_content_hash_matrix (cairo_content_hash_t *hash,
+			    const cairo_matrix_t *matrix)
+{
+    _cairo_content_hash_double (hash, matrix->xx);
+    _cairo_content_hash_double (hash, matrix->yx);
+    _cairo_content_hash_double (hash, matrix->xy);
+    _cairo_content_hash_double (hash, matrix->yy);
+    _cairo_content_hash_double (hash, matrix->x0);
+    _cairo_content_hash_double (hash, matrix->y0);
+}
+
+static void
+_cairo_content_hash_path (cairo_content_hash_t	   *hash,
+			  const cairo_path_fixed_t *path)
+{
+    const cairo_path_buf_t *buf;
+
+    cairo_path_foreach_buf_start (buf, path) {
+	_cairo_content_hash_int (hash, buf->num_ops);
+	_cairo_content_hash_update (hash, buf->op,
+				    buf->num_ops * sizeof (buf->op[0]));
+	_cairo_content_hash_update (hash, buf->points,
+				    buf->num_points * sizeof (buf->points[0]));
+    } cairo_path_foreach_buf_end (buf, path);
+    _cairo_content_hash_int (hash, -1);
+}
+
+static void
+_cairo_content_hash_clip (cairo_content_hash_t *hash,
+			  const cairo_clip_t   *clip)
+{
+    const cairo_clip_path_t *clip_path;
+
+    if (clip == NULL) {
+	_cairo_content_hash_int (hash, 0);
+	return;
+    }
+    if (_cairo_clip_is_all_clipped (clip)) {
+	_cairo_content_hash_int (hash, 1);
+	return;
+    }
+
+    _cairo_content_hash_int (hash, 2);
+    _cairo_content_hash_update (hash, &clip->extents, sizeof (clip->extents));
+    _cairo_content_hash_int (hash, clip->num_boxes);
+    _cairo_content_hash_update (hash, clip->boxes,
+				clip->num_boxes * sizeof (cairo_box_t));
+
+    for (clip_path = clip->path; clip_path; clip_path = clip_path->prev) {
+	_cairo_content_hash_path (hash, &clip_path->path);
+	_cairo_content_hash_int (hash, clip_path->fill_rule);
+	_cairo_content_hash_double (hash, clip_path->tolerance);
+	_cairo_content_hash_int (hash, clip_path->antialias);
+    }
+    _cairo_content_hash_int (hash, -1);
+}
+
+static cairo_int_status_t
+_cairo_content_hash_surface (cairo_content_hash_t *hash,
+			     cairo_surface_t	  *surface);
+
+static cairo_int_status_t
+_cairo_content_hash_pattern (cairo_content_hash_t  *hash,
+			     const cairo_pattern_t *pattern)
+{
+    _cairo_content_hash_int (hash, pattern->type);
+    _cairo_content_hash_int (hash, pattern->filter);
+    _cairo_content_hash_int (hash, pattern->extend);
+    _cairo_content_hash_int (hash, pattern->has_component_alpha);
+    _cairo_content_hash_matrix (hash, &pattern->matrix);
+    _cairo_content_hash_double (hash, pattern->opacity);
+
+    switch (pattern->type) {
+    case CAIRO_PATTERN_TYPE_SOLID: {
+	const cairo_solid_pattern_t *solid = (cairo_solid_pattern_t *) pattern;
+
+	_cairo_content_hash_update (hash, &solid->color, sizeof (solid->color));
+	return CAIRO_INT_STATUS_SUCCESS;
+    }
+
+    case CAIRO_PATTERN_TYPE_SURFACE:
+	return _cairo_content_hash_surface (hash,
+					    ((cairo_surface_pattern_t *) pattern)->surface);
+
+    case CAIRO_PATTERN_TYPE_LINEAR:
+    case CAIRO_PATTERN_TYPE_RADIAL: {
+	const cairo_gradient_pattern_t *gradient = (cairo_gradient_pattern_t *) pattern;
+
+	_cairo_content_hash_int (hash, gradient->n_stops);
+	_cairo_content_hash_update (hash, gradient->stops,
+				    gradient->n_stops * sizeof (cairo_gradient_stop_t));
+	if (pattern->type == CAIRO_PATTERN_TYPE_LINEAR) {
+	    const cairo_linear_pattern_t *linear = (cairo_linear_pattern_t *) pattern;
+
+	    _cairo_content_hash_update (hash, &linear->pd1, sizeof (linear->pd1));
+	    _cairo_content_hash_update (hash, &linear->pd2, sizeof (linear->pd2));
+	} else {
+	    const cairo_radial_pattern_t *radial = (cairo_radial_pattern_t *) pattern;
+
+	    _cairo_content_hash_update (hash, &radial->cd1, sizeof (radial->cd1));
+	    _cairo_content_hash_update (hash, &radial->cd2, sizeof (radial->cd2));
+	}
+	return CAIRO_INT_STATUS_SUCCESS;
+    }
+
+    case CAIRO_PATTERN_TYPE_MESH: {
+	const cairo_mesh_pattern_t *mesh = (cairo_mesh_pattern_t *) pattern;
+	unsigned int num_patches = _cairo_array_num_elements (&mesh->patches);
+
+	_cairo_content_hash_int (hash, num_patches);
+	if (num_patches) {
+	    _cairo_content_hash_update (hash,
+					_cairo_array_index_const (&mesh->patches, 0),
+					num_patches * sizeof (cairo_mesh_patch_t));
+	}
+	return CAIRO_INT_STATUS_SUCCESS;
+    }
+
+    default:
+    case CAIRO_PATTERN_TYPE_RASTER_SOURCE:
+	/* generated on demand, so its content is unknown */
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+    }
+}
+
+static void
+_cairo_content_hash_image_data (cairo_content_hash_t	    *hash,
+				const cairo_image_surface_t *image)
+{
+    size_t row_length;
+    int y;
+
+    _cairo_content_hash_int (hash, image->pixman_format);
+    _cairo_content_hash_int (hash, image->width);
+    _cairo_content_hash_int (hash, image->height);
+
+    /* skip the padding at the end of each row */
+    row_length = ((size_t) image->width *
+		  PIXMAN_FORMAT_BPP (image->pixman_format) + 7) / 8;
+    for (y = 0; y < image->height; y++) {
+	_cairo_content_hash_update (hash,
+				    image->data + (size_t) y * image->stride,
+				    row_length);
+    }
+}
+
+static cairo_int_status_t
+_cairo_content_hash_glyphs (cairo_content_hash_t		  *hash,
+			    const cairo_command_show_text_glyphs_t *command)
+{
+    cairo_scaled_font_t *scaled_font = command->scaled_font;
+    cairo_scaled_glyph_t *scaled_glyph;
+    cairo_int_status_t status = CAIRO_INT_STATUS_SUCCESS;
+    unsigned int i;
+
+    _cairo_content_hash_int (hash, command->utf8_len);
+    _cairo_content_hash_update (hash, command->utf8, command->utf8_len);
+    _cairo_content_hash_int (hash, command->num_clusters);
+    _cairo_content_hash_update (hash, command->clusters,
+				command->num_clusters * sizeof (cairo_text_cluster_t));
+    _cairo_content_hash_int (hash, command->cluster_flags);
+
+    /* The font is identified by the shapes of its glyphs, rather than
+     * by a pointer that may be reused once the recording is gone. */
+    _cairo_content_hash_matrix (hash, &scaled_font->font_matrix);
+    _cairo_content_hash_matrix (hash, &scaled_font->ctm);
+    _cairo_content_hash_int (hash, command->num_glyphs);
+
+    _cairo_scaled_font_freeze_cache (scaled_font);
+    for (i = 0; i < command->num_glyphs; i++) {
+	const cairo_glyph_t *glyph = &command->glyphs[i];
+
+	_cairo_content_hash_update (hash, &glyph->index, sizeof (glyph->index));
+	_cairo_content_hash_double (hash, glyph->x);
+	_cairo_content_hash_double (hash, glyph->y);
+
+	status = _cairo_scaled_glyph_lookup (scaled_font, glyph->index,
+					     CAIRO_SCALED_GLYPH_INFO_METRICS |
+					     CAIRO_SCALED_GLYPH_INFO_PATH,
+					     &scaled_glyph);
+	if (status == CAIRO_INT_STATUS_UNSUPPORTED) {
+	    /* A bitmap font, use the image of the glyph instead */
+	    status = _cairo_scaled_glyph_lookup (scaled_font, glyph->index,
+						 CAIRO_SCALED_GLYPH_INFO_METRICS |
+						 CAIRO_SCALED_GLYPH_INFO_SURFACE,
+						 &scaled_glyph);
+	}
+	if (unlikely (status))
+	    break;
+
+	_cairo_content_hash_double (hash, scaled_glyph->fs_metrics.x_advance);
+	_cairo_content_hash_double (hash, scaled_glyph->fs_metrics.y_advance);
+	if (scaled_glyph->has_info & CAIRO_SCALED_GLYPH_INFO_PATH) {
+	    _cairo_content_hash_path (hash, scaled_glyph->path);
+	} else {
+	    _cairo_content_hash_matrix (hash,
+					&scaled_glyph->surface->base.device_transform);
+	    _cairo_content_hash_image_data (hash, scaled_glyph->surface);
+	}
+    }
+    _cairo_scaled_font_thaw_cache (scaled_font);
+
+    return status;
+}
+
+static cairo_int_status_t
+_cairo_content_hash_recording (cairo_content_hash_t	 *hash,
+			       cairo_recording_surface_t *recording)
+{
+    cairo_command_t **elements;
+    cairo_int_status_t status;
+    unsigned int i, num_elements;
+
+    _cairo_content_hash_update (hash, &recording->extents_pixels,
+				sizeof (recording->extents_pixels));
+    _cairo_content_hash_int (hash, recording->unbounded);
+
+    num_elements = recording->commands.num_elements;
+    _cairo_content_hash_int (hash, num_elements);
+    if (num_elements == 0)
+	return CAIRO_INT_STATUS_SUCCESS;
+
+    elements = _cairo_array_index (&recording->commands, 0);
+    for (i = 0; i < num_elements; i++) {
+	cairo_command_t *command = elements[i];
+
+	_cairo_content_hash_int (hash, command->header.type);
+	_cairo_content_hash_int (hash, command->header.op);
+	_cairo_content_hash_clip (hash, command->header.clip);
+
+	switch (command->header.type) {
+	case CAIRO_COMMAND_PAINT:
+	    status = _cairo_content_hash_pattern (hash, &command->paint.source.base);
+	    break;
+
+	case CAIRO_COMMAND_MASK:
+	    status = _cairo_content_hash_pattern (hash, &command->mask.source.base);
+	    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+		status = _cairo_content_hash_pattern (hash, &command->mask.mask.base);
+	    break;
+
+	case CAIRO_COMMAND_STROKE: {
+	    const cairo_stroke_style_t *style = &command->stroke.style;
+
+	    status = _cairo_content_hash_pattern (hash, &command->stroke.source.base);
+	    _cairo_content_hash_path (hash, &command->stroke.path);
+	    _cairo_content_hash_double (hash, style->line_width);
+	    _cairo_content_hash_int (hash, style->line_cap);
+	    _cairo_content_hash_int (hash, style->line_join);
+	    _cairo_content_hash_double (hash, style->miter_limit);
+	    _cairo_content_hash_int (hash, style->num_dashes);
+	    _cairo_content_hash_update (hash, style->dash,
+					style->num_dashes * sizeof (double));
+	    _cairo_content_hash_double (hash, style->dash_offset);
+	    _cairo_content_hash_matrix (hash, &command->stroke.ctm);
+	    _cairo_content_hash_double (hash, command->stroke.tolerance);
+	    _cairo_content_hash_int (hash, command->stroke.antialias);
+	    break;
+	}
+
+	case CAIRO_COMMAND_FILL:
+	    status = _cairo_content_hash_pattern (hash, &command->fill.source.base);
+	    _cairo_content_hash_path (hash, &command->fill.path);
+	    _cairo_content_hash_int (hash, command->fill.fill_rule);
+	    _cairo_content_hash_double (hash, command->fill.tolerance);
+	    _cairo_content_hash_int (hash, command->fill.antialias);
+	    break;
+
+	case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+	    status = _cairo_content_hash_pattern (hash,
+						  &command->show_text_glyphs.source.base);
+	    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+		status = _cairo_content_hash_glyphs (hash, &command->show_text_glyphs);
+	    break;
+
+	default:
+	    ASSERT_NOT_REACHED;
+	    status = CAIRO_INT_STATUS_UNSUPPORTED;
+	}
+
+	if (unlikely (status))
+	    return status;
+    }
+
+    return CAIRO_INT_STATUS_SUCCESS;
+}
+
+static cairo_int_status_t
+_cairo_content_hash_surface (cairo_content_hash_t *hash,
+			     cairo_surface_t	  *surface)
+{
+    cairo_image_surface_t *image;
+    void *image_extra;
+    cairo_int_status_t status;
+
+    if (unlikely (surface->status))
+	return (cairo_int_status_t) surface->status;
+    if (surface->finished)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    if (_cairo_surface_is_subsurface (surface))
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    if (_cairo_surface_is_snapshot (surface)) {
+	cairo_surface_t *target;
+
+	target = _cairo_surface_snapshot_get_target (surface);
+	status = _cairo_content_hash_surface (hash, target);
+	cairo_surface_destroy (target);
+	return status;
+    }
+
+    _cairo_content_hash_int (hash, surface->content);
+    _cairo_content_hash_matrix (hash, &surface->device_transform);
+
+    if (_cairo_surface_is_recording (surface)) {
+	_cairo_content_hash_int (hash, CAIRO_SURFACE_TYPE_RECORDING);
+	return _cairo_content_hash_recording (hash,
+					      (cairo_recording_surface_t *) surface);
+    }
+
+    _cairo_content_hash_int (hash, CAIRO_SURFACE_TYPE_IMAGE);
+    status = (cairo_int_status_t)
+	_cairo_surface_acquire_source_image (surface, &image, &image_extra);
+    if (unlikely (status))
+	return status;
+
+    _cairo_content_hash_image_data (hash, image);
+
+    _cairo_surface_release_source_image (surface, image, image_extra);
+    return CAIRO_INT_STATUS_SUCCESS;
+}
+
+/**
+ * _cairo_surface_get_content_digest:
+ * @surface: an image, recording or other source surface
+ * @digest: return location for the digest
+ *
+ * Computes a digest of the content of @surface, such that two
+ * surfaces with the same digest render identically whatever their
+ * identity.
+ *
+ * Return value: %CAIRO_INT_STATUS_SUCCESS, %CAIRO_INT_STATUS_UNSUPPORTED
+ * if the surface cannot be hashed, or an error if it is in error or
+ * its content could not be acquired.
+ **/
+cairo_int_status_t
+_cairo_surface_get_content_digest (cairo_surface_t	  *surface,
+				   cairo_content_digest_t *digest)
+{
+    cairo_content_hash_t hash;
+    cairo_int_status_t status;
+
+    _cairo_content_hash_init (&hash);
+    status = _cairo_content_hash_surface (&hash, surface);
+    if (unlikely (status))
+	return status;
+
+    _cairo_content_hash_finish (&hash, digest);
+    return CAIRO_INT_STATUS_SUCCESS;
+}
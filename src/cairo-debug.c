@@ -34,7 +34,10 @@
  */
 
 #include "cairoint.h"
+#include "cairo-freed-pool-private.h"
 #include "cairo-image-surface-private.h"
+#include "cairo-recording-surface-private.h"
+#include "cairo-thread-pool-private.h"
 
 /**
  * cairo_debug_reset_static_data:
@@ -84,14 +87,26 @@ cairo_debug_reset_static_data (void)
 
     _cairo_clip_reset_static_data ();
 
+    _cairo_path_fill_cache_reset_static_data ();
+
+    _cairo_tor_scan_converter_reset_static_data ();
+
     _cairo_image_reset_static_data ();
 
+    _cairo_recording_surface_reset_static_data ();
+
+#if CAIRO_HAS_PNG_FUNCTIONS
+    _cairo_png_reset_static_data ();
+#endif
+
 #if CAIRO_HAS_DRM_SURFACE
     _cairo_drm_device_reset_static_data ();
 #endif
 
     _cairo_default_context_reset_static_data ();
 
+    _cairo_thread_pool_reset_static_data ();
+
 #if CAIRO_HAS_COGL_SURFACE
     _cairo_cogl_context_reset_static_data ();
 #endif
@@ -99,6 +114,204 @@ cairo_debug_reset_static_data (void)
     CAIRO_MUTEX_FINALIZE ();
 }
 
+/**
+ * cairo_debug_get_freed_pool_stats:
+ * @hits: return location for the number of objects that were recycled
+ * @misses: return location for the number of objects that had to be
+ * allocated afresh
+ *
+ * Reports how often cairo was able to reuse one of its recently freed
+ * contexts, patterns and clips instead of allocating a new one. The
+ * counters are accumulated over the lifetime of the process. Each thread
+ * counts its own lookups, which are included once it has exited, and
+ * those of the calling thread are always included.
+ *
+ * The number of objects each thread keeps aside for its own reuse can
+ * be set with the CAIRO_FREED_POOL_DEPTH environment variable. Lookups
+ * are only counted in builds with atomic operations and pthreads;
+ * otherwise both counters are reported as 0.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_debug_get_freed_pool_stats (unsigned long *hits,
+				  unsigned long *misses)
+{
+    unsigned long dummy;
+
+    if (hits == NULL)
+	hits = &dummy;
+    if (misses == NULL)
+	misses = &dummy;
+
+    _freed_pool_get_stats (hits, misses);
+}
+
+/**
+ * cairo_debug_get_tessellation_cache_stats:
+ * @hits: return location for the number of fills that reused a cached
+ * polygon
+ * @misses: return location for the number of fills that had to flatten
+ * their path
+ * @evictions: return location for the number of polygons ejected from
+ * the cache to make room for others
+ *
+ * Reports how often a fill found the flattened outline of its path,
+ * possibly at a different translation, in the tessellation cache. Only
+ * fills onto surfaces that enabled the cache with
+ * cairo_image_surface_set_tessellation_cache() are counted.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_debug_get_tessellation_cache_stats (unsigned long *hits,
+					  unsigned long *misses,
+					  unsigned long *evictions)
+{
+    unsigned long dummy;
+
+    if (hits == NULL)
+	hits = &dummy;
+    if (misses == NULL)
+	misses = &dummy;
+    if (evictions == NULL)
+	evictions = &dummy;
+
+    _cairo_path_fill_cache_get_stats (hits, misses, evictions);
+}
+
+/**
+ * cairo_debug_get_mesh_cache_stats:
+ * @hits: return location for the number of times a mesh pattern was
+ * painted from a previous rasterisation
+ * @misses: return location for the number of times a mesh pattern had
+ * to be rasterised
+ * @evictions: return location for the number of rasterised meshes
+ * ejected from the cache to make room for others
+ * @bytes: return location for the memory currently held by the cache
+ *
+ * Reports the effectiveness of the cache the image backend keeps of
+ * recently rasterised mesh patterns. Painting an unchanged mesh over
+ * the same area again reuses the cached pixels.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_debug_get_mesh_cache_stats (unsigned long *hits,
+				  unsigned long *misses,
+				  unsigned long *evictions,
+				  unsigned long *bytes)
+{
+    unsigned long dummy;
+
+    if (hits == NULL)
+	hits = &dummy;
+    if (misses == NULL)
+	misses = &dummy;
+    if (evictions == NULL)
+	evictions = &dummy;
+    if (bytes == NULL)
+	bytes = &dummy;
+
+    _cairo_image_mesh_cache_get_stats (hits, misses, evictions, bytes);
+}
+
+/**
+ * cairo_debug_get_gradient_cache_stats:
+ * @hits: return location for the number of color ramp lookups that
+ * found a cached ramp
+ * @misses: return location for the number of color ramps that had to
+ * be computed
+ * @evictions: return location for the number of color ramps ejected
+ * from the cache to make room for others
+ * @bytes: return location for the memory currently held by the cache
+ *
+ * Reports the effectiveness of the cache of gradient color ramps kept
+ * by the image backend. Gradients sharing the same color stops share
+ * a single ramp, whatever their geometry and extend mode.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_debug_get_gradient_cache_stats (unsigned long *hits,
+				      unsigned long *misses,
+				      unsigned long *evictions,
+				      unsigned long *bytes)
+{
+    unsigned long dummy;
+
+    if (hits == NULL)
+	hits = &dummy;
+    if (misses == NULL)
+	misses = &dummy;
+    if (evictions == NULL)
+	evictions = &dummy;
+    if (bytes == NULL)
+	bytes = &dummy;
+
+    _cairo_image_gradient_cache_get_stats (hits, misses, evictions, bytes);
+}
+
+/**
+ * cairo_debug_get_glyph_cache_stats:
+ * @hits: return location for the number of glyph lookups that found
+ * the glyph already in the cache
+ * @misses: return location for the number of glyphs that had to be
+ * loaded from the font
+ * @evictions: return location for the number of pages of glyphs
+ * ejected from the cache to make room for others
+ *
+ * Reports the effectiveness of the cache of glyphs shared by all
+ * scaled fonts. Glyphs are cached, and ejected, in pages.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_debug_get_glyph_cache_stats (unsigned long *hits,
+				   unsigned long *misses,
+				   unsigned long *evictions)
+{
+    unsigned long dummy;
+
+    if (hits == NULL)
+	hits = &dummy;
+    if (misses == NULL)
+	misses = &dummy;
+    if (evictions == NULL)
+	evictions = &dummy;
+
+    _cairo_scaled_glyph_page_cache_get_stats (hits, misses, evictions);
+}
+
+/**
+ * cairo_debug_get_recording_cull_stats:
+ * @replayed: return location for the number of recorded commands
+ * drawn whilst occlusion culling was active
+ * @culled: return location for the number of recorded commands that
+ * were skipped because later commands hid them
+ *
+ * Reports the effect of occlusion culling when replaying recording
+ * surfaces. Only the recording surfaces for which
+ * cairo_recording_surface_set_cull_hidden_commands() was called are
+ * culled and counted. A recording replayed in tiles counts the
+ * commands of each tile.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_debug_get_recording_cull_stats (unsigned long *replayed,
+				      unsigned long *culled)
+{
+    unsigned long dummy;
+
+    if (replayed == NULL)
+	replayed = &dummy;
+    if (culled == NULL)
+	culled = &dummy;
+
+    _cairo_recording_surface_get_cull_stats (replayed, culled);
+}
+
 #if HAVE_VALGRIND
 void
 _cairo_debug_check_image_surface_is_defined (const cairo_surface_t *surface)
@@ -37,6 +37,7 @@
 #define CAIRO_DEFAULT_CONTEXT_PRIVATE_H
 
 #include "cairo-private.h"
+#include "cairo-arena-private.h"
 #include "cairo-gstate-private.h"
 #include "cairo-path-fixed-private.h"
 
@@ -52,6 +53,9 @@ struct _cairo_default_context {
     cairo_gstate_t *gstate_freelist;
 
     cairo_path_fixed_t path[1];
+
+    /* scratch memory for the tessellation of a fill or stroke */
+    cairo_arena_t arena;
 };
 
 cairo_private cairo_t *
@@ -81,6 +81,7 @@ _cairo_default_context_fini (cairo_default_context_t *cr)
     }
 
     _cairo_path_fixed_fini (cr->path);
+    _cairo_arena_fini (&cr->arena);
 
     _cairo_fini (&cr->base);
 }
@@ -993,12 +994,25 @@ _cairo_default_context_mask (void *abstract_cr,
     return _cairo_gstate_mask (cr->gstate, mask);
 }
 
+static cairo_status_t
+_cairo_default_context_do_stroke (cairo_default_context_t *cr)
+{
+    cairo_arena_t *previous;
+    cairo_status_t status;
+
+    previous = _cairo_arena_enter (&cr->arena);
+    status = _cairo_gstate_stroke (cr->gstate, cr->path);
+    _cairo_arena_leave (&cr->arena, previous);
+
+    return status;
+}
+
 static cairo_status_t
 _cairo_default_context_stroke_preserve (void *abstract_cr)
 {
     cairo_default_context_t *cr = abstract_cr;
 
-    return _cairo_gstate_stroke (cr->gstate, cr->path);
+    return _cairo_default_context_do_stroke (cr);
 }
 
 static cairo_status_t
@@ -1007,7 +1021,7 @@ _cairo_default_context_stroke (void *abstract_cr)
     cairo_default_context_t *cr = abstract_cr;
     cairo_status_t status;
 
-    status = _cairo_gstate_stroke (cr->gstate, cr->path);
+    status = _cairo_default_context_do_stroke (cr);
     if (unlikely (status))
 	return status;
 
@@ -1038,12 +1052,25 @@ _cairo_default_context_stroke_extents (void *abstract_cr,
 					 x1, y1, x2, y2);
 }
 
+static cairo_status_t
+_cairo_default_context_do_fill (cairo_default_context_t *cr)
+{
+    cairo_arena_t *previous;
+    cairo_status_t status;
+
+    previous = _cairo_arena_enter (&cr->arena);
+    status = _cairo_gstate_fill (cr->gstate, cr->path);
+    _cairo_arena_leave (&cr->arena, previous);
+
+    return status;
+}
+
 static cairo_status_t
 _cairo_default_context_fill_preserve (void *abstract_cr)
 {
     cairo_default_context_t *cr = abstract_cr;
 
-    return _cairo_gstate_fill (cr->gstate, cr->path);
+    return _cairo_default_context_do_fill (cr);
 }
 
 static cairo_status_t
@@ -1052,7 +1079,7 @@ _cairo_default_context_fill (void *abstract_cr)
     cairo_default_context_t *cr = abstract_cr;
     cairo_status_t status;
 
-    status = _cairo_gstate_fill (cr->gstate, cr->path);
+    status = _cairo_default_context_do_fill (cr);
     if (unlikely (status))
 	return status;
 
@@ -1444,6 +1471,7 @@ _cairo_default_context_init (cairo_default_context_t *cr, void *target)
 {
     _cairo_init (&cr->base, &_cairo_default_context_backend);
     _cairo_path_fixed_init (cr->path);
+    _cairo_arena_init (&cr->arena);
 
     cr->gstate = &cr->gstate_tail[0];
     cr->gstate_freelist = &cr->gstate_tail[1];
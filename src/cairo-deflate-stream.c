@@ -40,16 +40,58 @@
 
 #include "cairo-error-private.h"
 #include "cairo-output-stream-private.h"
+#include "cairo-thread-pool-private.h"
 #include <zlib.h>
 
 #define BUFFER_SIZE 16384
 
+/* When the caller allows more than one thread, large streams, such as
+ * images and font subsets, are compressed in blocks spread across the
+ * thread pool, in the manner of pigz. Each block is deflated
+ * independently, primed with the 32KiB of data preceding it as the
+ * dictionary so that little compression is lost, and ends on a sync
+ * flush so that the blocks can simply be concatenated into a single zlib
+ * stream. Streams shorter than PARALLEL_THRESHOLD are compressed inline
+ * as before.
+ *
+ * The blocks always start at multiples of PARALLEL_BLOCK_SIZE, so the
+ * output does not depend on the number of threads actually available.
+ */
+#define PARALLEL_BLOCK_SIZE (128 * 1024)
+#define PARALLEL_THRESHOLD (2 * PARALLEL_BLOCK_SIZE)
+#define DICTIONARY_SIZE 32768
+
+typedef struct _cairo_deflate_block {
+    int			 level;
+    const unsigned char	*dictionary;
+    unsigned int	 dictionary_length;
+    const unsigned char	*data;
+    unsigned int	 length;
+    cairo_bool_t	 last;
+
+    unsigned char	*out;
+    unsigned long	 out_length;
+    uLong		 adler;
+    cairo_status_t	 status;
+} cairo_deflate_block_t;
+
 typedef struct _cairo_deflate_stream {
     cairo_output_stream_t  base;
     cairo_output_stream_t *output;
+    int                    level;
     z_stream               zlib_stream;
     unsigned char          input_buf[BUFFER_SIZE];
     unsigned char          output_buf[BUFFER_SIZE];
+
+    /* In parallel mode, the input is collected into batches of blocks,
+     * preceded by the tail of the previous batch for the dictionary. */
+    cairo_bool_t           parallel;
+    cairo_bool_t           started;
+    unsigned char         *batch;
+    unsigned int           batch_size;
+    unsigned int           dictionary_length;
+    unsigned int           pending_length;
+    uLong                  adler;
 } cairo_deflate_stream_t;
 
 static void
@@ -80,6 +122,179 @@ cairo_deflate_stream_deflate (cairo_deflate_stream_t *stream, cairo_bool_t flush
     stream->zlib_stream.next_in = stream->input_buf;
 }
 
+static void
+_cairo_deflate_block_compress (void *closure)
+{
+    cairo_deflate_block_t *block = closure;
+    z_stream zlib_stream;
+    unsigned long size;
+    int ret;
+
+    block->out = NULL;
+    block->adler = adler32 (adler32 (0, NULL, 0), block->data, block->length);
+
+    zlib_stream.zalloc = Z_NULL;
+    zlib_stream.zfree  = Z_NULL;
+    zlib_stream.opaque = Z_NULL;
+    if (deflateInit2 (&zlib_stream, block->level, Z_DEFLATED,
+		      -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+	block->status = CAIRO_STATUS_NO_MEMORY;
+	return;
+    }
+
+    if (block->dictionary_length) {
+	deflateSetDictionary (&zlib_stream,
+			      block->dictionary, block->dictionary_length);
+    }
+
+    /* room for the sync flush marker on top of the worst case */
+    size = deflateBound (&zlib_stream, block->length) + 16;
+    block->out = malloc (size);
+    if (unlikely (block->out == NULL)) {
+	deflateEnd (&zlib_stream);
+	block->status = CAIRO_STATUS_NO_MEMORY;
+	return;
+    }
+
+    zlib_stream.next_in = (Bytef *) block->data;
+    zlib_stream.avail_in = block->length;
+    zlib_stream.next_out = block->out;
+    zlib_stream.avail_out = size;
+    ret = deflate (&zlib_stream, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+    block->out_length = size - zlib_stream.avail_out;
+    deflateEnd (&zlib_stream);
+
+    if (ret != (block->last ? Z_STREAM_END : Z_OK) ||
+	zlib_stream.avail_in != 0 || zlib_stream.avail_out == 0)
+    {
+	free (block->out);
+	block->out = NULL;
+	block->status = CAIRO_STATUS_NO_MEMORY;
+	return;
+    }
+
+    block->status = CAIRO_STATUS_SUCCESS;
+}
+
+/* Compresses the pending input across the thread pool and writes it out
+ * in order, followed by the zlib trailer if this is the @last batch. */
+static cairo_status_t
+_cairo_deflate_stream_compress_batch (cairo_deflate_stream_t *stream,
+				      cairo_bool_t            last)
+{
+    cairo_deflate_block_t blocks[CAIRO_THREAD_POOL_MAX_THREADS];
+    const unsigned char *data;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    unsigned int offset, length;
+    int i, num_blocks;
+
+    if (! stream->started) {
+	unsigned char header[2];
+	int level = stream->level;
+
+	header[0] = 0x78;
+	header[1] = level == Z_DEFAULT_COMPRESSION || level == 6 ? 0x9c :
+		    level >= 7 ? 0xda : level >= 2 ? 0x5e : 0x01;
+	_cairo_output_stream_write (stream->output, header, 2);
+
+	stream->adler = adler32 (0, NULL, 0);
+	stream->started = TRUE;
+    }
+
+    data = stream->batch + stream->dictionary_length;
+    num_blocks = 0;
+    offset = 0;
+    do {
+	cairo_deflate_block_t *block = &blocks[num_blocks++];
+
+	length = stream->pending_length - offset;
+	if (length > PARALLEL_BLOCK_SIZE)
+	    length = PARALLEL_BLOCK_SIZE;
+
+	block->level = stream->level;
+	block->data = data + offset;
+	block->length = length;
+	block->dictionary_length = MIN (DICTIONARY_SIZE,
+					stream->dictionary_length + offset);
+	block->dictionary = block->data - block->dictionary_length;
+	offset += length;
+	block->last = last && offset == stream->pending_length;
+    } while (offset < stream->pending_length);
+
+    _cairo_thread_pool_run (_cairo_deflate_block_compress,
+			    blocks, num_blocks, sizeof (cairo_deflate_block_t));
+
+    for (i = 0; i < num_blocks; i++) {
+	if (unlikely (blocks[i].status) && status == CAIRO_STATUS_SUCCESS)
+	    status = _cairo_error (blocks[i].status);
+
+	if (status == CAIRO_STATUS_SUCCESS) {
+	    _cairo_output_stream_write (stream->output,
+					blocks[i].out, blocks[i].out_length);
+	    stream->adler = adler32_combine (stream->adler,
+					     blocks[i].adler, blocks[i].length);
+	}
+	free (blocks[i].out);
+    }
+
+    /* keep the end of this batch as the dictionary for the next */
+    length = MIN (DICTIONARY_SIZE,
+		  stream->dictionary_length + stream->pending_length);
+    memmove (stream->batch,
+	     data + stream->pending_length - length,
+	     length);
+    stream->dictionary_length = length;
+    stream->pending_length = 0;
+
+    if (last) {
+	unsigned char trailer[4];
+
+	trailer[0] = stream->adler >> 24;
+	trailer[1] = stream->adler >> 16;
+	trailer[2] = stream->adler >> 8;
+	trailer[3] = stream->adler;
+	_cairo_output_stream_write (stream->output, trailer, 4);
+    }
+
+    return status;
+}
+
+static cairo_status_t
+_cairo_deflate_stream_write_parallel (cairo_deflate_stream_t *stream,
+				      const unsigned char    *data,
+				      unsigned int	      length)
+{
+    cairo_status_t status;
+
+    while (length) {
+	unsigned int count;
+
+	if (stream->batch == NULL) {
+	    stream->batch = malloc (DICTIONARY_SIZE + stream->batch_size);
+	    if (unlikely (stream->batch == NULL))
+		return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	}
+
+	count = stream->batch_size - stream->pending_length;
+	if (count > length)
+	    count = length;
+	memcpy (stream->batch + stream->dictionary_length + stream->pending_length,
+		data, count);
+	stream->pending_length += count;
+	data += count;
+	length -= count;
+
+	if (stream->pending_length == stream->batch_size) {
+	    status = _cairo_deflate_stream_compress_batch (stream, FALSE);
+	    if (unlikely (status))
+		return status;
+	}
+    }
+
+    return _cairo_output_stream_get_status (stream->output);
+}
+
 static cairo_status_t
 _cairo_deflate_stream_write (cairo_output_stream_t *base,
                              const unsigned char   *data,
@@ -89,6 +304,9 @@ _cairo_deflate_stream_write (cairo_output_stream_t *base,
     unsigned int count;
     const unsigned char *p = data;
 
+    if (stream->parallel)
+	return _cairo_deflate_stream_write_parallel (stream, data, length);
+
     while (length) {
         count = length;
         if (count > BUFFER_SIZE - stream->zlib_stream.avail_in)
@@ -109,17 +327,50 @@ static cairo_status_t
 _cairo_deflate_stream_close (cairo_output_stream_t *base)
 {
     cairo_deflate_stream_t *stream = (cairo_deflate_stream_t *) base;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
 
-    cairo_deflate_stream_deflate (stream, TRUE);
+    if (stream->parallel &&
+	(stream->started || stream->pending_length >= PARALLEL_THRESHOLD))
+    {
+	status = _cairo_deflate_stream_compress_batch (stream, TRUE);
+    }
+    else
+    {
+	if (stream->pending_length) {
+	    /* too short to be worth splitting, so deflate it inline */
+	    stream->zlib_stream.next_in = stream->batch;
+	    stream->zlib_stream.avail_in = stream->pending_length;
+	}
+	cairo_deflate_stream_deflate (stream, TRUE);
+    }
     deflateEnd (&stream->zlib_stream);
+    free (stream->batch);
+
+    if (unlikely (status))
+	return status;
 
     return _cairo_output_stream_get_status (stream->output);
 }
 
 cairo_output_stream_t *
 _cairo_deflate_stream_create (cairo_output_stream_t *output)
+{
+    return _cairo_deflate_stream_create_with_options (output,
+						      Z_DEFAULT_COMPRESSION,
+						      1);
+}
+
+/* As _cairo_deflate_stream_create(), compressing at zlib @level, from
+ * 0 (none) to 9 (best), or -1 for the default. A @num_threads other
+ * than 1 compresses large streams in blocks, using up to that many
+ * threads of the pool, or all of them for 0. */
+cairo_output_stream_t *
+_cairo_deflate_stream_create_with_options (cairo_output_stream_t *output,
+					   int                    level,
+					   int                    num_threads)
 {
     cairo_deflate_stream_t *stream;
+    int max_threads;
 
     if (output->status)
 	return _cairo_output_stream_create_in_error (output->status);
@@ -135,12 +386,13 @@ _cairo_deflate_stream_create (cairo_output_stream_t *output)
 			       NULL,
 			       _cairo_deflate_stream_close);
     stream->output = output;
+    stream->level = level;
 
     stream->zlib_stream.zalloc = Z_NULL;
     stream->zlib_stream.zfree  = Z_NULL;
     stream->zlib_stream.opaque  = Z_NULL;
 
-    if (deflateInit (&stream->zlib_stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    if (deflateInit (&stream->zlib_stream, level) != Z_OK) {
 	free (stream);
 	return (cairo_output_stream_t *) &_cairo_output_stream_nil;
     }
@@ -150,6 +402,19 @@ _cairo_deflate_stream_create (cairo_output_stream_t *output)
     stream->zlib_stream.next_out = stream->output_buf;
     stream->zlib_stream.avail_out = BUFFER_SIZE;
 
+    /* Once allowed, the blocks are used even if the pool turns out to
+     * have a single thread, so that the output is the same everywhere. */
+    stream->parallel = num_threads != 1;
+    max_threads = _cairo_thread_pool_get_num_threads ();
+    if (num_threads <= 0 || num_threads > max_threads)
+	num_threads = max_threads;
+
+    stream->started = FALSE;
+    stream->batch = NULL;
+    stream->batch_size = MAX (num_threads, 2) * PARALLEL_BLOCK_SIZE;
+    stream->dictionary_length = 0;
+    stream->pending_length = 0;
+
     return &stream->base;
 }
 
@@ -52,6 +52,7 @@ CAIRO_BEGIN_DECLS
 typedef struct {
     void *pool[MAX_FREED_POOL_SIZE];
     int top;
+    int magazine;
 } freed_pool_t;
 
 static cairo_always_inline void *
@@ -76,7 +77,7 @@ cairo_private void *
 _freed_pool_get_search (freed_pool_t *pool);
 
 static inline void *
-_freed_pool_get (freed_pool_t *pool)
+_freed_pool_get_global (freed_pool_t *pool)
 {
     void *ptr;
     int i;
@@ -99,7 +100,7 @@ cairo_private void
 _freed_pool_put_search (freed_pool_t *pool, void *ptr);
 
 static inline void
-_freed_pool_put (freed_pool_t *pool, void *ptr)
+_freed_pool_put_global (freed_pool_t *pool, void *ptr)
 {
     int i;
 
@@ -115,6 +116,29 @@ _freed_pool_put (freed_pool_t *pool, void *ptr)
     _freed_pool_put_search (pool, ptr);
 }
 
+#if CAIRO_HAS_REAL_PTHREAD
+/* With many threads allocating and freeing the same kind of object, the
+ * shared array above is drained almost at once and its slots bounce
+ * between cpus. So each thread keeps a small magazine of objects for
+ * every pool in front of it, and only goes to the shared array when its
+ * magazine is empty (or full). The depth of the magazines can be tuned
+ * with the CAIRO_FREED_POOL_DEPTH environment variable, from 0 (disabled)
+ * up to MAX_FREED_POOL_MAGAZINE_SIZE.
+ */
+#define HAS_FREED_POOL_MAGAZINES 1
+#define MAX_FREED_POOL_MAGAZINE_SIZE 16
+#define FREED_POOL_MAGAZINE_SIZE 4
+
+cairo_private void *
+_freed_pool_get (freed_pool_t *pool);
+
+cairo_private void
+_freed_pool_put (freed_pool_t *pool, void *ptr);
+#else
+#define _freed_pool_get(pool) _freed_pool_get_global (pool)
+#define _freed_pool_put(pool, ptr) _freed_pool_put_global (pool, ptr)
+#endif
+
 cairo_private void
 _freed_pool_reset (freed_pool_t *pool);
 
@@ -130,10 +154,15 @@ typedef int freed_pool_t;
 
 #define _freed_pool_get(pool) NULL
 #define _freed_pool_put(pool, ptr) free(ptr)
+#define _freed_pool_get_global(pool) NULL
+#define _freed_pool_put_global(pool, ptr) free(ptr)
 #define _freed_pool_reset(ptr)
 
 #endif
 
+cairo_private void
+_freed_pool_get_stats (unsigned long *hits, unsigned long *misses);
+
 CAIRO_END_DECLS
 
 #endif /* CAIRO_FREED_POOL_PRIVATE_H */
@@ -38,6 +38,249 @@
 #include "cairoint.h"
 
 #include "cairo-freed-pool-private.h"
+#include "cairo-list-inline.h"
+
+#if HAS_FREED_POOL_MAGAZINES
+
+#include <pthread.h>
+
+#define MAX_FREED_POOLS 16
+
+typedef struct _freed_pool_magazine {
+    int count;
+    void *objects[MAX_FREED_POOL_MAGAZINE_SIZE];
+} freed_pool_magazine_t;
+
+typedef struct _freed_pool_thread {
+    cairo_list_t link;
+
+    /* Only ever touched by the owning thread, and folded into the
+     * totals as it exits or queries them */
+    unsigned long hits;
+    unsigned long misses;
+
+    freed_pool_magazine_t magazines[MAX_FREED_POOLS];
+} freed_pool_thread_t;
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_once_t once;
+    cairo_list_t threads;
+
+    pthread_key_t key;
+    cairo_bool_t has_key;
+    int depth;
+
+    int num_pools;
+    freed_pool_t *pools[MAX_FREED_POOLS];
+
+    /* counters folded in by the threads */
+    unsigned long hits;
+    unsigned long misses;
+} magazines = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_ONCE_INIT,
+    { &magazines.threads, &magazines.threads },
+};
+
+static void
+freed_pool_thread_exit (void *closure)
+{
+    freed_pool_thread_t *thread = closure;
+    int i;
+
+    pthread_mutex_lock (&magazines.mutex);
+    cairo_list_del (&thread->link);
+
+    magazines.hits += thread->hits;
+    magazines.misses += thread->misses;
+
+    /* hand the objects over to the threads that remain */
+    for (i = 0; i < magazines.num_pools; i++) {
+	freed_pool_magazine_t *magazine = &thread->magazines[i];
+
+	while (magazine->count)
+	    _freed_pool_put_global (magazines.pools[i],
+				    magazine->objects[--magazine->count]);
+    }
+    pthread_mutex_unlock (&magazines.mutex);
+
+    free (thread);
+}
+
+static void
+freed_pool_init_key (void)
+{
+    const char *env;
+
+    magazines.depth = FREED_POOL_MAGAZINE_SIZE;
+    env = getenv ("CAIRO_FREED_POOL_DEPTH");
+    if (env != NULL) {
+	magazines.depth = atoi (env);
+	if (magazines.depth < 0)
+	    magazines.depth = 0;
+	if (magazines.depth > MAX_FREED_POOL_MAGAZINE_SIZE)
+	    magazines.depth = MAX_FREED_POOL_MAGAZINE_SIZE;
+    }
+
+    magazines.has_key =
+	pthread_key_create (&magazines.key, freed_pool_thread_exit) == 0;
+}
+
+/* The thread state is created even when the magazines are disabled,
+ * as it also holds the counters. */
+static freed_pool_thread_t *
+freed_pool_get_thread (void)
+{
+    freed_pool_thread_t *thread;
+
+    pthread_once (&magazines.once, freed_pool_init_key);
+    if (unlikely (! magazines.has_key))
+	return NULL;
+
+    thread = pthread_getspecific (magazines.key);
+    if (likely (thread != NULL))
+	return thread;
+
+    thread = calloc (1, sizeof (freed_pool_thread_t));
+    if (unlikely (thread == NULL))
+	return NULL;
+
+    if (unlikely (pthread_setspecific (magazines.key, thread))) {
+	free (thread);
+	return NULL;
+    }
+
+    pthread_mutex_lock (&magazines.mutex);
+    cairo_list_add (&thread->link, &magazines.threads);
+    pthread_mutex_unlock (&magazines.mutex);
+
+    return thread;
+}
+
+/* Returns the slot of the pool within the per-thread magazines, or -1
+ * if there are more pools than we have room for. */
+static int
+freed_pool_get_index (freed_pool_t *pool)
+{
+    int index;
+
+    index = pool->magazine;
+    if (likely (index > 0))
+	return index - 1;
+    if (index < 0)
+	return -1;
+
+    pthread_mutex_lock (&magazines.mutex);
+    if (pool->magazine == 0) {
+	if (magazines.num_pools < MAX_FREED_POOLS) {
+	    magazines.pools[magazines.num_pools++] = pool;
+	    pool->magazine = magazines.num_pools;
+	} else {
+	    pool->magazine = -1;
+	}
+    }
+    index = pool->magazine;
+    pthread_mutex_unlock (&magazines.mutex);
+
+    return index > 0 ? index - 1 : -1;
+}
+
+void *
+_freed_pool_get (freed_pool_t *pool)
+{
+    freed_pool_thread_t *thread;
+    freed_pool_magazine_t *magazine;
+    void *ptr;
+    int index;
+
+    thread = freed_pool_get_thread ();
+    if (unlikely (thread == NULL))
+	return _freed_pool_get_global (pool);
+
+    index = freed_pool_get_index (pool);
+    if (likely (index >= 0)) {
+	magazine = &thread->magazines[index];
+	if (likely (magazine->count)) {
+	    thread->hits++;
+	    return magazine->objects[--magazine->count];
+	}
+    }
+
+    ptr = _freed_pool_get_global (pool);
+    if (ptr != NULL)
+	thread->hits++;
+    else
+	thread->misses++;
+
+    return ptr;
+}
+
+void
+_freed_pool_put (freed_pool_t *pool, void *ptr)
+{
+    freed_pool_thread_t *thread;
+    freed_pool_magazine_t *magazine;
+    int index;
+
+    thread = freed_pool_get_thread ();
+    index = freed_pool_get_index (pool);
+    if (likely (thread != NULL && index >= 0)) {
+	magazine = &thread->magazines[index];
+	if (likely (magazine->count < magazines.depth)) {
+	    magazine->objects[magazine->count++] = ptr;
+	    return;
+	}
+    }
+
+    _freed_pool_put_global (pool, ptr);
+}
+
+/* Like the rest of cairo_debug_reset_static_data(), this is only called
+ * while no other thread is using cairo, so the magazines of the other
+ * threads are idle and can be emptied from here. */
+static void
+freed_pool_reset_magazines (freed_pool_t *pool)
+{
+    freed_pool_thread_t *thread;
+    int index;
+
+    index = pool->magazine - 1;
+    if (index < 0)
+	return;
+
+    pthread_mutex_lock (&magazines.mutex);
+    cairo_list_foreach_entry (thread, freed_pool_thread_t,
+			      &magazines.threads, link)
+    {
+	freed_pool_magazine_t *magazine = &thread->magazines[index];
+
+	while (magazine->count)
+	    free (magazine->objects[--magazine->count]);
+    }
+    pthread_mutex_unlock (&magazines.mutex);
+}
+
+static void
+freed_pool_get_stats (unsigned long *hits, unsigned long *misses)
+{
+    freed_pool_thread_t *thread;
+
+    pthread_once (&magazines.once, freed_pool_init_key);
+    thread = magazines.has_key ? pthread_getspecific (magazines.key) : NULL;
+
+    pthread_mutex_lock (&magazines.mutex);
+    if (thread != NULL) {
+	magazines.hits += thread->hits;
+	magazines.misses += thread->misses;
+	thread->hits = thread->misses = 0;
+    }
+    *hits = magazines.hits;
+    *misses = magazines.misses;
+    pthread_mutex_unlock (&magazines.mutex);
+}
+
+#endif
 
 #if HAS_FREED_POOL
 
@@ -82,6 +325,10 @@ _freed_pool_reset (freed_pool_t *pool)
 {
     int i;
 
+#if HAS_FREED_POOL_MAGAZINES
+    freed_pool_reset_magazines (pool);
+#endif
+
     for (i = 0; i < ARRAY_LENGTH (pool->pool); i++) {
 	free (pool->pool[i]);
 	pool->pool[i] = NULL;
@@ -91,3 +338,13 @@ _freed_pool_reset (freed_pool_t *pool)
 }
 
 #endif
+
+void
+_freed_pool_get_stats (unsigned long *hits, unsigned long *misses)
+{
+#if HAS_FREED_POOL_MAGAZINES
+    freed_pool_get_stats (hits, misses);
+#else
+    *hits = *misses = 0;
+#endif
+}
@@ -40,87 +40,179 @@
 #include "cairo-error-private.h"
 
 /*
- * An entry can be in one of three states:
+ * The table is open-addressed and split into groups of
+ * HASH_GROUP_SIZE slots. Alongside the array of entry pointers we
+ * keep one control byte per slot, and a probe compares the control
+ * bytes of a whole group at once (with SSE2 where available) before
+ * touching any entries.
  *
- * FREE: Entry has never been used, terminates all searches.
- *       Appears in the table as a %NULL pointer.
+ * A control byte can be in one of three states:
  *
- * DEAD: Entry had been live in the past. A dead entry can be reused
- *       but does not terminate a search for an exact entry.
- *       Appears in the table as a pointer to DEAD_ENTRY.
+ * EMPTY: Slot has never been used, terminates all searches.
+ *        Appears as CTRL_EMPTY.
  *
- * LIVE: Entry is currently being used.
- *       Appears in the table as any non-%NULL, non-DEAD_ENTRY pointer.
- */
-
-#define DEAD_ENTRY ((cairo_hash_entry_t *) 0x1)
-
-#define ENTRY_IS_FREE(entry) ((entry) == NULL)
-#define ENTRY_IS_DEAD(entry) ((entry) == DEAD_ENTRY)
-#define ENTRY_IS_LIVE(entry) ((entry) >  DEAD_ENTRY)
-
-/*
- * This table is open-addressed with double hashing. Each table size
- * is a prime and it makes for the "first" hash modulus; a second
- * prime (2 less than the first prime) serves as the "second" hash
- * modulus, which is smaller and thus guarantees a complete
- * permutation of table indices.
+ * DELETED: Slot had been live in the past. A deleted slot can be
+ *          reused but does not terminate a search for an exact entry.
+ *          Appears as CTRL_DELETED.
+ *
+ * FULL: Slot is currently being used. The control byte holds the
+ *       top 7 bits of the mixed hash of the entry, so that a lookup
+ *       only needs to compare keys on a 1 in 128 false match.
  *
- * Hash tables are rehashed in order to keep between 12.5% and 50%
- * entries in the hash table alive and at least 25% free. When table
- * size is changed, the new table has about 25% live elements.
+ * The number of groups is a power of two; the home group comes from
+ * the mixed hash and subsequent groups are visited in triangular
+ * steps, which covers every group of a power-of-two sized table.
+ * A lookup stops at the first group with an EMPTY slot.
  *
- * The free entries guarantee an expected constant-time lookup.
+ * Hash tables are rehashed in order to keep at least 12.5% of the
+ * slots EMPTY and at least 6.25% of them live. When the table size
+ * is changed, the new table has at most 43.75% live slots.
+ *
+ * The EMPTY slots guarantee an expected constant-time lookup.
  * Doubling/halving the table in the described fashion guarantees
  * amortized O(1) insertion/removal.
- *
- * This structure, and accompanying table, is borrowed/modified from the
- * file xserver/render/glyph.c in the freedesktop.org x server, with
- * permission (and suggested modification of doubling sizes) by Keith
- * Packard.
  */
 
-static const unsigned long hash_table_sizes[] = {
-    43,
-    73,
-    151,
-    283,
-    571,
-    1153,
-    2269,
-    4519,
-    9013,
-    18043,
-    36109,
-    72091,
-    144409,
-    288361,
-    576883,
-    1153459,
-    2307163,
-    4613893,
-    9227641,
-    18455029,
-    36911011,
-    73819861,
-    147639589,
-    295279081,
-    590559793
-};
+#define HASH_GROUP_SIZE 16
+#define HASH_MIN_GROUPS 2
+
+#define CTRL_EMPTY   ((uint8_t) 0x80)
+#define CTRL_DELETED ((uint8_t) 0xfe)
+
+#define CTRL_IS_FULL(ctrl) (((ctrl) & 0x80) == 0)
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+static inline unsigned int
+_hash_group_match (const uint8_t *group, uint8_t ctrl)
+{
+    __m128i v = _mm_loadu_si128 ((const __m128i *) group);
+    return _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ((char) ctrl)));
+}
+
+static inline unsigned int
+_hash_group_match_available (const uint8_t *group)
+{
+    /* EMPTY and DELETED both have the sign bit set */
+    return _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *) group));
+}
+#else
+static inline unsigned int
+_hash_group_match (const uint8_t *group, uint8_t ctrl)
+{
+    unsigned int mask = 0;
+    int i;
+
+    for (i = 0; i < HASH_GROUP_SIZE; i++)
+	mask |= (unsigned int) (group[i] == ctrl) << i;
+
+    return mask;
+}
+
+static inline unsigned int
+_hash_group_match_available (const uint8_t *group)
+{
+    unsigned int mask = 0;
+    int i;
+
+    for (i = 0; i < HASH_GROUP_SIZE; i++)
+	mask |= (unsigned int) (group[i] >> 7) << i;
+
+    return mask;
+}
+#endif
+
+static inline int
+_hash_group_first (unsigned int mask)
+{
+#if (__GNUC__ >= 4)
+    return __builtin_ctz (mask);
+#else
+    int i = 0;
+
+    while ((mask & 1) == 0) {
+	mask >>= 1;
+	i++;
+    }
+
+    return i;
+#endif
+}
 
 struct _cairo_hash_table {
     cairo_hash_keys_equal_func_t keys_equal;
 
     cairo_hash_entry_t *cache[32];
 
-    const unsigned long *table_size;
+    unsigned long num_groups;
     cairo_hash_entry_t **entries;
+    uint8_t *ctrl;
 
     unsigned long live_entries;
-    unsigned long free_entries;
+    unsigned long free_entries; /* EMPTY slots */
     unsigned long iterating;   /* Iterating, no insert, no resize */
 };
 
+typedef struct _cairo_hash_probe {
+    unsigned long group;
+    unsigned long mask;
+    unsigned long stride;
+} cairo_hash_probe_t;
+
+/* Spread the user supplied hash, which is frequently just a small
+ * integer or a pointer, over all the bits with a Fibonacci multiply:
+ * the top 7 bits form the control byte and the bits below select the
+ * home group. */
+static inline uint64_t
+_cairo_hash_mix (unsigned long hash)
+{
+    return (uint64_t) hash * 0x9e3779b97f4a7c15ull;
+}
+
+static inline uint8_t
+_cairo_hash_h2 (uint64_t mixed)
+{
+    return mixed >> 57;
+}
+
+static inline void
+_cairo_hash_probe_init (cairo_hash_probe_t *probe,
+			const cairo_hash_table_t *hash_table,
+			uint64_t mixed)
+{
+    probe->mask = hash_table->num_groups - 1;
+    probe->group = (unsigned long) (mixed >> 25) & probe->mask;
+    probe->stride = 0;
+}
+
+static inline void
+_cairo_hash_probe_next (cairo_hash_probe_t *probe)
+{
+    probe->stride++;
+    probe->group = (probe->group + probe->stride) & probe->mask;
+}
+
+static cairo_status_t
+_cairo_hash_table_alloc (cairo_hash_table_t *hash_table,
+			 unsigned long num_groups)
+{
+    unsigned long num_slots = num_groups * HASH_GROUP_SIZE;
+
+    hash_table->entries =
+	_cairo_malloc_ab (num_slots, sizeof (cairo_hash_entry_t *) + 1);
+    if (unlikely (hash_table->entries == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    hash_table->ctrl = (uint8_t *) (hash_table->entries + num_slots);
+    memset (hash_table->ctrl, CTRL_EMPTY, num_slots);
+
+    hash_table->num_groups = num_groups;
+    hash_table->free_entries = num_slots;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
 /**
  * _cairo_hash_table_uid_keys_equal:
  * @key_a: the first key to be compared
@@ -176,18 +268,13 @@ _cairo_hash_table_create (cairo_hash_keys_equal_func_t keys_equal)
 	hash_table->keys_equal = keys_equal;
 
     memset (&hash_table->cache, 0, sizeof (hash_table->cache));
-    hash_table->table_size = &hash_table_sizes[0];
 
-    hash_table->entries = calloc (*hash_table->table_size,
-				  sizeof (cairo_hash_entry_t *));
-    if (unlikely (hash_table->entries == NULL)) {
-	_cairo_error_throw (CAIRO_STATUS_NO_MEMORY);
+    if (unlikely (_cairo_hash_table_alloc (hash_table, HASH_MIN_GROUPS))) {
 	free (hash_table);
 	return NULL;
     }
 
     hash_table->live_entries = 0;
-    hash_table->free_entries = *hash_table->table_size;
     hash_table->iterating = 0;
 
     return hash_table;
@@ -222,34 +309,40 @@ _cairo_hash_table_destroy (cairo_hash_table_t *hash_table)
     free (hash_table);
 }
 
-static cairo_hash_entry_t **
+static unsigned long
 _cairo_hash_table_lookup_unique_key (cairo_hash_table_t *hash_table,
-				     cairo_hash_entry_t *key)
+				     uint64_t mixed)
 {
-    unsigned long table_size, i, idx, step;
-    cairo_hash_entry_t **entry;
-
-    table_size = *hash_table->table_size;
-    idx = key->hash % table_size;
+    cairo_hash_probe_t probe;
+    unsigned long i;
 
-    entry = &hash_table->entries[idx];
-    if (! ENTRY_IS_LIVE (*entry))
-	return entry;
+    _cairo_hash_probe_init (&probe, hash_table, mixed);
+    for (i = 0; i < hash_table->num_groups; i++) {
+	unsigned long base = probe.group * HASH_GROUP_SIZE;
+	unsigned int match;
 
-    i = 1;
-    step = 1 + key->hash % (table_size - 2);
-    do {
-	idx += step;
-	if (idx >= table_size)
-	    idx -= table_size;
+	match = _hash_group_match_available (hash_table->ctrl + base);
+	if (match)
+	    return base + _hash_group_first (match);
 
-	entry = &hash_table->entries[idx];
-	if (! ENTRY_IS_LIVE (*entry))
-	    return entry;
-    } while (++i < table_size);
+	_cairo_hash_probe_next (&probe);
+    }
 
     ASSERT_NOT_REACHED;
-    return NULL;
+    return 0;
+}
+
+static void
+_cairo_hash_table_set (cairo_hash_table_t *hash_table,
+		       unsigned long idx,
+		       cairo_hash_entry_t *entry,
+		       uint64_t mixed)
+{
+    if (hash_table->ctrl[idx] == CTRL_EMPTY)
+	hash_table->free_entries--;
+
+    hash_table->ctrl[idx] = _cairo_hash_h2 (mixed);
+    hash_table->entries[idx] = entry;
 }
 
 /**
@@ -268,34 +361,15 @@ static cairo_status_t
 _cairo_hash_table_manage (cairo_hash_table_t *hash_table)
 {
     cairo_hash_table_t tmp;
-    unsigned long new_size, i;
-
-    /* Keep between 12.5% and 50% entries in the hash table alive and
-     * at least 25% free. */
-    unsigned long live_high = *hash_table->table_size >> 1;
-    unsigned long live_low = live_high >> 2;
-    unsigned long free_low = live_high >> 1;
-
-    tmp = *hash_table;
-
-    if (hash_table->live_entries > live_high)
-    {
-	tmp.table_size = hash_table->table_size + 1;
-	/* This code is being abused if we can't make a table big enough. */
-	assert (tmp.table_size - hash_table_sizes <
-		ARRAY_LENGTH (hash_table_sizes));
-    }
-    else if (hash_table->live_entries < live_low)
-    {
-	/* Can't shrink if we're at the smallest size */
-	if (hash_table->table_size == &hash_table_sizes[0])
-	    tmp.table_size = hash_table->table_size;
-	else
-	    tmp.table_size = hash_table->table_size - 1;
-    }
+    unsigned long num_slots, new_groups, i;
+    cairo_status_t status;
 
-    if (tmp.table_size == hash_table->table_size &&
-	hash_table->free_entries > free_low)
+    /* Keep at least 12.5% of the slots EMPTY to terminate the
+     * searches, and at least 6.25% of them alive. */
+    num_slots = hash_table->num_groups * HASH_GROUP_SIZE;
+    if (hash_table->free_entries > num_slots >> 3 &&
+	(hash_table->live_entries >= num_slots >> 4 ||
+	 hash_table->num_groups == HASH_MIN_GROUPS))
     {
 	/* The number of live entries is within the desired bounds
 	 * (we're not going to resize the table) and we have enough
@@ -303,22 +377,40 @@ _cairo_hash_table_manage (cairo_hash_table_t *hash_table)
 	return CAIRO_STATUS_SUCCESS;
     }
 
-    new_size = *tmp.table_size;
-    tmp.entries = calloc (new_size, sizeof (cairo_hash_entry_t*));
-    if (unlikely (tmp.entries == NULL))
-	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    /* Pick the smallest table where the live entries, plus the one we
+     * may be about to insert, fill no more than 7/16 of the slots.
+     * This may rehash in place if we only ran out of EMPTY slots
+     * through removals. */
+    new_groups = HASH_MIN_GROUPS;
+    while ((hash_table->live_entries + 1) * 16 >
+	   new_groups * HASH_GROUP_SIZE * 7)
+    {
+	/* This code is being abused if we can't make a table big enough. */
+	assert (new_groups < (ULONG_MAX >> 1) / HASH_GROUP_SIZE);
+	new_groups <<= 1;
+    }
 
-    for (i = 0; i < *hash_table->table_size; ++i) {
-	if (ENTRY_IS_LIVE (hash_table->entries[i])) {
-	    *_cairo_hash_table_lookup_unique_key (&tmp, hash_table->entries[i])
-		= hash_table->entries[i];
+    tmp = *hash_table;
+    status = _cairo_hash_table_alloc (&tmp, new_groups);
+    if (unlikely (status))
+	return status;
+
+    for (i = 0; i < num_slots; i++) {
+	if (CTRL_IS_FULL (hash_table->ctrl[i])) {
+	    cairo_hash_entry_t *entry = hash_table->entries[i];
+	    uint64_t mixed = _cairo_hash_mix (entry->hash);
+
+	    _cairo_hash_table_set (&tmp,
+				   _cairo_hash_table_lookup_unique_key (&tmp, mixed),
+				   entry, mixed);
 	}
     }
 
     free (hash_table->entries);
     hash_table->entries = tmp.entries;
-    hash_table->table_size = tmp.table_size;
-    hash_table->free_entries = new_size - hash_table->live_entries;
+    hash_table->ctrl = tmp.ctrl;
+    hash_table->num_groups = tmp.num_groups;
+    hash_table->free_entries = tmp.free_entries;
 
     return CAIRO_STATUS_SUCCESS;
 }
@@ -339,39 +431,40 @@ _cairo_hash_table_lookup (cairo_hash_table_t *hash_table,
 			  cairo_hash_entry_t *key)
 {
     cairo_hash_entry_t *entry;
-    unsigned long table_size, i, idx, step;
+    cairo_hash_probe_t probe;
     unsigned long hash = key->hash;
+    unsigned long i;
+    uint64_t mixed;
+    uint8_t h2;
 
     entry = hash_table->cache[hash & 31];
     if (entry && entry->hash == hash && hash_table->keys_equal (key, entry))
 	return entry;
 
-    table_size = *hash_table->table_size;
-    idx = hash % table_size;
+    mixed = _cairo_hash_mix (hash);
+    h2 = _cairo_hash_h2 (mixed);
+
+    _cairo_hash_probe_init (&probe, hash_table, mixed);
+    for (i = 0; i < hash_table->num_groups; i++) {
+	unsigned long base = probe.group * HASH_GROUP_SIZE;
+	const uint8_t *group = hash_table->ctrl + base;
+	unsigned int match;
 
-    entry = hash_table->entries[idx];
-    if (ENTRY_IS_LIVE (entry)) {
-	if (entry->hash == hash && hash_table->keys_equal (key, entry))
+	match = _hash_group_match (group, h2);
+	while (match) {
+	    entry = hash_table->entries[base + _hash_group_first (match)];
+	    if (entry->hash == hash && hash_table->keys_equal (key, entry))
 		goto insert_cache;
-    } else if (ENTRY_IS_FREE (entry))
-	return NULL;
 
-    i = 1;
-    step = 1 + hash % (table_size - 2);
-    do {
-	idx += step;
-	if (idx >= table_size)
-	    idx -= table_size;
+	    match &= match - 1;
+	}
 
-	entry = hash_table->entries[idx];
-	if (ENTRY_IS_LIVE (entry)) {
-	    if (entry->hash == hash && hash_table->keys_equal (key, entry))
-		    goto insert_cache;
-	} else if (ENTRY_IS_FREE (entry))
+	if (_hash_group_match (group, CTRL_EMPTY))
 	    return NULL;
-    } while (++i < table_size);
 
-    ASSERT_NOT_REACHED;
+	_cairo_hash_probe_next (&probe);
+    }
+
     return NULL;
 
 insert_cache:
@@ -387,12 +480,13 @@ insert_cache:
  * Find a random entry in the hash table satisfying the given
  * @predicate.
  *
- * We use the same algorithm as the lookup algorithm to walk over the
- * entries in the hash table in a pseudo-random order. Walking
- * linearly would favor entries following gaps in the hash table. We
- * could also call rand() repeatedly, which works well for almost-full
- * tables, but degrades when the table is almost empty, or predicate
- * returns %TRUE for most entries.
+ * We walk over the slots from a random start with a random odd
+ * stride, which visits every slot of the power-of-two sized table in
+ * a pseudo-random order. Walking linearly would favor entries
+ * following gaps in the hash table. We could also call rand()
+ * repeatedly, which works well for almost-full tables, but degrades
+ * when the table is almost empty, or predicate returns %TRUE for most
+ * entries.
  *
  * Return value: a random live entry or %NULL if there are no entries
  * that match the given predicate. In particular, if predicate is
@@ -403,30 +497,24 @@ _cairo_hash_table_random_entry (cairo_hash_table_t	   *hash_table,
 				cairo_hash_predicate_func_t predicate)
 {
     cairo_hash_entry_t *entry;
-    unsigned long hash;
-    unsigned long table_size, i, idx, step;
+    unsigned long num_slots, i, idx, step;
 
     assert (predicate != NULL);
 
-    table_size = *hash_table->table_size;
-    hash = rand ();
-    idx = hash % table_size;
+    num_slots = hash_table->num_groups * HASH_GROUP_SIZE;
+    idx = rand ();
+    step = ((unsigned long) rand () << 1) | 1;
 
-    entry = hash_table->entries[idx];
-    if (ENTRY_IS_LIVE (entry) && predicate (entry))
-	return entry;
+    for (i = 0; i < num_slots; i++) {
+	idx &= num_slots - 1;
+	if (CTRL_IS_FULL (hash_table->ctrl[idx])) {
+	    entry = hash_table->entries[idx];
+	    if (predicate (entry))
+		return entry;
+	}
 
-    i = 1;
-    step = 1 + hash % (table_size - 2);
-    do {
 	idx += step;
-	if (idx >= table_size)
-	    idx -= table_size;
-
-	entry = hash_table->entries[idx];
-	if (ENTRY_IS_LIVE (entry) && predicate (entry))
-	    return entry;
-    } while (++i < table_size);
+    }
 
     return NULL;
 }
@@ -455,8 +543,8 @@ cairo_status_t
 _cairo_hash_table_insert (cairo_hash_table_t *hash_table,
 			  cairo_hash_entry_t *key_and_value)
 {
-    cairo_hash_entry_t **entry;
     cairo_status_t status;
+    uint64_t mixed;
 
     /* Insert is illegal while an iterator is running. */
     assert (hash_table->iterating == 0);
@@ -465,47 +553,50 @@ _cairo_hash_table_insert (cairo_hash_table_t *hash_table,
     if (unlikely (status))
 	return status;
 
-    entry = _cairo_hash_table_lookup_unique_key (hash_table, key_and_value);
+    mixed = _cairo_hash_mix (key_and_value->hash);
+    _cairo_hash_table_set (hash_table,
+			   _cairo_hash_table_lookup_unique_key (hash_table, mixed),
+			   key_and_value, mixed);
 
-    if (ENTRY_IS_FREE (*entry))
-	hash_table->free_entries--;
-
-    *entry = key_and_value;
     hash_table->cache[key_and_value->hash & 31] = key_and_value;
     hash_table->live_entries++;
 
     return CAIRO_STATUS_SUCCESS;
 }
 
-static cairo_hash_entry_t **
+static unsigned long
 _cairo_hash_table_lookup_exact_key (cairo_hash_table_t *hash_table,
 				    cairo_hash_entry_t *key)
 {
-    unsigned long table_size, i, idx, step;
-    cairo_hash_entry_t **entry;
+    cairo_hash_probe_t probe;
+    unsigned long i;
+    uint64_t mixed;
+    uint8_t h2;
 
-    table_size = *hash_table->table_size;
-    idx = key->hash % table_size;
+    mixed = _cairo_hash_mix (key->hash);
+    h2 = _cairo_hash_h2 (mixed);
 
-    entry = &hash_table->entries[idx];
-    if (*entry == key)
-	return entry;
+    _cairo_hash_probe_init (&probe, hash_table, mixed);
+    for (i = 0; i < hash_table->num_groups; i++) {
+	unsigned long base = probe.group * HASH_GROUP_SIZE;
+	unsigned int match;
 
-    i = 1;
-    step = 1 + key->hash % (table_size - 2);
-    do {
-	idx += step;
-	if (idx >= table_size)
-	    idx -= table_size;
+	match = _hash_group_match (hash_table->ctrl + base, h2);
+	while (match) {
+	    unsigned long idx = base + _hash_group_first (match);
+	    if (hash_table->entries[idx] == key)
+		return idx;
 
-	entry = &hash_table->entries[idx];
-	if (*entry == key)
-	    return entry;
-    } while (++i < table_size);
+	    match &= match - 1;
+	}
+
+	_cairo_hash_probe_next (&probe);
+    }
 
     ASSERT_NOT_REACHED;
-    return NULL;
+    return 0;
 }
+
 /**
  * _cairo_hash_table_remove:
  * @hash_table: a hash table
@@ -520,7 +611,23 @@ void
 _cairo_hash_table_remove (cairo_hash_table_t *hash_table,
 			  cairo_hash_entry_t *key)
 {
-    *_cairo_hash_table_lookup_exact_key (hash_table, key) = DEAD_ENTRY;
+    unsigned long idx;
+
+    idx = _cairo_hash_table_lookup_exact_key (hash_table, key);
+
+    /* A search only continues past a group without EMPTY slots, so if
+     * the group already has one we can free this slot outright.
+     * Otherwise leave a DELETED marker so that entries which probed
+     * beyond this group can still be found. */
+    if (_hash_group_match (hash_table->ctrl +
+			   (idx & ~(unsigned long) (HASH_GROUP_SIZE - 1)),
+			   CTRL_EMPTY))
+    {
+	hash_table->ctrl[idx] = CTRL_EMPTY;
+	hash_table->free_entries++;
+    }
+    else
+	hash_table->ctrl[idx] = CTRL_DELETED;
     hash_table->live_entries--;
     hash_table->cache[key->hash & 31] = NULL;
 
@@ -556,15 +663,14 @@ _cairo_hash_table_foreach (cairo_hash_table_t	      *hash_table,
 			   cairo_hash_callback_func_t  hash_callback,
 			   void			      *closure)
 {
-    unsigned long i;
-    cairo_hash_entry_t *entry;
+    unsigned long num_slots, i;
 
     /* Mark the table for iteration */
     ++hash_table->iterating;
-    for (i = 0; i < *hash_table->table_size; i++) {
-	entry = hash_table->entries[i];
-	if (ENTRY_IS_LIVE(entry))
-	    hash_callback (entry, closure);
+    num_slots = hash_table->num_groups * HASH_GROUP_SIZE;
+    for (i = 0; i < num_slots; i++) {
+	if (CTRL_IS_FULL (hash_table->ctrl[i]))
+	    hash_callback (hash_table->entries[i], closure);
     }
     /* If some elements were deleted during the iteration,
      * the table may need resizing. Just do this every time
@@ -919,6 +919,234 @@ _cairo_image_scaled_glyph_fini (cairo_scaled_font_t *scaled_font,
 {
 }
 
+/* Batched glyph compositing.
+ *
+ * Rather than compositing every glyph of a run with its own call into
+ * pixman, we accumulate all the glyphs into a single mask in one pass and
+ * then composite that once. The glyph images are read directly from the
+ * scaled glyphs, which stay valid for the whole run as the font's glyph
+ * cache is frozen by our caller, so no further locking is required.
+ */
+
+static inline cairo_bool_t
+a1_pixel (const uint8_t *row, int x)
+{
+#ifdef WORDS_BIGENDIAN
+    return (row[x >> 3] >> (7 - (x & 7))) & 1;
+#else
+    return (row[x >> 3] >> (x & 7)) & 1;
+#endif
+}
+
+static inline uint32_t
+add_un8x4 (uint32_t a, uint32_t b)
+{
+    uint32_t rb, ag;
+
+    rb = (a & 0x00ff00ff) + (b & 0x00ff00ff);
+    rb |= 0x01000100 - ((rb >> 8) & 0x00010001);
+    ag = ((a >> 8) & 0x00ff00ff) + ((b >> 8) & 0x00ff00ff);
+    ag |= 0x01000100 - ((ag >> 8) & 0x00010001);
+
+    return (rb & 0x00ff00ff) | ((ag & 0x00ff00ff) << 8);
+}
+
+/* ADD the w x h pixels of the source into the mask, i.e. the equivalent
+ * of pixman's PIXMAN_OP_ADD of (white IN source) for alpha sources. */
+static void
+add_glyph (uint8_t *dst, int dst_stride, cairo_bool_t dst_is_a8,
+	   const cairo_image_surface_t *src, int src_x, int src_y,
+	   int w, int h)
+{
+    const uint8_t *s = src->data + src_y * src->stride;
+    int x;
+
+    switch (src->format) {
+    case CAIRO_FORMAT_A1:
+	for (; h--; dst += dst_stride, s += src->stride) {
+	    for (x = 0; x < w; x++) {
+		if (! a1_pixel (s, src_x + x))
+		    continue;
+
+		if (dst_is_a8)
+		    dst[x] = 0xff;
+		else
+		    ((uint32_t *) dst)[x] = 0xffffffff;
+	    }
+	}
+	break;
+
+    case CAIRO_FORMAT_A8:
+	s += src_x;
+	for (; h--; dst += dst_stride, s += src->stride) {
+	    if (dst_is_a8) {
+		for (x = 0; x < w; x++) {
+		    uint16_t t = dst[x] + s[x];
+		    dst[x] = t | (0 - (t >> 8));
+		}
+	    } else {
+		uint32_t *d = (uint32_t *) dst;
+		for (x = 0; x < w; x++) {
+		    if (s[x])
+			d[x] = add_un8x4 (d[x], s[x] * 0x01010101);
+		}
+	    }
+	}
+	break;
+
+    case CAIRO_FORMAT_ARGB32:
+	s += 4 * src_x;
+	for (; h--; dst += dst_stride, s += src->stride) {
+	    const uint32_t *ss = (const uint32_t *) s;
+	    uint32_t *d = (uint32_t *) dst;
+	    for (x = 0; x < w; x++) {
+		if (ss[x])
+		    d[x] = add_un8x4 (d[x], ss[x]);
+	    }
+	}
+	break;
+
+    case CAIRO_FORMAT_RGB30:
+    case CAIRO_FORMAT_RGB24:
+    case CAIRO_FORMAT_RGB16_565:
+    case CAIRO_FORMAT_INVALID:
+    default:
+	ASSERT_NOT_REACHED;
+	break;
+    }
+}
+
+/* The mask is only worth building for a sparse run if it is not much
+ * larger than the glyphs themselves. */
+#define GLYPH_RUN_MAX_OVERDRAW 4
+
+static cairo_int_status_t
+composite_glyphs_batched (void				*_dst,
+			  cairo_operator_t		 op,
+			  cairo_surface_t		*_src,
+			  int				 src_x,
+			  int				 src_y,
+			  int				 dst_x,
+			  int				 dst_y,
+			  cairo_composite_glyphs_info_t *info)
+{
+    cairo_image_surface_t *dst = _dst;
+    cairo_scaled_glyph_t *stack_glyphs[CAIRO_STACK_ARRAY_LENGTH (cairo_scaled_glyph_t *)];
+    cairo_scaled_glyph_t **scaled_glyphs = stack_glyphs;
+    const cairo_rectangle_int_t *r = &info->extents;
+    pixman_format_code_t format;
+    pixman_image_t *mask;
+    cairo_int_status_t status;
+    uint8_t *data;
+    int stride, cpp;
+    long area;
+    int i;
+
+    TRACE ((stderr, "%s\n", __FUNCTION__));
+
+    /* Adding overlapping glyphs one at a time rounds differently. */
+    if (! info->use_mask && op == CAIRO_OPERATOR_ADD &&
+	(dst->base.content & CAIRO_CONTENT_COLOR) == 0)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    if (info->num_glyphs > ARRAY_LENGTH (stack_glyphs)) {
+	scaled_glyphs = _cairo_malloc_ab (info->num_glyphs,
+					  sizeof (cairo_scaled_glyph_t *));
+	if (unlikely (scaled_glyphs == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    format = PIXMAN_a8;
+    area = 0;
+    for (i = 0; i < info->num_glyphs; i++) {
+	cairo_image_surface_t *image;
+
+	status = _cairo_scaled_glyph_lookup (info->font,
+					     info->glyphs[i].index,
+					     CAIRO_SCALED_GLYPH_INFO_SURFACE,
+					     &scaled_glyphs[i]);
+	if (unlikely (status))
+	    goto out;
+
+	image = scaled_glyphs[i]->surface;
+	switch (image->format) {
+	case CAIRO_FORMAT_ARGB32:
+	    format = PIXMAN_a8r8g8b8;
+	    /* fall through */
+	case CAIRO_FORMAT_A8:
+	case CAIRO_FORMAT_A1:
+	    break;
+	case CAIRO_FORMAT_RGB30:
+	case CAIRO_FORMAT_RGB24:
+	case CAIRO_FORMAT_RGB16_565:
+	case CAIRO_FORMAT_INVALID:
+	default:
+	    status = CAIRO_INT_STATUS_UNSUPPORTED;
+	    goto out;
+	}
+
+	area += image->width * image->height;
+    }
+
+    if (! info->use_mask &&
+	(long) r->width * r->height > GLYPH_RUN_MAX_OVERDRAW * area)
+    {
+	status = CAIRO_INT_STATUS_UNSUPPORTED;
+	goto out;
+    }
+
+    mask = pixman_image_create_bits (format, r->width, r->height, NULL, 0);
+    if (unlikely (mask == NULL)) {
+	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	goto out;
+    }
+    data = (uint8_t *) pixman_image_get_data (mask);
+    stride = pixman_image_get_stride (mask);
+    cpp = format == PIXMAN_a8 ? 1 : 4;
+
+    for (i = 0; i < info->num_glyphs; i++) {
+	cairo_image_surface_t *image = scaled_glyphs[i]->surface;
+	int x1, y1, x2, y2, x, y;
+
+	/* round glyph locations to the nearest pixel */
+	/* XXX: FRAGILE: We're ignoring device_transform scaling here. A bug? */
+	x = _cairo_lround (info->glyphs[i].x -
+			   image->base.device_transform.x0) - r->x;
+	y = _cairo_lround (info->glyphs[i].y -
+			   image->base.device_transform.y0) - r->y;
+
+	x1 = MAX (x, 0);
+	y1 = MAX (y, 0);
+	x2 = MIN (x + image->width, r->width);
+	y2 = MIN (y + image->height, r->height);
+	if (x2 <= x1 || y2 <= y1)
+	    continue;
+
+	add_glyph (data + y1 * stride + x1 * cpp, stride, cpp == 1,
+		   image, x1 - x, y1 - y,
+		   x2 - x1, y2 - y1);
+    }
+
+    if (format == PIXMAN_a8r8g8b8)
+	pixman_image_set_component_alpha (mask, TRUE);
+
+    pixman_image_composite32 (_pixman_operator (op),
+			      ((cairo_image_source_t *)_src)->pixman_image,
+			      mask,
+			      to_pixman_image (_dst),
+			      r->x + src_x, r->y + src_y,
+			      0, 0,
+			      r->x - dst_x, r->y - dst_y,
+			      r->width, r->height);
+    pixman_image_unref (mask);
+
+    status = CAIRO_INT_STATUS_SUCCESS;
+out:
+    if (scaled_glyphs != stack_glyphs)
+	free (scaled_glyphs);
+    return status;
+}
+
 static cairo_int_status_t
 composite_one_glyph (void				*_dst,
 		     cairo_operator_t			 op,
@@ -1142,7 +1370,7 @@ composite_glyphs (void				*_dst,
 {
     cairo_scaled_glyph_t *glyph_cache[64];
     pixman_image_t *dst, *src;
-    cairo_status_t status;
+    cairo_int_status_t status;
     int i;
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
@@ -1150,6 +1378,11 @@ composite_glyphs (void				*_dst,
     if (info->num_glyphs == 1)
 	return composite_one_glyph(_dst, op, _src, src_x, src_y, dst_x, dst_y, info);
 
+    status = composite_glyphs_batched (_dst, op, _src,
+				       src_x, src_y, dst_x, dst_y, info);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	return status;
+
     if (info->use_mask)
 	return composite_glyphs_via_mask(_dst, op, _src, src_x, src_y, dst_x, dst_y, info);
 
@@ -1209,6 +1442,20 @@ check_composite (const cairo_composite_rectangles_t *extents)
     return CAIRO_STATUS_SUCCESS;
 }
 
+static int
+num_threads (void *_dst)
+{
+    return _cairo_image_surface_num_threads (_dst);
+}
+
+static cairo_bool_t
+cache_fills (void *_dst)
+{
+    cairo_image_surface_t *dst = _dst;
+
+    return dst->tessellation_cache;
+}
+
 const cairo_compositor_t *
 _cairo_image_traps_compositor_get (void)
 {
@@ -1237,6 +1484,8 @@ _cairo_image_traps_compositor_get (void)
 #endif
 	compositor.check_composite_glyphs = check_composite_glyphs;
 	compositor.composite_glyphs = composite_glyphs;
+	compositor.num_threads = num_threads;
+	compositor.cache_fills = cache_fills;
     }
 
     return &compositor.base;
@@ -2899,6 +3148,13 @@ inplace_renderer_init (cairo_image_span_renderer_t	*r,
 	    pixman_image_set_destroy_function (r->mask, free_pixels, buf);
 
 	r->u.composite.dst = dst->pixman_image;
+
+	/* pixman lazily recomputes the flags of an image the first time
+	 * it is used after a change. Do that now with an empty composite
+	 * so that the bands of a fill, which share dst and possibly src,
+	 * only ever read them from the worker threads. */
+	pixman_image_composite32 (PIXMAN_OP_SRC, r->src, r->mask,
+				  dst->pixman_image, 0, 0, 0, 0, 0, 0, 0, 0);
     }
 
     return CAIRO_INT_STATUS_SUCCESS;
@@ -3099,6 +3355,8 @@ _cairo_image_spans_compositor_get (void)
 	//spans.check_span_renderer = check_span_renderer;
 	spans.renderer_init = span_renderer_init;
 	spans.renderer_fini = span_renderer_fini;
+	spans.num_threads = num_threads;
+	spans.cache_fills = cache_fills;
     }
 
     return &spans.base;
@@ -46,6 +46,8 @@
 
 #include "cairo-image-surface-private.h"
 
+#include "cairo-array-private.h"
+#include "cairo-cache-private.h"
 #include "cairo-compositor-private.h"
 #include "cairo-error-private.h"
 #include "cairo-pattern-inline.h"
@@ -55,6 +57,10 @@
 #include "cairo-surface-snapshot-inline.h"
 #include "cairo-surface-subsurface-private.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define PIXMAN_MAX_INT ((pixman_fixed_1 >> 1) - pixman_fixed_e) /* need to ensure deltas also fit */
 
 #if CAIRO_NO_MUTEX
@@ -286,10 +292,582 @@ _cairo_image_reset_static_data (void)
 	__pixman_white_image = NULL;
     }
 #endif
+
+    _cairo_image_mesh_cache_reset_static_data ();
+
+    _cairo_image_gradient_cache_reset_static_data ();
+}
+
+/* Rather than having pixman interpolate between the color stops for
+ * every pixel, gradients are evaluated by indexing a precomputed color
+ * ramp. The same few gradients tend to be used over and over, so the
+ * ramps are cached. A ramp depends on the color stops alone; the
+ * geometry and the extend mode of the gradient only determine how it
+ * is indexed, so they are not part of the key.
+ *
+ * The gradient is then filled into an image which pixman can composite
+ * with its fastest paths. A linear gradient that only varies along one
+ * device axis (the common horizontal or vertical gradient) needs just a
+ * single row or column, which pixman repeats. Anything else needs an
+ * image covering the extents of the operation.
+ *
+ * As the ramp quantizes the colors along the gradient, it is only used
+ * when the destination allows it, see
+ * cairo_image_surface_set_gradient_ramps(); otherwise pixman evaluates
+ * the gradient exactly, as before.
+ */
+#define GRADIENT_RAMP_SIZE 1024
+#define MAX_GRADIENT_CACHE_SIZE (256 << 10)
+
+typedef struct _cairo_gradient_ramp {
+    cairo_cache_entry_t base;
+    cairo_reference_count_t ref_count;
+
+    unsigned int n_stops;
+    const cairo_gradient_stop_t *stops;
+    uint32_t lut[GRADIENT_RAMP_SIZE];
+} cairo_gradient_ramp_t;
+
+static struct {
+    cairo_bool_t initialized;
+    cairo_cache_t cache;
+    unsigned long hits;
+    unsigned long misses;
+} gradient_cache;
+
+static cairo_bool_t
+_cairo_gradient_ramp_keys_equal (const void *key_a, const void *key_b)
+{
+    const cairo_gradient_ramp_t *a = key_a;
+    const cairo_gradient_ramp_t *b = key_b;
+    unsigned int n;
+
+    if (a->n_stops != b->n_stops)
+	return FALSE;
+
+    for (n = 0; n < a->n_stops; n++) {
+	if (a->stops[n].offset != b->stops[n].offset)
+	    return FALSE;
+	if (! _cairo_color_stop_equal (&a->stops[n].color, &b->stops[n].color))
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+_cairo_gradient_ramp_destroy (void *closure)
+{
+    cairo_gradient_ramp_t *ramp = closure;
+
+    if (! _cairo_reference_count_dec_and_test (&ramp->ref_count))
+	return;
+
+    free (ramp);
+}
+
+static void
+_cairo_gradient_ramp_init_key (cairo_gradient_ramp_t *key,
+			       const cairo_gradient_pattern_t *pattern)
+{
+    unsigned long hash = _CAIRO_HASH_INIT_VALUE;
+    unsigned int n;
+
+    /* Only hash what _cairo_color_stop_equal() compares */
+    for (n = 0; n < pattern->n_stops; n++) {
+	const cairo_gradient_stop_t *stop = &pattern->stops[n];
+
+	hash = _cairo_hash_bytes (hash, &stop->offset, sizeof (double));
+	hash = _cairo_hash_bytes (hash, &stop->color.red_short,
+				  4 * sizeof (uint16_t));
+    }
+
+    key->base.hash = hash;
+    key->n_stops = pattern->n_stops;
+    key->stops = pattern->stops;
+}
+
+/* Interpolate the unpremultiplied colors and premultiply the result,
+ * as pixman does. */
+static void
+_cairo_gradient_ramp_compute (cairo_gradient_ramp_t *ramp)
+{
+    const cairo_gradient_stop_t *stops = ramp->stops;
+    unsigned int n_stops = ramp->n_stops;
+    unsigned int k = 0;
+    int i;
+
+    for (i = 0; i < GRADIENT_RAMP_SIZE; i++) {
+	double t = i / (double) (GRADIENT_RAMP_SIZE - 1);
+	const cairo_color_stop_t *c0, *c1;
+	double s, a, r, g, b;
+
+	while (k < n_stops && stops[k].offset <= t)
+	    k++;
+
+	if (k == 0) {
+	    c0 = c1 = &stops[0].color;
+	    s = 0;
+	} else if (k == n_stops) {
+	    c0 = c1 = &stops[n_stops - 1].color;
+	    s = 0;
+	} else {
+	    c0 = &stops[k - 1].color;
+	    c1 = &stops[k].color;
+	    s = (t - stops[k - 1].offset) /
+		(stops[k].offset - stops[k - 1].offset);
+	}
+
+	a = (c0->alpha_short + s * (c1->alpha_short - c0->alpha_short)) / 65535.;
+	r = (c0->red_short + s * (c1->red_short - c0->red_short)) / 65535.;
+	g = (c0->green_short + s * (c1->green_short - c0->green_short)) / 65535.;
+	b = (c0->blue_short + s * (c1->blue_short - c0->blue_short)) / 65535.;
+
+	ramp->lut[i] =
+	    (uint32_t) (a * 255 + .5) << 24 |
+	    (uint32_t) (r * a * 255 + .5) << 16 |
+	    (uint32_t) (g * a * 255 + .5) << 8 |
+	    (uint32_t) (b * a * 255 + .5);
+    }
+}
+
+static cairo_gradient_ramp_t *
+_cairo_gradient_ramp_get (const cairo_gradient_pattern_t *pattern)
+{
+    cairo_gradient_ramp_t key, *ramp;
+    cairo_gradient_stop_t *stops;
+
+    _cairo_gradient_ramp_init_key (&key, pattern);
+
+    CAIRO_MUTEX_LOCK (_cairo_image_gradient_cache_mutex);
+    if (unlikely (! gradient_cache.initialized)) {
+	if (_cairo_cache_init (&gradient_cache.cache,
+			       _cairo_gradient_ramp_keys_equal,
+			       NULL,
+			       _cairo_gradient_ramp_destroy,
+			       MAX_GRADIENT_CACHE_SIZE) == CAIRO_STATUS_SUCCESS)
+	{
+	    _cairo_cache_set_policy (&gradient_cache.cache,
+				     CAIRO_CACHE_POLICY_SLRU);
+	    gradient_cache.initialized = TRUE;
+	}
+    }
+
+    if (likely (gradient_cache.initialized)) {
+	ramp = _cairo_cache_lookup (&gradient_cache.cache, &key.base);
+	if (ramp != NULL) {
+	    gradient_cache.hits++;
+	    _cairo_reference_count_inc (&ramp->ref_count);
+	    CAIRO_MUTEX_UNLOCK (_cairo_image_gradient_cache_mutex);
+	    return ramp;
+	}
+	gradient_cache.misses++;
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_image_gradient_cache_mutex);
+
+    ramp = _cairo_malloc_ab_plus_c (pattern->n_stops,
+				    sizeof (cairo_gradient_stop_t),
+				    sizeof (cairo_gradient_ramp_t));
+    if (unlikely (ramp == NULL))
+	return NULL;
+
+    stops = (cairo_gradient_stop_t *) (ramp + 1);
+    memcpy (stops, pattern->stops,
+	    pattern->n_stops * sizeof (cairo_gradient_stop_t));
+
+    ramp->base.hash = key.base.hash;
+    ramp->base.size = sizeof (cairo_gradient_ramp_t) +
+	pattern->n_stops * sizeof (cairo_gradient_stop_t);
+    CAIRO_REFERENCE_COUNT_INIT (&ramp->ref_count, 1);
+    ramp->n_stops = pattern->n_stops;
+    ramp->stops = stops;
+    _cairo_gradient_ramp_compute (ramp);
+
+    CAIRO_MUTEX_LOCK (_cairo_image_gradient_cache_mutex);
+    /* another thread may have computed the same ramp meanwhile */
+    if (gradient_cache.initialized &&
+	_cairo_cache_lookup (&gradient_cache.cache, &key.base) == NULL &&
+	_cairo_cache_insert (&gradient_cache.cache, &ramp->base) == CAIRO_STATUS_SUCCESS)
+    {
+	_cairo_reference_count_inc (&ramp->ref_count);
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_image_gradient_cache_mutex);
+
+    return ramp;
+}
+
+/* Map the gradient parameter to an entry of the ramp, or -1 where the
+ * gradient is transparent. */
+static inline int
+_cairo_gradient_ramp_index (double t, cairo_extend_t extend)
+{
+    switch (extend) {
+    case CAIRO_EXTEND_NONE:
+	if (! (t >= 0 && t <= 1))
+	    return -1;
+	break;
+    case CAIRO_EXTEND_REPEAT:
+	t -= floor (t);
+	break;
+    case CAIRO_EXTEND_REFLECT:
+	t = fabs (t - 2 * floor (t * .5 + .5));
+	break;
+    default:
+    case CAIRO_EXTEND_PAD:
+	break;
+    }
+
+    /* also catches NaN and the overflows of the reductions above */
+    if (! (t > 0))
+	return 0;
+    if (t > 1)
+	return GRADIENT_RAMP_SIZE - 1;
+
+    return t * (GRADIENT_RAMP_SIZE - 1) + .5;
+}
+
+#if defined(__SSE2__)
+static inline __m128
+_floor_ps (__m128 v)
+{
+    __m128 f = _mm_cvtepi32_ps (_mm_cvttps_epi32 (v));
+
+    return _mm_sub_ps (f, _mm_and_ps (_mm_cmpgt_ps (f, v),
+				      _mm_set1_ps (1.f)));
+}
+#endif
+
+/* Fill a row of pixels along which the parameter of a linear gradient
+ * starts at @t and advances by @dt per pixel. */
+static void
+_cairo_linear_gradient_fill_row (const cairo_gradient_ramp_t *ramp,
+				 cairo_extend_t extend,
+				 double t, double dt,
+				 uint32_t *row, int width)
+{
+    int i = 0;
+
+    /* Reduce the start so that the arithmetic below stays precise */
+    if (extend == CAIRO_EXTEND_REPEAT)
+	t -= floor (t);
+    else if (extend == CAIRO_EXTEND_REFLECT)
+	t -= 2 * floor (t * .5);
+
+#if defined(__SSE2__)
+    {
+	const __m128 steps = _mm_setr_ps (0.f, 1.f, 2.f, 3.f);
+	const __m128 zero = _mm_setzero_ps ();
+	const __m128 one = _mm_set1_ps (1.f);
+	const __m128 half = _mm_set1_ps (.5f);
+	const __m128 scale = _mm_set1_ps (GRADIENT_RAMP_SIZE - 1);
+	const __m128 sign = _mm_set1_ps (-0.f);
+	__m128 vdt = _mm_set1_ps (dt);
+
+	for (; i + 4 <= width; i += 4) {
+	    __m128 v = _mm_add_ps (_mm_set1_ps (t + i * dt),
+				   _mm_mul_ps (steps, vdt));
+	    int index[4], mask = 0xf;
+
+	    switch (extend) {
+	    case CAIRO_EXTEND_NONE:
+		mask = _mm_movemask_ps (_mm_and_ps (_mm_cmpge_ps (v, zero),
+						    _mm_cmple_ps (v, one)));
+		break;
+	    case CAIRO_EXTEND_REPEAT:
+		v = _mm_sub_ps (v, _floor_ps (v));
+		break;
+	    case CAIRO_EXTEND_REFLECT:
+		v = _mm_sub_ps (v,
+				_mm_mul_ps (_mm_add_ps (one, one),
+					   _floor_ps (_mm_add_ps (_mm_mul_ps (v, half),
+								  half))));
+		v = _mm_andnot_ps (sign, v);
+		break;
+	    default:
+	    case CAIRO_EXTEND_PAD:
+		break;
+	    }
+
+	    /* _mm_max_ps() returns its second operand for NaN */
+	    v = _mm_min_ps (_mm_max_ps (v, zero), one);
+	    _mm_storeu_si128 ((__m128i *) index,
+			      _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (v, scale),
+							    half)));
+
+	    row[i + 0] = mask & 1 ? ramp->lut[index[0]] : 0;
+	    row[i + 1] = mask & 2 ? ramp->lut[index[1]] : 0;
+	    row[i + 2] = mask & 4 ? ramp->lut[index[2]] : 0;
+	    row[i + 3] = mask & 8 ? ramp->lut[index[3]] : 0;
+	}
+    }
+#endif
+
+    for (; i < width; i++) {
+	int index = _cairo_gradient_ramp_index (t + i * dt, extend);
+	row[i] = index < 0 ? 0 : ramp->lut[index];
+    }
+}
+
+/* The parameter of a radial gradient is the largest t for which the
+ * point lies on the circle interpolated between the start and end
+ * circles, following pixman's evaluation. Given the @n roots of the
+ * quadratic in decreasing order, pick the color of the first usable one.
+ */
+static inline uint32_t
+_cairo_radial_gradient_pixel (const cairo_gradient_ramp_t *ramp,
+			      cairo_extend_t extend,
+			      double r1, double dr,
+			      const double *t, int n)
+{
+    int j;
+
+    for (j = 0; j < n; j++) {
+	if (extend == CAIRO_EXTEND_NONE ?
+	    0 <= t[j] && t[j] <= 1 :
+	    t[j] * dr >= -r1)
+	{
+	    int index = _cairo_gradient_ramp_index (t[j], extend);
+	    return index < 0 ? 0 : ramp->lut[index];
+	}
+    }
+
+    return 0;
+}
+
+static void
+_cairo_radial_gradient_fill_row (const cairo_gradient_ramp_t *ramp,
+				 const cairo_radial_pattern_t *radial,
+				 cairo_extend_t extend,
+				 double px, double py,
+				 double dx, double dy,
+				 uint32_t *row, int width)
+{
+    double cdx = radial->cd2.center.x - radial->cd1.center.x;
+    double cdy = radial->cd2.center.y - radial->cd1.center.y;
+    double r1 = radial->cd1.radius;
+    double dr = radial->cd2.radius - r1;
+    double a = cdx * cdx + cdy * cdy - dr * dr;
+    double inva = a != 0 ? 1. / a : 0;
+    int i = 0;
+
+    px -= radial->cd1.center.x;
+    py -= radial->cd1.center.y;
+
+#if defined(__SSE2__)
+    /* Two pixels at a time, in double precision like the scalar loop
+     * and with its operations in the same order, so that both produce
+     * the same roots. */
+    if (a != 0) {
+	const __m128d vcdx = _mm_set1_pd (cdx);
+	const __m128d vcdy = _mm_set1_pd (cdy);
+	const __m128d vr1dr = _mm_set1_pd (r1 * dr);
+	const __m128d vr1r1 = _mm_set1_pd (r1 * r1);
+	const __m128d va = _mm_set1_pd (a);
+	const __m128d vinva = _mm_set1_pd (inva);
+	const __m128d zero = _mm_setzero_pd ();
+
+	for (; i + 2 <= width; i += 2) {
+	    __m128d pdx = _mm_setr_pd (px + i * dx, px + (i + 1) * dx);
+	    __m128d pdy = _mm_setr_pd (py + i * dy, py + (i + 1) * dy);
+	    __m128d b, c, discr, sqrtdiscr;
+	    double t0[2], t1[2], t[2];
+	    int mask, j;
+
+	    b = _mm_add_pd (_mm_add_pd (_mm_mul_pd (pdx, vcdx),
+					_mm_mul_pd (pdy, vcdy)),
+			    vr1dr);
+	    c = _mm_sub_pd (_mm_add_pd (_mm_mul_pd (pdx, pdx),
+					_mm_mul_pd (pdy, pdy)),
+			    vr1r1);
+	    discr = _mm_sub_pd (_mm_mul_pd (b, b), _mm_mul_pd (va, c));
+	    mask = _mm_movemask_pd (_mm_cmpge_pd (discr, zero));
+	    sqrtdiscr = _mm_sqrt_pd (_mm_max_pd (discr, zero));
+
+	    _mm_storeu_pd (t0, _mm_mul_pd (_mm_add_pd (b, sqrtdiscr), vinva));
+	    _mm_storeu_pd (t1, _mm_mul_pd (_mm_sub_pd (b, sqrtdiscr), vinva));
+
+	    for (j = 0; j < 2; j++) {
+		t[0] = t0[j];
+		t[1] = t1[j];
+		row[i + j] = _cairo_radial_gradient_pixel (ramp, extend, r1, dr,
+							   t, mask >> j & 1 ? 2 : 0);
+	    }
+	}
+    }
+#endif
+
+    for (; i < width; i++) {
+	double pdx = px + i * dx;
+	double pdy = py + i * dy;
+	double b = pdx * cdx + pdy * cdy + r1 * dr;
+	double c = pdx * pdx + pdy * pdy - r1 * r1;
+	double t[2];
+	int n;
+
+	if (a == 0) {
+	    n = b != 0;
+	    t[0] = .5 * c / b;
+	} else {
+	    double discr = b * b - a * c;
+
+	    n = 0;
+	    if (discr >= 0) {
+		double sqrtdiscr = sqrt (discr);
+
+		t[0] = (b + sqrtdiscr) * inva;
+		t[1] = (b - sqrtdiscr) * inva;
+		n = 2;
+	    }
+	}
+
+	row[i] = _cairo_radial_gradient_pixel (ramp, extend, r1, dr, t, n);
+    }
+}
+
+/* The parameter of a linear gradient at device pixel centre (x, y) is
+ * *ta * x + *tb * y + *tc. */
+static void
+_cairo_linear_gradient_parameter (const cairo_linear_pattern_t *linear,
+				  double *ta, double *tb, double *tc)
+{
+    const cairo_matrix_t *m = &linear->base.base.matrix;
+    double dx = linear->pd2.x - linear->pd1.x;
+    double dy = linear->pd2.y - linear->pd1.y;
+    double l2 = dx * dx + dy * dy;
+
+    *ta = (m->xx * dx + m->yx * dy) / l2;
+    *tb = (m->xy * dx + m->yy * dy) / l2;
+    *tc = ((m->x0 - linear->pd1.x) * dx +
+	   (m->y0 - linear->pd1.y) * dy) / l2;
+}
+
+static cairo_bool_t
+_cairo_gradient_ramp_can_fill (const cairo_image_surface_t *dst,
+			       const cairo_gradient_pattern_t *pattern,
+			       const cairo_rectangle_int_t *extents)
+{
+    if (dst == NULL || ! dst->gradient_ramps)
+	return FALSE;
+
+    if (pattern->n_stops == 0)
+	return FALSE;
+
+    if (extents->width <= 0 || extents->height <= 0)
+	return FALSE;
+
+    if (pattern->base.type == CAIRO_PATTERN_TYPE_LINEAR) {
+	const cairo_linear_pattern_t *linear =
+	    (const cairo_linear_pattern_t *) pattern;
+
+	/* degenerate gradients are left to pixman */
+	if (linear->pd1.x == linear->pd2.x && linear->pd1.y == linear->pd2.y)
+	    return FALSE;
+    }
+
+    return _cairo_matrix_compute_determinant (&pattern->base.matrix) != 0;
 }
 
 static pixman_image_t *
-_pixman_image_for_gradient (const cairo_gradient_pattern_t *pattern,
+_pixman_image_for_gradient_ramp (const cairo_gradient_pattern_t *pattern,
+				 const cairo_rectangle_int_t *extents,
+				 int *ix, int *iy)
+{
+    const cairo_matrix_t *m = &pattern->base.matrix;
+    cairo_extend_t extend = pattern->base.extend;
+    cairo_gradient_ramp_t *ramp;
+    pixman_image_t *image;
+    uint8_t *data;
+    int width = extents->width, height = extents->height;
+    int stride, y;
+    double ta = 0, tb = 0, tc = 0;
+
+    if (pattern->base.type == CAIRO_PATTERN_TYPE_LINEAR) {
+	_cairo_linear_gradient_parameter ((const cairo_linear_pattern_t *) pattern,
+					  &ta, &tb, &tc);
+	if (tb == 0)
+	    height = 1;
+	else if (ta == 0)
+	    width = 1;
+    }
+
+    ramp = _cairo_gradient_ramp_get (pattern);
+    if (unlikely (ramp == NULL))
+	return NULL;
+
+    image = pixman_image_create_bits (PIXMAN_a8r8g8b8, width, height, NULL, 0);
+    if (unlikely (image == NULL)) {
+	_cairo_gradient_ramp_destroy (ramp);
+	return NULL;
+    }
+
+    data = (uint8_t *) pixman_image_get_data (image);
+    stride = pixman_image_get_stride (image);
+
+    /* The pattern matrix maps device space to pattern space; sample
+     * at the pixel centres. */
+    if (pattern->base.type == CAIRO_PATTERN_TYPE_LINEAR) {
+	for (y = 0; y < height; y++) {
+	    _cairo_linear_gradient_fill_row (ramp, extend,
+					     ta * (extents->x + .5) +
+					     tb * (extents->y + y + .5) + tc,
+					     ta,
+					     (uint32_t *) (data + y * stride),
+					     width);
+	}
+    } else {
+	const cairo_radial_pattern_t *radial =
+	    (const cairo_radial_pattern_t *) pattern;
+
+	for (y = 0; y < height; y++) {
+	    double px = extents->x + .5, py = extents->y + y + .5;
+
+	    cairo_matrix_transform_point (m, &px, &py);
+	    _cairo_radial_gradient_fill_row (ramp, radial, extend,
+					     px, py, m->xx, m->yx,
+					     (uint32_t *) (data + y * stride),
+					     width);
+	}
+    }
+
+    _cairo_gradient_ramp_destroy (ramp);
+
+    if (width != extents->width || height != extents->height)
+	pixman_image_set_repeat (image, PIXMAN_REPEAT_NORMAL);
+
+    *ix = -extents->x;
+    *iy = -extents->y;
+    return image;
+}
+
+void
+_cairo_image_gradient_cache_get_stats (unsigned long *hits,
+				       unsigned long *misses,
+				       unsigned long *evictions,
+				       unsigned long *bytes)
+{
+    CAIRO_MUTEX_LOCK (_cairo_image_gradient_cache_mutex);
+    *hits = gradient_cache.hits;
+    *misses = gradient_cache.misses;
+    *evictions = gradient_cache.initialized ? gradient_cache.cache.evictions : 0;
+    *bytes = gradient_cache.initialized ? gradient_cache.cache.size : 0;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_gradient_cache_mutex);
+}
+
+void
+_cairo_image_gradient_cache_reset_static_data (void)
+{
+    CAIRO_MUTEX_LOCK (_cairo_image_gradient_cache_mutex);
+    if (gradient_cache.initialized) {
+	_cairo_cache_fini (&gradient_cache.cache);
+	gradient_cache.initialized = FALSE;
+    }
+    gradient_cache.hits = gradient_cache.misses = 0;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_gradient_cache_mutex);
+}
+
+static pixman_image_t *
+_pixman_image_for_gradient (const cairo_image_surface_t *dst,
+			    const cairo_gradient_pattern_t *pattern,
 			    const cairo_rectangle_int_t *extents,
 			    int *ix, int *iy)
 {
@@ -305,6 +883,9 @@ _pixman_image_for_gradient (const cairo_gradient_pattern_t *pattern,
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
 
+    if (_cairo_gradient_ramp_can_fill (dst, pattern, extents))
+	return _pixman_image_for_gradient_ramp (pattern, extents, ix, iy);
+
     if (pattern->n_stops > ARRAY_LENGTH(pixman_stops_static)) {
 	pixman_stops = _cairo_malloc_ab (pattern->n_stops,
 					 sizeof(pixman_gradient_stop_t));
@@ -387,12 +968,99 @@ _pixman_image_for_gradient (const cairo_gradient_pattern_t *pattern,
     return pixman_image;
 }
 
+/* Rasterising a mesh is expensive, so keep the most recently used
+ * results around. The patterns are in device space by the time they
+ * get here, so an entry is identified by the content of the pattern
+ * (patches, matrix, extend...) together with the extents it was
+ * rasterised for; editing the pattern changes its content and thus
+ * simply stops it from matching its stale entries.
+ *
+ * The callers are free to change the transform and other properties
+ * of the pixman image we return, so every user gets its own image
+ * wrapping the cached pixels, which it keeps alive through a reference
+ * on the cache entry.
+ */
+#define MAX_MESH_CACHE_SIZE (16 << 20)
+
+typedef struct _cairo_mesh_cache_entry {
+    cairo_cache_entry_t base;
+    cairo_reference_count_t ref_count;
+
+    const cairo_pattern_t *pattern;
+    cairo_rectangle_int_t extents;
+    pixman_image_t *image;
+} cairo_mesh_cache_entry_t;
+
+static struct {
+    cairo_bool_t initialized;
+    cairo_cache_t cache;
+    unsigned long hits;
+    unsigned long misses;
+} mesh_cache;
+
+static cairo_bool_t
+_cairo_mesh_cache_keys_equal (const void *key_a, const void *key_b)
+{
+    const cairo_mesh_cache_entry_t *a = key_a;
+    const cairo_mesh_cache_entry_t *b = key_b;
+
+    return a->extents.x == b->extents.x &&
+	   a->extents.y == b->extents.y &&
+	   a->extents.width == b->extents.width &&
+	   a->extents.height == b->extents.height &&
+	   _cairo_pattern_equal (a->pattern, b->pattern);
+}
+
+static void
+_cairo_mesh_cache_entry_destroy (void *closure)
+{
+    cairo_mesh_cache_entry_t *entry = closure;
+
+    if (! _cairo_reference_count_dec_and_test (&entry->ref_count))
+	return;
+
+    pixman_image_unref (entry->image);
+    cairo_pattern_destroy ((cairo_pattern_t *) entry->pattern);
+    free (entry);
+}
+
+static void
+_cairo_mesh_cache_image_destroy (pixman_image_t *image, void *closure)
+{
+    _cairo_mesh_cache_entry_destroy (closure);
+}
+
+/* Called with the cache mutex held. */
 static pixman_image_t *
-_pixman_image_for_mesh (const cairo_mesh_pattern_t *pattern,
+_cairo_mesh_cache_entry_wrap (cairo_mesh_cache_entry_t *entry)
+{
+    pixman_image_t *image;
+
+    image = pixman_image_create_bits (PIXMAN_a8r8g8b8,
+				      entry->extents.width,
+				      entry->extents.height,
+				      pixman_image_get_data (entry->image),
+				      pixman_image_get_stride (entry->image));
+    if (unlikely (image == NULL))
+	return NULL;
+
+    _cairo_reference_count_inc (&entry->ref_count);
+    pixman_image_set_destroy_function (image,
+				       _cairo_mesh_cache_image_destroy,
+				       entry);
+    return image;
+}
+
+static pixman_image_t *
+_pixman_image_for_mesh (cairo_image_surface_t *dst,
+			const cairo_mesh_pattern_t *pattern,
 			const cairo_rectangle_int_t *extents,
 			int *tx, int *ty)
 {
+    cairo_mesh_cache_entry_t key, *entry;
+    cairo_pattern_t *copy;
     pixman_image_t *image;
+    unsigned long size;
     int width, height;
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
@@ -402,6 +1070,37 @@ _pixman_image_for_mesh (const cairo_mesh_pattern_t *pattern,
     width = extents->width;
     height = extents->height;
 
+    key.pattern = &pattern->base;
+    key.extents = *extents;
+    key.base.hash = _cairo_hash_bytes (_cairo_pattern_hash (&pattern->base),
+				       extents, sizeof (*extents));
+
+    CAIRO_MUTEX_LOCK (_cairo_image_mesh_cache_mutex);
+    if (unlikely (! mesh_cache.initialized)) {
+	if (_cairo_cache_init (&mesh_cache.cache,
+			       _cairo_mesh_cache_keys_equal,
+			       NULL,
+			       _cairo_mesh_cache_entry_destroy,
+			       MAX_MESH_CACHE_SIZE) == CAIRO_STATUS_SUCCESS)
+	{
+	    _cairo_cache_set_policy (&mesh_cache.cache,
+				     CAIRO_CACHE_POLICY_SLRU);
+	    mesh_cache.initialized = TRUE;
+	}
+    }
+
+    if (likely (mesh_cache.initialized)) {
+	entry = _cairo_cache_lookup (&mesh_cache.cache, &key.base);
+	if (entry != NULL) {
+	    mesh_cache.hits++;
+	    image = _cairo_mesh_cache_entry_wrap (entry);
+	    CAIRO_MUTEX_UNLOCK (_cairo_image_mesh_cache_mutex);
+	    return image;
+	}
+	mesh_cache.misses++;
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_image_mesh_cache_mutex);
+
     image = pixman_image_create_bits (PIXMAN_a8r8g8b8, width, height, NULL, 0);
     if (unlikely (image == NULL))
 	return NULL;
@@ -410,10 +1109,73 @@ _pixman_image_for_mesh (const cairo_mesh_pattern_t *pattern,
 				   pixman_image_get_data (image),
 				   width, height,
 				   pixman_image_get_stride (image),
-				   *tx, *ty);
+				   *tx, *ty,
+				   dst ? _cairo_image_surface_num_threads (dst) : 1);
+
+    size = (unsigned long) pixman_image_get_stride (image) * height;
+    if (! mesh_cache.initialized || size > MAX_MESH_CACHE_SIZE / 4)
+	return image;
+
+    if (_cairo_pattern_create_copy (&copy, &pattern->base))
+	return image;
+
+    entry = malloc (sizeof (cairo_mesh_cache_entry_t));
+    if (unlikely (entry == NULL)) {
+	cairo_pattern_destroy (copy);
+	return image;
+    }
+
+    entry->base.hash = key.base.hash;
+    entry->base.size = size +
+	_cairo_array_num_elements (&pattern->patches) * sizeof (cairo_mesh_patch_t);
+    CAIRO_REFERENCE_COUNT_INIT (&entry->ref_count, 1);
+    entry->pattern = copy;
+    entry->extents = *extents;
+    entry->image = image;
+
+    CAIRO_MUTEX_LOCK (_cairo_image_mesh_cache_mutex);
+    /* another thread may have rasterised the same mesh meanwhile */
+    if (_cairo_cache_lookup (&mesh_cache.cache, &key.base) != NULL ||
+	_cairo_cache_insert (&mesh_cache.cache, &entry->base))
+    {
+	CAIRO_MUTEX_UNLOCK (_cairo_image_mesh_cache_mutex);
+	entry->image = pixman_image_ref (image);
+	_cairo_mesh_cache_entry_destroy (entry);
+	return image;
+    }
+
+    image = _cairo_mesh_cache_entry_wrap (entry);
+    CAIRO_MUTEX_UNLOCK (_cairo_image_mesh_cache_mutex);
+
     return image;
 }
 
+void
+_cairo_image_mesh_cache_get_stats (unsigned long *hits,
+				   unsigned long *misses,
+				   unsigned long *evictions,
+				   unsigned long *bytes)
+{
+    CAIRO_MUTEX_LOCK (_cairo_image_mesh_cache_mutex);
+    *hits = mesh_cache.hits;
+    *misses = mesh_cache.misses;
+    *evictions = mesh_cache.initialized ? mesh_cache.cache.evictions : 0;
+    *bytes = mesh_cache.initialized ? mesh_cache.cache.size : 0;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_mesh_cache_mutex);
+}
+
+void
+_cairo_image_mesh_cache_reset_static_data (void)
+{
+    CAIRO_MUTEX_LOCK (_cairo_image_mesh_cache_mutex);
+    if (mesh_cache.initialized) {
+	_cairo_cache_fini (&mesh_cache.cache);
+	mesh_cache.initialized = FALSE;
+    }
+    mesh_cache.hits = mesh_cache.misses = 0;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_mesh_cache_mutex);
+}
+
 struct acquire_source_cleanup {
     cairo_surface_t *surface;
     cairo_image_surface_t *image;
@@ -807,6 +1569,11 @@ _pixman_image_for_recording (cairo_image_surface_t *dst,
 							      limit.height);
     }
 
+    /* The replay is part of rendering onto @dst, so it may use as many
+     * threads as @dst allows */
+    if (likely (clone->status == CAIRO_STATUS_SUCCESS))
+	to_image_surface (clone)->num_threads = dst->num_threads;
+
     m = NULL;
     if (extend == CAIRO_EXTEND_NONE) {
 	matrix = pattern->base.matrix;
@@ -844,6 +1611,234 @@ done:
     return pixman_image;
 }
 
+/* Painting a large image at a small fraction of its size with
+ * CAIRO_FILTER_GOOD convolves every one of its pixels. Instead, if the
+ * image allows it (cairo_image_surface_set_mipmap()), keep a pyramid
+ * of successively halved copies of the image and resample the level
+ * closest to the final size, leaving at most a factor of 2 to the
+ * convolution. The pyramid is attached to the image as a snapshot, so
+ * it is discarded as soon as the image is modified. Only the levels
+ * that have been asked for are computed.
+ */
+#define MIPMAP_MAX_LEVELS 16
+
+struct mipmap {
+    cairo_surface_t base;
+    int num_levels;
+    cairo_image_surface_t *levels[MIPMAP_MAX_LEVELS]; /* 1/2, 1/4, ... */
+};
+
+static cairo_status_t
+mipmap_finish (void *abstract_surface)
+{
+    struct mipmap *mipmap = abstract_surface;
+
+    while (mipmap->num_levels)
+	cairo_surface_destroy (&mipmap->levels[--mipmap->num_levels]->base);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static const cairo_surface_backend_t mipmap_backend  = {
+    CAIRO_INTERNAL_SURFACE_TYPE_NULL,
+    mipmap_finish,
+};
+
+static inline void
+_mipmap_accumulate (uint32_t p, uint32_t *rb, uint32_t *ag)
+{
+    *rb += p & 0xff00ff;
+    *ag += p >> 8 & 0xff00ff;
+}
+
+/* Average each 2x2 block of premultiplied pixels. For images with odd
+ * dimensions, the blocks along the right and bottom edges hang over the
+ * image and the samples outside of it count as transparent, so that
+ * the coverage of the level matches that of the original image. */
+static void
+_mipmap_downsample (const cairo_image_surface_t *src,
+		    cairo_image_surface_t *dst)
+{
+    int x, y;
+
+    for (y = 0; y < dst->height; y++) {
+	const uint32_t *r0, *r1;
+	uint32_t *d;
+
+	r0 = (const uint32_t *) (src->data + 2 * y * src->stride);
+	r1 = NULL;
+	if (2 * y + 1 < src->height)
+	    r1 = (const uint32_t *) (src->data + (2 * y + 1) * src->stride);
+	d = (uint32_t *) (dst->data + y * dst->stride);
+
+	for (x = 0; x < dst->width; x++) {
+	    int x0 = 2 * x, x1 = 2 * x + 1;
+	    uint32_t rb = 0x020002, ag = 0x020002;
+
+	    _mipmap_accumulate (r0[x0], &rb, &ag);
+	    if (x1 < src->width)
+		_mipmap_accumulate (r0[x1], &rb, &ag);
+	    if (r1) {
+		_mipmap_accumulate (r1[x0], &rb, &ag);
+		if (x1 < src->width)
+		    _mipmap_accumulate (r1[x1], &rb, &ag);
+	    }
+
+	    d[x] = (rb >> 2 & 0xff00ff) | (ag << 6 & 0xff00ff00);
+	}
+    }
+}
+
+/* Return how many times the image may be halved before resampling it
+ * through @pattern, or 0 if the pyramid should not be used. */
+static int
+_mipmap_level_for_pattern (const cairo_image_surface_t *source,
+			   const cairo_pattern_t *pattern)
+{
+    double scale;
+    int level;
+
+    if (! source->mipmap)
+	return 0;
+
+    if (pattern->filter != CAIRO_FILTER_GOOD)
+	return 0;
+
+    /* The halved images do not tile like the original */
+    if (pattern->extend != CAIRO_EXTEND_NONE &&
+	pattern->extend != CAIRO_EXTEND_PAD)
+	return 0;
+
+    if (source->format != CAIRO_FORMAT_ARGB32 &&
+	source->format != CAIRO_FORMAT_RGB24)
+	return 0;
+
+    scale = MIN (hypot (pattern->matrix.xx, pattern->matrix.yx),
+		 hypot (pattern->matrix.xy, pattern->matrix.yy));
+    if (! (scale >= 2.))
+	return 0;
+
+    level = MIN (floor (log2 (scale)), MIPMAP_MAX_LEVELS);
+    while (level > 0 && (1 << level) > MAX (source->width, source->height))
+	level--;
+
+    /* Partially covered edge pixels can only be represented with an
+     * alpha channel, and padding would spread them over the exterior. */
+    if (source->format != CAIRO_FORMAT_ARGB32 ||
+	pattern->extend != CAIRO_EXTEND_NONE)
+    {
+	while (level > 0 &&
+	       ((source->width | source->height) & ((1 << level) - 1)))
+	    level--;
+    }
+
+    return level;
+}
+
+/* Return a reference to the @level-th halved copy of @source. The
+ * pyramid is shared by all threads drawing from @source, so it is
+ * looked up and extended under _cairo_image_mipmap_mutex. */
+static cairo_image_surface_t *
+_mipmap_get_level (cairo_image_surface_t *source, int level)
+{
+    cairo_image_surface_t *image = NULL;
+    struct mipmap *mipmap;
+
+    CAIRO_MUTEX_LOCK (_cairo_image_mipmap_mutex);
+
+    mipmap = (struct mipmap *) _cairo_surface_has_snapshot (&source->base,
+							    &mipmap_backend);
+    if (mipmap == NULL) {
+	mipmap = malloc (sizeof (*mipmap));
+	if (unlikely (mipmap == NULL)) {
+	    _cairo_error_throw (CAIRO_STATUS_NO_MEMORY);
+	    goto UNLOCK;
+	}
+
+	_cairo_surface_init (&mipmap->base, &mipmap_backend, NULL,
+			     source->base.content);
+	mipmap->num_levels = 0;
+
+	_cairo_surface_attach_snapshot (&source->base, &mipmap->base, NULL);
+	cairo_surface_destroy (&mipmap->base);
+    }
+
+    while (mipmap->num_levels < level) {
+	cairo_image_surface_t *prev;
+
+	prev = mipmap->num_levels ? mipmap->levels[mipmap->num_levels - 1] : source;
+	image = (cairo_image_surface_t *)
+	    cairo_image_surface_create (source->format,
+					(prev->width + 1) / 2,
+					(prev->height + 1) / 2);
+	if (unlikely (image->base.status)) {
+	    cairo_surface_destroy (&image->base);
+	    image = NULL;
+	    goto UNLOCK;
+	}
+
+	_mipmap_downsample (prev, image);
+	mipmap->levels[mipmap->num_levels++] = image;
+    }
+
+    image = (cairo_image_surface_t *)
+	cairo_surface_reference (&mipmap->levels[level - 1]->base);
+
+UNLOCK:
+    CAIRO_MUTEX_UNLOCK (_cairo_image_mipmap_mutex);
+    return image;
+}
+
+static pixman_image_t *
+_pixman_image_for_mipmap (cairo_image_surface_t *source,
+			  const cairo_pattern_t *pattern,
+			  int level,
+			  const cairo_rectangle_int_t *extents,
+			  int *ix, int *iy)
+{
+    cairo_surface_pattern_t scaled;
+    cairo_image_surface_t *image;
+    pixman_image_t *pixman_image;
+    double f = 1. / (1 << level);
+
+    image = _mipmap_get_level (source, level);
+    if (unlikely (image == NULL))
+	return NULL;
+
+    pixman_image = pixman_image_create_bits (image->pixman_format,
+					     image->width,
+					     image->height,
+					     (uint32_t *) image->data,
+					     image->stride);
+    if (unlikely (pixman_image == NULL)) {
+	cairo_surface_destroy (&image->base);
+	return NULL;
+    }
+
+    /* The pyramid may be discarded before this image is used up */
+    pixman_image_set_destroy_function (pixman_image,
+				       _defer_free_cleanup,
+				       image);
+
+    /* Pattern space shrinks along with the image */
+    _cairo_pattern_init_static_copy (&scaled.base, pattern);
+    scaled.base.matrix.xx *= f;
+    scaled.base.matrix.xy *= f;
+    scaled.base.matrix.yx *= f;
+    scaled.base.matrix.yy *= f;
+    scaled.base.matrix.x0 *= f;
+    scaled.base.matrix.y0 *= f;
+
+    if (! _pixman_image_set_properties (pixman_image,
+					&scaled.base, extents,
+					ix, iy)) {
+	pixman_image_unref (pixman_image);
+	pixman_image= NULL;
+    }
+
+    return pixman_image;
+}
+
 static pixman_image_t *
 _pixman_image_for_surface (cairo_image_surface_t *dst,
 			   const cairo_surface_pattern_t *pattern,
@@ -871,6 +1866,7 @@ _pixman_image_for_surface (cairo_image_surface_t *dst,
 	cairo_surface_t *defer_free = NULL;
 	cairo_image_surface_t *source = (cairo_image_surface_t *) pattern->surface;
 	cairo_surface_type_t type;
+	int level;
 
 	if (_cairo_surface_is_snapshot (&source->base)) {
 	    defer_free = _cairo_surface_snapshot_get_target (&source->base);
@@ -922,6 +1918,16 @@ _pixman_image_for_surface (cairo_image_surface_t *dst,
 	    }
 #endif
 
+	    level = _mipmap_level_for_pattern (source, &pattern->base);
+	    if (level) {
+		pixman_image = _pixman_image_for_mipmap (source,
+							 &pattern->base,
+							 level, extents,
+							 ix, iy);
+		cairo_surface_destroy (defer_free);
+		return pixman_image;
+	    }
+
 	    pixman_image = pixman_image_create_bits (source->pixman_format,
 						     source->width,
 						     source->height,
@@ -1158,11 +2164,12 @@ _pixman_image_for_pattern (cairo_image_surface_t *dst,
 
     case CAIRO_PATTERN_TYPE_RADIAL:
     case CAIRO_PATTERN_TYPE_LINEAR:
-	return _pixman_image_for_gradient ((const cairo_gradient_pattern_t *) pattern,
+	return _pixman_image_for_gradient (dst,
+					   (const cairo_gradient_pattern_t *) pattern,
 					   extents, tx, ty);
 
     case CAIRO_PATTERN_TYPE_MESH:
-	return _pixman_image_for_mesh ((const cairo_mesh_pattern_t *) pattern,
+	return _pixman_image_for_mesh (dst, (const cairo_mesh_pattern_t *) pattern,
 					   extents, tx, ty);
 
     case CAIRO_PATTERN_TYPE_SURFACE:
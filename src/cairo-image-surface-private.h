@@ -74,9 +74,24 @@ struct _cairo_image_surface {
     int stride;
     int depth;
 
+    /* Number of threads to use when rasterising onto the surface,
+     * 1 (the default) keeps everything on the calling thread and 0
+     * selects one thread per available cpu. */
+    int num_threads;
+
     unsigned owns_data : 1;
     unsigned transparency : 2;
     unsigned color : 2;
+    /* Whether downscaling the surface as a source may go through a
+     * pyramid of halved copies, see cairo_image_surface_set_mipmap(). */
+    unsigned mipmap : 1;
+    /* Whether gradients drawn onto the surface may be filled from a
+     * precomputed color ramp, see cairo_image_surface_set_gradient_ramps(). */
+    unsigned gradient_ramps : 1;
+    /* Whether the outlines of fills onto the surface may be looked up in
+     * the tessellation cache, see
+     * cairo_image_surface_set_tessellation_cache(). */
+    unsigned tessellation_cache : 1;
 };
 #define to_image_surface(S) ((cairo_image_surface_t *)(S))
 
@@ -222,6 +237,9 @@ _pixman_image_add_tristrip (pixman_image_t *image,
 			    int dst_x, int dst_y,
 			    cairo_tristrip_t *strip);
 
+cairo_private int
+_cairo_image_surface_num_threads (const cairo_image_surface_t *surface);
+
 cairo_private cairo_image_surface_t *
 _cairo_image_surface_clone_subimage (cairo_surface_t             *surface,
 				     const cairo_rectangle_int_t *extents);
@@ -54,6 +54,7 @@
 #include "cairo-scaled-font-private.h"
 #include "cairo-surface-snapshot-private.h"
 #include "cairo-surface-subsurface-private.h"
+#include "cairo-thread-pool-private.h"
 
 /* Limit on the width / height of an image surface in pixels.  This is
  * mainly determined by coordinates of things sent to pixman at the
@@ -169,6 +170,10 @@ _cairo_image_surface_init (cairo_image_surface_t *surface,
     surface->height = pixman_image_get_height (pixman_image);
     surface->stride = pixman_image_get_stride (pixman_image);
     surface->depth = pixman_image_get_depth (pixman_image);
+    surface->num_threads = 1;
+    surface->mipmap = FALSE;
+    surface->gradient_ramps = FALSE;
+    surface->tessellation_cache = FALSE;
 
     surface->base.is_clear = surface->width == 0 || surface->height == 0;
 
@@ -671,6 +676,276 @@ cairo_image_surface_get_stride (cairo_surface_t *surface)
 }
 slim_hidden_def (cairo_image_surface_get_stride);
 
+/**
+ * cairo_image_surface_set_threads:
+ * @surface: a #cairo_image_surface_t
+ * @num_threads: the maximum number of threads to use, or 0 to use one
+ * thread per available processor
+ *
+ * Allows cairo to split the rasterisation of large drawing operations
+ * on @surface across a pool of worker threads. Each operation is divided
+ * into horizontal bands which are scan converted and composited
+ * independently, producing exactly the same pixels as when rendering on
+ * a single thread.
+ *
+ * The default value of 1 keeps all rendering on the calling thread. Note
+ * that the call to the drawing function still only returns once the
+ * whole operation is complete, so this only pays off for operations
+ * covering a large area of a large surface.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_image_surface_set_threads (cairo_surface_t *surface,
+				 int		  num_threads)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (unlikely (surface->status))
+	return;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return;
+    }
+
+    if (num_threads < 0)
+	num_threads = 0;
+
+    image_surface->num_threads = num_threads;
+}
+
+/**
+ * cairo_image_surface_get_threads:
+ * @surface: a #cairo_image_surface_t
+ *
+ * Gets the maximum number of threads used to render onto @surface, as
+ * set by cairo_image_surface_set_threads().
+ *
+ * Return value: the maximum number of threads, 0 meaning one thread per
+ * available processor (or 0 if @surface is not an image surface).
+ *
+ * Since: 1.14
+ **/
+int
+cairo_image_surface_get_threads (cairo_surface_t *surface)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return 0;
+    }
+
+    return image_surface->num_threads;
+}
+
+/* The number of threads that rasterising onto @surface may use, with 0
+ * (one per processor) and anything beyond the thread pool clamped to
+ * the size of the pool. */
+int
+_cairo_image_surface_num_threads (const cairo_image_surface_t *surface)
+{
+    int max_threads, n;
+
+    n = surface->num_threads;
+    if (n == 1)
+	return 1;
+
+    max_threads = _cairo_thread_pool_get_num_threads ();
+    if (n == 0 || n > max_threads)
+	n = max_threads;
+
+    return n;
+}
+
+/**
+ * cairo_image_surface_set_mipmap:
+ * @surface: a #cairo_image_surface_t
+ * @mipmap: %TRUE to allow resampling @surface from a mipmap pyramid
+ *
+ * Allows cairo to keep a pyramid of successively halved copies of
+ * @surface and to resample the closest one when @surface is painted
+ * at half its size or less with %CAIRO_FILTER_GOOD. This is much
+ * faster for large reductions, at the cost of up to a third more
+ * memory while @surface is unmodified and of slightly softer results,
+ * as each level is a 2x2 box average of the previous one.
+ *
+ * The pyramid is only built on demand and is discarded as soon as
+ * @surface is modified. It is not used for repeating patterns, or
+ * for formats other than %CAIRO_FORMAT_ARGB32 and %CAIRO_FORMAT_RGB24.
+ *
+ * By default, the pyramid is not used.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_image_surface_set_mipmap (cairo_surface_t *surface,
+				cairo_bool_t	 mipmap)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (unlikely (surface->status))
+	return;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return;
+    }
+
+    image_surface->mipmap = mipmap != FALSE;
+}
+
+/**
+ * cairo_image_surface_get_mipmap:
+ * @surface: a #cairo_image_surface_t
+ *
+ * Gets whether @surface may be resampled from a mipmap pyramid, as set
+ * by cairo_image_surface_set_mipmap().
+ *
+ * Return value: %TRUE if the pyramid may be used, %FALSE otherwise (or
+ * if @surface is not an image surface).
+ *
+ * Since: 1.14
+ **/
+cairo_bool_t
+cairo_image_surface_get_mipmap (cairo_surface_t *surface)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return FALSE;
+    }
+
+    return image_surface->mipmap;
+}
+
+/**
+ * cairo_image_surface_set_gradient_ramps:
+ * @surface: a #cairo_image_surface_t
+ * @gradient_ramps: %TRUE to allow filling gradients from a color ramp
+ *
+ * Allows cairo to draw linear and radial gradients onto @surface by
+ * looking up each pixel in a precomputed (and cached) ramp of 1024
+ * colors, rather than by interpolating between the color stops for
+ * every pixel. This is much faster, but the colors are quantized along
+ * the gradient: each channel may be off by a couple of levels, and the
+ * transition at a hard color stop may move by a pixel.
+ *
+ * A gradient that only varies along one device axis is filled as a
+ * single row or column; any other is filled into an image covering the
+ * extents of the operation.
+ *
+ * By default, gradients are interpolated exactly.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_image_surface_set_gradient_ramps (cairo_surface_t *surface,
+					cairo_bool_t	 gradient_ramps)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (unlikely (surface->status))
+	return;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return;
+    }
+
+    image_surface->gradient_ramps = gradient_ramps != FALSE;
+}
+
+/**
+ * cairo_image_surface_get_gradient_ramps:
+ * @surface: a #cairo_image_surface_t
+ *
+ * Gets whether gradients drawn onto @surface may be filled from a color
+ * ramp, as set by cairo_image_surface_set_gradient_ramps().
+ *
+ * Return value: %TRUE if color ramps may be used, %FALSE otherwise (or
+ * if @surface is not an image surface).
+ *
+ * Since: 1.14
+ **/
+cairo_bool_t
+cairo_image_surface_get_gradient_ramps (cairo_surface_t *surface)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return FALSE;
+    }
+
+    return image_surface->gradient_ramps;
+}
+
+/**
+ * cairo_image_surface_set_tessellation_cache:
+ * @surface: a #cairo_image_surface_t
+ * @tessellation_cache: %TRUE to look fills up in the tessellation cache
+ *
+ * Allows cairo to keep the flattened outlines of the paths filled onto
+ * @surface in a cache shared by all surfaces that allow it, and to reuse
+ * them when the same path is filled again, even at a different position.
+ * This saves flattening curves and reducing rectilinear paths to boxes
+ * when the same shapes, such as icons, are filled over and over. The
+ * rendering is unchanged.
+ *
+ * The cache holds at most a few megabytes, and keeps the shapes that are
+ * filled most often. Its hit rate is reported by
+ * cairo_debug_get_tessellation_cache_stats(), and it is emptied by
+ * cairo_debug_reset_static_data().
+ *
+ * By default, fills are not cached.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_image_surface_set_tessellation_cache (cairo_surface_t *surface,
+					    cairo_bool_t     tessellation_cache)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (unlikely (surface->status))
+	return;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return;
+    }
+
+    image_surface->tessellation_cache = tessellation_cache != FALSE;
+}
+
+/**
+ * cairo_image_surface_get_tessellation_cache:
+ * @surface: a #cairo_image_surface_t
+ *
+ * Gets whether fills onto @surface may be looked up in the tessellation
+ * cache, as set by cairo_image_surface_set_tessellation_cache().
+ *
+ * Return value: %TRUE if fills may be cached, %FALSE otherwise (or if
+ * @surface is not an image surface).
+ *
+ * Since: 1.14
+ **/
+cairo_bool_t
+cairo_image_surface_get_tessellation_cache (cairo_surface_t *surface)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return FALSE;
+    }
+
+    return image_surface->tessellation_cache;
+}
+
     cairo_format_t
 _cairo_format_from_content (cairo_content_t content)
 {
@@ -774,6 +1049,7 @@ _cairo_image_surface_snapshot (void *abstract_surface)
 
 	clone->transparency = image->transparency;
 	clone->color = image->color;
+	clone->mipmap = image->mipmap;
 
 	clone->owns_data = TRUE;
 	return &clone->base;
@@ -798,6 +1074,7 @@ _cairo_image_surface_snapshot (void *abstract_surface)
 				  0, 0,
 				  image->width, image->height);
     }
+    clone->mipmap = image->mipmap;
     clone->base.is_clear = FALSE;
     return &clone->base;
 }
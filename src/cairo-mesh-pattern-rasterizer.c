@@ -38,6 +38,11 @@
 
 #include "cairo-array-private.h"
 #include "cairo-pattern-private.h"
+#include "cairo-thread-pool-private.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /*
  * Rasterizer for mesh patterns.
@@ -155,6 +160,37 @@
 #define STEPS_CLIP_V 64.0
 #define STEPS_CLIP_U 64.0
 
+/*
+ * Large images are rasterized in horizontal bands, which are run in
+ * parallel on the thread pool. Each band walks the whole mesh, so
+ * bands should not be too thin; there are a few bands per thread so
+ * that a band crossed by many patches does not stall the others.
+ */
+#define MESH_BAND_MIN_ROWS 32
+#define MESH_BAND_MIN_PIXELS (256 * 256)
+#define MESH_BANDS_PER_THREAD 2
+
+/*
+ * The image being drawn.
+ *
+ * data is the base pointer of the image, width and height are its
+ * dimensions and stride is the stride in bytes between adjacent rows.
+ *
+ * Only the rows in [band_top, band_bottom) are written. Visibility
+ * (and thus the choice of where to split patches and curves) is
+ * always computed against the whole image, so that drawing the image
+ * band by band produces exactly the same pixels as drawing it in a
+ * single pass.
+ */
+typedef struct _cairo_mesh_target {
+    unsigned char *data;
+    int width;
+    int height;
+    int stride;
+    int band_top;
+    int band_bottom;
+} cairo_mesh_target_t;
+
 
 /* Utils */
 static inline double
@@ -435,16 +471,28 @@ intersect_interval (double a, double b, double c, double d)
 	return PARTIAL;
 }
 
+/*
+ * Check if a curve or patch spanning the rows [top,bottom] cannot
+ * touch the band of the target.
+ *
+ * This only avoids useless work: pixels outside of the band are never
+ * written anyway. The samples can be off by a fraction of a pixel
+ * because of rounding, so the check is conservative.
+ */
+static inline cairo_bool_t
+outside_band (const cairo_mesh_target_t *target, double top, double bottom)
+{
+    return bottom + 1 < target->band_top || top - 1 >= target->band_bottom;
+}
+
 /*
  * Set the color of a pixel.
  *
- * Input: data is the base pointer of the image
- *        width, height are the dimensions of the image
- *        stride is the stride in bytes between adjacent rows
+ * Input: target is the image being drawn (see cairo_mesh_target_t)
  *        x, y are the coordinates of the pixel to be colored
  *        r,g,b,a are the color components of the color to be set
  *
- * Output: the (x,y) pixel in data has the (r,g,b,a) color
+ * Output: the (x,y) pixel in target has the (r,g,b,a) color
  *
  * The input color components are not premultiplied, but the data
  * stored in the image is assumed to be in CAIRO_FORMAT_ARGB32 (8 bpc,
@@ -454,10 +502,12 @@ intersect_interval (double a, double b, double c, double d)
  * nothing.
  */
 static inline void
-draw_pixel (unsigned char *data, int width, int height, int stride,
+draw_pixel (const cairo_mesh_target_t *target,
 	    int x, int y, uint16_t r, uint16_t g, uint16_t b, uint16_t a)
 {
-    if (likely (0 <= x && 0 <= y && x < width && y < height)) {
+    if (likely (0 <= x && target->band_top <= y &&
+		x < target->width && y < target->band_bottom))
+    {
 	uint32_t tr, tg, tb, ta;
 
 	/* Premultiply and round */
@@ -470,23 +520,58 @@ draw_pixel (unsigned char *data, int width, int height, int stride,
 	tg += tg >> 16;
 	tb += tb >> 16;
 
-	*((uint32_t*) (data + y*stride + 4*x)) = ((ta << 16) & 0xff000000) |
+	*((uint32_t*) (target->data + y*target->stride + 4*x)) = ((ta << 16) & 0xff000000) |
 	    ((tr >> 8) & 0xff0000) | ((tg >> 16) & 0xff00) | (tb >> 24);
     }
 }
 
+#if defined(__SSE2__)
+/*
+ * Same as draw_pixel, but the color is packed in the low four 16-bit
+ * lanes of an SSE2 register, as (b, g, r, a).
+ *
+ * All the channels are premultiplied at once, with the same rounding
+ * as draw_pixel, so the result is bit-identical.
+ */
+static inline void
+draw_pixel_packed (const cairo_mesh_target_t *target,
+		   int x, int y, __m128i color)
+{
+    if (likely (0 <= x && target->band_top <= y &&
+		x < target->width && y < target->band_bottom))
+    {
+	__m128i alpha, t;
+	uint32_t pixel;
+
+	/* Premultiply and round, in 32-bit lanes */
+	alpha = _mm_shufflelo_epi16 (color, _MM_SHUFFLE (3, 3, 3, 3));
+	t = _mm_unpacklo_epi16 (_mm_mullo_epi16 (color, alpha),
+				_mm_mulhi_epu16 (color, alpha));
+	t = _mm_add_epi32 (t, _mm_set1_epi32 (0x8000));
+	t = _mm_add_epi32 (t, _mm_srli_epi32 (t, 16));
+	t = _mm_srli_epi32 (t, 24);
+	t = _mm_packs_epi32 (t, t);
+	t = _mm_packus_epi16 (t, t);
+
+	/* The alpha lane computed a*a, replace it with a */
+	pixel = _mm_cvtsi128_si32 (t) & 0x00ffffff;
+	pixel |= ((uint32_t) _mm_extract_epi16 (color, 3) << 16) & 0xff000000;
+
+	*((uint32_t*) (target->data + y*target->stride + 4*x)) = pixel;
+    }
+}
+#endif
+
 /*
  * Forward-rasterize a cubic curve using forward differences.
  *
- * Input: data is the base pointer of the image
- *        width, height are the dimensions of the image
- *        stride is the stride in bytes between adjacent rows
+ * Input: target is the image being drawn (see cairo_mesh_target_t)
  *        ushift is log2(n) if n is the number of desired steps
  *        dxu[i], dyu[i] are the x,y forward differences of the curve
  *        r0,g0,b0,a0 are the color components of the start point
  *        r3,g3,b3,a3 are the color components of the end point
  *
- * Output: data will be changed to have the requested curve drawn in
+ * Output: target will be changed to have the requested curve drawn in
  *         the specified colors
  *
  * The input color components are not premultiplied, but the data
@@ -499,7 +584,7 @@ draw_pixel (unsigned char *data, int width, int height, int stride,
  * [0,1] (including both extremes).
  */
 static inline void
-rasterize_bezier_curve (unsigned char *data, int width, int height, int stride,
+rasterize_bezier_curve (const cairo_mesh_target_t *target,
 			int ushift, double dxu[4], double dyu[4],
 			uint16_t r0, uint16_t g0, uint16_t b0, uint16_t a0,
 			uint16_t r3, uint16_t g3, uint16_t b3, uint16_t a3)
@@ -507,11 +592,18 @@ rasterize_bezier_curve (unsigned char *data, int width, int height, int stride,
     int32_t xu[4], yu[4];
     int x0, y0, u, usteps = 1 << ushift;
 
-    uint16_t r = r0, g = g0, b = b0, a = a0;
     int16_t dr = _color_delta_to_shifted_short (r0, r3, ushift);
     int16_t dg = _color_delta_to_shifted_short (g0, g3, ushift);
     int16_t db = _color_delta_to_shifted_short (b0, b3, ushift);
     int16_t da = _color_delta_to_shifted_short (a0, a3, ushift);
+#if defined(__SSE2__)
+    /* Step all the color components at once. The 16-bit lanes wrap
+     * around exactly like the scalar uint16_t components would. */
+    __m128i color = _mm_setr_epi16 (b0, g0, r0, a0, 0, 0, 0, 0);
+    __m128i dcolor = _mm_setr_epi16 (db, dg, dr, da, 0, 0, 0, 0);
+#else
+    uint16_t r = r0, g = g0, b = b0, a = a0;
+#endif
 
     fd_fixed (dxu, xu);
     fd_fixed (dyu, yu);
@@ -537,28 +629,34 @@ rasterize_bezier_curve (unsigned char *data, int width, int height, int stride,
 	int x = _cairo_fixed_integer_floor (x0 + (xu[0] >> 15) + ((xu[0] >> 14) & 1));
 	int y = _cairo_fixed_integer_floor (y0 + (yu[0] >> 15) + ((yu[0] >> 14) & 1));
 
-	draw_pixel (data, width, height, stride, x, y, r, g, b, a);
+#if defined(__SSE2__)
+	draw_pixel_packed (target, x, y, color);
+#else
+	draw_pixel (target, x, y, r, g, b, a);
+#endif
 
 	fd_fixed_fwd (xu);
 	fd_fixed_fwd (yu);
+#if defined(__SSE2__)
+	color = _mm_add_epi16 (color, dcolor);
+#else
 	r += dr;
 	g += dg;
 	b += db;
 	a += da;
+#endif
     }
 }
 
 /*
  * Clip, split and rasterize a Bezier curve.
  *
- * Input: data is the base pointer of the image
- *        width, height are the dimensions of the image
- *        stride is the stride in bytes between adjacent rows
+ * Input: target is the image being drawn (see cairo_mesh_target_t)
  *        p[i] is the i-th node of the Bezier curve
  *        c0[i] is the i-th color component at the start point
  *        c3[i] is the i-th color component at the end point
  *
- * Output: data will be changed to have the requested curve drawn in
+ * Output: target will be changed to have the requested curve drawn in
  *         the specified colors
  *
  * The input color components are not premultiplied, but the data
@@ -573,7 +671,7 @@ rasterize_bezier_curve (unsigned char *data, int width, int height, int stride,
  * appear when using this function to rasterize a patch).
  */
 static void
-draw_bezier_curve (unsigned char *data, int width, int height, int stride,
+draw_bezier_curve (const cairo_mesh_target_t *target,
 		   cairo_point_double_t p[4], double c0[4], double c3[4])
 {
     double top, bottom, left, right, steps_sq;
@@ -586,8 +684,8 @@ draw_bezier_curve (unsigned char *data, int width, int height, int stride,
     }
 
     /* Check visibility */
-    v = intersect_interval (top, bottom, 0, height);
-    if (v == OUTSIDE)
+    v = intersect_interval (top, bottom, 0, target->height);
+    if (v == OUTSIDE || outside_band (target, top, bottom))
 	return;
 
     left = right = p[0].x;
@@ -596,7 +694,7 @@ draw_bezier_curve (unsigned char *data, int width, int height, int stride,
 	right = MAX (right, p[i].x);
     }
 
-    v &= intersect_interval (left, right, 0, width);
+    v &= intersect_interval (left, right, 0, target->width);
     if (v == OUTSIDE)
 	return;
 
@@ -615,8 +713,8 @@ draw_bezier_curve (unsigned char *data, int width, int height, int stride,
 	midc[1] = (c0[1] + c3[1]) * 0.5;
 	midc[2] = (c0[2] + c3[2]) * 0.5;
 	midc[3] = (c0[3] + c3[3]) * 0.5;
-	draw_bezier_curve (data, width, height, stride, first, c0, midc);
-	draw_bezier_curve (data, width, height, stride, second, midc, c3);
+	draw_bezier_curve (target, first, c0, midc);
+	draw_bezier_curve (target, second, midc, c3);
     } else {
 	double xu[4], yu[4];
 	int ushift = sqsteps2shift (steps_sq), k;
@@ -629,7 +727,7 @@ draw_bezier_curve (unsigned char *data, int width, int height, int stride,
 	    fd_down (yu);
 	}
 
-	rasterize_bezier_curve (data, width, height, stride, ushift,
+	rasterize_bezier_curve (target, ushift,
 				xu, yu,
 				_cairo_color_double_to_short (c0[0]),
 				_cairo_color_double_to_short (c0[1]),
@@ -642,7 +740,7 @@ draw_bezier_curve (unsigned char *data, int width, int height, int stride,
 
 	/* Draw the end point, to make sure that we didn't leave it
 	 * out because of rounding */
-	draw_pixel (data, width, height, stride,
+	draw_pixel (target,
 		    _cairo_fixed_integer_floor (_cairo_fixed_from_double (p[3].x)),
 		    _cairo_fixed_integer_floor (_cairo_fixed_from_double (p[3].y)),
 		    _cairo_color_double_to_short (c3[0]),
@@ -655,14 +753,12 @@ draw_bezier_curve (unsigned char *data, int width, int height, int stride,
 /*
  * Forward-rasterize a cubic Bezier patch using forward differences.
  *
- * Input: data is the base pointer of the image
- *        width, height are the dimensions of the image
- *        stride is the stride in bytes between adjacent rows
+ * Input: target is the image being drawn (see cairo_mesh_target_t)
  *        vshift is log2(n) if n is the number of desired steps
  *        p[i][j], p[i][j] are the the nodes of the Bezier patch
  *        col[i][j] is the j-th color component of the i-th corner
  *
- * Output: data will be changed to have the requested patch drawn in
+ * Output: target will be changed to have the requested patch drawn in
  *         the specified colors
  *
  * The nodes of the patch are as follows:
@@ -693,7 +789,7 @@ draw_bezier_curve (unsigned char *data, int width, int height, int stride,
  * [0,1] (including both extremes).
  */
 static inline void
-rasterize_bezier_patch (unsigned char *data, int width, int height, int stride, int vshift,
+rasterize_bezier_patch (const cairo_mesh_target_t *target, int vshift,
 			cairo_point_double_t p[4][4], double col[4][4])
 {
     double pv[4][2][4], cstart[4], cend[4], dcstart[4], dcend[4];
@@ -736,7 +832,7 @@ rasterize_bezier_patch (unsigned char *data, int width, int height, int stride,
 	    nodes[i].y = pv[i][1][0];
 	}
 
-	draw_bezier_curve (data, width, height, stride, nodes, cstart, cend);
+	draw_bezier_curve (target, nodes, cstart, cend);
 
 	for (i = 0; i < 4; ++i) {
 	    fd_fwd (pv[i][0]);
@@ -750,13 +846,11 @@ rasterize_bezier_patch (unsigned char *data, int width, int height, int stride,
 /*
  * Clip, split and rasterize a Bezier cubic patch.
  *
- * Input: data is the base pointer of the image
- *        width, height are the dimensions of the image
- *        stride is the stride in bytes between adjacent rows
+ * Input: target is the image being drawn (see cairo_mesh_target_t)
  *        p[i][j], p[i][j] are the nodes of the patch
  *        col[i][j] is the j-th color component of the i-th corner
  *
- * Output: data will be changed to have the requested patch drawn in
+ * Output: target will be changed to have the requested patch drawn in
  *         the specified colors
  *
  * The nodes of the patch are as follows:
@@ -789,7 +883,7 @@ rasterize_bezier_patch (unsigned char *data, int width, int height, int stride,
  * shadings (see http://www.adobe.com/devnet/pdf/pdf_reference.html).
  */
 static void
-draw_bezier_patch (unsigned char *data, int width, int height, int stride,
+draw_bezier_patch (const cairo_mesh_target_t *target,
 		     cairo_point_double_t p[4][4], double c[4][4])
 {
     double top, bottom, left, right, steps_sq;
@@ -803,8 +897,8 @@ draw_bezier_patch (unsigned char *data, int width, int height, int stride,
 	}
     }
 
-    v = intersect_interval (top, bottom, 0, height);
-    if (v == OUTSIDE)
+    v = intersect_interval (top, bottom, 0, target->height);
+    if (v == OUTSIDE || outside_band (target, top, bottom))
 	return;
 
     left = right = p[0][0].x;
@@ -815,7 +909,7 @@ draw_bezier_patch (unsigned char *data, int width, int height, int stride,
 	}
     }
 
-    v &= intersect_interval (left, right, 0, width);
+    v &= intersect_interval (left, right, 0, target->width);
     if (v == OUTSIDE)
 	return;
 
@@ -845,7 +939,7 @@ draw_bezier_patch (unsigned char *data, int width, int height, int stride,
 	    subc[3][i] = 0.5 * (c[1][i] + c[3][i]);
 	}
 
-	draw_bezier_patch (data, width, height, stride, first, subc);
+	draw_bezier_patch (target, first, subc);
 
 	for (i = 0; i < 4; ++i) {
 	    subc[0][i] = subc[2][i];
@@ -853,61 +947,45 @@ draw_bezier_patch (unsigned char *data, int width, int height, int stride,
 	    subc[2][i] = c[2][i];
 	    subc[3][i] = c[3][i];
 	}
-	draw_bezier_patch (data, width, height, stride, second, subc);
+	draw_bezier_patch (target, second, subc);
     } else {
-	rasterize_bezier_patch (data, width, height, stride, sqsteps2shift (steps_sq), p, c);
+	rasterize_bezier_patch (target, sqsteps2shift (steps_sq), p, c);
     }
 }
 
+typedef struct _cairo_mesh_band {
+    const cairo_mesh_pattern_t *mesh;
+    const cairo_matrix_t *p2u;
+    double x_offset;
+    double y_offset;
+    cairo_mesh_target_t target;
+} cairo_mesh_band_t;
+
 /*
- * Draw a tensor product shading pattern.
- *
- * Input: mesh is the mesh pattern
- *        data is the base pointer of the image
- *        width, height are the dimensions of the image
- *        stride is the stride in bytes between adjacent rows
- *
- * Output: data will be changed to have the pattern drawn on it
- *
- * data is assumed to be clear and its content is assumed to be in
- * CAIRO_FORMAT_ARGB32 (8 bpc, premultiplied).
+ * Draw all the patches of a mesh, in order, into a band of the target.
  *
- * This function can be used to rasterize a PDF type 7 shading (see
- * http://www.adobe.com/devnet/pdf/pdf_reference.html).
+ * Input: band describes the mesh, the transformation from pattern
+ *        space to the image and the band being drawn
  */
-void
-_cairo_mesh_pattern_rasterize (const cairo_mesh_pattern_t *mesh,
-			       void                       *data,
-			       int                         width,
-			       int                         height,
-			       int                         stride,
-			       double                      x_offset,
-			       double                      y_offset)
+static void
+draw_mesh_band (void *closure)
 {
+    const cairo_mesh_band_t *band = closure;
+    const cairo_mesh_patch_t *patch;
     cairo_point_double_t nodes[4][4];
     double colors[4][4];
-    cairo_matrix_t p2u;
     unsigned int i, j, k, n;
-    cairo_status_t status;
-    const cairo_mesh_patch_t *patch;
     const cairo_color_t *c;
 
-    assert (mesh->base.status == CAIRO_STATUS_SUCCESS);
-    assert (mesh->current_patch == NULL);
-
-    p2u = mesh->base.matrix;
-    status = cairo_matrix_invert (&p2u);
-    assert (status == CAIRO_STATUS_SUCCESS);
-
-    n = _cairo_array_num_elements (&mesh->patches);
-    patch = _cairo_array_index_const (&mesh->patches, 0);
+    n = _cairo_array_num_elements (&band->mesh->patches);
+    patch = _cairo_array_index_const (&band->mesh->patches, 0);
     for (i = 0; i < n; i++) {
 	for (j = 0; j < 4; j++) {
 	    for (k = 0; k < 4; k++) {
 		nodes[j][k] = patch->points[j][k];
-		cairo_matrix_transform_point (&p2u, &nodes[j][k].x, &nodes[j][k].y);
-		nodes[j][k].x += x_offset;
-		nodes[j][k].y += y_offset;
+		cairo_matrix_transform_point (band->p2u, &nodes[j][k].x, &nodes[j][k].y);
+		nodes[j][k].x += band->x_offset;
+		nodes[j][k].y += band->y_offset;
 	    }
 	}
 
@@ -935,7 +1013,100 @@ _cairo_mesh_pattern_rasterize (const cairo_mesh_pattern_t *mesh,
 	colors[3][2] = c->blue;
 	colors[3][3] = c->alpha;
 
-	draw_bezier_patch (data, width, height, stride, nodes, colors);
+	draw_bezier_patch (&band->target, nodes, colors);
 	patch++;
     }
 }
+
+/*
+ * Choose the number of bands to split the image into.
+ *
+ * Small images are drawn in a single pass, since the cost of walking
+ * the mesh once per band would outweigh any gain.
+ */
+static int
+mesh_num_bands (int width, int height, int max_threads)
+{
+    int num_bands;
+
+    if ((double) width * height < MESH_BAND_MIN_PIXELS)
+	return 1;
+
+    num_bands = MIN (max_threads, _cairo_thread_pool_get_num_threads ());
+    if (num_bands <= 1)
+	return 1;
+
+    num_bands *= MESH_BANDS_PER_THREAD;
+    if (num_bands > height / MESH_BAND_MIN_ROWS)
+	num_bands = height / MESH_BAND_MIN_ROWS;
+
+    return MAX (num_bands, 1);
+}
+
+/*
+ * Draw a tensor product shading pattern.
+ *
+ * Input: mesh is the mesh pattern
+ *        data is the base pointer of the image
+ *        width, height are the dimensions of the image
+ *        stride is the stride in bytes between adjacent rows
+ *        max_threads is the number of threads the caller allows
+ *
+ * Output: data will be changed to have the pattern drawn on it
+ *
+ * data is assumed to be clear and its content is assumed to be in
+ * CAIRO_FORMAT_ARGB32 (8 bpc, premultiplied).
+ *
+ * Large images are split in horizontal bands which are drawn in
+ * parallel, when max_threads allows. Every band draws all of the patches in order, so patches
+ * still overlap as specified, and the result is identical to drawing
+ * the whole image in a single pass.
+ *
+ * This function can be used to rasterize a PDF type 7 shading (see
+ * http://www.adobe.com/devnet/pdf/pdf_reference.html).
+ */
+void
+_cairo_mesh_pattern_rasterize (const cairo_mesh_pattern_t *mesh,
+			       void                       *data,
+			       int                         width,
+			       int                         height,
+			       int                         stride,
+			       double                      x_offset,
+			       double                      y_offset,
+			       int                         max_threads)
+{
+    cairo_mesh_band_t bands[CAIRO_THREAD_POOL_MAX_THREADS * MESH_BANDS_PER_THREAD];
+    cairo_matrix_t p2u;
+    cairo_status_t status;
+    int i, num_bands, rows;
+
+    assert (mesh->base.status == CAIRO_STATUS_SUCCESS);
+    assert (mesh->current_patch == NULL);
+
+    p2u = mesh->base.matrix;
+    status = cairo_matrix_invert (&p2u);
+    assert (status == CAIRO_STATUS_SUCCESS);
+
+    num_bands = mesh_num_bands (width, height, max_threads);
+    if (num_bands > ARRAY_LENGTH (bands))
+	num_bands = ARRAY_LENGTH (bands);
+    rows = (height + num_bands - 1) / num_bands;
+
+    for (i = 0; i < num_bands; i++) {
+	cairo_mesh_band_t *band = &bands[i];
+
+	band->mesh = mesh;
+	band->p2u = &p2u;
+	band->x_offset = x_offset;
+	band->y_offset = y_offset;
+
+	band->target.data = data;
+	band->target.width = width;
+	band->target.height = height;
+	band->target.stride = stride;
+	band->target.band_top = i * rows;
+	band->target.band_bottom = MIN (height, (i + 1) * rows);
+    }
+
+    _cairo_thread_pool_run (draw_mesh_band, bands, num_bands, sizeof (*bands));
+}
@@ -39,6 +39,9 @@
 CAIRO_MUTEX_DECLARE (_cairo_pattern_solid_surface_cache_lock)
 
 CAIRO_MUTEX_DECLARE (_cairo_image_solid_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_image_mesh_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_image_gradient_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_image_mipmap_mutex)
 
 CAIRO_MUTEX_DECLARE (_cairo_toy_font_face_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_intern_string_mutex)
@@ -46,6 +49,8 @@ CAIRO_MUTEX_DECLARE (_cairo_scaled_font_map_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_scaled_font_error_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_fill_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_recording_cull_mutex)
 
 #if CAIRO_HAS_FT_FONT
 CAIRO_MUTEX_DECLARE (_cairo_ft_unscaled_font_map_mutex)
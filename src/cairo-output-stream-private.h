@@ -197,5 +197,10 @@ _cairo_base64_stream_create (cairo_output_stream_t *output);
 cairo_private cairo_output_stream_t *
 _cairo_deflate_stream_create (cairo_output_stream_t *output);
 
+cairo_private cairo_output_stream_t *
+_cairo_deflate_stream_create_with_options (cairo_output_stream_t *output,
+					   int                    level,
+					   int                    num_threads);
+
 
 #endif /* CAIRO_OUTPUT_STREAM_PRIVATE_H */
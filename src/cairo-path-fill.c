@@ -37,7 +37,9 @@
 
 #include "cairoint.h"
 #include "cairo-boxes-private.h"
+#include "cairo-cache-private.h"
 #include "cairo-error-private.h"
+#include "cairo-list-inline.h"
 #include "cairo-path-fixed-private.h"
 #include "cairo-region-private.h"
 #include "cairo-traps-private.h"
@@ -339,3 +341,443 @@ _cairo_path_fixed_fill_rectilinear_to_boxes (const cairo_path_fixed_t *path,
 								   antialias,
 								   boxes);
 }
+
+/*
+ * A cache of the flattened outlines of recently filled paths, for the
+ * surfaces that opted in with cairo_image_surface_set_tessellation_cache().
+ *
+ * The path is already in device space, so the key is its shape relative
+ * to its first point together with the flattening tolerance. Spline
+ * decomposition only ever works on differences between the control
+ * points, so a path that is merely translated flattens to exactly the
+ * same edges shifted by the same amount and can be replayed from the
+ * cache. The polygon is cached without any limits and clipped to the
+ * limits of each caller on replay.
+ *
+ * Rectilinear paths are cached as the boxes they reduce to, which also
+ * depend upon the fill rule and antialiasing. Without antialiasing the
+ * boxes are rounded to whole pixels, so the origin of their shape is the
+ * pixel containing the first point instead, and only translations by
+ * whole pixels are replayed.
+ */
+#define FILL_CACHE_MAX_SIZE (4 << 20)
+
+typedef struct _cairo_fill_cache_entry {
+    cairo_cache_entry_t base;
+
+    /* set on lookup keys only */
+    const cairo_path_fixed_t *path;
+    cairo_point_t origin;
+
+    cairo_bool_t is_boxes;
+    double tolerance;
+    cairo_fill_rule_t fill_rule;
+    cairo_antialias_t antialias;
+    int num_ops;
+    int num_points;
+    int num_edges;
+    int num_boxes;
+    cairo_path_op_t *ops;
+    cairo_point_t *points;
+    cairo_edge_t *edges;
+    cairo_box_t *boxes;
+} cairo_fill_cache_entry_t;
+
+static cairo_cache_t fill_cache;
+static cairo_bool_t fill_cache_initialized;
+static unsigned long fill_cache_hits;
+static unsigned long fill_cache_misses;
+
+static cairo_bool_t
+_cairo_fill_cache_keys_equal (const void *key_a, const void *key_b)
+{
+    const cairo_fill_cache_entry_t *key = key_a;
+    const cairo_fill_cache_entry_t *entry = key_b;
+    const cairo_path_buf_t *buf;
+    int num_ops, num_points;
+    unsigned int i;
+
+    if (key->is_boxes != entry->is_boxes ||
+	key->tolerance != entry->tolerance ||
+	key->fill_rule != entry->fill_rule ||
+	key->antialias != entry->antialias ||
+	key->num_ops != entry->num_ops ||
+	key->num_points != entry->num_points)
+    {
+	return FALSE;
+    }
+
+    num_ops = num_points = 0;
+    cairo_path_foreach_buf_start (buf, key->path) {
+	if (memcmp (buf->op, entry->ops + num_ops, buf->num_ops))
+	    return FALSE;
+	num_ops += buf->num_ops;
+
+	for (i = 0; i < buf->num_points; i++) {
+	    const cairo_point_t *p = &entry->points[num_points++];
+
+	    if (buf->points[i].x - key->origin.x != p->x ||
+		buf->points[i].y - key->origin.y != p->y)
+	    {
+		return FALSE;
+	    }
+	}
+    } cairo_path_foreach_buf_end (buf, key->path);
+
+    return TRUE;
+}
+
+static void
+_cairo_fill_cache_key_init (cairo_fill_cache_entry_t *key,
+			    const cairo_path_fixed_t *path,
+			    cairo_bool_t is_boxes,
+			    double tolerance,
+			    cairo_fill_rule_t fill_rule,
+			    cairo_antialias_t antialias)
+{
+    const cairo_path_buf_t *buf;
+    unsigned long hash = _CAIRO_HASH_INIT_VALUE;
+    unsigned int i;
+
+    key->path = path;
+    key->origin = cairo_path_head (path)->points[0];
+    if (is_boxes && antialias == CAIRO_ANTIALIAS_NONE) {
+	key->origin.x = _cairo_fixed_round_down (key->origin.x);
+	key->origin.y = _cairo_fixed_round_down (key->origin.y);
+    }
+    key->is_boxes = is_boxes;
+    key->tolerance = tolerance;
+    key->fill_rule = fill_rule;
+    key->antialias = antialias;
+
+    key->num_edges = key->num_boxes = 0;
+    key->num_ops = key->num_points = 0;
+    cairo_path_foreach_buf_start (buf, path) {
+	hash = _cairo_hash_bytes (hash, buf->op, buf->num_ops);
+	key->num_ops += buf->num_ops;
+
+	for (i = 0; i < buf->num_points; i++) {
+	    cairo_point_t p;
+
+	    p.x = buf->points[i].x - key->origin.x;
+	    p.y = buf->points[i].y - key->origin.y;
+	    hash = _cairo_hash_bytes (hash, &p, sizeof (p));
+	}
+	key->num_points += buf->num_points;
+    } cairo_path_foreach_buf_end (buf, path);
+
+    hash = _cairo_hash_bytes (hash, &tolerance, sizeof (tolerance));
+    if (is_boxes) {
+	hash = _cairo_hash_bytes (hash, &fill_rule, sizeof (fill_rule));
+	hash = _cairo_hash_bytes (hash, &antialias, sizeof (antialias));
+    }
+    key->base.hash = hash;
+}
+
+/* Allocates an entry for @key with room for @data_size bytes of edges
+ * or boxes, to be filled in by the caller, in front of the shape. */
+static cairo_fill_cache_entry_t *
+_cairo_fill_cache_entry_create (const cairo_fill_cache_entry_t *key,
+				size_t data_size)
+{
+    cairo_fill_cache_entry_t *entry;
+    const cairo_path_buf_t *buf;
+    size_t size;
+    int i, n;
+
+    size = sizeof (cairo_fill_cache_entry_t) + data_size +
+	   key->num_points * sizeof (cairo_point_t) +
+	   key->num_ops;
+    if (size > FILL_CACHE_MAX_SIZE / 8)
+	return NULL;
+
+    entry = malloc (size);
+    if (unlikely (entry == NULL))
+	return NULL;
+
+    *entry = *key;
+    entry->base.size = size;
+    entry->path = NULL;
+    entry->edges = (cairo_edge_t *) (entry + 1);
+    entry->boxes = (cairo_box_t *) (entry + 1);
+    entry->points = (cairo_point_t *) ((char *) (entry + 1) + data_size);
+    entry->ops = (cairo_path_op_t *) (entry->points + entry->num_points);
+
+    i = n = 0;
+    cairo_path_foreach_buf_start (buf, key->path) {
+	unsigned int j;
+
+	memcpy (entry->ops + i, buf->op, buf->num_ops);
+	i += buf->num_ops;
+
+	for (j = 0; j < buf->num_points; j++) {
+	    entry->points[n].x = buf->points[j].x - key->origin.x;
+	    entry->points[n].y = buf->points[j].y - key->origin.y;
+	    n++;
+	}
+    } cairo_path_foreach_buf_end (buf, key->path);
+
+    return entry;
+}
+
+/* Called with the mutex held, the cache is created on first use */
+static cairo_fill_cache_entry_t *
+_cairo_fill_cache_lookup (cairo_fill_cache_entry_t *key)
+{
+    cairo_fill_cache_entry_t *entry = NULL;
+
+    if (! fill_cache_initialized) {
+	if (_cairo_cache_init (&fill_cache,
+			       _cairo_fill_cache_keys_equal,
+			       NULL,
+			       free,
+			       FILL_CACHE_MAX_SIZE))
+	{
+	    return NULL;
+	}
+
+	/* keep the shapes that are drawn over and over resident
+	 * whilst one-off paths pass through */
+	_cairo_cache_set_policy (&fill_cache, CAIRO_CACHE_POLICY_SLRU);
+	fill_cache_initialized = TRUE;
+    }
+
+    entry = _cairo_cache_lookup (&fill_cache, &key->base);
+    if (entry != NULL)
+	fill_cache_hits++;
+    else
+	fill_cache_misses++;
+
+    return entry;
+}
+
+static void
+_cairo_fill_cache_insert (cairo_fill_cache_entry_t *key,
+			  cairo_fill_cache_entry_t *entry)
+{
+    CAIRO_MUTEX_LOCK (_cairo_fill_cache_mutex);
+    /* another thread may have beaten us to it */
+    if (! fill_cache_initialized ||
+	_cairo_cache_lookup (&fill_cache, &key->base) != NULL ||
+	_cairo_cache_insert (&fill_cache, &entry->base))
+    {
+	free (entry);
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_fill_cache_mutex);
+}
+
+static cairo_status_t
+_cairo_fill_cache_replay_edges (const cairo_edge_t *edges,
+				int num_edges,
+				const cairo_point_t *offset,
+				cairo_polygon_t *polygon)
+{
+    cairo_status_t status;
+    int i;
+
+    for (i = 0; i < num_edges; i++) {
+	cairo_line_t line = edges[i].line;
+
+	line.p1.x += offset->x;
+	line.p1.y += offset->y;
+	line.p2.x += offset->x;
+	line.p2.y += offset->y;
+
+	status = _cairo_polygon_add_line (polygon, &line,
+					  edges[i].top + offset->y,
+					  edges[i].bottom + offset->y,
+					  edges[i].dir);
+	if (unlikely (status))
+	    return status;
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_fill_cache_replay_boxes (const cairo_box_t *cached,
+				int num_boxes,
+				const cairo_point_t *offset,
+				cairo_antialias_t antialias,
+				cairo_boxes_t *boxes)
+{
+    cairo_status_t status;
+    int i;
+
+    for (i = 0; i < num_boxes; i++) {
+	cairo_box_t box = cached[i];
+
+	box.p1.x += offset->x;
+	box.p1.y += offset->y;
+	box.p2.x += offset->x;
+	box.p2.y += offset->y;
+
+	status = _cairo_boxes_add (boxes, antialias, &box);
+	if (unlikely (status))
+	    return status;
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* As _cairo_path_fixed_fill_to_polygon(), looking the polygon up in the
+ * cache and adding it there on a miss. */
+cairo_status_t
+_cairo_path_fixed_fill_to_polygon_cached (const cairo_path_fixed_t *path,
+					  double tolerance,
+					  cairo_polygon_t *polygon)
+{
+    cairo_fill_cache_entry_t key, *entry;
+    cairo_polygon_t flat;
+    cairo_point_t zero;
+    cairo_status_t status;
+    int i;
+
+    if (cairo_path_head (path)->num_points == 0)
+	return _cairo_path_fixed_fill_to_polygon (path, tolerance, polygon);
+
+    _cairo_fill_cache_key_init (&key, path, FALSE, tolerance, 0, 0);
+
+    CAIRO_MUTEX_LOCK (_cairo_fill_cache_mutex);
+    entry = _cairo_fill_cache_lookup (&key);
+    if (entry != NULL) {
+	status = _cairo_fill_cache_replay_edges (entry->edges, entry->num_edges,
+						 &key.origin, polygon);
+	CAIRO_MUTEX_UNLOCK (_cairo_fill_cache_mutex);
+	return status;
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_fill_cache_mutex);
+
+    _cairo_polygon_init (&flat, NULL, 0);
+    status = _cairo_path_fixed_fill_to_polygon (path, tolerance, &flat);
+    if (unlikely (status))
+	goto FINISH;
+
+    entry = _cairo_fill_cache_entry_create (&key,
+					    flat.num_edges * sizeof (cairo_edge_t));
+    if (entry != NULL) {
+	entry->num_edges = flat.num_edges;
+	for (i = 0; i < flat.num_edges; i++) {
+	    cairo_edge_t *edge = &entry->edges[i];
+
+	    *edge = flat.edges[i];
+	    edge->line.p1.x -= key.origin.x;
+	    edge->line.p1.y -= key.origin.y;
+	    edge->line.p2.x -= key.origin.x;
+	    edge->line.p2.y -= key.origin.y;
+	    edge->top -= key.origin.y;
+	    edge->bottom -= key.origin.y;
+	}
+
+	_cairo_fill_cache_insert (&key, entry);
+    }
+
+    zero.x = zero.y = 0;
+    status = _cairo_fill_cache_replay_edges (flat.edges, flat.num_edges,
+					     &zero, polygon);
+
+  FINISH:
+    _cairo_polygon_fini (&flat);
+    return status;
+}
+
+/* As _cairo_path_fixed_fill_rectilinear_to_boxes(), looking the boxes up
+ * in the cache and adding them there on a miss. */
+cairo_status_t
+_cairo_path_fixed_fill_rectilinear_to_boxes_cached (const cairo_path_fixed_t *path,
+						    cairo_fill_rule_t fill_rule,
+						    cairo_antialias_t antialias,
+						    cairo_boxes_t *boxes)
+{
+    cairo_fill_cache_entry_t key, *entry;
+    const struct _cairo_boxes_chunk *chunk;
+    cairo_boxes_t flat;
+    cairo_status_t status;
+    cairo_box_t box;
+    int i, n;
+
+    /* a single box is quicker to recognise than to look up */
+    if (_cairo_path_fixed_is_box (path, &box))
+	return _cairo_boxes_add (boxes, antialias, &box);
+
+    if (cairo_path_head (path)->num_points == 0) {
+	return _cairo_path_fixed_fill_rectilinear_to_boxes (path,
+							    fill_rule,
+							    antialias,
+							    boxes);
+    }
+
+    _cairo_fill_cache_key_init (&key, path, TRUE, 0., fill_rule, antialias);
+
+    CAIRO_MUTEX_LOCK (_cairo_fill_cache_mutex);
+    entry = _cairo_fill_cache_lookup (&key);
+    if (entry != NULL) {
+	status = _cairo_fill_cache_replay_boxes (entry->boxes, entry->num_boxes,
+						 &key.origin, antialias, boxes);
+	CAIRO_MUTEX_UNLOCK (_cairo_fill_cache_mutex);
+	return status;
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_fill_cache_mutex);
+
+    _cairo_boxes_init (&flat);
+    status = _cairo_path_fixed_fill_rectilinear_to_boxes (path,
+							  fill_rule,
+							  antialias,
+							  &flat);
+    if (unlikely (status))
+	goto FINISH;
+
+    entry = _cairo_fill_cache_entry_create (&key,
+					    flat.num_boxes * sizeof (cairo_box_t));
+    if (entry != NULL) {
+	entry->num_boxes = flat.num_boxes;
+	n = 0;
+	for (chunk = &flat.chunks; chunk != NULL; chunk = chunk->next) {
+	    for (i = 0; i < chunk->count; i++) {
+		box = chunk->base[i];
+		box.p1.x -= key.origin.x;
+		box.p1.y -= key.origin.y;
+		box.p2.x -= key.origin.x;
+		box.p2.y -= key.origin.y;
+		entry->boxes[n++] = box;
+	    }
+	}
+
+	_cairo_fill_cache_insert (&key, entry);
+    }
+
+    for (chunk = &flat.chunks; chunk != NULL; chunk = chunk->next) {
+	for (i = 0; i < chunk->count; i++) {
+	    status = _cairo_boxes_add (boxes, antialias, &chunk->base[i]);
+	    if (unlikely (status))
+		goto FINISH;
+	}
+    }
+
+  FINISH:
+    _cairo_boxes_fini (&flat);
+    return status;
+}
+
+void
+_cairo_path_fill_cache_get_stats (unsigned long *hits,
+				  unsigned long *misses,
+				  unsigned long *evictions)
+{
+    CAIRO_MUTEX_LOCK (_cairo_fill_cache_mutex);
+    *hits = fill_cache_hits;
+    *misses = fill_cache_misses;
+    *evictions = fill_cache_initialized ? fill_cache.evictions : 0;
+    CAIRO_MUTEX_UNLOCK (_cairo_fill_cache_mutex);
+}
+
+void
+_cairo_path_fill_cache_reset_static_data (void)
+{
+    CAIRO_MUTEX_LOCK (_cairo_fill_cache_mutex);
+    if (fill_cache_initialized)
+	_cairo_cache_fini (&fill_cache);
+    fill_cache_initialized = FALSE;
+    fill_cache_hits = fill_cache_misses = 0;
+    CAIRO_MUTEX_UNLOCK (_cairo_fill_cache_mutex);
+}
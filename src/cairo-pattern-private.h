@@ -337,7 +337,8 @@ _cairo_mesh_pattern_rasterize (const cairo_mesh_pattern_t *mesh,
 			       int                         height,
 			       int                         stride,
 			       double                      x_offset,
-			       double                      y_offset);
+			       double                      y_offset,
+			       int                         max_threads);
 
 cairo_private cairo_surface_t *
 _cairo_raster_source_pattern_acquire (const cairo_pattern_t *abstract_pattern,
@@ -44,6 +44,7 @@
 
 #include "cairo-pdf.h"
 
+#include "cairo-content-hash-private.h"
 #include "cairo-surface-private.h"
 #include "cairo-surface-clipper-private.h"
 #include "cairo-pdf-operators-private.h"
@@ -70,6 +71,8 @@ typedef struct _cairo_pdf_source_surface_entry {
     unsigned int id;
     unsigned char *unique_id;
     unsigned long unique_id_length;
+    cairo_bool_t has_digest;
+    cairo_content_digest_t digest;
     cairo_operator_t operator;
     cairo_bool_t interpolate;
     cairo_bool_t stencil_mask;
@@ -170,6 +173,10 @@ struct _cairo_pdf_surface {
 
     cairo_pdf_version_t pdf_version;
     cairo_bool_t compress_content;
+    int compression_level;
+    int num_threads;
+    cairo_bool_t use_object_streams;
+    cairo_bool_t deduplicate_content;
 
     cairo_pdf_resource_t content;
     cairo_pdf_resource_t content_resources;
@@ -196,6 +203,15 @@ struct _cairo_pdf_surface {
 	cairo_bool_t is_knockout;
     } group_stream;
 
+    /* Non-stream objects collected for the next /ObjStm */
+    struct {
+	cairo_bool_t active;
+	cairo_bool_t written;
+	cairo_output_stream_t *stream;
+	cairo_output_stream_t *old_output;
+	cairo_array_t objects;
+    } object_stream;
+
     cairo_surface_clipper_t clipper;
 
     cairo_pdf_operators_t pdf_operators;
@@ -188,9 +188,15 @@ static const char *_cairo_pdf_supported_mime_types[] =
 };
 
 typedef struct _cairo_pdf_object {
-    long offset;
+    long offset;	/* or the index within its object stream */
+    int object_stream;	/* the object stream holding it, or 0 */
 } cairo_pdf_object_t;
 
+typedef struct _cairo_pdf_packed_object {
+    cairo_pdf_resource_t resource;
+    long offset;
+} cairo_pdf_packed_object_t;
+
 typedef struct _cairo_pdf_font {
     unsigned int font_id;
     unsigned int subset_id;
@@ -250,6 +256,11 @@ _cairo_pdf_surface_write_catalog (cairo_pdf_surface_t *surface);
 static long
 _cairo_pdf_surface_write_xref (cairo_pdf_surface_t *surface);
 
+static long
+_cairo_pdf_surface_write_xref_stream (cairo_pdf_surface_t	*surface,
+				      cairo_pdf_resource_t	 catalog,
+				      cairo_pdf_resource_t	 info);
+
 static cairo_int_status_t
 _cairo_pdf_surface_write_page (cairo_pdf_surface_t *surface);
 
@@ -270,6 +281,7 @@ _cairo_pdf_surface_new_object (cairo_pdf_surface_t *surface)
     cairo_pdf_object_t object;
 
     object.offset = _cairo_output_stream_get_position (surface->output);
+    object.object_stream = 0;
 
     status = _cairo_array_append (&surface->objects, &object);
     if (unlikely (status)) {
@@ -291,6 +303,168 @@ _cairo_pdf_surface_update_object (cairo_pdf_surface_t	*surface,
 
     object = _cairo_array_index (&surface->objects, resource.id - 1);
     object->offset = _cairo_output_stream_get_position (surface->output);
+    object->object_stream = 0;
+}
+
+static cairo_bool_t
+_cairo_pdf_surface_use_object_streams (cairo_pdf_surface_t *surface)
+{
+    return surface->use_object_streams &&
+	surface->pdf_version >= CAIRO_PDF_VERSION_1_5;
+}
+
+/* Begins the non-stream object @resource. Unless object streams are in
+ * use, this writes the "obj" header as before; otherwise surface->output
+ * is redirected into the pending object stream until the matching
+ * _cairo_pdf_surface_object_end(). Should the object fail to be queued,
+ * it is simply written out directly.
+ */
+static void
+_cairo_pdf_surface_object_begin (cairo_pdf_surface_t	*surface,
+				 cairo_pdf_resource_t	 resource)
+{
+    assert (! surface->object_stream.active);
+
+    if (_cairo_pdf_surface_use_object_streams (surface)) {
+	cairo_pdf_packed_object_t packed;
+	cairo_int_status_t status;
+
+	if (surface->object_stream.stream == NULL)
+	    surface->object_stream.stream = _cairo_memory_stream_create ();
+
+	status = _cairo_output_stream_get_status (surface->object_stream.stream);
+	if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+	    packed.resource = resource;
+	    packed.offset =
+		_cairo_output_stream_get_position (surface->object_stream.stream);
+	    status = _cairo_array_append (&surface->object_stream.objects,
+					  &packed);
+	}
+	if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+	    surface->object_stream.active = TRUE;
+	    surface->object_stream.old_output = surface->output;
+	    surface->output = surface->object_stream.stream;
+	    return;
+	}
+    }
+
+    _cairo_pdf_surface_update_object (surface, resource);
+    _cairo_output_stream_printf (surface->output,
+				 "%d 0 obj\n",
+				 resource.id);
+}
+
+static void
+_cairo_pdf_surface_object_end (cairo_pdf_surface_t *surface)
+{
+    if (surface->object_stream.active) {
+	_cairo_output_stream_printf (surface->output, "\n");
+	surface->output = surface->object_stream.old_output;
+	surface->object_stream.old_output = NULL;
+	surface->object_stream.active = FALSE;
+    } else {
+	_cairo_output_stream_printf (surface->output, "endobj\n");
+    }
+}
+
+/* Writes out the objects collected since the last call as an /ObjStm */
+static cairo_int_status_t
+_cairo_pdf_surface_write_object_stream (cairo_pdf_surface_t *surface)
+{
+    cairo_pdf_packed_object_t *packed;
+    cairo_pdf_object_t *object;
+    cairo_pdf_resource_t self;
+    cairo_output_stream_t *header, *data, *output;
+    cairo_int_status_t status, status2;
+    int num_objects, first, i;
+
+    assert (! surface->object_stream.active);
+
+    num_objects = _cairo_array_num_elements (&surface->object_stream.objects);
+    if (num_objects == 0)
+	return CAIRO_INT_STATUS_SUCCESS;
+
+    self = _cairo_pdf_surface_new_object (surface);
+    if (self.id == 0)
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    header = _cairo_memory_stream_create ();
+    for (i = 0; i < num_objects; i++) {
+	packed = _cairo_array_index (&surface->object_stream.objects, i);
+	_cairo_output_stream_printf (header, "%d %ld\n",
+				     packed->resource.id, packed->offset);
+    }
+    first = _cairo_memory_stream_length (header);
+
+    /* The length of an object stream cannot itself be packed, so
+     * compress it up front and give its length directly. */
+    data = _cairo_memory_stream_create ();
+    if (surface->compress_content)
+	output = _cairo_deflate_stream_create_with_options (data,
+							    surface->compression_level,
+							    surface->num_threads);
+    else
+	output = data;
+    _cairo_memory_stream_copy (header, output);
+    _cairo_memory_stream_copy (surface->object_stream.stream, output);
+    status = _cairo_output_stream_get_status (output);
+    if (output != data) {
+	status2 = _cairo_output_stream_destroy (output);
+	if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	    status = status2;
+    }
+    status2 = _cairo_output_stream_destroy (header);
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	status = status2;
+    if (unlikely (status)) {
+	status2 = _cairo_output_stream_destroy (data);
+	return status;
+    }
+
+    _cairo_pdf_surface_update_object (surface, self);
+    _cairo_output_stream_printf (surface->output,
+				 "%d 0 obj\n"
+				 "<< /Type /ObjStm\n"
+				 "   /N %d\n"
+				 "   /First %d\n"
+				 "   /Length %d\n",
+				 self.id,
+				 num_objects,
+				 first,
+				 _cairo_memory_stream_length (data));
+    if (surface->compress_content) {
+	_cairo_output_stream_printf (surface->output,
+				     "   /Filter /FlateDecode\n");
+    }
+    _cairo_output_stream_printf (surface->output,
+				 ">>\n"
+				 "stream\n");
+    _cairo_memory_stream_copy (data, surface->output);
+    _cairo_output_stream_printf (surface->output,
+				 "\n"
+				 "endstream\n"
+				 "endobj\n");
+    status = _cairo_output_stream_destroy (data);
+
+    for (i = 0; i < num_objects; i++) {
+	packed = _cairo_array_index (&surface->object_stream.objects, i);
+	object = _cairo_array_index (&surface->objects,
+				     packed->resource.id - 1);
+	object->object_stream = self.id;
+	object->offset = i;
+    }
+    _cairo_array_truncate (&surface->object_stream.objects, 0);
+
+    status2 = _cairo_output_stream_destroy (surface->object_stream.stream);
+    surface->object_stream.stream = NULL;
+    surface->object_stream.written = TRUE;
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	status = status2;
+
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	status = _cairo_output_stream_get_status (surface->output);
+
+    return status;
 }
 
 static void
@@ -410,6 +584,16 @@ _cairo_pdf_surface_create_for_stream_internal (cairo_output_stream_t	*output,
 
     surface->pdf_version = CAIRO_PDF_VERSION_1_5;
     surface->compress_content = TRUE;
+    surface->compression_level = -1;
+    surface->num_threads = 1;
+    surface->use_object_streams = FALSE;
+    surface->deduplicate_content = FALSE;
+    surface->object_stream.active = FALSE;
+    surface->object_stream.written = FALSE;
+    surface->object_stream.stream = NULL;
+    surface->object_stream.old_output = NULL;
+    _cairo_array_init (&surface->object_stream.objects,
+		       sizeof (cairo_pdf_packed_object_t));
     surface->pdf_stream.active = FALSE;
     surface->pdf_stream.old_output = NULL;
     surface->group_stream.active = FALSE;
@@ -704,6 +888,128 @@ cairo_pdf_surface_set_size (cairo_surface_t	*surface,
 	status = _cairo_surface_set_error (surface, status);
 }
 
+/**
+ * cairo_pdf_surface_set_compression_level:
+ * @surface: a PDF #cairo_surface_t
+ * @level: the zlib compression level, from 0 (no compression) to 9
+ * (best compression), or -1 for the default level
+ *
+ * Sets the level of compression applied to the streams, such as
+ * page content, images and fonts, subsequently written to the PDF
+ * file. Lower levels trade larger files for faster output. Values out
+ * of range are clamped.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_pdf_surface_set_compression_level (cairo_surface_t	*abstract_surface,
+					 int			 level)
+{
+    cairo_pdf_surface_t *surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (abstract_surface, &surface))
+	return;
+
+    if (level < -1)
+	level = -1;
+    if (level > 9)
+	level = 9;
+
+    surface->compression_level = level;
+}
+
+/**
+ * cairo_pdf_surface_set_threads:
+ * @surface: a PDF #cairo_surface_t
+ * @num_threads: the maximum number of threads to use, or 0 for one per
+ * available processor
+ *
+ * Sets the maximum number of threads used to compress the streams, such
+ * as images and fonts, subsequently written to the PDF file. With more
+ * than one thread, large streams are split into blocks of fixed size
+ * which are compressed concurrently; the file is then slightly larger,
+ * but identical whatever the number of processors available.
+ *
+ * The default value of 1 compresses every stream on the calling thread,
+ * as a single block.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_pdf_surface_set_threads (cairo_surface_t	*abstract_surface,
+			       int		 num_threads)
+{
+    cairo_pdf_surface_t *surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (abstract_surface, &surface))
+	return;
+
+    if (num_threads < 0)
+	num_threads = 0;
+
+    surface->num_threads = num_threads;
+}
+
+/**
+ * cairo_pdf_surface_set_object_streams:
+ * @surface: a PDF #cairo_surface_t
+ * @object_streams: %TRUE to pack objects into object streams
+ *
+ * Sets whether the objects of the PDF file that are not themselves
+ * streams, such as font descriptors, patterns and the page tree, are
+ * packed into compressed object streams, with a cross-reference
+ * stream in place of the cross-reference table. This typically makes
+ * documents with many small objects considerably smaller.
+ *
+ * Object streams require PDF 1.5 and are not used if the output has
+ * been restricted to an earlier version with
+ * cairo_pdf_surface_restrict_to_version(). This function should be
+ * called before any drawing is performed on the surface.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_pdf_surface_set_object_streams (cairo_surface_t	*abstract_surface,
+				      cairo_bool_t	 object_streams)
+{
+    cairo_pdf_surface_t *surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (abstract_surface, &surface))
+	return;
+
+    surface->use_object_streams = object_streams;
+}
+
+/**
+ * cairo_pdf_surface_set_deduplicate_content:
+ * @surface: a PDF #cairo_surface_t
+ * @deduplicate: %TRUE to share sources of identical content
+ *
+ * Sets whether image and recording surfaces used as sources are
+ * recognised by their content, rather than only by their identity or
+ * %CAIRO_MIME_TYPE_UNIQUE_ID. When enabled, a source whose pixels, or
+ * recorded drawing, are identical to one already written refers to
+ * that same XObject instead of being embedded again. This helps
+ * applications that, for instance, decode the same logo afresh for
+ * every page.
+ *
+ * Computing the content hash costs a pass over every new source, so
+ * this is disabled by default.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_pdf_surface_set_deduplicate_content (cairo_surface_t	*abstract_surface,
+					   cairo_bool_t		 deduplicate)
+{
+    cairo_pdf_surface_t *surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (abstract_surface, &surface))
+	return;
+
+    surface->deduplicate_content = deduplicate;
+}
+
 static void
 _cairo_pdf_surface_clear (cairo_pdf_surface_t *surface)
 {
@@ -1117,6 +1423,11 @@ _cairo_pdf_source_surface_equal (const void *key_a, const void *key_b)
     if (a->interpolate != b->interpolate)
 	return FALSE;
 
+    if (a->has_digest || b->has_digest) {
+	return a->has_digest && b->has_digest &&
+	    memcmp (&a->digest, &b->digest, sizeof (a->digest)) == 0;
+    }
+
     if (a->unique_id && b->unique_id && a->unique_id_length == b->unique_id_length)
 	return (memcmp (a->unique_id, b->unique_id, a->unique_id_length) == 0);
 
@@ -1126,7 +1437,9 @@ _cairo_pdf_source_surface_equal (const void *key_a, const void *key_b)
 static void
 _cairo_pdf_source_surface_init_key (cairo_pdf_source_surface_entry_t *key)
 {
-    if (key->unique_id && key->unique_id_length > 0) {
+    if (key->has_digest) {
+	key->base.hash = key->digest.h[0];
+    } else if (key->unique_id && key->unique_id_length > 0) {
 	key->base.hash = _cairo_hash_bytes (_CAIRO_HASH_INIT_VALUE,
 					    key->unique_id, key->unique_id_length);
     } else {
@@ -1321,6 +1634,36 @@ _get_source_surface_size (cairo_surface_t         *source,
     return CAIRO_STATUS_SUCCESS;
 }
 
+/* Makes @entry also found by the id or content of @key. The alias
+ * only serves lookups; the source is written out through @entry. */
+static cairo_int_status_t
+_cairo_pdf_surface_add_source_alias (cairo_pdf_surface_t		    *surface,
+				     const cairo_pdf_source_surface_entry_t *entry,
+				     const cairo_pdf_source_surface_entry_t *key)
+{
+    cairo_pdf_source_surface_entry_t *alias;
+    cairo_int_status_t status;
+
+    alias = malloc (sizeof (cairo_pdf_source_surface_entry_t));
+    if (unlikely (alias == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    *alias = *entry;
+    alias->id = key->id;
+    alias->unique_id = NULL;
+    alias->unique_id_length = 0;
+    alias->has_digest = key->has_digest;
+    if (key->has_digest)
+	alias->digest = key->digest;
+    _cairo_pdf_source_surface_init_key (alias);
+
+    status = _cairo_hash_table_insert (surface->all_surfaces, &alias->base);
+    if (unlikely (status))
+	free (alias);
+
+    return status;
+}
+
 /**
  * _cairo_pdf_surface_add_source_surface:
  * @surface: the pdf surface
@@ -1344,7 +1687,8 @@ _get_source_surface_size (cairo_surface_t         *source,
  * a PDF resource to reference the image. A hash table of all images
  * in the PDF files (keyed by CAIRO_MIME_TYPE_UNIQUE_ID or surface
  * unique_id) to ensure surfaces with the same id are only written
- * once to the PDF file.
+ * once to the PDF file. With content deduplication enabled, surfaces
+ * of identical content are also written once, whatever their id.
  *
  * Only one of @source_pattern or @source_surface is to be
  * specified. Set the other to NULL.
@@ -1368,6 +1712,7 @@ _cairo_pdf_surface_add_source_surface (cairo_pdf_surface_t	    *surface,
 {
     cairo_pdf_source_surface_t src_surface;
     cairo_pdf_source_surface_entry_t surface_key;
+    cairo_pdf_source_surface_entry_t digest_key;
     cairo_pdf_source_surface_entry_t *surface_entry;
     cairo_int_status_t status;
     cairo_bool_t interpolate;
@@ -1408,11 +1753,43 @@ _cairo_pdf_surface_add_source_surface (cairo_pdf_surface_t	    *surface,
 
     surface_key.id  = source_surface->unique_id;
     surface_key.interpolate = interpolate;
+    surface_key.has_digest = FALSE;
     cairo_surface_get_mime_data (source_surface, CAIRO_MIME_TYPE_UNIQUE_ID,
 				 (const unsigned char **) &surface_key.unique_id,
 				 &surface_key.unique_id_length);
     _cairo_pdf_source_surface_init_key (&surface_key);
     surface_entry = _cairo_hash_table_lookup (surface->all_surfaces, &surface_key.base);
+
+    /* Failing that, look for an earlier source with the same content */
+    digest_key.has_digest = FALSE;
+    if (surface_entry == NULL &&
+	surface->deduplicate_content &&
+	surface_key.unique_id == NULL)
+    {
+	status = _cairo_surface_get_content_digest (source_surface,
+						    &digest_key.digest);
+	if (status == CAIRO_INT_STATUS_SUCCESS) {
+	    digest_key.id = 0;
+	    digest_key.unique_id = NULL;
+	    digest_key.unique_id_length = 0;
+	    digest_key.interpolate = interpolate;
+	    digest_key.has_digest = TRUE;
+	    _cairo_pdf_source_surface_init_key (&digest_key);
+	    surface_entry = _cairo_hash_table_lookup (surface->all_surfaces,
+						      &digest_key.base);
+	    if (surface_entry) {
+		/* so that the next use of this surface finds it directly */
+		status = _cairo_pdf_surface_add_source_alias (surface,
+							      surface_entry,
+							      &surface_key);
+		if (unlikely (status))
+		    goto release_source;
+	    }
+	} else if (status != CAIRO_INT_STATUS_UNSUPPORTED) {
+	    goto release_source;
+	}
+    }
+
     if (surface_entry) {
 	*surface_res = surface_entry->surface_res;
 	*width = surface_entry->width;
@@ -1462,6 +1839,7 @@ release_source:
     surface_entry->smask = smask;
     surface_entry->unique_id_length = unique_id_length;
     surface_entry->unique_id = unique_id;
+    surface_entry->has_digest = FALSE;
     surface_entry->width = *width;
     surface_entry->height = *height;
     surface_entry->extents = *source_extents;
@@ -1502,6 +1880,9 @@ release_source:
 
     *surface_res = surface_entry->surface_res;
 
+    if (digest_key.has_digest)
+	status = _cairo_pdf_surface_add_source_alias (surface, surface_entry, &digest_key);
+
     return status;
 
 fail3:
@@ -1664,7 +2045,9 @@ _cairo_pdf_surface_open_stream (cairo_pdf_surface_t	*surface,
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
     if (compressed) {
-	output = _cairo_deflate_stream_create (surface->output);
+	output = _cairo_deflate_stream_create_with_options (surface->output,
+							    surface->compression_level,
+							    surface->num_threads);
 	if (_cairo_output_stream_get_status (output))
 	    return _cairo_output_stream_destroy (output);
     }
@@ -1738,14 +2121,11 @@ _cairo_pdf_surface_close_stream (cairo_pdf_surface_t *surface)
 				 "endstream\n"
 				 "endobj\n");
 
-    _cairo_pdf_surface_update_object (surface,
-				      surface->pdf_stream.length);
+    _cairo_pdf_surface_object_begin (surface, surface->pdf_stream.length);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
-				 "   %ld\n"
-				 "endobj\n",
-				 surface->pdf_stream.length.id,
+				 "   %ld\n",
 				 length);
+    _cairo_pdf_surface_object_end (surface);
 
     surface->pdf_stream.active = FALSE;
 
@@ -1823,7 +2203,9 @@ _cairo_pdf_surface_open_group (cairo_pdf_surface_t         *surface,
 
     if (surface->compress_content) {
 	surface->group_stream.stream =
-	    _cairo_deflate_stream_create (surface->group_stream.mem_stream);
+	    _cairo_deflate_stream_create_with_options (surface->group_stream.mem_stream,
+						       surface->compression_level,
+						       surface->num_threads);
     } else {
 	surface->group_stream.stream = surface->group_stream.mem_stream;
     }
@@ -1992,13 +2374,9 @@ _cairo_pdf_surface_close_content_stream (cairo_pdf_surface_t *surface)
     if (unlikely (status))
 	return status;
 
-    _cairo_pdf_surface_update_object (surface, surface->content_resources);
-    _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n",
-				 surface->content_resources.id);
+    _cairo_pdf_surface_object_begin (surface, surface->content_resources);
     _cairo_pdf_surface_emit_group_resources (surface, &surface->resources);
-    _cairo_output_stream_printf (surface->output,
-				 "endobj\n");
+    _cairo_pdf_surface_object_end (surface);
 
     return _cairo_output_stream_get_status (surface->output);
 }
@@ -2029,6 +2407,10 @@ _cairo_pdf_surface_finish (void *abstract_surface)
     if (status == CAIRO_STATUS_SUCCESS)
 	status = _cairo_pdf_surface_emit_font_subsets (surface);
 
+    /* an error may have left a font object unterminated */
+    if (surface->object_stream.active)
+	_cairo_pdf_surface_object_end (surface);
+
     _cairo_pdf_surface_write_pages (surface);
 
     info = _cairo_pdf_surface_write_info (surface);
@@ -2039,17 +2421,34 @@ _cairo_pdf_surface_finish (void *abstract_surface)
     if (catalog.id == 0 && status == CAIRO_STATUS_SUCCESS)
 	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
-    offset = _cairo_pdf_surface_write_xref (surface);
+    status2 = _cairo_pdf_surface_write_object_stream (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = status2;
 
-    _cairo_output_stream_printf (surface->output,
-				 "trailer\n"
-				 "<< /Size %d\n"
-				 "   /Root %d 0 R\n"
-				 "   /Info %d 0 R\n"
-				 ">>\n",
-				 surface->next_available_resource.id,
-				 catalog.id,
-				 info.id);
+    if (surface->object_stream.written ||
+	_cairo_pdf_surface_use_object_streams (surface))
+    {
+	offset = _cairo_pdf_surface_write_xref_stream (surface, catalog, info);
+	if (offset < 0) {
+	    if (status == CAIRO_STATUS_SUCCESS)
+		status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	    offset = 0;
+	}
+    }
+    else
+    {
+	offset = _cairo_pdf_surface_write_xref (surface);
+
+	_cairo_output_stream_printf (surface->output,
+				     "trailer\n"
+				     "<< /Size %d\n"
+				     "   /Root %d 0 R\n"
+				     "   /Info %d 0 R\n"
+				     ">>\n",
+				     surface->next_available_resource.id,
+				     catalog.id,
+				     info.id);
+    }
 
     _cairo_output_stream_printf (surface->output,
 				 "startxref\n"
@@ -2079,6 +2478,11 @@ _cairo_pdf_surface_finish (void *abstract_surface)
 	if (status == CAIRO_STATUS_SUCCESS)
 	    status = status2;
     }
+    if (surface->object_stream.stream != NULL) {
+	status2 = _cairo_output_stream_destroy (surface->object_stream.stream);
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = status2;
+    }
     if (surface->pdf_stream.active)
 	surface->output = surface->pdf_stream.old_output;
     if (surface->group_stream.active)
@@ -2093,6 +2497,7 @@ _cairo_pdf_surface_finish (void *abstract_surface)
     _cairo_pdf_group_resources_fini (&surface->resources);
 
     _cairo_array_fini (&surface->objects);
+    _cairo_array_fini (&surface->object_stream.objects);
     _cairo_array_fini (&surface->pages);
     _cairo_array_fini (&surface->rgb_linear_functions);
     _cairo_array_fini (&surface->alpha_linear_functions);
@@ -3327,22 +3732,21 @@ cairo_pdf_surface_emit_rgb_linear_function (cairo_pdf_surface_t    *surface,
     if (res.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /FunctionType 2\n"
 				 "   /Domain [ 0 1 ]\n"
 				 "   /C0 [ %f %f %f ]\n"
 				 "   /C1 [ %f %f %f ]\n"
 				 "   /N 1\n"
-				 ">>\n"
-				 "endobj\n",
-				 res.id,
+				 ">>\n",
                                  stop1->color[0],
                                  stop1->color[1],
                                  stop1->color[2],
                                  stop2->color[0],
                                  stop2->color[1],
                                  stop2->color[2]);
+    _cairo_pdf_surface_object_end (surface);
 
     elem.resource = res;
     memcpy (&elem.color1[0], &stop1->color[0], sizeof (double)*3);
@@ -3380,18 +3784,17 @@ cairo_pdf_surface_emit_alpha_linear_function (cairo_pdf_surface_t    *surface,
     if (res.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /FunctionType 2\n"
 				 "   /Domain [ 0 1 ]\n"
 				 "   /C0 [ %f ]\n"
 				 "   /C1 [ %f ]\n"
 				 "   /N 1\n"
-				 ">>\n"
-				 "endobj\n",
-				 res.id,
+				 ">>\n",
                                  stop1->color[3],
                                  stop2->color[3]);
+    _cairo_pdf_surface_object_end (surface);
 
     elem.resource = res;
     elem.alpha1 = stop1->color[3];
@@ -3438,11 +3841,10 @@ _cairo_pdf_surface_emit_stitched_colorgradient (cairo_pdf_surface_t    *surface,
     if (res.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /FunctionType 3\n"
 				 "   /Domain [ %f %f ]\n",
-				 res.id,
                                  stops[0].offset,
                                  stops[n_stops - 1].offset);
 
@@ -3471,8 +3873,8 @@ _cairo_pdf_surface_emit_stitched_colorgradient (cairo_pdf_surface_t    *surface,
 				 "]\n");
 
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     *function = res;
 
@@ -3652,11 +4054,10 @@ _cairo_pdf_surface_emit_repeating_function (cairo_pdf_surface_t      *surface,
     if (res.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /FunctionType 3\n"
 				 "   /Domain [ %d %d ]\n",
-				 res.id,
                                  begin,
                                  end);
 
@@ -3691,8 +4092,8 @@ _cairo_pdf_surface_emit_repeating_function (cairo_pdf_surface_t      *surface,
 				 "]\n");
 
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     *function = res;
 
@@ -3796,30 +4197,27 @@ cairo_pdf_surface_emit_transparency_group (cairo_pdf_surface_t  *surface,
     if (smask_resource.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, smask_resource);
     _cairo_output_stream_printf (surface->output,
-                                 "%d 0 obj\n"
                                  "<< /Type /Mask\n"
                                  "   /S /Luminosity\n"
                                  "   /G %d 0 R\n"
-                                 ">>\n"
-                                 "endobj\n",
-                                 smask_resource.id,
+                                 ">>\n",
                                  surface->pdf_stream.self.id);
+    _cairo_pdf_surface_object_end (surface);
 
     /* Create GState which uses the transparency group as an SMask. */
-    _cairo_pdf_surface_update_object (surface, gstate_resource);
 
+    _cairo_pdf_surface_object_begin (surface, gstate_resource);
     _cairo_output_stream_printf (surface->output,
-                                 "%d 0 obj\n"
                                  "<< /Type /ExtGState\n"
                                  "   /SMask %d 0 R\n"
                                  "   /ca 1\n"
                                  "   /CA 1\n"
                                  "   /AIS false\n"
-                                 ">>\n"
-                                 "endobj\n",
-                                 gstate_resource.id,
+                                 ">>\n",
                                  smask_resource.id);
+    _cairo_pdf_surface_object_end (surface);
 
     return _cairo_output_stream_get_status (surface->output);
 }
@@ -3835,9 +4233,7 @@ _cairo_pdf_surface_output_gradient (cairo_pdf_surface_t        *surface,
 				    const char                 *colorspace,
 				    cairo_pdf_resource_t        color_function)
 {
-    _cairo_output_stream_printf (surface->output,
-                                 "%d 0 obj\n",
-				 pattern_resource.id);
+    _cairo_pdf_surface_object_begin (surface, pattern_resource);
 
     if (!pdf_pattern->is_shading) {
 	_cairo_output_stream_printf (surface->output,
@@ -3892,8 +4288,7 @@ _cairo_pdf_surface_output_gradient (cairo_pdf_surface_t        *surface,
 				     ">>\n");
     }
 
-    _cairo_output_stream_printf (surface->output,
-				     "endobj\n");
+    _cairo_pdf_surface_object_end (surface);
 }
 
 static cairo_int_status_t
@@ -4010,7 +4405,6 @@ _cairo_pdf_surface_emit_gradient (cairo_pdf_surface_t    *surface,
 	domain[1] = 1.0;
     }
 
-    _cairo_pdf_surface_update_object (surface, pdf_pattern->pattern_res);
     _cairo_pdf_surface_output_gradient (surface, pdf_pattern,
 					pdf_pattern->pattern_res,
 					&pat_to_pdf, &start, &end, domain,
@@ -4100,20 +4494,18 @@ _cairo_pdf_surface_emit_mesh_pattern (cairo_pdf_surface_t    *surface,
 
     _cairo_pdf_shading_fini (&shading);
 
-    _cairo_pdf_surface_update_object (surface, pdf_pattern->pattern_res);
+    _cairo_pdf_surface_object_begin (surface, pdf_pattern->pattern_res);
     _cairo_output_stream_printf (surface->output,
-                                 "%d 0 obj\n"
                                  "<< /Type /Pattern\n"
                                  "   /PatternType 2\n"
-                                 "   /Matrix [ ",
-				 pdf_pattern->pattern_res.id);
+                                 "   /Matrix [ ");
     _cairo_output_stream_print_matrix (surface->output, &pat_to_pdf);
     _cairo_output_stream_printf (surface->output,
                                  " ]\n"
                                  "   /Shading %d 0 R\n"
-				 ">>\n"
-				 "endobj\n",
+				 ">>\n",
 				 res.id);
+    _cairo_pdf_surface_object_end (surface);
 
     if (pdf_pattern->gstate_res.id != 0) {
 	cairo_pdf_resource_t mask_resource;
@@ -4162,19 +4554,18 @@ _cairo_pdf_surface_emit_mesh_pattern (cairo_pdf_surface_t    *surface,
 	if (unlikely (mask_resource.id == 0))
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+	_cairo_pdf_surface_object_begin (surface, mask_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Pattern\n"
 				     "   /PatternType 2\n"
-				     "   /Matrix [ ",
-				     mask_resource.id);
+				     "   /Matrix [ ");
 	_cairo_output_stream_print_matrix (surface->output, &pat_to_pdf);
 	_cairo_output_stream_printf (surface->output,
 				     " ]\n"
 				     "   /Shading %d 0 R\n"
-				     ">>\n"
-				     "endobj\n",
+				     ">>\n",
 				     res.id);
+	_cairo_pdf_surface_object_end (surface);
 
 	status = cairo_pdf_surface_emit_transparency_group (surface,
 							    pdf_pattern,
@@ -4596,6 +4987,10 @@ _cairo_pdf_surface_show_page (void *abstract_surface)
     if (unlikely (status))
 	return status;
 
+    status = _cairo_pdf_surface_write_object_stream (surface);
+    if (unlikely (status))
+	return status;
+
     _cairo_pdf_surface_clear (surface);
 
     return CAIRO_STATUS_SUCCESS;
@@ -4641,15 +5036,14 @@ _cairo_pdf_surface_write_info (cairo_pdf_surface_t *surface)
     if (info.id == 0)
 	return info;
 
+    _cairo_pdf_surface_object_begin (surface, info);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Creator (cairo %s (http://cairographics.org))\n"
 				 "   /Producer (cairo %s (http://cairographics.org))\n"
-				 ">>\n"
-				 "endobj\n",
-				 info.id,
+				 ">>\n",
                                  cairo_version_string (),
                                  cairo_version_string ());
+    _cairo_pdf_surface_object_end (surface);
 
     return info;
 }
@@ -4660,12 +5054,10 @@ _cairo_pdf_surface_write_pages (cairo_pdf_surface_t *surface)
     cairo_pdf_resource_t page;
     int num_pages, i;
 
-    _cairo_pdf_surface_update_object (surface, surface->pages_resource);
+    _cairo_pdf_surface_object_begin (surface, surface->pages_resource);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Pages\n"
-				 "   /Kids [ ",
-				 surface->pages_resource.id);
+				 "   /Kids [ ");
 
     num_pages = _cairo_array_num_elements (&surface->pages);
     for (i = 0; i < num_pages; i++) {
@@ -4680,8 +5072,8 @@ _cairo_pdf_surface_write_pages (cairo_pdf_surface_t *surface)
     /* TODO: Figure out which other defaults to be inherited by /Page
      * objects. */
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 }
 
 static cairo_int_status_t
@@ -5015,11 +5407,10 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
     if (descriptor.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, descriptor);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /FontDescriptor\n"
 				 "   /FontName /%s+%s\n",
-				 descriptor.id,
 				 tag,
 				 subset->ps_name);
 
@@ -5046,8 +5437,7 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 				 "   /StemV 80\n"
 				 "   /StemH 80\n"
 				 "   /FontFile3 %u 0 R\n"
-				 ">>\n"
-				 "endobj\n",
+				 ">>\n",
 				 (long)(subset->x_min*PDF_UNITS_PER_EM),
 				 (long)(subset->y_min*PDF_UNITS_PER_EM),
 				 (long)(subset->x_max*PDF_UNITS_PER_EM),
@@ -5056,6 +5446,7 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 				 (long)(subset->descent*PDF_UNITS_PER_EM),
 				 (long)(subset->y_max*PDF_UNITS_PER_EM),
 				 stream.id);
+    _cairo_pdf_surface_object_end (surface);
 
     if (font_subset->is_latin) {
 	/* find last glyph used */
@@ -5064,9 +5455,8 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 		break;
 
 	last_glyph = i;
-	_cairo_pdf_surface_update_object (surface, subset_resource);
+	_cairo_pdf_surface_object_begin (surface, subset_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /Type1\n"
 				     "   /BaseFont /%s+%s\n"
@@ -5075,7 +5465,6 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 				     "   /FontDescriptor %d 0 R\n"
 				     "   /Encoding /WinAnsiEncoding\n"
 				     "   /Widths [",
-				     subset_resource.id,
 				     tag,
 				     subset->ps_name,
 				     last_glyph,
@@ -5101,15 +5490,15 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 					 to_unicode_stream.id);
 
 	_cairo_output_stream_printf (surface->output,
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
     } else {
 	cidfont_dict = _cairo_pdf_surface_new_object (surface);
 	if (cidfont_dict.id == 0)
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+	_cairo_pdf_surface_object_begin (surface, cidfont_dict);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /CIDFontType0\n"
 				     "   /BaseFont /%s+%s\n"
@@ -5120,7 +5509,6 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 				     "   >>\n"
 				     "   /FontDescriptor %d 0 R\n"
 				     "   /W [0 [",
-				     cidfont_dict.id,
 				     tag,
 				     subset->ps_name,
 				     descriptor.id);
@@ -5132,18 +5520,16 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 
 	_cairo_output_stream_printf (surface->output,
 				     " ]]\n"
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
 
-	_cairo_pdf_surface_update_object (surface, subset_resource);
+	_cairo_pdf_surface_object_begin (surface, subset_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /Type0\n"
 				     "   /BaseFont /%s+%s\n"
 				     "   /Encoding /Identity-H\n"
 				     "   /DescendantFonts [ %d 0 R]\n",
-				     subset_resource.id,
 				     tag,
 				     subset->ps_name,
 				     cidfont_dict.id);
@@ -5154,8 +5540,8 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 					 to_unicode_stream.id);
 
 	_cairo_output_stream_printf (surface->output,
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
     }
 
     font.font_id = font_subset->font_id;
@@ -5272,8 +5658,8 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
     if (descriptor.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, descriptor);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /FontDescriptor\n"
 				 "   /FontName /%s+%s\n"
 				 "   /Flags 4\n"
@@ -5285,9 +5671,7 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
 				 "   /StemV 80\n"
 				 "   /StemH 80\n"
 				 "   /FontFile %u 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 descriptor.id,
+				 ">>\n",
 				 tag,
 				 subset->base_font,
 				 (long)(subset->x_min*PDF_UNITS_PER_EM),
@@ -5298,17 +5682,16 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
 				 (long)(subset->descent*PDF_UNITS_PER_EM),
 				 (long)(subset->y_max*PDF_UNITS_PER_EM),
 				 stream.id);
+    _cairo_pdf_surface_object_end (surface);
 
-    _cairo_pdf_surface_update_object (surface, subset_resource);
+    _cairo_pdf_surface_object_begin (surface, subset_resource);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Font\n"
 				 "   /Subtype /Type1\n"
 				 "   /BaseFont /%s+%s\n"
 				 "   /FirstChar %d\n"
 				 "   /LastChar %d\n"
 				 "   /FontDescriptor %d 0 R\n",
-				 subset_resource.id,
 				 tag,
 				 subset->base_font,
 				 font_subset->is_latin ? 32 : 0,
@@ -5346,8 +5729,8 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
                                      to_unicode_stream.id);
 
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     font.font_id = font_subset->font_id;
     font.subset_id = font_subset->subset_id;
@@ -5460,11 +5843,10 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
     }
 
+    _cairo_pdf_surface_object_begin (surface, descriptor);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /FontDescriptor\n"
 				 "   /FontName /%s+%s\n",
-				 descriptor.id,
 				 tag,
 				 subset.ps_name);
 
@@ -5491,8 +5873,7 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				 "   /StemV 80\n"
 				 "   /StemH 80\n"
 				 "   /FontFile2 %u 0 R\n"
-				 ">>\n"
-				 "endobj\n",
+				 ">>\n",
 				 font_subset->is_latin ? 32 : 4,
 				 (long)(subset.x_min*PDF_UNITS_PER_EM),
 				 (long)(subset.y_min*PDF_UNITS_PER_EM),
@@ -5502,6 +5883,7 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				 (long)(subset.descent*PDF_UNITS_PER_EM),
 				 (long)(subset.y_max*PDF_UNITS_PER_EM),
 				 stream.id);
+    _cairo_pdf_surface_object_end (surface);
 
     if (font_subset->is_latin) {
 	/* find last glyph used */
@@ -5510,9 +5892,8 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 		break;
 
 	last_glyph = i;
-	_cairo_pdf_surface_update_object (surface, subset_resource);
+	_cairo_pdf_surface_object_begin (surface, subset_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /TrueType\n"
 				     "   /BaseFont /%s+%s\n"
@@ -5521,7 +5902,6 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				     "   /FontDescriptor %d 0 R\n"
 				     "   /Encoding /WinAnsiEncoding\n"
 				     "   /Widths [",
-				     subset_resource.id,
 				     tag,
 				     subset.ps_name,
 				     last_glyph,
@@ -5547,8 +5927,8 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 					 to_unicode_stream.id);
 
 	_cairo_output_stream_printf (surface->output,
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
     } else {
 	cidfont_dict = _cairo_pdf_surface_new_object (surface);
 	if (cidfont_dict.id == 0) {
@@ -5556,8 +5936,8 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 	}
 
+	_cairo_pdf_surface_object_begin (surface, cidfont_dict);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /CIDFontType2\n"
 				     "   /BaseFont /%s+%s\n"
@@ -5568,7 +5948,6 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				     "   >>\n"
 				     "   /FontDescriptor %d 0 R\n"
 				     "   /W [0 [",
-				     cidfont_dict.id,
 				     tag,
 				     subset.ps_name,
 				     descriptor.id);
@@ -5580,18 +5959,16 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 
 	_cairo_output_stream_printf (surface->output,
 				     " ]]\n"
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
 
-	_cairo_pdf_surface_update_object (surface, subset_resource);
+	_cairo_pdf_surface_object_begin (surface, subset_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /Type0\n"
 				     "   /BaseFont /%s+%s\n"
 				     "   /Encoding /Identity-H\n"
 				     "   /DescendantFonts [ %d 0 R]\n",
-				     subset_resource.id,
 				     tag,
 				     subset.ps_name,
 				     cidfont_dict.id);
@@ -5602,8 +5979,8 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 					 to_unicode_stream.id);
 
 	_cairo_output_stream_printf (surface->output,
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
     }
 
     font.font_id = font_subset->font_id;
@@ -5794,17 +6171,17 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
     }
 
+    _cairo_pdf_surface_object_begin (surface, encoding);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Encoding\n"
-				 "   /Differences [0", encoding.id);
+				 "   /Differences [0");
     for (i = 0; i < font_subset->num_glyphs; i++)
 	_cairo_output_stream_printf (surface->output,
 				     " /%d", i);
     _cairo_output_stream_printf (surface->output,
 				 "]\n"
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     char_procs = _cairo_pdf_surface_new_object (surface);
     if (char_procs.id == 0) {
@@ -5813,16 +6190,16 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
     }
 
+    _cairo_pdf_surface_object_begin (surface, char_procs);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
-				 "<<\n", char_procs.id);
+				 "<<\n");
     for (i = 0; i < font_subset->num_glyphs; i++)
 	_cairo_output_stream_printf (surface->output,
 				     " /%d %d 0 R\n",
 				     i, glyphs[i].id);
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     free (glyphs);
 
@@ -5834,9 +6211,8 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
 	return status;
     }
 
-    _cairo_pdf_surface_update_object (surface, subset_resource);
+    _cairo_pdf_surface_object_begin (surface, subset_resource);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Font\n"
 				 "   /Subtype /Type3\n"
 				 "   /FontBBox [%f %f %f %f]\n"
@@ -5845,7 +6221,6 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
 				 "   /CharProcs %d 0 R\n"
 				 "   /FirstChar 0\n"
 				 "   /LastChar %d\n",
-				 subset_resource.id,
 				 _cairo_fixed_to_double (font_bbox.p1.x),
 				 - _cairo_fixed_to_double (font_bbox.p2.y),
 				 _cairo_fixed_to_double (font_bbox.p2.x),
@@ -5872,8 +6247,8 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
                                      to_unicode_stream.id);
 
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     font.font_id = font_subset->font_id;
     font.subset_id = font_subset->subset_id;
@@ -5970,14 +6345,13 @@ _cairo_pdf_surface_write_catalog (cairo_pdf_surface_t *surface)
     if (catalog.id == 0)
 	return catalog;
 
+    _cairo_pdf_surface_object_begin (surface, catalog);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Catalog\n"
 				 "   /Pages %d 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 catalog.id,
+				 ">>\n",
 				 surface->pages_resource.id);
+    _cairo_pdf_surface_object_end (surface);
 
     return catalog;
 }
@@ -6010,6 +6384,141 @@ _cairo_pdf_surface_write_xref (cairo_pdf_surface_t *surface)
     return offset;
 }
 
+/* Returns the number of bytes needed to store @value */
+static int
+_cairo_pdf_xref_field_width (unsigned long value)
+{
+    int width = 1;
+
+    while (width < (int) sizeof (value) && value >> (8 * width))
+	width++;
+
+    return width;
+}
+
+static void
+_cairo_pdf_xref_write_entry (cairo_output_stream_t	*output,
+			     int			 type,
+			     unsigned long		 field2,
+			     int			 width2,
+			     unsigned long		 field3,
+			     int			 width3)
+{
+    unsigned char entry[1 + 2 * sizeof (unsigned long)];
+    int i, n = 0;
+
+    entry[n++] = type;
+    for (i = width2 - 1; i >= 0; i--)
+	entry[n++] = field2 >> (8 * i);
+    for (i = width3 - 1; i >= 0; i--)
+	entry[n++] = field3 >> (8 * i);
+
+    _cairo_output_stream_write (output, entry, n);
+}
+
+/* Writes a PDF 1.5 cross-reference stream, which also takes the place
+ * of the trailer, and returns its offset or -1 upon failure. It is
+ * needed to locate the objects packed into object streams. */
+static long
+_cairo_pdf_surface_write_xref_stream (cairo_pdf_surface_t	*surface,
+				      cairo_pdf_resource_t	 catalog,
+				      cairo_pdf_resource_t	 info)
+{
+    cairo_pdf_object_t *object;
+    cairo_pdf_resource_t self;
+    cairo_output_stream_t *data, *output;
+    cairo_int_status_t status, status2;
+    unsigned long max2 = 0, max3 = 0xffff;
+    int num_objects, width2, width3, i;
+    long offset;
+
+    offset = _cairo_output_stream_get_position (surface->output);
+    self = _cairo_pdf_surface_new_object (surface);
+    if (self.id == 0)
+	return -1;
+
+    num_objects = _cairo_array_num_elements (&surface->objects);
+    for (i = 0; i < num_objects; i++) {
+	object = _cairo_array_index (&surface->objects, i);
+	if (object->object_stream) {
+	    max2 = MAX (max2, (unsigned long) object->object_stream);
+	    max3 = MAX (max3, (unsigned long) object->offset);
+	} else {
+	    max2 = MAX (max2, (unsigned long) object->offset);
+	}
+    }
+    width2 = _cairo_pdf_xref_field_width (max2);
+    width3 = _cairo_pdf_xref_field_width (max3);
+
+    data = _cairo_memory_stream_create ();
+    if (surface->compress_content)
+	output = _cairo_deflate_stream_create_with_options (data,
+							    surface->compression_level,
+							    surface->num_threads);
+    else
+	output = data;
+
+    /* object 0 heads the (empty) list of free objects */
+    _cairo_pdf_xref_write_entry (output, 0, 0, width2, 0xffff, width3);
+    for (i = 0; i < num_objects; i++) {
+	object = _cairo_array_index (&surface->objects, i);
+	if (object->object_stream) {
+	    _cairo_pdf_xref_write_entry (output,
+					 2, object->object_stream, width2,
+					 object->offset, width3);
+	} else {
+	    _cairo_pdf_xref_write_entry (output,
+					 1, object->offset, width2,
+					 0, width3);
+	}
+    }
+
+    status = _cairo_output_stream_get_status (output);
+    if (output != data) {
+	status2 = _cairo_output_stream_destroy (output);
+	if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	    status = status2;
+    }
+    if (unlikely (status)) {
+	status2 = _cairo_output_stream_destroy (data);
+	return -1;
+    }
+
+    _cairo_output_stream_printf (surface->output,
+				 "%d 0 obj\n"
+				 "<< /Type /XRef\n"
+				 "   /Size %d\n"
+				 "   /W [ 1 %d %d ]\n"
+				 "   /Root %d 0 R\n"
+				 "   /Info %d 0 R\n"
+				 "   /Length %d\n",
+				 self.id,
+				 surface->next_available_resource.id,
+				 width2,
+				 width3,
+				 catalog.id,
+				 info.id,
+				 _cairo_memory_stream_length (data));
+    if (surface->compress_content) {
+	_cairo_output_stream_printf (surface->output,
+				     "   /Filter /FlateDecode\n");
+    }
+    _cairo_output_stream_printf (surface->output,
+				 ">>\n"
+				 "stream\n");
+    _cairo_memory_stream_copy (data, surface->output);
+    _cairo_output_stream_printf (surface->output,
+				 "\n"
+				 "endstream\n"
+				 "endobj\n");
+
+    status = _cairo_output_stream_destroy (data);
+    if (unlikely (status))
+	return -1;
+
+    return offset;
+}
+
 static cairo_int_status_t
 _cairo_pdf_surface_write_mask_group (cairo_pdf_surface_t	*surface,
 				     cairo_pdf_smask_group_t	*group)
@@ -6177,29 +6686,26 @@ _cairo_pdf_surface_write_mask_group (cairo_pdf_surface_t	*surface,
     if (smask.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, smask);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Mask\n"
 				 "   /S /Alpha\n"
 				 "   /G %d 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 smask.id,
+				 ">>\n",
 				 mask_group.id);
+    _cairo_pdf_surface_object_end (surface);
 
     /* Create a GState that uses the smask */
-    _cairo_pdf_surface_update_object (surface, group->group_res);
+    _cairo_pdf_surface_object_begin (surface, group->group_res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /ExtGState\n"
 				 "   /SMask %d 0 R\n"
 				 "   /ca 1\n"
 				 "   /CA 1\n"
 				 "   /AIS false\n"
-				 ">>\n"
-				 "endobj\n",
-				 group->group_res.id,
+				 ">>\n",
 				 smask.id);
+    _cairo_pdf_surface_object_end (surface);
 
     return _cairo_output_stream_get_status (surface->output);
 }
@@ -6394,8 +6900,8 @@ _cairo_pdf_surface_write_page (cairo_pdf_surface_t *surface)
     if (page.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, page);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Page\n"
 				 "   /Parent %d 0 R\n"
 				 "   /MediaBox [ 0 0 %f %f ]\n"
@@ -6407,14 +6913,13 @@ _cairo_pdf_surface_write_page (cairo_pdf_surface_t *surface)
 				 "      /CS /DeviceRGB\n"
 				 "   >>\n"
 				 "   /Resources %d 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 page.id,
+				 ">>\n",
 				 surface->pages_resource.id,
 				 surface->width,
 				 surface->height,
 				 surface->content.id,
 				 surface->content_resources.id);
+    _cairo_pdf_surface_object_end (surface);
 
     status = _cairo_array_append (&surface->pages, &page);
     if (unlikely (status))
@@ -85,6 +85,22 @@ cairo_pdf_surface_set_size (cairo_surface_t	*surface,
 			    double		 width_in_points,
 			    double		 height_in_points);
 
+cairo_public void
+cairo_pdf_surface_set_compression_level (cairo_surface_t	*surface,
+					 int			 level);
+
+cairo_public void
+cairo_pdf_surface_set_threads (cairo_surface_t	*surface,
+			       int		 num_threads);
+
+cairo_public void
+cairo_pdf_surface_set_object_streams (cairo_surface_t	*surface,
+				      cairo_bool_t	 object_streams);
+
+cairo_public void
+cairo_pdf_surface_set_deduplicate_content (cairo_surface_t	*surface,
+					   cairo_bool_t		 deduplicate);
+
 CAIRO_END_DECLS
 
 #else  /* CAIRO_HAS_PDF_SURFACE */
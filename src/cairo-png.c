@@ -39,13 +39,24 @@
 #include "cairoint.h"
 
 #include "cairo-error-private.h"
-#include "cairo-image-surface-private.h"
+#include "cairo-freed-pool-private.h"
+#include "cairo-image-surface-inline.h"
 #include "cairo-output-stream-private.h"
 
+#include "cairo-thread-pool-private.h"
+
 #include <stdio.h>
 #include <errno.h>
 #include <png.h>
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /**
  * SECTION:cairo-png
  * @Title: PNG Support
@@ -78,21 +89,64 @@ struct png_read_closure_t {
     cairo_read_func_t		 read_func;
     void			*closure;
     cairo_output_stream_t	*png_data;
+
+    /* The destination of the pixels. If data is NULL, get_data() is
+     * called to provide it once the size of the image is known,
+     * otherwise the image must fit within width x height. Afterwards
+     * these describe the decoded image. */
+    cairo_status_t		(*get_data) (struct png_read_closure_t *);
+    unsigned char		*data;
+    cairo_format_t		 format;
+    int				 width;
+    int				 height;
+    int				 stride;
 };
 
 
-/* Unpremultiplies data and converts native endian ARGB => RGBA bytes */
+/* Unpremultiplies native endian ARGB pixels into RGBA bytes. The
+ * conversion may be done in place, with @dst equal to @src. */
 static void
-unpremultiply_data (png_structp png, png_row_infop row_info, png_bytep data)
+unpremultiply_row (const uint8_t *src, uint8_t *dst, unsigned int width)
 {
-    unsigned int i;
+    unsigned int i = 0;
+
+#if defined(__SSE2__) && ! defined(WORDS_BIGENDIAN)
+    /* The quotients are at most 65152 and, unless exact, at least 1/255
+     * away from the next integer, so the error of a single precision
+     * division never changes the truncated result. */
+    const __m128i mask = _mm_set1_epi32 (0xff);
+    const __m128 c255 = _mm_set1_ps (255.f);
+
+    for (; i + 4 <= width; i += 4) {
+	__m128i p = _mm_loadu_si128 ((const __m128i *) (src + 4 * i));
+	__m128i a = _mm_srli_epi32 (p, 24);
+	__m128 fa = _mm_cvtepi32_ps (a);
+	__m128 half = _mm_cvtepi32_ps (_mm_srli_epi32 (a, 1));
+	__m128i r, g, b;
+
+#define UNPREMULTIPLY(c) \
+	_mm_and_si128 (_mm_cvttps_epi32 (_mm_div_ps (_mm_add_ps (_mm_mul_ps (_mm_cvtepi32_ps (c), c255), half), fa)), mask)
+	r = UNPREMULTIPLY (_mm_and_si128 (_mm_srli_epi32 (p, 16), mask));
+	g = UNPREMULTIPLY (_mm_and_si128 (_mm_srli_epi32 (p, 8), mask));
+	b = UNPREMULTIPLY (_mm_and_si128 (p, mask));
+#undef UNPREMULTIPLY
+
+	p = _mm_or_si128 (_mm_or_si128 (r, _mm_slli_epi32 (g, 8)),
+			  _mm_or_si128 (_mm_slli_epi32 (b, 16),
+					_mm_slli_epi32 (a, 24)));
+
+	/* Transparent pixels divided by zero */
+	p = _mm_andnot_si128 (_mm_cmpeq_epi32 (a, _mm_setzero_si128 ()), p);
+	_mm_storeu_si128 ((__m128i *) (dst + 4 * i), p);
+    }
+#endif
 
-    for (i = 0; i < row_info->rowbytes; i += 4) {
-        uint8_t *b = &data[i];
+    for (; i < width; i++) {
+        uint8_t *b = &dst[4 * i];
         uint32_t pixel;
         uint8_t  alpha;
 
-	memcpy (&pixel, b, sizeof (uint32_t));
+	memcpy (&pixel, &src[4 * i], sizeof (uint32_t));
 	alpha = (pixel & 0xff000000) >> 24;
         if (alpha == 0) {
 	    b[0] = b[1] = b[2] = b[3] = 0;
@@ -105,6 +159,13 @@ unpremultiply_data (png_structp png, png_row_infop row_info, png_bytep data)
     }
 }
 
+/* Unpremultiplies data and converts native endian ARGB => RGBA bytes */
+static void
+unpremultiply_data (png_structp png, png_row_infop row_info, png_bytep data)
+{
+    unpremultiply_row (data, data, row_info->rowbytes / 4);
+}
+
 /* Converts native endian xRGB => RGBx bytes */
 static void
 convert_data_to_bytes (png_structp png, png_row_infop row_info, png_bytep data)
@@ -166,10 +227,523 @@ png_simple_output_flush_fn (png_structp png_ptr)
 {
 }
 
+/**
+ * cairo_png_options_t:
+ *
+ * An opaque structure holding the options used when encoding a surface
+ * as a PNG image with cairo_surface_write_to_png_stream_with_options().
+ * Individual options are set with the
+ * <function>cairo_png_options_set_<emphasis>option_name</emphasis>()</function>
+ * functions, all of them start out with their default value, which
+ * reproduces the output of cairo_surface_write_to_png_stream().
+ *
+ * Since: 1.14
+ **/
+struct _cairo_png_options {
+    int compression_level;
+    cairo_png_filter_t filter;
+    int strip_height;
+};
+
+static const cairo_png_options_t _cairo_png_options_nil = {
+    -1,
+    CAIRO_PNG_FILTER_DEFAULT,
+    0
+};
+
+/**
+ * cairo_png_options_create:
+ *
+ * Allocates a new PNG options object with all options initialized
+ * to default values.
+ *
+ * Return value: a newly allocated #cairo_png_options_t. Free with
+ *   cairo_png_options_destroy(). This function always returns a
+ *   valid pointer; if memory cannot be allocated, then a special
+ *   error object is returned where all operations on the object do nothing.
+ *   You can check for this with cairo_png_options_status().
+ *
+ * Since: 1.14
+ **/
+cairo_png_options_t *
+cairo_png_options_create (void)
+{
+    cairo_png_options_t *options;
+
+    options = malloc (sizeof (cairo_png_options_t));
+    if (unlikely (options == NULL)) {
+	_cairo_error_throw (CAIRO_STATUS_NO_MEMORY);
+	return (cairo_png_options_t *) &_cairo_png_options_nil;
+    }
+
+    *options = _cairo_png_options_nil;
+
+    return options;
+}
+
+/**
+ * cairo_png_options_destroy:
+ * @options: a #cairo_png_options_t
+ *
+ * Destroys a #cairo_png_options_t object created with
+ * cairo_png_options_create().
+ *
+ * Since: 1.14
+ **/
+void
+cairo_png_options_destroy (cairo_png_options_t *options)
+{
+    if (cairo_png_options_status (options))
+	return;
+
+    free (options);
+}
+
+/**
+ * cairo_png_options_status:
+ * @options: a #cairo_png_options_t
+ *
+ * Checks whether an error has previously occurred for this
+ * PNG options object
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS or %CAIRO_STATUS_NO_MEMORY
+ *
+ * Since: 1.14
+ **/
+cairo_status_t
+cairo_png_options_status (cairo_png_options_t *options)
+{
+    if (options == NULL)
+	return CAIRO_STATUS_NULL_POINTER;
+    else if (options == (cairo_png_options_t *) &_cairo_png_options_nil)
+	return CAIRO_STATUS_NO_MEMORY;
+    else
+	return CAIRO_STATUS_SUCCESS;
+}
+slim_hidden_def (cairo_png_options_status);
+
+/**
+ * cairo_png_options_set_compression_level:
+ * @options: a #cairo_png_options_t
+ * @level: the zlib compression level, from 0 (no compression) to 9
+ * (best compression), or -1 for the default level
+ *
+ * Sets the level of compression applied to the image data. Lower
+ * levels encode faster at the expense of larger files. Values out of
+ * range are clamped.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_png_options_set_compression_level (cairo_png_options_t *options,
+					 int                  level)
+{
+    if (cairo_png_options_status (options))
+	return;
+
+    options->compression_level = MAX (-1, MIN (level, 9));
+}
+
+/**
+ * cairo_png_options_get_compression_level:
+ * @options: a #cairo_png_options_t
+ *
+ * Gets the compression level for the PNG options object.
+ * See cairo_png_options_set_compression_level().
+ *
+ * Return value: the compression level, or -1 for the default level
+ *
+ * Since: 1.14
+ **/
+int
+cairo_png_options_get_compression_level (const cairo_png_options_t *options)
+{
+    if (cairo_png_options_status ((cairo_png_options_t *) options))
+	return -1;
+
+    return options->compression_level;
+}
+
+/**
+ * cairo_png_options_set_filter:
+ * @options: a #cairo_png_options_t
+ * @filter: the new filter strategy
+ *
+ * Sets how the rows of the image are filtered before compression.
+ * See #cairo_png_filter_t for details.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_png_options_set_filter (cairo_png_options_t *options,
+			      cairo_png_filter_t   filter)
+{
+    if (cairo_png_options_status (options))
+	return;
+
+    if (filter < CAIRO_PNG_FILTER_DEFAULT || filter > CAIRO_PNG_FILTER_PAETH)
+	filter = CAIRO_PNG_FILTER_DEFAULT;
+
+    options->filter = filter;
+}
+
+/**
+ * cairo_png_options_get_filter:
+ * @options: a #cairo_png_options_t
+ *
+ * Gets the filter strategy for the PNG options object.
+ * See cairo_png_options_set_filter().
+ *
+ * Return value: the filter strategy
+ *
+ * Since: 1.14
+ **/
+cairo_png_filter_t
+cairo_png_options_get_filter (const cairo_png_options_t *options)
+{
+    if (cairo_png_options_status ((cairo_png_options_t *) options))
+	return CAIRO_PNG_FILTER_DEFAULT;
+
+    return options->filter;
+}
+
+/**
+ * cairo_png_options_set_strip_height:
+ * @options: a #cairo_png_options_t
+ * @strip_height: the number of rows per strip, or 0
+ *
+ * Selects parallel encoding. When @strip_height is positive, the
+ * image is cut into strips of that many rows, which are filtered
+ * and compressed independently of each other, on several threads
+ * if possible, and then joined into a single valid PNG image. The
+ * output only depends on the options and not on the number of
+ * threads used. Each strip restarts the compression, so the file
+ * grows slightly as strips get shorter; strips of a few hundred
+ * kilobytes of pixel data work well.
+ *
+ * Parallel encoding is only available for surfaces of format
+ * %CAIRO_FORMAT_ARGB32, %CAIRO_FORMAT_RGB24 and %CAIRO_FORMAT_A8,
+ * other formats are always encoded serially. The default of 0
+ * encodes the image serially as a single strip.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_png_options_set_strip_height (cairo_png_options_t *options,
+				    int                  strip_height)
+{
+    if (cairo_png_options_status (options))
+	return;
+
+    options->strip_height = MAX (strip_height, 0);
+}
+
+/**
+ * cairo_png_options_get_strip_height:
+ * @options: a #cairo_png_options_t
+ *
+ * Gets the strip height for the PNG options object.
+ * See cairo_png_options_set_strip_height().
+ *
+ * Return value: the number of rows per strip, or 0 for serial encoding
+ *
+ * Since: 1.14
+ **/
+int
+cairo_png_options_get_strip_height (const cairo_png_options_t *options)
+{
+    if (cairo_png_options_status ((cairo_png_options_t *) options))
+	return 0;
+
+    return options->strip_height;
+}
+
+#if HAVE_ZLIB
+/* Parallel encoding, in the manner of pigz: each strip of rows is
+ * converted, filtered and deflated on its own into a raw deflate
+ * stream ending on a byte boundary (a sync flush), except for the last
+ * one which is finished. Concatenated behind a zlib header and followed
+ * by the combined adler32 checksum of all the strips, they form the
+ * zlib stream of the IDAT chunks.
+ */
+typedef struct _png_strip {
+    const cairo_image_surface_t *image;
+    int bpp; /* bytes per pixel of the PNG rows */
+    int y, height;
+    int level;
+    cairo_png_filter_t filter;
+    cairo_bool_t last;
+
+    /* 2 bytes are reserved in front for the zlib header, and 4 at the
+     * end for the checksum */
+    unsigned char *data;
+    unsigned long length;
+    unsigned long raw_length;
+    unsigned long adler;
+    cairo_status_t status;
+} png_strip_t;
+
+static void
+png_convert_row (const cairo_image_surface_t *image, int y, int bpp,
+		 uint8_t *row)
+{
+    const uint8_t *src = image->data + y * image->stride;
+    int x;
+
+    switch (bpp) {
+    case 4:
+	unpremultiply_row (src, row, image->width);
+	break;
+    case 3:
+	for (x = 0; x < image->width; x++) {
+	    uint32_t pixel;
+
+	    memcpy (&pixel, src + 4 * x, sizeof (uint32_t));
+	    row[3 * x + 0] = (pixel & 0xff0000) >> 16;
+	    row[3 * x + 1] = (pixel & 0x00ff00) >>  8;
+	    row[3 * x + 2] = (pixel & 0x0000ff) >>  0;
+	}
+	break;
+    default:
+	memcpy (row, src, image->width);
+	break;
+    }
+}
+
+static inline uint8_t
+png_paeth (uint8_t a, uint8_t b, uint8_t c)
+{
+    int p = a + b - c;
+    int pa = abs (p - a), pb = abs (p - b), pc = abs (p - c);
+
+    if (pa <= pb && pa <= pc)
+	return a;
+    if (pb <= pc)
+	return b;
+    return c;
+}
+
+/* Writes the filter type followed by the filtered row into @out */
+static void
+png_filter_row (int type, const uint8_t *row, const uint8_t *prev,
+		int rowbytes, int bpp, uint8_t *out)
+{
+    int i;
+
+    *out++ = type;
+    switch (type) {
+    case 0:
+	memcpy (out, row, rowbytes);
+	break;
+    case 1:
+	for (i = 0; i < rowbytes; i++)
+	    out[i] = row[i] - (i >= bpp ? row[i - bpp] : 0);
+	break;
+    case 2:
+	for (i = 0; i < rowbytes; i++)
+	    out[i] = row[i] - prev[i];
+	break;
+    case 3:
+	for (i = 0; i < rowbytes; i++)
+	    out[i] = row[i] - (((i >= bpp ? row[i - bpp] : 0) + prev[i]) >> 1);
+	break;
+    case 4:
+	for (i = 0; i < rowbytes; i++) {
+	    out[i] = row[i] - png_paeth (i >= bpp ? row[i - bpp] : 0,
+					 prev[i],
+					 i >= bpp ? prev[i - bpp] : 0);
+	}
+	break;
+    }
+}
+
+/* Picks the filter minimising the sum of the filtered bytes taken as
+ * signed values, the same heuristic as libpng uses. */
+static void
+png_filter_row_adaptive (const uint8_t *row, const uint8_t *prev,
+			 int rowbytes, int bpp,
+			 uint8_t *scratch, uint8_t *out)
+{
+    unsigned long best_sum = (unsigned long) -1;
+    int type, best = 0, i;
+
+    for (type = 0; type < 5; type++) {
+	unsigned long sum = 0;
+
+	png_filter_row (type, row, prev, rowbytes, bpp, scratch);
+	for (i = 1; i <= rowbytes; i++)
+	    sum += abs ((int8_t) scratch[i]);
+
+	if (sum < best_sum) {
+	    best_sum = sum;
+	    best = type;
+	}
+    }
+
+    png_filter_row (best, row, prev, rowbytes, bpp, out);
+}
+
+static void
+png_encode_strip (void *closure)
+{
+    png_strip_t *strip = closure;
+    const cairo_image_surface_t *image = strip->image;
+    int rowbytes = image->width * strip->bpp;
+    uint8_t *rows, *prev, *row, *raw, *out;
+    unsigned long bound;
+    z_stream zs;
+    int y, ret;
+
+    strip->raw_length = (unsigned long) strip->height * (rowbytes + 1);
+    rows = _cairo_malloc_ab_plus_c (3, rowbytes, strip->raw_length + 1);
+    if (unlikely (rows == NULL)) {
+	strip->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	return;
+    }
+    prev = rows;
+    row = rows + rowbytes;
+    raw = row + rowbytes;
+    out = raw + strip->raw_length;
+
+    /* The first row of the image is filtered against zeroes */
+    if (strip->y == 0)
+	memset (prev, 0, rowbytes);
+    else
+	png_convert_row (image, strip->y - 1, strip->bpp, prev);
+
+    for (y = 0; y < strip->height; y++) {
+	uint8_t *tmp;
+
+	png_convert_row (image, strip->y + y, strip->bpp, row);
+	if (strip->filter == CAIRO_PNG_FILTER_DEFAULT) {
+	    png_filter_row_adaptive (row, prev, rowbytes, strip->bpp,
+				     out, raw + y * (rowbytes + 1));
+	} else {
+	    png_filter_row (strip->filter - CAIRO_PNG_FILTER_NONE,
+			    row, prev, rowbytes, strip->bpp,
+			    raw + y * (rowbytes + 1));
+	}
+
+	tmp = prev;
+	prev = row;
+	row = tmp;
+    }
+
+    strip->adler = adler32 (adler32 (0, NULL, 0), raw, strip->raw_length);
+
+    memset (&zs, 0, sizeof (zs));
+    if (deflateInit2 (&zs, strip->level, Z_DEFLATED, -MAX_WBITS, 8,
+		      strip->filter == CAIRO_PNG_FILTER_NONE ?
+		      Z_DEFAULT_STRATEGY : Z_FILTERED) != Z_OK)
+    {
+	free (rows);
+	strip->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	return;
+    }
+
+    /* Room for the sync flush marker, the zlib header and trailer */
+    bound = deflateBound (&zs, strip->raw_length) + 16;
+    strip->data = malloc (bound);
+    if (unlikely (strip->data == NULL)) {
+	deflateEnd (&zs);
+	free (rows);
+	strip->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	return;
+    }
+
+    zs.next_in = raw;
+    zs.avail_in = strip->raw_length;
+    zs.next_out = strip->data + 2;
+    zs.avail_out = bound - 6;
+    ret = deflate (&zs, strip->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (strip->last ? Z_STREAM_END : Z_OK) || zs.avail_in != 0)
+	strip->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    strip->length = zs.total_out;
+
+    deflateEnd (&zs);
+    free (rows);
+}
+
+/* Writes the IDAT chunks for @image, cut into @strips */
+static void
+write_png_strips (png_struct *png,
+		  const cairo_image_surface_t *image,
+		  int bpp,
+		  const cairo_png_options_t *options,
+		  png_strip_t *strips,
+		  int num_strips)
+{
+    cairo_status_t *error = png_get_error_ptr (png);
+    unsigned long adler;
+    int i, level;
+
+    level = options->compression_level;
+    if (level < 0)
+	level = Z_DEFAULT_COMPRESSION;
+
+    for (i = 0; i < num_strips; i++) {
+	strips[i].image = image;
+	strips[i].bpp = bpp;
+	strips[i].y = i * options->strip_height;
+	strips[i].height = MIN (options->strip_height,
+				image->height - strips[i].y);
+	strips[i].level = level;
+	strips[i].filter = options->filter;
+	strips[i].last = i == num_strips - 1;
+	strips[i].data = NULL;
+	strips[i].status = CAIRO_STATUS_SUCCESS;
+    }
+
+    _cairo_thread_pool_run (png_encode_strip,
+			    strips, num_strips, sizeof (png_strip_t));
+
+    adler = adler32 (0, NULL, 0);
+    for (i = 0; i < num_strips; i++) {
+	if (unlikely (strips[i].status)) {
+	    *error = strips[i].status;
+	    png_error (png, NULL);
+	}
+
+	adler = adler32_combine (adler, strips[i].adler, strips[i].raw_length);
+    }
+
+    for (i = 0; i < num_strips; i++) {
+	png_strip_t *strip = &strips[i];
+	unsigned char *data = strip->data + 2;
+	unsigned long length = strip->length;
+
+	if (i == 0) {
+	    /* A zlib header for a 32K window, with the level hint zlib
+	     * would have chosen */
+	    data -= 2;
+	    length += 2;
+	    data[0] = 0x78;
+	    data[1] = level == Z_DEFAULT_COMPRESSION || level == 6 ? 0x9c :
+		      level >= 7 ? 0xda : level >= 2 ? 0x5e : 0x01;
+	}
+
+	if (strip->last) {
+	    unsigned char *end = strip->data + 2 + strip->length;
+
+	    end[0] = adler >> 24;
+	    end[1] = adler >> 16;
+	    end[2] = adler >> 8;
+	    end[3] = adler;
+	    length += 4;
+	}
+
+	png_write_chunk (png, (png_bytep) "IDAT", data, length);
+    }
+
+    png_write_chunk (png, (png_bytep) "IEND", NULL, 0);
+}
+#endif
+
 static cairo_status_t
-write_png (cairo_surface_t	*surface,
-	   png_rw_ptr		write_func,
-	   void			*closure)
+write_png (cairo_surface_t		*surface,
+	   png_rw_ptr			 write_func,
+	   void				*closure,
+	   const cairo_png_options_t	*options)
 {
     int i;
     cairo_int_status_t status;
@@ -179,6 +753,10 @@ write_png (cairo_surface_t	*surface,
     png_struct *png;
     png_info *info;
     png_byte **volatile rows = NULL;
+#if HAVE_ZLIB
+    png_strip_t *volatile strips = NULL;
+    volatile int num_strips = 0;
+#endif
     png_color_16 white;
     int png_color_type;
     int bpc;
@@ -236,6 +814,29 @@ write_png (cairo_surface_t	*surface,
 
     png_set_write_fn (png, closure, write_func, png_simple_output_flush_fn);
 
+    if (options->compression_level >= 0)
+	png_set_compression_level (png, options->compression_level);
+
+    switch (options->filter) {
+    case CAIRO_PNG_FILTER_DEFAULT:
+	break;
+    case CAIRO_PNG_FILTER_NONE:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+	break;
+    case CAIRO_PNG_FILTER_SUB:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+	break;
+    case CAIRO_PNG_FILTER_UP:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_UP);
+	break;
+    case CAIRO_PNG_FILTER_AVERAGE:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_AVG);
+	break;
+    case CAIRO_PNG_FILTER_PAETH:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_PAETH);
+	break;
+    }
+
     switch (clone->format) {
     case CAIRO_FORMAT_ARGB32:
 	bpc = 8;
@@ -295,6 +896,31 @@ write_png (cairo_surface_t	*surface,
      */
     png_write_info (png, info);
 
+#if HAVE_ZLIB
+    if (options->strip_height > 0 && bpc == 8 &&
+	clone->format != CAIRO_FORMAT_RGB30)
+    {
+	int bpp;
+
+	if (png_color_type == PNG_COLOR_TYPE_RGB_ALPHA)
+	    bpp = 4;
+	else if (png_color_type == PNG_COLOR_TYPE_RGB)
+	    bpp = 3;
+	else
+	    bpp = 1;
+
+	num_strips = 1 + (clone->height - 1) / options->strip_height;
+	strips = _cairo_malloc_ab (num_strips, sizeof (png_strip_t));
+	if (unlikely (strips == NULL)) {
+	    status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	    goto BAIL4;
+	}
+
+	write_png_strips (png, clone, bpp, options, strips, num_strips);
+	goto BAIL4;
+    }
+#endif
+
     if (png_color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
 	png_set_write_user_transform_fn (png, unpremultiply_data);
     } else if (png_color_type == PNG_COLOR_TYPE_RGB) {
@@ -306,6 +932,13 @@ write_png (cairo_surface_t	*surface,
     png_write_end (png, info);
 
 BAIL4:
+#if HAVE_ZLIB
+    if (strips != NULL) {
+	for (i = 0; i < num_strips; i++)
+	    free (strips[i].data);
+	free (strips);
+    }
+#endif
     png_destroy_write_struct (&png, &info);
 BAIL3:
     free (rows);
@@ -376,7 +1009,7 @@ cairo_surface_write_to_png (cairo_surface_t	*surface,
 	}
     }
 
-    status = write_png (surface, stdio_write_func, fp);
+    status = write_png (surface, stdio_write_func, fp, &_cairo_png_options_nil);
 
     if (fclose (fp) && status == CAIRO_STATUS_SUCCESS)
 	status = _cairo_error (CAIRO_STATUS_WRITE_ERROR);
@@ -437,10 +1070,56 @@ cairo_surface_write_to_png_stream (cairo_surface_t	*surface,
     png_closure.write_func = write_func;
     png_closure.closure = closure;
 
-    return write_png (surface, stream_write_func, &png_closure);
+    return write_png (surface, stream_write_func, &png_closure,
+		      &_cairo_png_options_nil);
 }
 slim_hidden_def (cairo_surface_write_to_png_stream);
 
+/**
+ * cairo_surface_write_to_png_stream_with_options:
+ * @surface: a #cairo_surface_t with pixel contents
+ * @write_func: a #cairo_write_func_t
+ * @closure: closure data for the write function
+ * @options: a #cairo_png_options_t controlling the encoding
+ *
+ * Writes the image surface to the write function, like
+ * cairo_surface_write_to_png_stream(), but encoding it as described
+ * by @options: with a chosen compression level and filter strategy,
+ * and possibly in parallel strips.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if the PNG file was written
+ * successfully.  Otherwise, %CAIRO_STATUS_NO_MEMORY is returned if
+ * memory could not be allocated for the operation,
+ * %CAIRO_STATUS_SURFACE_TYPE_MISMATCH if the surface does not have
+ * pixel contents, or the error status of @options.
+ *
+ * Since: 1.14
+ **/
+cairo_status_t
+cairo_surface_write_to_png_stream_with_options (cairo_surface_t			*surface,
+						cairo_write_func_t		 write_func,
+						void				*closure,
+						const cairo_png_options_t	*options)
+{
+    struct png_write_closure_t png_closure;
+    cairo_status_t status;
+
+    if (surface->status)
+	return surface->status;
+
+    if (surface->finished)
+	return _cairo_error (CAIRO_STATUS_SURFACE_FINISHED);
+
+    status = cairo_png_options_status ((cairo_png_options_t *) options);
+    if (unlikely (status))
+	return _cairo_error (status);
+
+    png_closure.write_func = write_func;
+    png_closure.closure = closure;
+
+    return write_png (surface, stream_write_func, &png_closure, options);
+}
+
 static inline int
 multiply_alpha (int alpha, int color)
 {
@@ -448,16 +1127,47 @@ multiply_alpha (int alpha, int color)
     return ((temp + (temp >> 8)) >> 8);
 }
 
-/* Premultiplies data and converts RGBA bytes => native endian */
+#if defined(__SSE2__) && ! defined(WORDS_BIGENDIAN)
+/* Premultiplies two RGBA pixels, widened to 16 bits per channel, and
+ * swaps them around into BGRA, rounding exactly as multiply_alpha(). */
+static inline __m128i
+premultiply_2x16 (__m128i p)
+{
+    const __m128i alpha_one = _mm_set_epi16 (0xff, 0, 0, 0, 0xff, 0, 0, 0);
+    __m128i a, t;
+
+    a = _mm_shufflelo_epi16 (p, _MM_SHUFFLE (3, 3, 3, 3));
+    a = _mm_shufflehi_epi16 (a, _MM_SHUFFLE (3, 3, 3, 3));
+    a = _mm_or_si128 (a, alpha_one);
+
+    p = _mm_shufflelo_epi16 (p, _MM_SHUFFLE (3, 0, 1, 2));
+    p = _mm_shufflehi_epi16 (p, _MM_SHUFFLE (3, 0, 1, 2));
+
+    t = _mm_add_epi16 (_mm_mullo_epi16 (p, a), _mm_set1_epi16 (0x80));
+    return _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+}
+#endif
+
+/* Premultiplies RGBA bytes => native endian ARGB, in place */
 static void
-premultiply_data (png_structp   png,
-                  png_row_infop row_info,
-                  png_bytep     data)
+premultiply_row (uint8_t *data, unsigned int width)
 {
-    unsigned int i;
+    unsigned int i = 0;
 
-    for (i = 0; i < row_info->rowbytes; i += 4) {
-	uint8_t *base  = &data[i];
+#if defined(__SSE2__) && ! defined(WORDS_BIGENDIAN)
+    const __m128i zero = _mm_setzero_si128 ();
+
+    for (; i + 4 <= width; i += 4) {
+	__m128i p = _mm_loadu_si128 ((const __m128i *) (data + 4 * i));
+
+	p = _mm_packus_epi16 (premultiply_2x16 (_mm_unpacklo_epi8 (p, zero)),
+			      premultiply_2x16 (_mm_unpackhi_epi8 (p, zero)));
+	_mm_storeu_si128 ((__m128i *) (data + 4 * i), p);
+    }
+#endif
+
+    for (; i < width; i++) {
+	uint8_t *base  = &data[4 * i];
 	uint8_t  alpha = base[3];
 	uint32_t p;
 
@@ -479,13 +1189,37 @@ premultiply_data (png_structp   png,
     }
 }
 
+/* Premultiplies data and converts RGBA bytes => native endian */
+static void
+premultiply_data (png_structp   png,
+                  png_row_infop row_info,
+                  png_bytep     data)
+{
+    premultiply_row (data, row_info->rowbytes / 4);
+}
+
 /* Converts RGBx bytes to native endian xRGB */
 static void
 convert_bytes_to_data (png_structp png, png_row_infop row_info, png_bytep data)
 {
-    unsigned int i;
+    unsigned int i = 0;
 
-    for (i = 0; i < row_info->rowbytes; i += 4) {
+#if defined(__SSE2__) && ! defined(WORDS_BIGENDIAN)
+    const __m128i mask = _mm_set1_epi32 (0xff);
+    const __m128i green = _mm_set1_epi32 (0xff00);
+    const __m128i alpha = _mm_set1_epi32 (0xff000000);
+
+    for (; i + 16 <= row_info->rowbytes; i += 16) {
+	__m128i p = _mm_loadu_si128 ((const __m128i *) (data + i));
+
+	p = _mm_or_si128 (_mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (p, mask), 16),
+					_mm_and_si128 (_mm_srli_epi32 (p, 16), mask)),
+			  _mm_or_si128 (_mm_and_si128 (p, green), alpha));
+	_mm_storeu_si128 ((__m128i *) (data + i), p);
+    }
+#endif
+
+    for (; i < row_info->rowbytes; i += 4) {
 	uint8_t *base  = &data[i];
 	uint8_t  red   = base[0];
 	uint8_t  green = base[1];
@@ -497,6 +1231,85 @@ convert_bytes_to_data (png_structp png, png_row_infop row_info, png_bytep data)
     }
 }
 
+/* Decoding lots of small images, such as the tiles of a map, spends
+ * much of its time allocating and faulting in fresh pixel data, only
+ * for the image to be composited and thrown away. So the data of tile
+ * sized images is recycled through a few pools, one for each power of
+ * four from 4KiB up to 256KiB (a 256x256 ARGB32 tile).
+ *
+ * The price is that a pooled surface does not own its data, so when it
+ * is destroyed while still snapshotted, for instance as the source of
+ * a recording or a vector surface, _cairo_image_surface_snapshot()
+ * has to copy the pixels instead of stealing them. That costs one
+ * extra copy of a tile sized image, and only on that path; larger
+ * images, which are the ones worth stealing, still own their data.
+ *
+ * These buffers are much larger than the objects the freed pools were
+ * made for, so they only go through the shared arrays, which keep at
+ * most MAX_FREED_POOL_SIZE of each size, and not through the magazines
+ * every thread keeps in front of them.
+ */
+#define PNG_POOL_MIN_SHIFT 12
+#define PNG_POOL_MAX_SHIFT 18
+#define PNG_POOL_COUNT ((PNG_POOL_MAX_SHIFT - PNG_POOL_MIN_SHIFT) / 2 + 1)
+
+typedef union {
+    int bucket;
+    uint8_t align[16];
+} png_pool_header_t;
+
+static freed_pool_t png_pool[PNG_POOL_COUNT];
+static const cairo_user_data_key_t png_pool_key;
+
+/* Returns the pool for images of @size bytes, or -1 if too large */
+static int
+png_pool_bucket (size_t size)
+{
+    int bucket;
+
+    for (bucket = 0; bucket < PNG_POOL_COUNT; bucket++) {
+	if (size <= (size_t) 1 << (PNG_POOL_MIN_SHIFT + 2 * bucket))
+	    return bucket;
+    }
+
+    return -1;
+}
+
+static unsigned char *
+png_pool_alloc (int bucket)
+{
+    png_pool_header_t *header;
+
+    header = _freed_pool_get_global (&png_pool[bucket]);
+    if (header == NULL) {
+	header = malloc (sizeof (png_pool_header_t) +
+			 ((size_t) 1 << (PNG_POOL_MIN_SHIFT + 2 * bucket)));
+	if (unlikely (header == NULL))
+	    return NULL;
+
+	header->bucket = bucket;
+    }
+
+    return (unsigned char *) (header + 1);
+}
+
+static void
+png_pool_release (void *data)
+{
+    png_pool_header_t *header = (png_pool_header_t *) data - 1;
+
+    _freed_pool_put_global (&png_pool[header->bucket], header);
+}
+
+void
+_cairo_png_reset_static_data (void)
+{
+    int i;
+
+    for (i = 0; i < PNG_POOL_COUNT; i++)
+	_freed_pool_reset (&png_pool[i]);
+}
+
 static cairo_status_t
 stdio_read_func (void *closure, unsigned char *data, unsigned int size)
 {
@@ -531,40 +1344,34 @@ stream_read_func (png_structp png, png_bytep data, png_size_t size)
 	png_error (png, NULL);
     }
 
-    _cairo_output_stream_write (png_closure->png_data, data, size);
+    if (png_closure->png_data != NULL)
+	_cairo_output_stream_write (png_closure->png_data, data, size);
 }
 
-static cairo_surface_t *
-read_png (struct png_read_closure_t *png_closure)
+/* Decodes the PNG image into png_closure->data */
+static cairo_status_t
+read_png_data (struct png_read_closure_t *png_closure)
 {
-    cairo_surface_t *surface;
     png_struct *png = NULL;
-    png_info *info;
-    png_byte *data = NULL;
-    png_byte **row_pointers = NULL;
+    png_info *info = NULL;
+    png_byte *stack_rows[CAIRO_STACK_ARRAY_LENGTH (png_byte *)];
+    png_byte ** volatile row_pointers = stack_rows;
     png_uint_32 png_width, png_height;
-    int depth, color_type, interlace, stride;
+    int depth, color_type, interlace;
     unsigned int i;
-    cairo_format_t format;
     cairo_status_t status;
-    unsigned char *mime_data;
-    unsigned long mime_data_length;
-
-    png_closure->png_data = _cairo_memory_stream_create ();
 
     /* XXX: Perhaps we'll want some other error handlers? */
     png = png_create_read_struct (PNG_LIBPNG_VER_STRING,
                                   &status,
 	                          png_simple_error_callback,
 	                          png_simple_warning_callback);
-    if (unlikely (png == NULL)) {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
-	goto BAIL;
-    }
+    if (unlikely (png == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
     info = png_create_info_struct (png);
     if (unlikely (info == NULL)) {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
 	goto BAIL;
     }
 
@@ -572,10 +1379,8 @@ read_png (struct png_read_closure_t *png_closure)
 
     status = CAIRO_STATUS_SUCCESS;
 #ifdef PNG_SETJMP_SUPPORTED
-    if (setjmp (png_jmpbuf (png))) {
-	surface = _cairo_surface_create_in_error (status);
+    if (setjmp (png_jmpbuf (png)))
 	goto BAIL;
-    }
 #endif
 
     png_read_info (png, info);
@@ -583,10 +1388,8 @@ read_png (struct png_read_closure_t *png_closure)
     png_get_IHDR (png, info,
                   &png_width, &png_height, &depth,
                   &color_type, &interlace, NULL, NULL);
-    if (unlikely (status)) { /* catch any early warnings */
-	surface = _cairo_surface_create_in_error (status);
+    if (unlikely (status)) /* catch any early warnings */
 	goto BAIL;
-    }
 
     /* convert palette/gray image to rgb */
     if (color_type == PNG_COLOR_TYPE_PALETTE)
@@ -632,7 +1435,7 @@ read_png (struct png_read_closure_t *png_closure)
 	! (color_type == PNG_COLOR_TYPE_RGB ||
 	   color_type == PNG_COLOR_TYPE_RGB_ALPHA))
     {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_READ_ERROR));
+	status = _cairo_error (CAIRO_STATUS_READ_ERROR);
 	goto BAIL;
     }
 
@@ -642,53 +1445,127 @@ read_png (struct png_read_closure_t *png_closure)
 	    /* fall-through just in case ;-) */
 
 	case PNG_COLOR_TYPE_RGB_ALPHA:
-	    format = CAIRO_FORMAT_ARGB32;
+	    png_closure->format = CAIRO_FORMAT_ARGB32;
 	    png_set_read_user_transform_fn (png, premultiply_data);
 	    break;
 
 	case PNG_COLOR_TYPE_RGB:
-	    format = CAIRO_FORMAT_RGB24;
+	    png_closure->format = CAIRO_FORMAT_RGB24;
 	    png_set_read_user_transform_fn (png, convert_bytes_to_data);
 	    break;
     }
 
-    stride = cairo_format_stride_for_width (format, png_width);
-    if (stride < 0) {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_INVALID_STRIDE));
-	goto BAIL;
-    }
+    if (png_closure->data == NULL) {
+	if (png_width > INT_MAX || png_height > INT_MAX) {
+	    status = _cairo_error (CAIRO_STATUS_INVALID_SIZE);
+	    goto BAIL;
+	}
 
-    data = _cairo_malloc_ab (png_height, stride);
-    if (unlikely (data == NULL)) {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
-	goto BAIL;
+	png_closure->width = png_width;
+	png_closure->height = png_height;
+	status = png_closure->get_data (png_closure);
+	if (unlikely (status))
+	    goto BAIL;
+    } else {
+	if (png_width > (png_uint_32) png_closure->width ||
+	    png_height > (png_uint_32) png_closure->height)
+	{
+	    status = _cairo_error (CAIRO_STATUS_INVALID_SIZE);
+	    goto BAIL;
+	}
+
+	png_closure->width = png_width;
+	png_closure->height = png_height;
     }
 
-    row_pointers = _cairo_malloc_ab (png_height, sizeof (char *));
-    if (unlikely (row_pointers == NULL)) {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
-	goto BAIL;
+    if (png_height > ARRAY_LENGTH (stack_rows)) {
+	row_pointers = _cairo_malloc_ab (png_height, sizeof (png_byte *));
+	if (unlikely (row_pointers == NULL)) {
+	    status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	    goto BAIL;
+	}
     }
 
     for (i = 0; i < png_height; i++)
-        row_pointers[i] = &data[i * stride];
+        row_pointers[i] = &png_closure->data[i * png_closure->stride];
 
     png_read_image (png, row_pointers);
     png_read_end (png, info);
 
-    if (unlikely (status)) { /* catch any late warnings - probably hit an error already */
+    /* status catches any late warnings - probably hit an error already */
+
+ BAIL:
+    if (row_pointers != stack_rows)
+	free (row_pointers);
+    png_destroy_read_struct (&png, &info, NULL);
+
+    return status;
+}
+
+static cairo_status_t
+read_png_get_data (struct png_read_closure_t *png_closure)
+{
+    int bucket;
+
+    png_closure->stride = cairo_format_stride_for_width (png_closure->format,
+							 png_closure->width);
+    if (png_closure->stride < 0)
+	return _cairo_error (CAIRO_STATUS_INVALID_STRIDE);
+
+    bucket = png_pool_bucket ((size_t) png_closure->height * png_closure->stride);
+    if (bucket >= 0)
+	png_closure->data = png_pool_alloc (bucket);
+    else
+	png_closure->data = _cairo_malloc_ab (png_closure->height,
+					      png_closure->stride);
+    if (unlikely (png_closure->data == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+read_png (struct png_read_closure_t *png_closure)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_bool_t pooled;
+    unsigned char *mime_data;
+    unsigned long mime_data_length;
+
+    png_closure->png_data = _cairo_memory_stream_create ();
+    png_closure->get_data = read_png_get_data;
+    png_closure->data = NULL;
+
+    status = read_png_data (png_closure);
+    if (unlikely (status)) {
 	surface = _cairo_surface_create_in_error (status);
 	goto BAIL;
     }
 
-    surface = cairo_image_surface_create_for_data (data, format,
-						   png_width, png_height,
-						   stride);
+    surface = cairo_image_surface_create_for_data (png_closure->data,
+						   png_closure->format,
+						   png_closure->width,
+						   png_closure->height,
+						   png_closure->stride);
     if (surface->status)
 	goto BAIL;
 
-    _cairo_image_surface_assume_ownership_of_data ((cairo_image_surface_t*)surface);
-    data = NULL;
+    pooled = png_pool_bucket ((size_t) png_closure->height *
+			      png_closure->stride) >= 0;
+    if (pooled) {
+	status = cairo_surface_set_user_data (surface, &png_pool_key,
+					      png_closure->data,
+					      png_pool_release);
+	if (unlikely (status)) {
+	    cairo_surface_destroy (surface);
+	    surface = _cairo_surface_create_in_error (status);
+	    goto BAIL;
+	}
+    } else {
+	_cairo_image_surface_assume_ownership_of_data ((cairo_image_surface_t*)surface);
+    }
+    png_closure->data = NULL;
 
     _cairo_debug_check_image_surface_is_defined (surface);
 
@@ -716,10 +1593,13 @@ read_png (struct png_read_closure_t *png_closure)
     }
 
  BAIL:
-    free (row_pointers);
-    free (data);
-    if (png != NULL)
-	png_destroy_read_struct (&png, &info, NULL);
+    if (png_closure->data != NULL) {
+	if (png_pool_bucket ((size_t) png_closure->height *
+			     png_closure->stride) >= 0)
+	    png_pool_release (png_closure->data);
+	else
+	    free (png_closure->data);
+    }
     if (png_closure->png_data != NULL) {
 	cairo_status_t status_ignored;
 
@@ -817,3 +1697,161 @@ cairo_image_surface_create_from_png_stream (cairo_read_func_t	read_func,
 
     return read_png (&png_closure);
 }
+
+static cairo_status_t
+read_png_into (cairo_read_func_t	 read_func,
+	       void			*closure,
+	       unsigned char		*data,
+	       int			*width,
+	       int			*height,
+	       int			 stride)
+{
+    struct png_read_closure_t png_closure;
+    cairo_status_t status;
+
+    png_closure.read_func = read_func;
+    png_closure.closure = closure;
+    png_closure.png_data = NULL;
+    png_closure.get_data = NULL;
+    png_closure.data = data;
+    png_closure.width = *width;
+    png_closure.height = *height;
+    png_closure.stride = stride;
+
+    status = read_png_data (&png_closure);
+
+    *width = png_closure.width;
+    *height = png_closure.height;
+
+    return status;
+}
+
+/**
+ * cairo_png_read_stream_to_data:
+ * @read_func: function called to read the data of the file
+ * @closure: data to pass to @read_func.
+ * @data: the pixel data to decode the image into
+ * @format: the format of @data, either %CAIRO_FORMAT_ARGB32 or
+ * %CAIRO_FORMAT_RGB24
+ * @width: the width of the area available at @data
+ * @height: the height of the area available at @data
+ * @stride: the number of bytes between the start of rows in @data
+ *
+ * Decodes PNG data read incrementally via the @read_func function
+ * directly into the caller's pixel data, without allocating an image
+ * surface. The image is placed at the top-left of the area, so to
+ * decode it at an offset, pass a pointer to the first pixel within
+ * the buffer. Pixels of the area beyond the size of the image are
+ * left untouched.
+ *
+ * The pixels are stored as if the image had been painted with
+ * %CAIRO_OPERATOR_SOURCE, so images with an alpha channel keep it
+ * in %CAIRO_FORMAT_ARGB32 and are composited over black in
+ * %CAIRO_FORMAT_RGB24.
+ *
+ * If the image is larger than the area, %CAIRO_STATUS_INVALID_SIZE
+ * is returned before any pixels are written. Upon any other error,
+ * the contents of the area are undefined.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if the image was decoded,
+ * otherwise %CAIRO_STATUS_NULL_POINTER, %CAIRO_STATUS_INVALID_FORMAT,
+ * %CAIRO_STATUS_INVALID_SIZE, %CAIRO_STATUS_INVALID_STRIDE,
+ * %CAIRO_STATUS_NO_MEMORY or %CAIRO_STATUS_READ_ERROR.
+ *
+ * Since: 1.14
+ **/
+cairo_status_t
+cairo_png_read_stream_to_data (cairo_read_func_t	 read_func,
+			       void			*closure,
+			       unsigned char		*data,
+			       cairo_format_t		 format,
+			       int			 width,
+			       int			 height,
+			       int			 stride)
+{
+    if (data == NULL)
+	return _cairo_error (CAIRO_STATUS_NULL_POINTER);
+
+    if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24)
+	return _cairo_error (CAIRO_STATUS_INVALID_FORMAT);
+
+    if (width < 0 || height < 0)
+	return _cairo_error (CAIRO_STATUS_INVALID_SIZE);
+
+    if (stride / 4 < width)
+	return _cairo_error (CAIRO_STATUS_INVALID_STRIDE);
+
+    return read_png_into (read_func, closure, data, &width, &height, stride);
+}
+
+/**
+ * cairo_image_surface_read_png_stream:
+ * @surface: a #cairo_image_surface_t
+ * @x: the X coordinate at which to place the image
+ * @y: the Y coordinate at which to place the image
+ * @read_func: function called to read the data of the file
+ * @closure: data to pass to @read_func.
+ *
+ * Decodes PNG data read incrementally via the @read_func function
+ * directly into the pixels of an existing image surface, with its
+ * top-left corner at (@x, @y). This replaces the contents of that
+ * area, as painting the image with %CAIRO_OPERATOR_SOURCE would, but
+ * avoids allocating a new surface for every image decoded. The
+ * surface is flushed beforehand and marked dirty afterwards.
+ *
+ * @surface must be of format %CAIRO_FORMAT_ARGB32 or
+ * %CAIRO_FORMAT_RGB24, and the image must fit within it, otherwise
+ * %CAIRO_STATUS_INVALID_SIZE is returned before any pixels are
+ * written. Upon any other error, the contents of the area covered by
+ * the image are undefined.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if the image was decoded,
+ * otherwise the status of @surface if it is in error, or
+ * %CAIRO_STATUS_SURFACE_TYPE_MISMATCH, %CAIRO_STATUS_SURFACE_FINISHED,
+ * %CAIRO_STATUS_INVALID_FORMAT, %CAIRO_STATUS_INVALID_SIZE,
+ * %CAIRO_STATUS_NO_MEMORY or %CAIRO_STATUS_READ_ERROR.
+ *
+ * Since: 1.14
+ **/
+cairo_status_t
+cairo_image_surface_read_png_stream (cairo_surface_t	*surface,
+				     int		 x,
+				     int		 y,
+				     cairo_read_func_t	 read_func,
+				     void		*closure)
+{
+    cairo_image_surface_t *image;
+    cairo_status_t status;
+    int width, height;
+
+    if (unlikely (surface->status))
+	return surface->status;
+
+    if (unlikely (surface->finished))
+	return _cairo_error (CAIRO_STATUS_SURFACE_FINISHED);
+
+    if (! _cairo_surface_is_image (surface))
+	return _cairo_error (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+
+    image = (cairo_image_surface_t *) surface;
+    if (image->format != CAIRO_FORMAT_ARGB32 &&
+	image->format != CAIRO_FORMAT_RGB24)
+    {
+	return _cairo_error (CAIRO_STATUS_INVALID_FORMAT);
+    }
+
+    if (x < 0 || y < 0 || x >= image->width || y >= image->height)
+	return _cairo_error (CAIRO_STATUS_INVALID_SIZE);
+
+    cairo_surface_flush (surface);
+
+    width = image->width - x;
+    height = image->height - y;
+    status = read_png_into (read_func, closure,
+			    image->data + y * image->stride + 4 * x,
+			    &width, &height, image->stride);
+
+    cairo_surface_mark_dirty_rectangle (surface, x, y, width, height);
+
+    return status;
+}
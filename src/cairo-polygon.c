@@ -37,6 +37,7 @@
 
 #include "cairoint.h"
 
+#include "cairo-arena-private.h"
 #include "cairo-boxes-private.h"
 #include "cairo-contour-private.h"
 #include "cairo-error-private.h"
@@ -130,6 +131,7 @@ _cairo_polygon_init (cairo_polygon_t *polygon,
 
     polygon->edges = polygon->edges_embedded;
     polygon->edges_size = ARRAY_LENGTH (polygon->edges_embedded);
+    polygon->arena = NULL;
 
     polygon->extents.p1.x = polygon->extents.p1.y = INT32_MAX;
     polygon->extents.p2.x = polygon->extents.p2.y = INT32_MIN;
@@ -162,6 +164,7 @@ _cairo_polygon_init_boxes (cairo_polygon_t *polygon,
 
     polygon->edges = polygon->edges_embedded;
     polygon->edges_size = ARRAY_LENGTH (polygon->edges_embedded);
+    polygon->arena = NULL;
     if (boxes->num_boxes > ARRAY_LENGTH (polygon->edges_embedded)/2) {
 	polygon->edges_size = 2 * boxes->num_boxes;
 	polygon->edges = _cairo_malloc_ab (polygon->edges_size,
@@ -210,6 +213,7 @@ _cairo_polygon_init_box_array (cairo_polygon_t *polygon,
 
     polygon->edges = polygon->edges_embedded;
     polygon->edges_size = ARRAY_LENGTH (polygon->edges_embedded);
+    polygon->arena = NULL;
     if (num_boxes > ARRAY_LENGTH (polygon->edges_embedded)/2) {
 	polygon->edges_size = 2 * num_boxes;
 	polygon->edges = _cairo_malloc_ab (polygon->edges_size,
@@ -242,10 +246,21 @@ _cairo_polygon_init_box_array (cairo_polygon_t *polygon,
 }
 
 
+/* Let @polygon grow within the arena of the current operation, if any.
+ * Only for a polygon that is finished before the operation returns and
+ * whose edges are not handed on to anything that outlives it. */
+void
+_cairo_polygon_use_arena (cairo_polygon_t *polygon)
+{
+    assert (polygon->edges == polygon->edges_embedded);
+
+    polygon->arena = _cairo_arena_get_current ();
+}
+
 void
 _cairo_polygon_fini (cairo_polygon_t *polygon)
 {
-    if (polygon->edges != polygon->edges_embedded)
+    if (polygon->edges != polygon->edges_embedded && polygon->arena == NULL)
 	free (polygon->edges);
 
     VG (VALGRIND_MAKE_MEM_NOACCESS (polygon, sizeof (cairo_polygon_t)));
@@ -264,10 +279,30 @@ _cairo_polygon_grow (cairo_polygon_t *polygon)
 	return FALSE;
     }
 
-    if (polygon->edges == polygon->edges_embedded) {
+    new_edges = NULL;
+    if (polygon->arena) {
+	if (polygon->edges == polygon->edges_embedded) {
+	    new_edges = _cairo_arena_alloc_ab (polygon->arena,
+					       new_size, sizeof (cairo_edge_t));
+	    if (new_edges != NULL)
+		memcpy (new_edges, polygon->edges, old_size * sizeof (cairo_edge_t));
+	} else if (_cairo_arena_extend_ab (polygon->arena, polygon->edges,
+					   new_size, sizeof (cairo_edge_t)))
+	{
+	    new_edges = polygon->edges;
+	}
+    }
+
+    if (new_edges != NULL) {
+	/* grown within the arena */
+    } else if (polygon->edges == polygon->edges_embedded || polygon->arena) {
+	/* Leave the arena for good rather than abandon block after block,
+	 * or fall back to the heap if the arena could not get a chunk. */
 	new_edges = _cairo_malloc_ab (new_size, sizeof (cairo_edge_t));
-	if (new_edges != NULL)
+	if (new_edges != NULL) {
 	    memcpy (new_edges, polygon->edges, old_size * sizeof (cairo_edge_t));
+	    polygon->arena = NULL;
+	}
     } else {
 	new_edges = _cairo_realloc_ab (polygon->edges,
 		                       new_size, sizeof (cairo_edge_t));
@@ -43,12 +43,27 @@
 
 #include "cairo-ps.h"
 
+#include "cairo-content-hash-private.h"
 #include "cairo-surface-private.h"
 #include "cairo-surface-clipper-private.h"
 #include "cairo-pdf-operators-private.h"
 
 #include <time.h>
 
+/* A source written once, as a procedure in the setup section, and
+ * called wherever a surface of the same content is painted. */
+typedef struct _cairo_ps_shared_surface {
+    cairo_hash_entry_t base;
+    cairo_content_digest_t digest;
+    cairo_operator_t op;
+    cairo_filter_t filter;
+    cairo_bool_t pad;
+    cairo_bool_t stencil_mask;
+    int width;
+    int height;
+    int id;
+} cairo_ps_shared_surface_t;
+
 typedef struct cairo_ps_surface {
     cairo_surface_t base;
 
@@ -72,6 +87,11 @@ typedef struct cairo_ps_surface {
 
     cairo_bool_t use_string_datasource;
 
+    cairo_bool_t deduplicate_content;
+    cairo_hash_table_t *shared_surfaces;
+    cairo_output_stream_t *shared_surfaces_stream;
+    int num_shared_surfaces;
+
     cairo_bool_t current_pattern_is_solid_color;
     cairo_color_t current_color;
 
@@ -1056,6 +1056,10 @@ _cairo_ps_surface_create_for_stream_internal (cairo_output_stream_t *stream,
     surface->content = CAIRO_CONTENT_COLOR_ALPHA;
     surface->use_string_datasource = FALSE;
     surface->current_pattern_is_solid_color = FALSE;
+    surface->deduplicate_content = FALSE;
+    surface->shared_surfaces = NULL;
+    surface->shared_surfaces_stream = NULL;
+    surface->num_shared_surfaces = 0;
 
     surface->page_bbox.x = 0;
     surface->page_bbox.y = 0;
@@ -1367,6 +1371,36 @@ cairo_ps_surface_get_eps (cairo_surface_t	*surface)
     return ps_surface->eps;
 }
 
+/**
+ * cairo_ps_surface_set_deduplicate_content:
+ * @surface: a PostScript #cairo_surface_t
+ * @deduplicate: %TRUE to share sources of identical content
+ *
+ * Sets whether image and recording surfaces used as sources are
+ * recognised by their content. When enabled, each distinct source is
+ * written once, as a procedure in the setup section of the document,
+ * and every surface of identical pixels, or recorded drawing, painted
+ * on any page calls that procedure instead of embedding its data
+ * again.
+ *
+ * The shared sources are held in memory until the surface is
+ * finished, and computing their content hash costs a pass over every
+ * source, so this is disabled by default.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_ps_surface_set_deduplicate_content (cairo_surface_t	*surface,
+					  cairo_bool_t		 deduplicate)
+{
+    cairo_ps_surface_t *ps_surface = NULL;
+
+    if (! _extract_ps_surface (surface, TRUE, &ps_surface))
+	return;
+
+    ps_surface->deduplicate_content = deduplicate;
+}
+
 /**
  * cairo_ps_surface_set_size:
  * @surface: a PostScript #cairo_surface_t
@@ -1593,6 +1627,16 @@ cairo_ps_surface_dsc_begin_page_setup (cairo_surface_t *surface)
     }
 }
 
+static void
+_cairo_ps_shared_surface_pluck (void *entry, void *closure)
+{
+    cairo_ps_shared_surface_t *shared = entry;
+    cairo_hash_table_t *shared_surfaces = closure;
+
+    _cairo_hash_table_remove (shared_surfaces, &shared->base);
+    free (shared);
+}
+
 static cairo_status_t
 _cairo_ps_surface_finish (void *abstract_surface)
 {
@@ -1611,6 +1655,15 @@ _cairo_ps_surface_finish (void *abstract_surface)
     if (unlikely (status))
 	goto CLEANUP;
 
+    if (surface->shared_surfaces_stream != NULL) {
+	_cairo_memory_stream_copy (surface->shared_surfaces_stream,
+				   surface->final_stream);
+	status = _cairo_output_stream_destroy (surface->shared_surfaces_stream);
+	surface->shared_surfaces_stream = NULL;
+	if (unlikely (status))
+	    goto CLEANUP;
+    }
+
     _cairo_output_stream_printf (surface->final_stream,
 				 "%%%%EndSetup\n");
 
@@ -1623,6 +1676,18 @@ _cairo_ps_surface_finish (void *abstract_surface)
 CLEANUP:
     _cairo_scaled_font_subsets_destroy (surface->font_subsets);
 
+    if (surface->shared_surfaces_stream != NULL) {
+	status2 = _cairo_output_stream_destroy (surface->shared_surfaces_stream);
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = status2;
+    }
+    if (surface->shared_surfaces != NULL) {
+	_cairo_hash_table_foreach (surface->shared_surfaces,
+				   _cairo_ps_shared_surface_pluck,
+				   surface->shared_surfaces);
+	_cairo_hash_table_destroy (surface->shared_surfaces);
+    }
+
     status2 = _cairo_output_stream_destroy (surface->stream);
     if (status == CAIRO_STATUS_SUCCESS)
 	status = status2;
@@ -3132,13 +3197,13 @@ _cairo_ps_surface_emit_solid_pattern (cairo_ps_surface_t    *surface,
 }
 
 static cairo_status_t
-_cairo_ps_surface_emit_surface (cairo_ps_surface_t      *surface,
-				cairo_pattern_t         *source_pattern,
-				cairo_surface_t         *source_surface,
-				cairo_operator_t	 op,
-				int                      width,
-				int                      height,
-				cairo_bool_t             stencil_mask)
+_cairo_ps_surface_emit_surface_inline (cairo_ps_surface_t      *surface,
+				       cairo_pattern_t         *source_pattern,
+				       cairo_surface_t         *source_surface,
+				       cairo_operator_t		op,
+				       int                      width,
+				       int                      height,
+				       cairo_bool_t             stencil_mask)
 {
     cairo_int_status_t status;
 
@@ -3169,6 +3234,164 @@ _cairo_ps_surface_emit_surface (cairo_ps_surface_t      *surface,
     return status;
 }
 
+static cairo_bool_t
+_cairo_ps_shared_surface_equal (const void *key_a, const void *key_b)
+{
+    const cairo_ps_shared_surface_t *a = key_a;
+    const cairo_ps_shared_surface_t *b = key_b;
+
+    return memcmp (&a->digest, &b->digest, sizeof (a->digest)) == 0 &&
+	a->op == b->op &&
+	a->filter == b->filter &&
+	a->pad == b->pad &&
+	a->stencil_mask == b->stencil_mask &&
+	a->width == b->width &&
+	a->height == b->height;
+}
+
+/* Paints a source through the procedure shared by all sources of the
+ * same content, writing that procedure into the setup section the
+ * first time. The procedure reads its data from strings, as the
+ * PaintProc of a pattern does, so that it can run any number of
+ * times. Each procedure is built in a stream of its own, so that
+ * those of the sources nested within it are complete, and defined,
+ * before it. */
+static cairo_int_status_t
+_cairo_ps_surface_emit_shared_surface (cairo_ps_surface_t      *surface,
+				       cairo_pattern_t         *source_pattern,
+				       cairo_surface_t         *source_surface,
+				       cairo_operator_t		op,
+				       int                      width,
+				       int                      height,
+				       cairo_bool_t             stencil_mask)
+{
+    cairo_ps_shared_surface_t key, *shared;
+    cairo_output_stream_t *old_stream, *procedure;
+    cairo_bool_t old_use_string_datasource;
+    cairo_int_status_t status, status2;
+
+    status = _cairo_surface_get_content_digest (source_surface, &key.digest);
+    if (unlikely (status))
+	return status;
+
+    key.op = op;
+    key.filter = source_pattern->filter;
+    key.pad = source_pattern->extend == CAIRO_EXTEND_PAD;
+    key.stencil_mask = stencil_mask;
+    key.width = width;
+    key.height = height;
+    key.base.hash = key.digest.h[0];
+
+    if (surface->shared_surfaces == NULL) {
+	surface->shared_surfaces =
+	    _cairo_hash_table_create (_cairo_ps_shared_surface_equal);
+	if (unlikely (surface->shared_surfaces == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    shared = _cairo_hash_table_lookup (surface->shared_surfaces, &key.base);
+    if (shared == NULL) {
+	if (surface->shared_surfaces_stream == NULL) {
+	    surface->shared_surfaces_stream = _cairo_memory_stream_create ();
+	    status = _cairo_output_stream_get_status (surface->shared_surfaces_stream);
+	    if (unlikely (status))
+		return status;
+	}
+
+	shared = malloc (sizeof (cairo_ps_shared_surface_t));
+	if (unlikely (shared == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+	*shared = key;
+	shared->id = surface->num_shared_surfaces++;
+
+	status = _cairo_pdf_operators_flush (&surface->pdf_operators);
+	if (unlikely (status)) {
+	    free (shared);
+	    return status;
+	}
+
+	procedure = _cairo_memory_stream_create ();
+	old_stream = surface->stream;
+	old_use_string_datasource = surface->use_string_datasource;
+	surface->stream = procedure;
+	surface->use_string_datasource = TRUE;
+	_cairo_pdf_operators_set_stream (&surface->pdf_operators, surface->stream);
+
+	_cairo_output_stream_printf (surface->stream,
+				     "/cairo_surface_%d {\n",
+				     shared->id);
+	status = _cairo_ps_surface_emit_surface_inline (surface,
+							source_pattern,
+							source_surface,
+							op,
+							width, height,
+							stencil_mask);
+	status2 = _cairo_pdf_operators_flush (&surface->pdf_operators);
+	if (status == CAIRO_INT_STATUS_SUCCESS)
+	    status = status2;
+	_cairo_output_stream_printf (surface->stream,
+				     "} bind def\n");
+
+	surface->stream = old_stream;
+	surface->use_string_datasource = old_use_string_datasource;
+	_cairo_pdf_operators_set_stream (&surface->pdf_operators, surface->stream);
+
+	if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	    _cairo_memory_stream_copy (procedure, surface->shared_surfaces_stream);
+	status2 = _cairo_output_stream_destroy (procedure);
+	if (status == CAIRO_INT_STATUS_SUCCESS)
+	    status = status2;
+	if (unlikely (status)) {
+	    free (shared);
+	    return status;
+	}
+
+	status = _cairo_hash_table_insert (surface->shared_surfaces,
+					   &shared->base);
+	if (unlikely (status)) {
+	    free (shared);
+	    return status;
+	}
+    }
+
+    _cairo_output_stream_printf (surface->stream,
+				 "cairo_surface_%d\n",
+				 shared->id);
+
+    return CAIRO_INT_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_ps_surface_emit_surface (cairo_ps_surface_t      *surface,
+				cairo_pattern_t         *source_pattern,
+				cairo_surface_t         *source_surface,
+				cairo_operator_t	 op,
+				int                      width,
+				int                      height,
+				cairo_bool_t             stencil_mask)
+{
+    cairo_int_status_t status;
+
+    if (surface->deduplicate_content) {
+	status = _cairo_ps_surface_emit_shared_surface (surface,
+							source_pattern,
+							source_surface,
+							op,
+							width, height,
+							stencil_mask);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
+    }
+
+    return _cairo_ps_surface_emit_surface_inline (surface,
+						  source_pattern,
+						  source_surface,
+						  op,
+						  width, height,
+						  stencil_mask);
+}
+
 
 static void
 _path_fixed_init_rectangle (cairo_path_fixed_t *path,
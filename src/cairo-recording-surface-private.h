@@ -65,7 +65,6 @@ typedef struct _cairo_command_header {
     cairo_clip_t		*clip;
 
     int index;
-    struct _cairo_command_header *chain;
 } cairo_command_header_t;
 
 typedef struct _cairo_command_paint {
@@ -122,6 +121,10 @@ typedef union _cairo_command {
     cairo_command_show_text_glyphs_t		show_text_glyphs;
 } cairo_command_t;
 
+#define CAIRO_RECORDING_RTREE_MAX_LEVELS 9
+
+typedef struct _cairo_recording_mapping cairo_recording_mapping_t;
+
 typedef struct _cairo_recording_surface {
     cairo_surface_t base;
 
@@ -138,16 +141,57 @@ typedef struct _cairo_recording_surface {
     cairo_bool_t optimize_clears;
     cairo_bool_t has_bilevel_alpha;
     cairo_bool_t has_only_op_over;
-
-    struct bbtree {
-	cairo_box_t extents;
-	struct bbtree *left, *right;
-	cairo_command_header_t *chain;
-    } bbtree;
+    /* Whether every command only reads state that several threads may
+     * share while replaying it, kept up to date as commands are added */
+    cairo_bool_t thread_safe;
+
+    /* Packed R-tree over the commands, built when first needed */
+    struct _cairo_recording_rtree {
+	cairo_bool_t valid;
+	unsigned int *entries;
+	unsigned int num_entries;
+	cairo_box_t *boxes;
+	unsigned int level_start[CAIRO_RECORDING_RTREE_MAX_LEVELS];
+	unsigned int level_count[CAIRO_RECORDING_RTREE_MAX_LEVELS];
+	unsigned int num_levels;
+    } rtree;
+
+    /* The commands hidden by later opaque ones, found when first needed
+     * if cull_hidden_commands */
+    cairo_bool_t cull_hidden_commands;
+    struct _cairo_recording_occlusion {
+	cairo_bool_t valid;
+	unsigned char *hidden;
+	unsigned int num_hidden;
+    } occlusion;
+
+    /* The commands to replay, with runs of similar fills and strokes
+     * merged into one, found when first needed if coalesce_commands */
+    cairo_bool_t coalesce_commands;
+    struct _cairo_recording_coalesced {
+	cairo_bool_t valid;
+	cairo_command_t **commands;
+	unsigned int *indices;
+	unsigned int num_commands;
+	cairo_command_t **merged;
+	unsigned int num_merged;
+    } coalesced;
+
+    /* The image kept by cairo_recording_surface_get_image(); the
+     * damage of the base surface records where it is out of date */
+    cairo_surface_t *rendering;
+
+    /* The leading commands of a surface loaded from a file point into
+     * the file, and are released along with it. */
+    cairo_recording_mapping_t *mapping;
+    unsigned int num_mapped;
 } cairo_recording_surface_t;
 
 slim_hidden_proto (cairo_recording_surface_create);
 
+cairo_private void
+_cairo_recording_mapping_destroy (cairo_recording_mapping_t *mapping);
+
 cairo_private cairo_int_status_t
 _cairo_recording_surface_get_path (cairo_surface_t	 *surface,
 				   cairo_path_fixed_t *path);
@@ -186,10 +230,20 @@ _cairo_recording_surface_get_ink_bbox (cairo_recording_surface_t *surface,
 				       cairo_box_t *bbox,
 				       const cairo_matrix_t *transform);
 
+cairo_private cairo_bool_t
+_cairo_recording_command_is_thread_safe (const cairo_command_t *command);
+
 cairo_private cairo_bool_t
 _cairo_recording_surface_has_only_bilevel_alpha (cairo_recording_surface_t *surface);
 
 cairo_private cairo_bool_t
 _cairo_recording_surface_has_only_op_over (cairo_recording_surface_t *surface);
 
+cairo_private void
+_cairo_recording_surface_get_cull_stats (unsigned long *replayed,
+					 unsigned long *culled);
+
+cairo_private void
+_cairo_recording_surface_reset_static_data (void);
+
 #endif /* CAIRO_RECORDING_SURFACE_H */
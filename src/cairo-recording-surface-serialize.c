@@ -0,0 +1,2772 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is agent.
+ *
+ * Contributor(s):
+ *	agent <agent@local>
+ */
+
+/* A compact binary form of a recording surface.
+ *
+ * The file is a header followed by position independent records,
+ * all addressed by their byte offset from the start of the file and
+ * aligned to 8 bytes. Variable sized data (path operations and
+ * points, gradient stops, mesh patches, dashes, glyphs, text and
+ * pixels) is stored in exactly the layout cairo uses in memory, so
+ * that a loaded recording can point straight into the file rather
+ * than copying it.
+ *
+ * Source surfaces, clips and fonts are shared between commands and
+ * kept in three tables. Nested recording surfaces are written before
+ * any surface that refers to them, so the surface table can be loaded
+ * front to back. Fonts are reduced to the outlines (or, failing that,
+ * the images) of the glyphs actually used, and are loaded back as user
+ * fonts; clips are rebuilt from their boxes and paths.
+ *
+ * The loader reads the whole file into memory and places every command
+ * of a recording in a single block, with the commands' patterns, glyphs
+ * and all but the first few segments of their paths referring to the
+ * loaded data. Nothing is allocated per command, so the cost of loading
+ * is dominated by validating the offsets and path operations.
+ *
+ * The format is versioned and native-endian: the header records the
+ * byte order and the size of the structures shared with the file, and
+ * a loader rejects anything that does not match exactly.
+ */
+
+#include "cairoint.h"
+
+#include "cairo-array-private.h"
+#include "cairo-boxes-private.h"
+#include "cairo-clip-inline.h"
+#include "cairo-combsort-inline.h"
+#include "cairo-error-private.h"
+#include "cairo-image-surface-private.h"
+#include "cairo-list-inline.h"
+#include "cairo-recording-surface-inline.h"
+#include "cairo-scaled-font-private.h"
+#include "cairo-surface-snapshot-inline.h"
+
+#include <errno.h>
+
+#if _XOPEN_SOURCE >= 600 || defined (_ISOC99_SOURCE)
+#define ISFINITE(x) isfinite (x)
+#else
+#define ISFINITE(x) ((x) * (x) >= 0.) /* check for NaNs */
+#endif
+
+#define CAIRO_RECORDING_FILE_MAGIC "CAIROREC"
+#define CAIRO_RECORDING_FILE_VERSION 1
+#define CAIRO_RECORDING_FILE_BYTE_ORDER 0x01020304
+#define CAIRO_RECORDING_FILE_ALIGN 8
+
+#define CAIRO_RECORDING_NO_CLIP -1
+#define CAIRO_RECORDING_ALL_CLIPPED -2
+
+enum {
+    CAIRO_RECORDING_SURFACE_IMAGE,
+    CAIRO_RECORDING_SURFACE_RECORDING
+};
+
+enum {
+    CAIRO_RECORDING_GLYPH_EMPTY,
+    CAIRO_RECORDING_GLYPH_PATH,
+    CAIRO_RECORDING_GLYPH_IMAGE
+};
+
+enum {
+    CAIRO_RECORDING_PATH_HAS_CURRENT_POINT	= 1 << 0,
+    CAIRO_RECORDING_PATH_NEEDS_MOVE_TO		= 1 << 1,
+    CAIRO_RECORDING_PATH_HAS_EXTENTS		= 1 << 2,
+    CAIRO_RECORDING_PATH_HAS_CURVE_TO		= 1 << 3,
+    CAIRO_RECORDING_PATH_STROKE_IS_RECTILINEAR	= 1 << 4,
+    CAIRO_RECORDING_PATH_FILL_IS_RECTILINEAR	= 1 << 5,
+    CAIRO_RECORDING_PATH_FILL_MAYBE_REGION	= 1 << 6,
+    CAIRO_RECORDING_PATH_FILL_IS_EMPTY		= 1 << 7
+};
+
+/* All records keep their 64-bit members naturally aligned so that the
+ * layout does not depend upon the ABI's alignment of doubles. */
+
+typedef struct _cairo_recording_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t stop_size;
+    uint32_t patch_size;
+    uint32_t glyph_size;
+    uint32_t num_surfaces;
+    uint32_t num_fonts;
+    uint32_t num_clips;
+    uint64_t length;
+    uint64_t surfaces;
+    uint64_t fonts;
+    uint64_t clips;
+    uint64_t root;
+} cairo_recording_file_header_t;
+
+typedef struct _cairo_recording_record {
+    uint32_t content;
+    uint32_t unbounded;
+    uint32_t is_clear;
+    uint32_t num_commands;
+    double extents[4];
+    double device_transform[4];
+    uint64_t commands;
+} cairo_recording_record_t;
+
+typedef struct _cairo_recording_surface_record {
+    uint32_t kind;
+    uint32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    uint32_t reserved;
+    double device_transform[4];
+    uint64_t data;
+} cairo_recording_surface_record_t;
+
+typedef struct _cairo_recording_path_record {
+    uint32_t flags;
+    uint32_t num_ops;
+    uint32_t num_points;
+    int32_t last_move_point[2];
+    int32_t current_point[2];
+    int32_t extents[4];
+    uint32_t reserved;
+    uint64_t ops;
+    uint64_t points;
+} cairo_recording_path_record_t;
+
+typedef struct _cairo_recording_pattern_record {
+    uint32_t type;
+    uint32_t filter;
+    uint32_t extend;
+    uint32_t has_component_alpha;
+    double matrix[6];
+    double opacity;
+    double params[6];
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t data;
+} cairo_recording_pattern_record_t;
+
+typedef struct _cairo_recording_command_record {
+    uint32_t type;
+    uint32_t op;
+    int32_t extents[4];
+    int32_t clip;
+    uint32_t reserved;
+    cairo_recording_pattern_record_t source;
+} cairo_recording_command_record_t;
+
+typedef struct _cairo_recording_mask_record {
+    cairo_recording_command_record_t command;
+    cairo_recording_pattern_record_t mask;
+} cairo_recording_mask_record_t;
+
+typedef struct _cairo_recording_stroke_record {
+    cairo_recording_command_record_t command;
+    cairo_recording_path_record_t path;
+    double line_width;
+    double miter_limit;
+    double dash_offset;
+    double tolerance;
+    double ctm[6];
+    double ctm_inverse[6];
+    uint32_t line_cap;
+    uint32_t line_join;
+    uint32_t num_dashes;
+    uint32_t antialias;
+    uint64_t dashes;
+} cairo_recording_stroke_record_t;
+
+typedef struct _cairo_recording_fill_record {
+    cairo_recording_command_record_t command;
+    cairo_recording_path_record_t path;
+    double tolerance;
+    uint32_t fill_rule;
+    uint32_t antialias;
+} cairo_recording_fill_record_t;
+
+typedef struct _cairo_recording_glyphs_record {
+    cairo_recording_command_record_t command;
+    uint32_t font;
+    uint32_t num_glyphs;
+    uint32_t utf8_len;
+    uint32_t num_clusters;
+    uint32_t cluster_flags;
+    uint32_t reserved;
+    uint64_t glyphs;
+    uint64_t utf8;
+    uint64_t clusters;
+} cairo_recording_glyphs_record_t;
+
+typedef struct _cairo_recording_clip_record {
+    int32_t extents[4];
+    uint32_t is_region;
+    uint32_t num_boxes;
+    uint32_t num_paths;
+    uint32_t reserved;
+    uint64_t boxes;
+    uint64_t paths;
+} cairo_recording_clip_record_t;
+
+typedef struct _cairo_recording_clip_path_record {
+    cairo_recording_path_record_t path;
+    double tolerance;
+    uint32_t fill_rule;
+    uint32_t antialias;
+} cairo_recording_clip_path_record_t;
+
+typedef struct _cairo_recording_font_record {
+    double font_matrix[6];
+    double ctm[6];
+    double extents[5];
+    uint32_t antialias;
+    uint32_t subpixel_order;
+    uint32_t lcd_filter;
+    uint32_t hint_style;
+    uint32_t hint_metrics;
+    uint32_t round_glyph_positions;
+    uint32_t num_glyphs;
+    uint32_t reserved;
+    uint64_t glyphs;
+} cairo_recording_font_record_t;
+
+typedef struct _cairo_recording_glyph_record {
+    uint64_t index;
+    double metrics[6];
+    uint32_t kind;
+    uint32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    uint32_t reserved;
+    double device_offset[2];
+    cairo_recording_path_record_t path;
+    uint64_t data;
+} cairo_recording_glyph_record_t;
+
+typedef union _cairo_recording_any_command_record {
+    cairo_recording_command_record_t paint;
+    cairo_recording_mask_record_t mask;
+    cairo_recording_stroke_record_t stroke;
+    cairo_recording_fill_record_t fill;
+    cairo_recording_glyphs_record_t glyphs;
+} cairo_recording_any_command_record_t;
+
+static void
+_cairo_recording_matrix_to_doubles (const cairo_matrix_t *matrix, double *v)
+{
+    v[0] = matrix->xx; v[1] = matrix->yx;
+    v[2] = matrix->xy; v[3] = matrix->yy;
+    v[4] = matrix->x0; v[5] = matrix->y0;
+}
+
+static void
+_cairo_recording_matrix_from_doubles (cairo_matrix_t *matrix, const double *v)
+{
+    cairo_matrix_init (matrix, v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
+static void
+_cairo_recording_device_transform_to_doubles (const cairo_surface_t *surface,
+					      double *v)
+{
+    v[0] = surface->device_transform.xx;
+    v[1] = surface->device_transform.yy;
+    v[2] = surface->device_transform.x0;
+    v[3] = surface->device_transform.y0;
+}
+
+static void
+_cairo_recording_device_transform_from_doubles (cairo_surface_t *surface,
+						const double *v)
+{
+    if (v[0] != 1. || v[1] != 1.)
+	cairo_surface_set_device_scale (surface, v[0], v[1]);
+    if (v[2] != 0. || v[3] != 0.)
+	cairo_surface_set_device_offset (surface, v[2], v[3]);
+}
+
+/* Writer */
+
+typedef struct _cairo_recording_writer_surface {
+    cairo_hash_entry_t base;
+    uint32_t index;
+} cairo_recording_writer_surface_t;
+
+typedef struct _cairo_recording_writer_font {
+    cairo_scaled_font_t *scaled_font;
+    cairo_array_t glyphs;
+} cairo_recording_writer_font_t;
+
+typedef struct _cairo_recording_writer {
+    cairo_array_t data;
+
+    cairo_hash_table_t *surface_ids;
+    cairo_array_t surfaces;
+
+    cairo_array_t clips;
+    const cairo_clip_t *last_clip;
+    int32_t last_clip_index;
+
+    cairo_array_t fonts;
+} cairo_recording_writer_t;
+
+static cairo_status_t
+_cairo_recording_writer_write_recording (cairo_recording_writer_t  *writer,
+					 cairo_recording_surface_t *recording,
+					 uint64_t		   *offset);
+
+static cairo_bool_t
+_cairo_recording_writer_surface_equal (const void *key_a, const void *key_b)
+{
+    const cairo_recording_writer_surface_t *a = key_a;
+    const cairo_recording_writer_surface_t *b = key_b;
+
+    return a->base.hash == b->base.hash;
+}
+
+static cairo_status_t
+_cairo_recording_writer_init (cairo_recording_writer_t *writer)
+{
+    _cairo_array_init (&writer->data, 1);
+    _cairo_array_init (&writer->surfaces, sizeof (uint64_t));
+    _cairo_array_init (&writer->clips, sizeof (uint64_t));
+    _cairo_array_init (&writer->fonts, sizeof (cairo_recording_writer_font_t));
+
+    writer->last_clip = NULL;
+    writer->last_clip_index = CAIRO_RECORDING_NO_CLIP;
+
+    writer->surface_ids =
+	_cairo_hash_table_create (_cairo_recording_writer_surface_equal);
+    if (unlikely (writer->surface_ids == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_recording_writer_pluck_surface (void *entry, void *closure)
+{
+    _cairo_hash_table_remove (closure, entry);
+    free (entry);
+}
+
+static void
+_cairo_recording_writer_fini (cairo_recording_writer_t *writer)
+{
+    cairo_recording_writer_font_t *fonts;
+    unsigned int n;
+
+    fonts = _cairo_array_index (&writer->fonts, 0);
+    for (n = 0; n < writer->fonts.num_elements; n++) {
+	cairo_scaled_font_destroy (fonts[n].scaled_font);
+	_cairo_array_fini (&fonts[n].glyphs);
+    }
+    _cairo_array_fini (&writer->fonts);
+
+    if (writer->surface_ids != NULL) {
+	_cairo_hash_table_foreach (writer->surface_ids,
+				   _cairo_recording_writer_pluck_surface,
+				   writer->surface_ids);
+	_cairo_hash_table_destroy (writer->surface_ids);
+    }
+
+    _cairo_array_fini (&writer->clips);
+    _cairo_array_fini (&writer->surfaces);
+    _cairo_array_fini (&writer->data);
+}
+
+/* Append @length bytes, aligned, and return where they were placed */
+static cairo_status_t
+_cairo_recording_writer_append (cairo_recording_writer_t *writer,
+				const void		 *data,
+				size_t			  length,
+				uint64_t		 *offset)
+{
+    static const char zero[CAIRO_RECORDING_FILE_ALIGN];
+    unsigned int pad;
+    cairo_status_t status;
+
+    pad = -writer->data.num_elements & (CAIRO_RECORDING_FILE_ALIGN - 1);
+    status = _cairo_array_append_multiple (&writer->data, zero, pad);
+    if (unlikely (status))
+	return status;
+
+    if (unlikely (length > UINT_MAX - writer->data.num_elements))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    *offset = writer->data.num_elements;
+    if (length == 0)
+	return CAIRO_STATUS_SUCCESS;
+
+    return _cairo_array_append_multiple (&writer->data, data, length);
+}
+
+static cairo_status_t
+_cairo_recording_writer_write_path (cairo_recording_writer_t	  *writer,
+				    const cairo_path_fixed_t	  *path,
+				    cairo_recording_path_record_t *record)
+{
+    const cairo_path_buf_t *buf;
+    cairo_status_t status;
+
+    memset (record, 0, sizeof (*record));
+
+    record->flags =
+	(path->has_current_point ? CAIRO_RECORDING_PATH_HAS_CURRENT_POINT : 0) |
+	(path->needs_move_to ? CAIRO_RECORDING_PATH_NEEDS_MOVE_TO : 0) |
+	(path->has_extents ? CAIRO_RECORDING_PATH_HAS_EXTENTS : 0) |
+	(path->has_curve_to ? CAIRO_RECORDING_PATH_HAS_CURVE_TO : 0) |
+	(path->stroke_is_rectilinear ? CAIRO_RECORDING_PATH_STROKE_IS_RECTILINEAR : 0) |
+	(path->fill_is_rectilinear ? CAIRO_RECORDING_PATH_FILL_IS_RECTILINEAR : 0) |
+	(path->fill_maybe_region ? CAIRO_RECORDING_PATH_FILL_MAYBE_REGION : 0) |
+	(path->fill_is_empty ? CAIRO_RECORDING_PATH_FILL_IS_EMPTY : 0);
+    record->last_move_point[0] = path->last_move_point.x;
+    record->last_move_point[1] = path->last_move_point.y;
+    record->current_point[0] = path->current_point.x;
+    record->current_point[1] = path->current_point.y;
+    record->extents[0] = path->extents.p1.x;
+    record->extents[1] = path->extents.p1.y;
+    record->extents[2] = path->extents.p2.x;
+    record->extents[3] = path->extents.p2.y;
+
+    /* Concatenate the buffers so that the loaded path is a single one */
+    status = _cairo_recording_writer_append (writer, NULL, 0, &record->ops);
+    cairo_path_foreach_buf_start (buf, path) {
+	if (unlikely (status))
+	    return status;
+	status = _cairo_array_append_multiple (&writer->data,
+					       buf->op, buf->num_ops);
+	record->num_ops += buf->num_ops;
+    } cairo_path_foreach_buf_end (buf, path);
+
+    status = _cairo_recording_writer_append (writer, NULL, 0, &record->points);
+    cairo_path_foreach_buf_start (buf, path) {
+	if (unlikely (status))
+	    return status;
+	status = _cairo_array_append_multiple (&writer->data,
+					       buf->points,
+					       buf->num_points * sizeof (cairo_point_t));
+	record->num_points += buf->num_points;
+    } cairo_path_foreach_buf_end (buf, path);
+
+    return status;
+}
+
+static cairo_status_t
+_cairo_recording_writer_add_surface (cairo_recording_writer_t *writer,
+				     cairo_surface_t	      *source,
+				     uint32_t		      *index)
+{
+    cairo_recording_writer_surface_t key, *entry;
+    cairo_recording_surface_record_t record;
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    uint64_t offset;
+
+    if (_cairo_surface_is_snapshot (source))
+	surface = _cairo_surface_snapshot_get_target (source);
+    else
+	surface = cairo_surface_reference (source);
+
+    key.base.hash = surface->unique_id;
+    entry = _cairo_hash_table_lookup (writer->surface_ids, &key.base);
+    if (entry != NULL) {
+	*index = entry->index;
+	cairo_surface_destroy (surface);
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    memset (&record, 0, sizeof (record));
+    _cairo_recording_device_transform_to_doubles (surface,
+						  record.device_transform);
+
+    if (_cairo_surface_is_recording (surface)) {
+	record.kind = CAIRO_RECORDING_SURFACE_RECORDING;
+	status = _cairo_recording_writer_write_recording (writer,
+							  (cairo_recording_surface_t *) surface,
+							  &record.data);
+    } else {
+	cairo_image_surface_t *image, *clone;
+	void *image_extra;
+
+	status = _cairo_surface_acquire_source_image (surface,
+						      &image, &image_extra);
+	if (unlikely (status))
+	    goto BAIL;
+
+	clone = image;
+	if (image->format == CAIRO_FORMAT_INVALID)
+	    clone = _cairo_image_surface_coerce (image);
+	status = clone->base.status;
+	if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	    record.kind = CAIRO_RECORDING_SURFACE_IMAGE;
+	    record.format = clone->format;
+	    record.width = clone->width;
+	    record.height = clone->height;
+	    record.stride = clone->stride;
+	    status = _cairo_recording_writer_append (writer, clone->data,
+						     (size_t) clone->stride * clone->height,
+						     &record.data);
+	}
+
+	if (clone != image)
+	    cairo_surface_destroy (&clone->base);
+	_cairo_surface_release_source_image (surface, image, image_extra);
+    }
+    if (unlikely (status))
+	goto BAIL;
+
+    status = _cairo_recording_writer_append (writer,
+					     &record, sizeof (record),
+					     &offset);
+    if (unlikely (status))
+	goto BAIL;
+
+    entry = malloc (sizeof (cairo_recording_writer_surface_t));
+    if (unlikely (entry == NULL)) {
+	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	goto BAIL;
+    }
+
+    entry->base.hash = surface->unique_id;
+    entry->index = writer->surfaces.num_elements;
+    status = _cairo_hash_table_insert (writer->surface_ids, &entry->base);
+    if (unlikely (status)) {
+	free (entry);
+	goto BAIL;
+    }
+
+    *index = entry->index;
+    status = _cairo_array_append (&writer->surfaces, &offset);
+
+BAIL:
+    cairo_surface_destroy (surface);
+    return status;
+}
+
+static cairo_status_t
+_cairo_recording_writer_write_pattern (cairo_recording_writer_t		*writer,
+				       const cairo_pattern_t		*pattern,
+				       cairo_recording_pattern_record_t *record)
+{
+    memset (record, 0, sizeof (*record));
+
+    record->type = pattern->type;
+    record->filter = pattern->filter;
+    record->extend = pattern->extend;
+    record->has_component_alpha = pattern->has_component_alpha;
+    _cairo_recording_matrix_to_doubles (&pattern->matrix, record->matrix);
+    record->opacity = pattern->opacity;
+
+    switch (pattern->type) {
+    case CAIRO_PATTERN_TYPE_SOLID: {
+	const cairo_color_t *color = &((cairo_solid_pattern_t *) pattern)->color;
+
+	record->params[0] = color->red;
+	record->params[1] = color->green;
+	record->params[2] = color->blue;
+	record->params[3] = color->alpha;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    case CAIRO_PATTERN_TYPE_SURFACE:
+	return _cairo_recording_writer_add_surface (writer,
+						    ((cairo_surface_pattern_t *) pattern)->surface,
+						    &record->count);
+
+    case CAIRO_PATTERN_TYPE_LINEAR:
+    case CAIRO_PATTERN_TYPE_RADIAL: {
+	const cairo_gradient_pattern_t *gradient =
+	    (const cairo_gradient_pattern_t *) pattern;
+
+	if (pattern->type == CAIRO_PATTERN_TYPE_LINEAR) {
+	    const cairo_linear_pattern_t *linear =
+		(const cairo_linear_pattern_t *) pattern;
+
+	    record->params[0] = linear->pd1.x;
+	    record->params[1] = linear->pd1.y;
+	    record->params[2] = linear->pd2.x;
+	    record->params[3] = linear->pd2.y;
+	} else {
+	    const cairo_radial_pattern_t *radial =
+		(const cairo_radial_pattern_t *) pattern;
+
+	    record->params[0] = radial->cd1.center.x;
+	    record->params[1] = radial->cd1.center.y;
+	    record->params[2] = radial->cd1.radius;
+	    record->params[3] = radial->cd2.center.x;
+	    record->params[4] = radial->cd2.center.y;
+	    record->params[5] = radial->cd2.radius;
+	}
+
+	record->count = gradient->n_stops;
+	return _cairo_recording_writer_append (writer, gradient->stops,
+					       gradient->n_stops * sizeof (cairo_gradient_stop_t),
+					       &record->data);
+    }
+
+    case CAIRO_PATTERN_TYPE_MESH: {
+	const cairo_mesh_pattern_t *mesh = (const cairo_mesh_pattern_t *) pattern;
+
+	record->count = mesh->patches.num_elements;
+	return _cairo_recording_writer_append (writer,
+					       _cairo_array_index_const (&mesh->patches, 0),
+					       record->count * sizeof (cairo_mesh_patch_t),
+					       &record->data);
+    }
+
+    default:
+    case CAIRO_PATTERN_TYPE_RASTER_SOURCE:
+	/* The callbacks cannot be stored */
+	return _cairo_error (CAIRO_STATUS_PATTERN_TYPE_MISMATCH);
+    }
+}
+
+static cairo_status_t
+_cairo_recording_writer_add_clip (cairo_recording_writer_t *writer,
+				  const cairo_clip_t	   *clip,
+				  int32_t		   *index)
+{
+    cairo_recording_clip_record_t record;
+    cairo_recording_clip_path_record_t *paths;
+    const cairo_clip_path_t *clip_path;
+    cairo_status_t status;
+    uint64_t offset;
+    int n;
+
+    if (clip == NULL) {
+	*index = CAIRO_RECORDING_NO_CLIP;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    if (_cairo_clip_is_all_clipped (clip)) {
+	*index = CAIRO_RECORDING_ALL_CLIPPED;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    /* Consecutive commands usually share the clip */
+    if (writer->last_clip != NULL && _cairo_clip_equal (clip, writer->last_clip)) {
+	*index = writer->last_clip_index;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    memset (&record, 0, sizeof (record));
+    record.extents[0] = clip->extents.x;
+    record.extents[1] = clip->extents.y;
+    record.extents[2] = clip->extents.width;
+    record.extents[3] = clip->extents.height;
+    record.is_region = clip->is_region;
+
+    record.num_boxes = clip->num_boxes;
+    status = _cairo_recording_writer_append (writer, clip->boxes,
+					     clip->num_boxes * sizeof (cairo_box_t),
+					     &record.boxes);
+    if (unlikely (status))
+	return status;
+
+    for (clip_path = clip->path; clip_path; clip_path = clip_path->prev)
+	record.num_paths++;
+
+    paths = NULL;
+    if (record.num_paths) {
+	paths = _cairo_malloc_ab (record.num_paths,
+				  sizeof (cairo_recording_clip_path_record_t));
+	if (unlikely (paths == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    /* Stored oldest first, the order in which they are reapplied */
+    n = record.num_paths;
+    for (clip_path = clip->path; clip_path; clip_path = clip_path->prev) {
+	cairo_recording_clip_path_record_t *p = &paths[--n];
+
+	status = _cairo_recording_writer_write_path (writer,
+						     &clip_path->path,
+						     &p->path);
+	if (unlikely (status))
+	    goto BAIL;
+
+	p->tolerance = clip_path->tolerance;
+	p->fill_rule = clip_path->fill_rule;
+	p->antialias = clip_path->antialias;
+    }
+
+    status = _cairo_recording_writer_append (writer, paths,
+					     record.num_paths * sizeof (cairo_recording_clip_path_record_t),
+					     &record.paths);
+    if (unlikely (status))
+	goto BAIL;
+
+    status = _cairo_recording_writer_append (writer,
+					     &record, sizeof (record),
+					     &offset);
+    if (unlikely (status))
+	goto BAIL;
+
+    *index = writer->clips.num_elements;
+    status = _cairo_array_append (&writer->clips, &offset);
+    if (unlikely (status))
+	goto BAIL;
+
+    writer->last_clip = clip;
+    writer->last_clip_index = *index;
+
+BAIL:
+    free (paths);
+    return status;
+}
+
+static cairo_status_t
+_cairo_recording_writer_add_font (cairo_recording_writer_t *writer,
+				  cairo_scaled_font_t	   *scaled_font,
+				  const cairo_glyph_t	   *glyphs,
+				  int			    num_glyphs,
+				  uint32_t		   *index)
+{
+    cairo_recording_writer_font_t *fonts, *font;
+    cairo_status_t status;
+    unsigned int n;
+    int i;
+
+    font = NULL;
+    fonts = _cairo_array_index (&writer->fonts, 0);
+    for (n = 0; n < writer->fonts.num_elements; n++) {
+	if (fonts[n].scaled_font == scaled_font) {
+	    font = &fonts[n];
+	    break;
+	}
+    }
+
+    if (font == NULL) {
+	cairo_recording_writer_font_t new_font;
+
+	new_font.scaled_font = cairo_scaled_font_reference (scaled_font);
+	_cairo_array_init (&new_font.glyphs, sizeof (unsigned long));
+	status = _cairo_array_append (&writer->fonts, &new_font);
+	if (unlikely (status)) {
+	    cairo_scaled_font_destroy (scaled_font);
+	    return status;
+	}
+
+	font = _cairo_array_index (&writer->fonts, n);
+    }
+
+    *index = n;
+
+    status = _cairo_array_grow_by (&font->glyphs, num_glyphs);
+    if (unlikely (status))
+	return status;
+
+    for (i = 0; i < num_glyphs; i++) {
+	unsigned long glyph = glyphs[i].index;
+
+	status = _cairo_array_append (&font->glyphs, &glyph);
+	if (unlikely (status))
+	    return status;
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static int
+_cairo_recording_glyph_index_cmp (unsigned long a, unsigned long b)
+{
+    return a < b ? -1 : a > b;
+}
+
+CAIRO_COMBSORT_DECLARE (_cairo_recording_glyphs_sort,
+			unsigned long,
+			_cairo_recording_glyph_index_cmp)
+
+static cairo_status_t
+_cairo_recording_writer_write_glyph (cairo_recording_writer_t	    *writer,
+				     cairo_scaled_font_t	    *scaled_font,
+				     unsigned long		     index,
+				     cairo_recording_glyph_record_t *record)
+{
+    cairo_scaled_glyph_t *scaled_glyph;
+    cairo_int_status_t status;
+
+    memset (record, 0, sizeof (*record));
+    record->index = index;
+    record->kind = CAIRO_RECORDING_GLYPH_EMPTY;
+
+    status = _cairo_scaled_glyph_lookup (scaled_font, index,
+					 CAIRO_SCALED_GLYPH_INFO_METRICS |
+					 CAIRO_SCALED_GLYPH_INFO_PATH,
+					 &scaled_glyph);
+    if (status == CAIRO_INT_STATUS_UNSUPPORTED) {
+	/* A bitmap font, keep the image of the glyph instead */
+	status = _cairo_scaled_glyph_lookup (scaled_font, index,
+					     CAIRO_SCALED_GLYPH_INFO_METRICS |
+					     CAIRO_SCALED_GLYPH_INFO_SURFACE,
+					     &scaled_glyph);
+    }
+    if (unlikely (status))
+	return (cairo_status_t) status;
+
+    record->metrics[0] = scaled_glyph->fs_metrics.x_bearing;
+    record->metrics[1] = scaled_glyph->fs_metrics.y_bearing;
+    record->metrics[2] = scaled_glyph->fs_metrics.width;
+    record->metrics[3] = scaled_glyph->fs_metrics.height;
+    record->metrics[4] = scaled_glyph->fs_metrics.x_advance;
+    record->metrics[5] = scaled_glyph->fs_metrics.y_advance;
+
+    if (scaled_glyph->has_info & CAIRO_SCALED_GLYPH_INFO_PATH) {
+	record->kind = CAIRO_RECORDING_GLYPH_PATH;
+	return _cairo_recording_writer_write_path (writer,
+						   scaled_glyph->path,
+						   &record->path);
+    } else {
+	cairo_image_surface_t *image = scaled_glyph->surface;
+
+	record->kind = CAIRO_RECORDING_GLYPH_IMAGE;
+	record->format = image->format;
+	record->width = image->width;
+	record->height = image->height;
+	record->stride = image->stride;
+	record->device_offset[0] = image->base.device_transform.x0;
+	record->device_offset[1] = image->base.device_transform.y0;
+	return _cairo_recording_writer_append (writer, image->data,
+					       (size_t) image->stride * image->height,
+					       &record->data);
+    }
+}
+
+static cairo_status_t
+_cairo_recording_writer_write_font (cairo_recording_writer_t	  *writer,
+				    cairo_recording_writer_font_t *font,
+				    uint64_t			  *offset)
+{
+    cairo_scaled_font_t *scaled_font = font->scaled_font;
+    cairo_recording_font_record_t record;
+    cairo_array_t glyph_records;
+    unsigned long *glyphs;
+    unsigned int n, num_glyphs;
+    cairo_status_t status;
+
+    /* Each glyph used is stored once, in order of index */
+    glyphs = _cairo_array_index (&font->glyphs, 0);
+    num_glyphs = font->glyphs.num_elements;
+    if (num_glyphs > 1) {
+	_cairo_recording_glyphs_sort (glyphs, num_glyphs);
+
+	for (n = 1, num_glyphs = 1; n < font->glyphs.num_elements; n++) {
+	    if (glyphs[n] != glyphs[num_glyphs - 1])
+		glyphs[num_glyphs++] = glyphs[n];
+	}
+    }
+
+    memset (&record, 0, sizeof (record));
+    _cairo_recording_matrix_to_doubles (&scaled_font->font_matrix,
+					record.font_matrix);
+    _cairo_recording_matrix_to_doubles (&scaled_font->ctm, record.ctm);
+    record.extents[0] = scaled_font->fs_extents.ascent;
+    record.extents[1] = scaled_font->fs_extents.descent;
+    record.extents[2] = scaled_font->fs_extents.height;
+    record.extents[3] = scaled_font->fs_extents.max_x_advance;
+    record.extents[4] = scaled_font->fs_extents.max_y_advance;
+    record.antialias = scaled_font->options.antialias;
+    record.subpixel_order = scaled_font->options.subpixel_order;
+    record.lcd_filter = scaled_font->options.lcd_filter;
+    record.hint_style = scaled_font->options.hint_style;
+    record.hint_metrics = scaled_font->options.hint_metrics;
+    record.round_glyph_positions = scaled_font->options.round_glyph_positions;
+    record.num_glyphs = num_glyphs;
+
+    _cairo_array_init (&glyph_records, sizeof (cairo_recording_glyph_record_t));
+    status = _cairo_array_grow_by (&glyph_records, num_glyphs);
+    if (unlikely (status))
+	goto BAIL;
+
+    _cairo_scaled_font_freeze_cache (scaled_font);
+    for (n = 0; n < num_glyphs; n++) {
+	cairo_recording_glyph_record_t glyph;
+
+	status = _cairo_recording_writer_write_glyph (writer, scaled_font,
+						      glyphs[n], &glyph);
+	if (unlikely (status))
+	    break;
+
+	status = _cairo_array_append (&glyph_records, &glyph);
+	if (unlikely (status))
+	    break;
+    }
+    _cairo_scaled_font_thaw_cache (scaled_font);
+    if (unlikely (status))
+	goto BAIL;
+
+    status = _cairo_recording_writer_append (writer,
+					     _cairo_array_index (&glyph_records, 0),
+					     num_glyphs * sizeof (cairo_recording_glyph_record_t),
+					     &record.glyphs);
+    if (unlikely (status))
+	goto BAIL;
+
+    status = _cairo_recording_writer_append (writer,
+					     &record, sizeof (record),
+					     offset);
+
+BAIL:
+    _cairo_array_fini (&glyph_records);
+    return status;
+}
+
+static size_t
+_cairo_recording_command_record_size (cairo_command_type_t type)
+{
+    switch (type) {
+    case CAIRO_COMMAND_PAINT:
+	return sizeof (cairo_recording_command_record_t);
+    case CAIRO_COMMAND_MASK:
+	return sizeof (cairo_recording_mask_record_t);
+    case CAIRO_COMMAND_STROKE:
+	return sizeof (cairo_recording_stroke_record_t);
+    case CAIRO_COMMAND_FILL:
+	return sizeof (cairo_recording_fill_record_t);
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+	return sizeof (cairo_recording_glyphs_record_t);
+    default:
+	return 0;
+    }
+}
+
+static cairo_status_t
+_cairo_recording_writer_write_command (cairo_recording_writer_t *writer,
+				       const cairo_command_t	*command,
+				       uint64_t			*offset)
+{
+    cairo_recording_any_command_record_t record;
+    cairo_recording_command_record_t *header = &record.paint;
+    cairo_status_t status;
+
+    memset (&record, 0, sizeof (record));
+
+    header->type = command->header.type;
+    header->op = command->header.op;
+    header->extents[0] = command->header.extents.x;
+    header->extents[1] = command->header.extents.y;
+    header->extents[2] = command->header.extents.width;
+    header->extents[3] = command->header.extents.height;
+
+    status = _cairo_recording_writer_add_clip (writer,
+					       command->header.clip,
+					       &header->clip);
+    if (unlikely (status))
+	return status;
+
+    switch (command->header.type) {
+    case CAIRO_COMMAND_PAINT:
+	status = _cairo_recording_writer_write_pattern (writer,
+							&command->paint.source.base,
+							&header->source);
+	break;
+
+    case CAIRO_COMMAND_MASK:
+	status = _cairo_recording_writer_write_pattern (writer,
+							&command->mask.source.base,
+							&header->source);
+	if (unlikely (status))
+	    return status;
+
+	status = _cairo_recording_writer_write_pattern (writer,
+							&command->mask.mask.base,
+							&record.mask.mask);
+	break;
+
+    case CAIRO_COMMAND_STROKE: {
+	const cairo_command_stroke_t *stroke = &command->stroke;
+	cairo_recording_stroke_record_t *r = &record.stroke;
+
+	status = _cairo_recording_writer_write_pattern (writer,
+							&stroke->source.base,
+							&header->source);
+	if (unlikely (status))
+	    return status;
+
+	status = _cairo_recording_writer_write_path (writer,
+						     &stroke->path, &r->path);
+	if (unlikely (status))
+	    return status;
+
+	r->line_width = stroke->style.line_width;
+	r->miter_limit = stroke->style.miter_limit;
+	r->dash_offset = stroke->style.dash_offset;
+	r->tolerance = stroke->tolerance;
+	_cairo_recording_matrix_to_doubles (&stroke->ctm, r->ctm);
+	_cairo_recording_matrix_to_doubles (&stroke->ctm_inverse, r->ctm_inverse);
+	r->line_cap = stroke->style.line_cap;
+	r->line_join = stroke->style.line_join;
+	r->antialias = stroke->antialias;
+	r->num_dashes = stroke->style.num_dashes;
+	status = _cairo_recording_writer_append (writer, stroke->style.dash,
+						 r->num_dashes * sizeof (double),
+						 &r->dashes);
+	break;
+    }
+
+    case CAIRO_COMMAND_FILL: {
+	const cairo_command_fill_t *fill = &command->fill;
+	cairo_recording_fill_record_t *r = &record.fill;
+
+	status = _cairo_recording_writer_write_pattern (writer,
+							&fill->source.base,
+							&header->source);
+	if (unlikely (status))
+	    return status;
+
+	status = _cairo_recording_writer_write_path (writer,
+						     &fill->path, &r->path);
+	r->tolerance = fill->tolerance;
+	r->fill_rule = fill->fill_rule;
+	r->antialias = fill->antialias;
+	break;
+    }
+
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS: {
+	const cairo_command_show_text_glyphs_t *glyphs = &command->show_text_glyphs;
+	cairo_recording_glyphs_record_t *r = &record.glyphs;
+
+	status = _cairo_recording_writer_write_pattern (writer,
+							&glyphs->source.base,
+							&header->source);
+	if (unlikely (status))
+	    return status;
+
+	status = _cairo_recording_writer_add_font (writer,
+						   glyphs->scaled_font,
+						   glyphs->glyphs,
+						   glyphs->num_glyphs,
+						   &r->font);
+	if (unlikely (status))
+	    return status;
+
+	r->num_glyphs = glyphs->num_glyphs;
+	status = _cairo_recording_writer_append (writer, glyphs->glyphs,
+						 glyphs->num_glyphs * sizeof (cairo_glyph_t),
+						 &r->glyphs);
+	if (unlikely (status))
+	    return status;
+
+	r->utf8_len = glyphs->utf8 ? glyphs->utf8_len : 0;
+	status = _cairo_recording_writer_append (writer, glyphs->utf8,
+						 r->utf8_len, &r->utf8);
+	if (unlikely (status))
+	    return status;
+
+	r->num_clusters = glyphs->clusters ? glyphs->num_clusters : 0;
+	r->cluster_flags = glyphs->cluster_flags;
+	status = _cairo_recording_writer_append (writer, glyphs->clusters,
+						 r->num_clusters * sizeof (cairo_text_cluster_t),
+						 &r->clusters);
+	break;
+    }
+
+    default:
+	ASSERT_NOT_REACHED;
+    }
+    if (unlikely (status))
+	return status;
+
+    return _cairo_recording_writer_append (writer, &record,
+					   _cairo_recording_command_record_size (command->header.type),
+					   offset);
+}
+
+static cairo_status_t
+_cairo_recording_writer_write_recording (cairo_recording_writer_t  *writer,
+					 cairo_recording_surface_t *recording,
+					 uint64_t		   *offset)
+{
+    cairo_recording_record_t record;
+    cairo_command_t **elements;
+    cairo_array_t commands;
+    cairo_status_t status;
+    unsigned int i;
+
+    memset (&record, 0, sizeof (record));
+    record.content = recording->base.content;
+    record.unbounded = recording->unbounded;
+    record.is_clear = recording->base.is_clear;
+    record.num_commands = recording->commands.num_elements;
+    record.extents[0] = recording->extents_pixels.x;
+    record.extents[1] = recording->extents_pixels.y;
+    record.extents[2] = recording->extents_pixels.width;
+    record.extents[3] = recording->extents_pixels.height;
+    _cairo_recording_device_transform_to_doubles (&recording->base,
+						  record.device_transform);
+
+    _cairo_array_init (&commands, sizeof (uint64_t));
+    status = _cairo_array_grow_by (&commands, record.num_commands);
+    if (unlikely (status))
+	goto BAIL;
+
+    elements = _cairo_array_index (&recording->commands, 0);
+    for (i = 0; i < record.num_commands; i++) {
+	uint64_t command;
+
+	status = _cairo_recording_writer_write_command (writer,
+							elements[i],
+							&command);
+	if (unlikely (status))
+	    goto BAIL;
+
+	status = _cairo_array_append (&commands, &command);
+	if (unlikely (status))
+	    goto BAIL;
+    }
+
+    status = _cairo_recording_writer_append (writer,
+					     _cairo_array_index (&commands, 0),
+					     record.num_commands * sizeof (uint64_t),
+					     &record.commands);
+    if (unlikely (status))
+	goto BAIL;
+
+    status = _cairo_recording_writer_append (writer,
+					     &record, sizeof (record),
+					     offset);
+
+BAIL:
+    _cairo_array_fini (&commands);
+    return status;
+}
+
+static cairo_status_t
+_cairo_recording_writer_write (cairo_recording_writer_t  *writer,
+			       cairo_recording_surface_t *recording)
+{
+    cairo_recording_file_header_t header;
+    cairo_recording_writer_font_t *fonts;
+    cairo_array_t font_offsets;
+    cairo_status_t status;
+    uint64_t offset;
+    unsigned int n;
+
+    memset (&header, 0, sizeof (header));
+    status = _cairo_recording_writer_append (writer,
+					     &header, sizeof (header),
+					     &offset);
+    if (unlikely (status))
+	return status;
+
+    status = _cairo_recording_writer_write_recording (writer, recording,
+						      &header.root);
+    if (unlikely (status))
+	return status;
+
+    _cairo_array_init (&font_offsets, sizeof (uint64_t));
+    fonts = _cairo_array_index (&writer->fonts, 0);
+    for (n = 0; n < writer->fonts.num_elements; n++) {
+	status = _cairo_recording_writer_write_font (writer, &fonts[n], &offset);
+	if (unlikely (status))
+	    break;
+
+	status = _cairo_array_append (&font_offsets, &offset);
+	if (unlikely (status))
+	    break;
+    }
+    if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	header.num_fonts = font_offsets.num_elements;
+	status = _cairo_recording_writer_append (writer,
+						 _cairo_array_index (&font_offsets, 0),
+						 header.num_fonts * sizeof (uint64_t),
+						 &header.fonts);
+    }
+    _cairo_array_fini (&font_offsets);
+    if (unlikely (status))
+	return status;
+
+    header.num_surfaces = writer->surfaces.num_elements;
+    status = _cairo_recording_writer_append (writer,
+					     _cairo_array_index (&writer->surfaces, 0),
+					     header.num_surfaces * sizeof (uint64_t),
+					     &header.surfaces);
+    if (unlikely (status))
+	return status;
+
+    header.num_clips = writer->clips.num_elements;
+    status = _cairo_recording_writer_append (writer,
+					     _cairo_array_index (&writer->clips, 0),
+					     header.num_clips * sizeof (uint64_t),
+					     &header.clips);
+    if (unlikely (status))
+	return status;
+
+    memcpy (header.magic, CAIRO_RECORDING_FILE_MAGIC, sizeof (header.magic));
+    header.version = CAIRO_RECORDING_FILE_VERSION;
+    header.byte_order = CAIRO_RECORDING_FILE_BYTE_ORDER;
+    header.stop_size = sizeof (cairo_gradient_stop_t);
+    header.patch_size = sizeof (cairo_mesh_patch_t);
+    header.glyph_size = sizeof (cairo_glyph_t);
+    header.length = writer->data.num_elements;
+    memcpy (_cairo_array_index (&writer->data, 0), &header, sizeof (header));
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/**
+ * cairo_recording_surface_write_to_stream:
+ * @surface: a #cairo_recording_surface_t
+ * @write_func: a #cairo_write_func_t whose behavior is that of the
+ * write() system call
+ * @closure: closure data for the write function
+ *
+ * Writes the commands recorded by @surface, along with the images,
+ * nested recordings and glyph outlines they use, as a compact binary
+ * stream that can be loaded again with
+ * cairo_recording_surface_create_from_file().
+ *
+ * The stream is intended as a cache between runs of the same build of
+ * cairo on the same machine, not as an interchange format: it is only
+ * readable by a cairo of the same format version and architecture.
+ * Fonts are stored as the outlines of the glyphs that were used, so
+ * the text is replayed through a user font. Raster source patterns
+ * cannot be stored.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if the recording was written
+ * successfully, %CAIRO_STATUS_SURFACE_TYPE_MISMATCH if @surface is not
+ * a recording surface, %CAIRO_STATUS_PATTERN_TYPE_MISMATCH if it uses
+ * a raster source pattern, %CAIRO_STATUS_NO_MEMORY if memory could not
+ * be allocated, or %CAIRO_STATUS_WRITE_ERROR if the write function
+ * reported an error.
+ *
+ * Since: 1.14
+ **/
+cairo_status_t
+cairo_recording_surface_write_to_stream (cairo_surface_t	*surface,
+					 cairo_write_func_t	 write_func,
+					 void			*closure)
+{
+    cairo_recording_writer_t writer;
+    cairo_status_t status;
+
+    if (surface->status)
+	return surface->status;
+
+    if (surface->finished)
+	return _cairo_error (CAIRO_STATUS_SURFACE_FINISHED);
+
+    if (! _cairo_surface_is_recording (surface))
+	return _cairo_error (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+
+    status = _cairo_recording_writer_init (&writer);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = _cairo_recording_writer_write (&writer,
+						(cairo_recording_surface_t *) surface);
+    if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	status = write_func (closure,
+			     _cairo_array_index (&writer.data, 0),
+			     writer.data.num_elements);
+	if (unlikely (status))
+	    status = _cairo_error (status);
+    }
+    _cairo_recording_writer_fini (&writer);
+
+    return status;
+}
+
+static cairo_status_t
+stdio_write_func (void *closure, const unsigned char *data, unsigned int size)
+{
+    FILE *fp = closure;
+
+    while (size) {
+	size_t ret = fwrite (data, 1, size, fp);
+	size -= ret;
+	data += ret;
+	if (size && ferror (fp))
+	    return _cairo_error (CAIRO_STATUS_WRITE_ERROR);
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/**
+ * cairo_recording_surface_write_to_file:
+ * @surface: a #cairo_recording_surface_t
+ * @filename: the name of a file to write to
+ *
+ * Writes the commands recorded by @surface to a new file @filename,
+ * in the form described by cairo_recording_surface_write_to_stream().
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if the file was written
+ * successfully, otherwise one of the errors of
+ * cairo_recording_surface_write_to_stream().
+ *
+ * Since: 1.14
+ **/
+cairo_status_t
+cairo_recording_surface_write_to_file (cairo_surface_t	*surface,
+				       const char	*filename)
+{
+    cairo_status_t status;
+    FILE *fp;
+
+    if (surface->status)
+	return surface->status;
+
+    if (surface->finished)
+	return _cairo_error (CAIRO_STATUS_SURFACE_FINISHED);
+
+    if (! _cairo_surface_is_recording (surface))
+	return _cairo_error (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+
+    fp = fopen (filename, "wb");
+    if (fp == NULL) {
+	switch (errno) {
+	case ENOMEM:
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	default:
+	    return _cairo_error (CAIRO_STATUS_WRITE_ERROR);
+	}
+    }
+
+    status = cairo_recording_surface_write_to_stream (surface,
+						      stdio_write_func, fp);
+
+    if (fclose (fp) && status == CAIRO_STATUS_SUCCESS)
+	status = _cairo_error (CAIRO_STATUS_WRITE_ERROR);
+
+    return status;
+}
+
+/* Loader */
+
+typedef struct _cairo_recording_blob {
+    cairo_reference_count_t ref_count;
+    unsigned char *data;
+    size_t length;
+} cairo_recording_blob_t;
+
+struct _cairo_recording_mapping {
+    cairo_recording_blob_t *blob;
+
+    /* The block holding every loaded command */
+    void *commands;
+
+    /* The objects used by the commands, owned here rather than by
+     * each command */
+    cairo_array_t clips;
+    cairo_array_t surfaces;
+    cairo_array_t fonts;
+};
+
+typedef struct _cairo_recording_font {
+    cairo_recording_blob_t *blob;
+    const cairo_recording_font_record_t *record;
+    const cairo_recording_glyph_record_t *glyphs;
+} cairo_recording_font_t;
+
+typedef struct _cairo_recording_loader {
+    cairo_recording_blob_t *blob;
+    const cairo_recording_file_header_t *header;
+    const uint64_t *surface_table;
+    const uint64_t *font_table;
+    const uint64_t *clip_table;
+
+    cairo_surface_t **surfaces;
+    unsigned int num_surfaces;
+    cairo_scaled_font_t **fonts;
+    cairo_clip_t **clips;
+
+    /* Which recording last took a reference to each object, so that a
+     * recording's mapping holds each of them once. */
+    unsigned int current;
+    unsigned int *surface_owner;
+    unsigned int *font_owner;
+    unsigned int *clip_owner;
+} cairo_recording_loader_t;
+
+static const cairo_user_data_key_t cairo_recording_blob_key;
+static const cairo_user_data_key_t cairo_recording_font_key;
+
+static cairo_recording_blob_t *
+_cairo_recording_blob_reference (cairo_recording_blob_t *blob)
+{
+    _cairo_reference_count_inc (&blob->ref_count);
+    return blob;
+}
+
+static void
+_cairo_recording_blob_destroy (void *abstract_blob)
+{
+    cairo_recording_blob_t *blob = abstract_blob;
+
+    if (! _cairo_reference_count_dec_and_test (&blob->ref_count))
+	return;
+
+    free (blob->data);
+    free (blob);
+}
+
+static cairo_status_t
+_cairo_recording_blob_create_from_file (const char		*filename,
+					cairo_recording_blob_t **blob_out)
+{
+    cairo_recording_blob_t *blob;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    size_t size = 0, ret;
+    FILE *fp;
+
+    blob = malloc (sizeof (cairo_recording_blob_t));
+    if (unlikely (blob == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    CAIRO_REFERENCE_COUNT_INIT (&blob->ref_count, 1);
+    blob->data = NULL;
+    blob->length = 0;
+
+    /* The file is read rather than mapped: the loaded recording points
+     * into the data once it has been validated, so it must not change
+     * (or disappear) underneath us. */
+    fp = fopen (filename, "rb");
+    if (fp == NULL) {
+	status = errno == ENOENT ? CAIRO_STATUS_FILE_NOT_FOUND :
+				   CAIRO_STATUS_READ_ERROR;
+	free (blob);
+	return _cairo_error (status);
+    }
+
+    do {
+	if (blob->length == size) {
+	    unsigned char *data;
+
+	    size = size ? 2 * size : 65536;
+	    data = realloc (blob->data, size);
+	    if (unlikely (data == NULL)) {
+		status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+		break;
+	    }
+	    blob->data = data;
+	}
+
+	ret = fread (blob->data + blob->length, 1, size - blob->length, fp);
+	blob->length += ret;
+    } while (ret != 0);
+
+    if (status == CAIRO_STATUS_SUCCESS && ferror (fp))
+	status = _cairo_error (CAIRO_STATUS_READ_ERROR);
+    fclose (fp);
+
+    if (unlikely (status)) {
+	_cairo_recording_blob_destroy (blob);
+	return status;
+    }
+
+    *blob_out = blob;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* Find @count elements of @size bytes at @offset, or NULL if they do
+ * not lie within the file. */
+static const void *
+_cairo_recording_loader_get (const cairo_recording_loader_t *loader,
+			     uint64_t			     offset,
+			     uint64_t			     count,
+			     size_t			     size)
+{
+    uint64_t length = loader->blob->length;
+
+    if (offset & (CAIRO_RECORDING_FILE_ALIGN - 1))
+	return NULL;
+
+    if (offset > length || (size && count > (length - offset) / size))
+	return NULL;
+
+    return loader->blob->data + offset;
+}
+
+/* Initialise @path from the file. As the rest of cairo assumes that the
+ * head of a path is its embedded buffer, that is filled in as it would
+ * have been when the path was built, and only the remainder of a long
+ * path is borrowed from the file, through @tail. */
+static cairo_status_t
+_cairo_recording_loader_init_path (const cairo_recording_loader_t	*loader,
+				   const cairo_recording_path_record_t	*record,
+				   cairo_path_fixed_t			*path,
+				   cairo_path_buf_t			*tail)
+{
+    const cairo_path_op_t *ops;
+    const cairo_point_t *points;
+    cairo_path_buf_t *head;
+    unsigned int n, num_points;
+    unsigned int head_ops, head_points;
+
+    ops = _cairo_recording_loader_get (loader, record->ops,
+				       record->num_ops,
+				       sizeof (cairo_path_op_t));
+    points = _cairo_recording_loader_get (loader, record->points,
+					  record->num_points,
+					  sizeof (cairo_point_t));
+    if (unlikely (ops == NULL || points == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    _cairo_path_fixed_init (path);
+    head = cairo_path_head (path);
+
+    /* The consumers of paths trust the operations to match the points */
+    num_points = 0;
+    head_ops = head_points = 0;
+    for (n = 0; n < record->num_ops; n++) {
+	switch (ops[n]) {
+	case CAIRO_PATH_OP_MOVE_TO:
+	case CAIRO_PATH_OP_LINE_TO:
+	    num_points += 1;
+	    break;
+	case CAIRO_PATH_OP_CURVE_TO:
+	    num_points += 3;
+	    break;
+	case CAIRO_PATH_OP_CLOSE_PATH:
+	    break;
+	default:
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	}
+
+	if (head_ops == n && n < head->size_ops && num_points <= head->size_points) {
+	    head_ops = n + 1;
+	    head_points = num_points;
+	}
+    }
+    if (unlikely (num_points != record->num_points))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    path->last_move_point.x = record->last_move_point[0];
+    path->last_move_point.y = record->last_move_point[1];
+    path->current_point.x = record->current_point[0];
+    path->current_point.y = record->current_point[1];
+    path->has_current_point = !! (record->flags & CAIRO_RECORDING_PATH_HAS_CURRENT_POINT);
+    path->needs_move_to = !! (record->flags & CAIRO_RECORDING_PATH_NEEDS_MOVE_TO);
+    path->has_extents = !! (record->flags & CAIRO_RECORDING_PATH_HAS_EXTENTS);
+    path->has_curve_to = !! (record->flags & CAIRO_RECORDING_PATH_HAS_CURVE_TO);
+    path->stroke_is_rectilinear = !! (record->flags & CAIRO_RECORDING_PATH_STROKE_IS_RECTILINEAR);
+    path->fill_is_rectilinear = !! (record->flags & CAIRO_RECORDING_PATH_FILL_IS_RECTILINEAR);
+    path->fill_maybe_region = !! (record->flags & CAIRO_RECORDING_PATH_FILL_MAYBE_REGION);
+    path->fill_is_empty = !! (record->flags & CAIRO_RECORDING_PATH_FILL_IS_EMPTY);
+    path->extents.p1.x = record->extents[0];
+    path->extents.p1.y = record->extents[1];
+    path->extents.p2.x = record->extents[2];
+    path->extents.p2.y = record->extents[3];
+
+    memcpy (head->op, ops, head_ops * sizeof (cairo_path_op_t));
+    memcpy (head->points, points, head_points * sizeof (cairo_point_t));
+    head->num_ops = head_ops;
+    head->num_points = head_points;
+
+    /* The tail is never appended to, nor freed */
+    if (head_ops < record->num_ops) {
+	tail->op = (cairo_path_op_t *) ops + head_ops;
+	tail->points = (cairo_point_t *) points + head_points;
+	tail->num_ops = tail->size_ops = record->num_ops - head_ops;
+	tail->num_points = tail->size_points = record->num_points - head_points;
+	cairo_list_add_tail (&tail->link, &head->link);
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_loader_create_image (cairo_recording_loader_t *loader,
+				      uint32_t			format,
+				      int32_t			width,
+				      int32_t			height,
+				      int32_t			stride,
+				      uint64_t			offset,
+				      cairo_surface_t	      **image_out)
+{
+    const unsigned char *data;
+    cairo_surface_t *image;
+    cairo_status_t status;
+
+    if (format > CAIRO_FORMAT_RGB30 || width < 0 || height < 0 ||
+	stride < cairo_format_stride_for_width (format, width))
+    {
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+    }
+
+    data = _cairo_recording_loader_get (loader, offset, height, stride);
+    if (unlikely (data == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    image = cairo_image_surface_create_for_data ((unsigned char *) data,
+						 format, width, height,
+						 stride);
+    status = image->status;
+    if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	status = cairo_surface_set_user_data (image,
+					      &cairo_recording_blob_key,
+					      loader->blob,
+					      _cairo_recording_blob_destroy);
+	if (likely (status == CAIRO_STATUS_SUCCESS))
+	    _cairo_recording_blob_reference (loader->blob);
+    }
+    if (unlikely (status)) {
+	cairo_surface_destroy (image);
+	return status;
+    }
+
+    *image_out = image;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static const cairo_recording_glyph_record_t *
+_cairo_recording_font_find_glyph (const cairo_recording_font_t *font,
+				  unsigned long			glyph)
+{
+    unsigned int min = 0, max = font->record->num_glyphs;
+
+    while (min < max) {
+	unsigned int mid = min + (max - min) / 2;
+
+	if (font->glyphs[mid].index == glyph)
+	    return &font->glyphs[mid];
+
+	if (font->glyphs[mid].index < glyph)
+	    min = mid + 1;
+	else
+	    max = mid;
+    }
+
+    return NULL;
+}
+
+static cairo_status_t
+_cairo_recording_font_init (cairo_scaled_font_t	 *scaled_font,
+			    cairo_t		 *cr,
+			    cairo_font_extents_t *extents)
+{
+    const cairo_recording_font_t *font;
+
+    font = cairo_font_face_get_user_data (cairo_scaled_font_get_font_face (scaled_font),
+					  &cairo_recording_font_key);
+
+    extents->ascent = font->record->extents[0];
+    extents->descent = font->record->extents[1];
+    extents->height = font->record->extents[2];
+    extents->max_x_advance = font->record->extents[3];
+    extents->max_y_advance = font->record->extents[4];
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_font_render_glyph (cairo_scaled_font_t	 *scaled_font,
+				    unsigned long	  index,
+				    cairo_t		 *cr,
+				    cairo_text_extents_t *extents)
+{
+    const cairo_recording_font_t *font;
+    const cairo_recording_glyph_record_t *glyph;
+
+    font = cairo_font_face_get_user_data (cairo_scaled_font_get_font_face (scaled_font),
+					  &cairo_recording_font_key);
+
+    glyph = _cairo_recording_font_find_glyph (font, index);
+    if (glyph == NULL)
+	return CAIRO_STATUS_SUCCESS;
+
+    extents->x_bearing = glyph->metrics[0];
+    extents->y_bearing = glyph->metrics[1];
+    extents->width = glyph->metrics[2];
+    extents->height = glyph->metrics[3];
+    extents->x_advance = glyph->metrics[4];
+    extents->y_advance = glyph->metrics[5];
+
+    /* The glyph was stored in device space, relative to its origin */
+    cairo_identity_matrix (cr);
+
+    switch (glyph->kind) {
+    case CAIRO_RECORDING_GLYPH_PATH: {
+	const cairo_path_op_t *op = (const cairo_path_op_t *)
+	    (font->blob->data + glyph->path.ops);
+	const cairo_point_t *p = (const cairo_point_t *)
+	    (font->blob->data + glyph->path.points);
+	unsigned int n;
+
+	for (n = 0; n < glyph->path.num_ops; n++) {
+	    switch (op[n]) {
+	    case CAIRO_PATH_OP_MOVE_TO:
+		cairo_move_to (cr,
+			       _cairo_fixed_to_double (p[0].x),
+			       _cairo_fixed_to_double (p[0].y));
+		p += 1;
+		break;
+	    case CAIRO_PATH_OP_LINE_TO:
+		cairo_line_to (cr,
+			       _cairo_fixed_to_double (p[0].x),
+			       _cairo_fixed_to_double (p[0].y));
+		p += 1;
+		break;
+	    case CAIRO_PATH_OP_CURVE_TO:
+		cairo_curve_to (cr,
+				_cairo_fixed_to_double (p[0].x),
+				_cairo_fixed_to_double (p[0].y),
+				_cairo_fixed_to_double (p[1].x),
+				_cairo_fixed_to_double (p[1].y),
+				_cairo_fixed_to_double (p[2].x),
+				_cairo_fixed_to_double (p[2].y));
+		p += 3;
+		break;
+	    case CAIRO_PATH_OP_CLOSE_PATH:
+		cairo_close_path (cr);
+		break;
+	    }
+	}
+	cairo_fill (cr);
+	break;
+    }
+
+    case CAIRO_RECORDING_GLYPH_IMAGE: {
+	cairo_surface_t *image;
+
+	image = cairo_image_surface_create_for_data (font->blob->data + glyph->data,
+						     glyph->format,
+						     glyph->width,
+						     glyph->height,
+						     glyph->stride);
+	cairo_surface_set_device_offset (image,
+					 glyph->device_offset[0],
+					 glyph->device_offset[1]);
+	cairo_mask_surface (cr, image, 0, 0);
+	cairo_surface_destroy (image);
+	break;
+    }
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_recording_font_destroy (void *abstract_font)
+{
+    cairo_recording_font_t *font = abstract_font;
+
+    _cairo_recording_blob_destroy (font->blob);
+    free (font);
+}
+
+static cairo_status_t
+_cairo_recording_loader_load_font (cairo_recording_loader_t  *loader,
+				   uint64_t		      offset,
+				   cairo_scaled_font_t	    **scaled_font_out)
+{
+    const cairo_recording_font_record_t *record;
+    const cairo_recording_glyph_record_t *glyphs;
+    cairo_recording_font_t *font;
+    cairo_font_face_t *font_face;
+    cairo_scaled_font_t *scaled_font;
+    cairo_matrix_t font_matrix, ctm;
+    cairo_font_options_t options;
+    cairo_status_t status;
+    unsigned int n;
+
+    record = _cairo_recording_loader_get (loader, offset, 1, sizeof (*record));
+    if (unlikely (record == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    glyphs = _cairo_recording_loader_get (loader, record->glyphs,
+					  record->num_glyphs,
+					  sizeof (cairo_recording_glyph_record_t));
+    if (unlikely (glyphs == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    /* Check the glyphs now, as they are rendered long after loading */
+    for (n = 0; n < record->num_glyphs; n++) {
+	const cairo_recording_glyph_record_t *glyph = &glyphs[n];
+
+	if (n && glyph->index <= glyphs[n - 1].index)
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+	switch (glyph->kind) {
+	case CAIRO_RECORDING_GLYPH_EMPTY:
+	    break;
+
+	case CAIRO_RECORDING_GLYPH_PATH: {
+	    cairo_path_fixed_t path;
+	    cairo_path_buf_t tail;
+
+	    status = _cairo_recording_loader_init_path (loader,
+							&glyph->path,
+							&path, &tail);
+	    if (unlikely (status))
+		return status;
+	    break;
+	}
+
+	case CAIRO_RECORDING_GLYPH_IMAGE:
+	    if (glyph->format > CAIRO_FORMAT_RGB30 ||
+		glyph->width < 0 || glyph->height < 0 ||
+		glyph->stride < cairo_format_stride_for_width (glyph->format,
+							       glyph->width) ||
+		_cairo_recording_loader_get (loader, glyph->data,
+					     glyph->height,
+					     glyph->stride) == NULL)
+	    {
+		return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	    }
+	    break;
+
+	default:
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	}
+    }
+
+    _cairo_recording_matrix_from_doubles (&font_matrix, record->font_matrix);
+    _cairo_recording_matrix_from_doubles (&ctm, record->ctm);
+
+    _cairo_font_options_init_default (&options);
+    if (record->antialias <= CAIRO_ANTIALIAS_BEST)
+	options.antialias = record->antialias;
+    if (record->subpixel_order <= CAIRO_SUBPIXEL_ORDER_VBGR)
+	options.subpixel_order = record->subpixel_order;
+    if (record->lcd_filter <= CAIRO_LCD_FILTER_FIR5)
+	options.lcd_filter = record->lcd_filter;
+    if (record->hint_style <= CAIRO_HINT_STYLE_FULL)
+	options.hint_style = record->hint_style;
+    if (record->hint_metrics <= CAIRO_HINT_METRICS_ON)
+	options.hint_metrics = record->hint_metrics;
+    if (record->round_glyph_positions <= CAIRO_ROUND_GLYPH_POS_OFF)
+	options.round_glyph_positions = record->round_glyph_positions;
+
+    font = malloc (sizeof (cairo_recording_font_t));
+    if (unlikely (font == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    font->blob = _cairo_recording_blob_reference (loader->blob);
+    font->record = record;
+    font->glyphs = glyphs;
+
+    font_face = cairo_user_font_face_create ();
+    status = cairo_font_face_set_user_data (font_face,
+					    &cairo_recording_font_key,
+					    font,
+					    _cairo_recording_font_destroy);
+    if (unlikely (status)) {
+	_cairo_recording_font_destroy (font);
+	cairo_font_face_destroy (font_face);
+	return status;
+    }
+
+    cairo_user_font_face_set_init_func (font_face,
+					_cairo_recording_font_init);
+    cairo_user_font_face_set_render_glyph_func (font_face,
+						_cairo_recording_font_render_glyph);
+
+    scaled_font = cairo_scaled_font_create (font_face,
+					    &font_matrix, &ctm,
+					    &options);
+    cairo_font_face_destroy (font_face);
+
+    status = scaled_font->status;
+    if (unlikely (status)) {
+	cairo_scaled_font_destroy (scaled_font);
+	return status;
+    }
+
+    *scaled_font_out = scaled_font;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_loader_create_clip (cairo_recording_loader_t *loader,
+				     uint32_t		       index,
+				     cairo_clip_t	     **clip_out)
+{
+    const cairo_recording_clip_record_t *record;
+    const cairo_recording_clip_path_record_t *paths;
+    const cairo_box_t *boxes;
+    cairo_clip_t *clip;
+    cairo_status_t status;
+    unsigned int n;
+
+    record = _cairo_recording_loader_get (loader, loader->clip_table[index],
+					  1, sizeof (*record));
+    if (unlikely (record == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    boxes = _cairo_recording_loader_get (loader, record->boxes,
+					 record->num_boxes,
+					 sizeof (cairo_box_t));
+    paths = _cairo_recording_loader_get (loader, record->paths,
+					 record->num_paths,
+					 sizeof (cairo_recording_clip_path_record_t));
+    if (unlikely (boxes == NULL || paths == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    /* Rebuild the clip the way it was first built, from its boxes and
+     * then its paths, oldest first. */
+    clip = _cairo_clip_create ();
+    if (unlikely (clip == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    if (record->num_boxes) {
+	cairo_boxes_t clip_boxes;
+
+	_cairo_boxes_init_for_array (&clip_boxes,
+				     (cairo_box_t *) boxes,
+				     record->num_boxes);
+	clip = _cairo_clip_intersect_boxes (clip, &clip_boxes);
+    }
+
+    for (n = 0; n < record->num_paths; n++) {
+	const cairo_recording_clip_path_record_t *p = &paths[n];
+	cairo_path_fixed_t path;
+	cairo_path_buf_t tail;
+
+	if (p->fill_rule > CAIRO_FILL_RULE_EVEN_ODD ||
+	    p->antialias > CAIRO_ANTIALIAS_BEST)
+	{
+	    _cairo_clip_destroy (clip);
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	}
+
+	status = _cairo_recording_loader_init_path (loader, &p->path,
+						    &path, &tail);
+	if (unlikely (status)) {
+	    _cairo_clip_destroy (clip);
+	    return status;
+	}
+
+	clip = _cairo_clip_intersect_path (clip, &path,
+					   p->fill_rule,
+					   p->tolerance,
+					   p->antialias);
+    }
+
+    if (! _cairo_clip_is_all_clipped (clip)) {
+	clip->extents.x = record->extents[0];
+	clip->extents.y = record->extents[1];
+	clip->extents.width = record->extents[2];
+	clip->extents.height = record->extents[3];
+	clip->is_region = record->is_region && clip->path == NULL;
+    }
+
+    *clip_out = clip;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_loader_get_clip (cairo_recording_loader_t  *loader,
+				  cairo_recording_mapping_t *mapping,
+				  int32_t		     index,
+				  cairo_clip_t		   **clip_out)
+{
+    cairo_status_t status;
+
+    if (index == CAIRO_RECORDING_NO_CLIP) {
+	*clip_out = NULL;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    if (index == CAIRO_RECORDING_ALL_CLIPPED) {
+	*clip_out = _cairo_clip_set_all_clipped (NULL);
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    if (unlikely (index < 0 || (uint32_t) index >= loader->header->num_clips))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    if (loader->clip_owner[index] != loader->current) {
+	cairo_clip_t *clip;
+
+	status = _cairo_recording_loader_create_clip (loader, index, &clip);
+	if (unlikely (status))
+	    return status;
+
+	status = _cairo_array_append (&mapping->clips, &clip);
+	if (unlikely (status)) {
+	    _cairo_clip_destroy (clip);
+	    return status;
+	}
+
+	loader->clips[index] = clip;
+	loader->clip_owner[index] = loader->current;
+    }
+
+    *clip_out = loader->clips[index];
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_loader_get_surface (cairo_recording_loader_t  *loader,
+				     cairo_recording_mapping_t *mapping,
+				     uint32_t			index,
+				     cairo_surface_t	      **surface_out)
+{
+    cairo_status_t status;
+
+    /* Only those already loaded, which rules out any cycle */
+    if (unlikely (index >= loader->num_surfaces))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    if (loader->surface_owner[index] != loader->current) {
+	status = _cairo_array_append (&mapping->surfaces,
+				      &loader->surfaces[index]);
+	if (unlikely (status))
+	    return status;
+
+	cairo_surface_reference (loader->surfaces[index]);
+	loader->surface_owner[index] = loader->current;
+    }
+
+    *surface_out = loader->surfaces[index];
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_loader_get_font (cairo_recording_loader_t  *loader,
+				  cairo_recording_mapping_t *mapping,
+				  uint32_t		     index,
+				  cairo_scaled_font_t	   **scaled_font_out)
+{
+    cairo_status_t status;
+
+    if (unlikely (index >= loader->header->num_fonts))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    if (loader->font_owner[index] != loader->current) {
+	status = _cairo_array_append (&mapping->fonts, &loader->fonts[index]);
+	if (unlikely (status))
+	    return status;
+
+	cairo_scaled_font_reference (loader->fonts[index]);
+	loader->font_owner[index] = loader->current;
+    }
+
+    *scaled_font_out = loader->fonts[index];
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_loader_init_pattern (cairo_recording_loader_t		    *loader,
+				      cairo_recording_mapping_t		    *mapping,
+				      const cairo_recording_pattern_record_t *record,
+				      cairo_pattern_union_t		    *pattern)
+{
+    cairo_status_t status;
+
+    if (record->filter > CAIRO_FILTER_GAUSSIAN ||
+	record->extend > CAIRO_EXTEND_PAD)
+    {
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+    }
+
+    switch (record->type) {
+    case CAIRO_PATTERN_TYPE_SOLID: {
+	cairo_color_t color;
+
+	_cairo_color_init_rgba (&color,
+				record->params[0], record->params[1],
+				record->params[2], record->params[3]);
+	_cairo_pattern_init_solid (&pattern->solid, &color);
+	break;
+    }
+
+    case CAIRO_PATTERN_TYPE_SURFACE:
+	_cairo_pattern_init (&pattern->base, CAIRO_PATTERN_TYPE_SURFACE);
+	status = _cairo_recording_loader_get_surface (loader, mapping,
+						      record->count,
+						      &pattern->surface.surface);
+	if (unlikely (status))
+	    return status;
+	break;
+
+    case CAIRO_PATTERN_TYPE_LINEAR:
+    case CAIRO_PATTERN_TYPE_RADIAL: {
+	cairo_gradient_pattern_t *gradient = &pattern->gradient.base;
+	const cairo_gradient_stop_t *stops;
+
+	stops = _cairo_recording_loader_get (loader, record->data,
+					     record->count,
+					     sizeof (cairo_gradient_stop_t));
+	if (unlikely (stops == NULL))
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+	_cairo_pattern_init (&pattern->base, record->type);
+	if (record->type == CAIRO_PATTERN_TYPE_LINEAR) {
+	    pattern->gradient.linear.pd1.x = record->params[0];
+	    pattern->gradient.linear.pd1.y = record->params[1];
+	    pattern->gradient.linear.pd2.x = record->params[2];
+	    pattern->gradient.linear.pd2.y = record->params[3];
+	} else {
+	    pattern->gradient.radial.cd1.center.x = record->params[0];
+	    pattern->gradient.radial.cd1.center.y = record->params[1];
+	    pattern->gradient.radial.cd1.radius = record->params[2];
+	    pattern->gradient.radial.cd2.center.x = record->params[3];
+	    pattern->gradient.radial.cd2.center.y = record->params[4];
+	    pattern->gradient.radial.cd2.radius = record->params[5];
+	}
+
+	gradient->n_stops = gradient->stops_size = record->count;
+	gradient->stops = record->count ? (cairo_gradient_stop_t *) stops : NULL;
+	break;
+    }
+
+    case CAIRO_PATTERN_TYPE_MESH: {
+	cairo_mesh_pattern_t *mesh = &pattern->mesh;
+	const cairo_mesh_patch_t *patches;
+
+	patches = _cairo_recording_loader_get (loader, record->data,
+					       record->count,
+					       sizeof (cairo_mesh_patch_t));
+	if (unlikely (patches == NULL))
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+	_cairo_pattern_init (&pattern->base, CAIRO_PATTERN_TYPE_MESH);
+	_cairo_array_init (&mesh->patches, sizeof (cairo_mesh_patch_t));
+	if (record->count) {
+	    mesh->patches.elements = (char *) patches;
+	    mesh->patches.size = mesh->patches.num_elements = record->count;
+	}
+	mesh->current_patch = NULL;
+	break;
+    }
+
+    default:
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+    }
+
+    pattern->base.filter = record->filter;
+    pattern->base.extend = record->extend;
+    pattern->base.has_component_alpha = record->has_component_alpha != 0;
+    _cairo_recording_matrix_from_doubles (&pattern->base.matrix, record->matrix);
+    pattern->base.opacity = record->opacity;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static size_t
+_cairo_recording_command_size (cairo_command_type_t type)
+{
+    size_t size;
+
+    switch (type) {
+    case CAIRO_COMMAND_PAINT: size = sizeof (cairo_command_paint_t); break;
+    case CAIRO_COMMAND_MASK: size = sizeof (cairo_command_mask_t); break;
+    case CAIRO_COMMAND_STROKE: size = sizeof (cairo_command_stroke_t) + sizeof (cairo_path_buf_t); break;
+    case CAIRO_COMMAND_FILL: size = sizeof (cairo_command_fill_t) + sizeof (cairo_path_buf_t); break;
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS: size = sizeof (cairo_command_show_text_glyphs_t); break;
+    default: return 0;
+    }
+
+    return (size + sizeof (double) - 1) & -sizeof (double);
+}
+
+/* Apply the checks cairo_set_line_width(), cairo_set_dash(),
+ * cairo_set_tolerance() and friends make on their arguments, so that a
+ * corrupt file cannot hand the stroker a style it was never meant to
+ * see. */
+static cairo_bool_t
+_cairo_recording_stroke_style_is_valid (const cairo_recording_stroke_record_t *r,
+					const double			      *dashes)
+{
+    cairo_matrix_t matrix;
+    double dash_total = 0;
+    unsigned int i;
+
+    if (! ISFINITE (r->line_width) || r->line_width < 0.)
+	return FALSE;
+
+    if (! ISFINITE (r->miter_limit))
+	return FALSE;
+
+    if (! ISFINITE (r->tolerance) || ! (r->tolerance > 0.))
+	return FALSE;
+
+    if (! ISFINITE (r->dash_offset))
+	return FALSE;
+
+    for (i = 0; i < r->num_dashes; i++) {
+	if (! ISFINITE (dashes[i]) || dashes[i] < 0.)
+	    return FALSE;
+	dash_total += dashes[i];
+    }
+    if (r->num_dashes && ! (dash_total > 0.))
+	return FALSE;
+
+    _cairo_recording_matrix_from_doubles (&matrix, r->ctm);
+    if (! _cairo_matrix_is_invertible (&matrix))
+	return FALSE;
+
+    _cairo_recording_matrix_from_doubles (&matrix, r->ctm_inverse);
+    if (! _cairo_matrix_is_invertible (&matrix))
+	return FALSE;
+
+    return TRUE;
+}
+
+static cairo_status_t
+_cairo_recording_loader_init_command (cairo_recording_loader_t		      *loader,
+				      cairo_recording_mapping_t		      *mapping,
+				      const cairo_recording_any_command_record_t *record,
+				      cairo_command_t			      *command)
+{
+    const cairo_recording_command_record_t *header = &record->paint;
+    cairo_status_t status;
+
+    if (header->op > CAIRO_OPERATOR_HSL_LUMINOSITY)
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    command->header.type = header->type;
+    command->header.region = CAIRO_RECORDING_REGION_ALL;
+    command->header.op = header->op;
+    command->header.extents.x = header->extents[0];
+    command->header.extents.y = header->extents[1];
+    command->header.extents.width = header->extents[2];
+    command->header.extents.height = header->extents[3];
+
+    status = _cairo_recording_loader_get_clip (loader, mapping,
+					       header->clip,
+					       &command->header.clip);
+    if (unlikely (status))
+	return status;
+
+    /* Every command begins with its source */
+    status = _cairo_recording_loader_init_pattern (loader, mapping,
+						   &header->source,
+						   &command->paint.source);
+    if (unlikely (status))
+	return status;
+
+    switch (header->type) {
+    case CAIRO_COMMAND_PAINT:
+	break;
+
+    case CAIRO_COMMAND_MASK:
+	status = _cairo_recording_loader_init_pattern (loader, mapping,
+						       &record->mask.mask,
+						       &command->mask.mask);
+	break;
+
+    case CAIRO_COMMAND_STROKE: {
+	const cairo_recording_stroke_record_t *r = &record->stroke;
+	cairo_command_stroke_t *stroke = &command->stroke;
+	const double *dashes;
+
+	if (r->line_cap > CAIRO_LINE_CAP_SQUARE ||
+	    r->line_join > CAIRO_LINE_JOIN_BEVEL ||
+	    r->antialias > CAIRO_ANTIALIAS_BEST)
+	{
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	}
+
+	dashes = _cairo_recording_loader_get (loader, r->dashes,
+					      r->num_dashes, sizeof (double));
+	if (unlikely (dashes == NULL))
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+	if (! _cairo_recording_stroke_style_is_valid (r, dashes))
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+	/* The tail of the path is kept alongside the command */
+	status = _cairo_recording_loader_init_path (loader, &r->path,
+						    &stroke->path,
+						    (cairo_path_buf_t *) (stroke + 1));
+	if (unlikely (status))
+	    return status;
+
+	stroke->style.line_width = r->line_width;
+	stroke->style.line_cap = r->line_cap;
+	stroke->style.line_join = r->line_join;
+	stroke->style.miter_limit = r->miter_limit;
+	stroke->style.dash = r->num_dashes ? (double *) dashes : NULL;
+	stroke->style.num_dashes = r->num_dashes;
+	stroke->style.dash_offset = r->dash_offset;
+	_cairo_recording_matrix_from_doubles (&stroke->ctm, r->ctm);
+	_cairo_recording_matrix_from_doubles (&stroke->ctm_inverse, r->ctm_inverse);
+	stroke->tolerance = r->tolerance;
+	stroke->antialias = r->antialias;
+	break;
+    }
+
+    case CAIRO_COMMAND_FILL: {
+	const cairo_recording_fill_record_t *r = &record->fill;
+	cairo_command_fill_t *fill = &command->fill;
+
+	if (r->fill_rule > CAIRO_FILL_RULE_EVEN_ODD ||
+	    r->antialias > CAIRO_ANTIALIAS_BEST ||
+	    ! ISFINITE (r->tolerance) || ! (r->tolerance > 0.))
+	{
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	}
+
+	status = _cairo_recording_loader_init_path (loader, &r->path,
+						    &fill->path,
+						    (cairo_path_buf_t *) (fill + 1));
+	if (unlikely (status))
+	    return status;
+
+	fill->fill_rule = r->fill_rule;
+	fill->tolerance = r->tolerance;
+	fill->antialias = r->antialias;
+	break;
+    }
+
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS: {
+	const cairo_recording_glyphs_record_t *r = &record->glyphs;
+	cairo_command_show_text_glyphs_t *glyphs = &command->show_text_glyphs;
+	const cairo_glyph_t *glyph_data;
+	const cairo_text_cluster_t *clusters;
+	const char *utf8;
+
+	if (r->num_glyphs > INT_MAX || r->utf8_len > INT_MAX ||
+	    r->num_clusters > INT_MAX ||
+	    r->cluster_flags > CAIRO_TEXT_CLUSTER_FLAG_BACKWARD)
+	{
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	}
+
+	glyph_data = _cairo_recording_loader_get (loader, r->glyphs,
+						  r->num_glyphs,
+						  sizeof (cairo_glyph_t));
+	utf8 = _cairo_recording_loader_get (loader, r->utf8, r->utf8_len, 1);
+	clusters = _cairo_recording_loader_get (loader, r->clusters,
+						r->num_clusters,
+						sizeof (cairo_text_cluster_t));
+	if (unlikely (glyph_data == NULL || utf8 == NULL || clusters == NULL))
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+	glyphs->glyphs = (cairo_glyph_t *) glyph_data;
+	glyphs->num_glyphs = r->num_glyphs;
+	glyphs->utf8 = r->utf8_len ? (char *) utf8 : NULL;
+	glyphs->utf8_len = r->utf8_len;
+	glyphs->clusters = r->num_clusters ? (cairo_text_cluster_t *) clusters : NULL;
+	glyphs->num_clusters = r->num_clusters;
+	glyphs->cluster_flags = r->cluster_flags;
+
+	if (glyphs->utf8 != NULL && glyphs->clusters != NULL) {
+	    status = _cairo_validate_text_clusters (glyphs->utf8,
+						    glyphs->utf8_len,
+						    glyphs->glyphs,
+						    glyphs->num_glyphs,
+						    glyphs->clusters,
+						    glyphs->num_clusters,
+						    glyphs->cluster_flags);
+	    if (unlikely (status))
+		return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	}
+
+	status = _cairo_recording_loader_get_font (loader, mapping,
+						   r->font,
+						   &glyphs->scaled_font);
+	break;
+    }
+
+    default:
+	ASSERT_NOT_REACHED;
+    }
+
+    return status;
+}
+
+static cairo_recording_mapping_t *
+_cairo_recording_mapping_create (cairo_recording_blob_t *blob)
+{
+    cairo_recording_mapping_t *mapping;
+
+    mapping = malloc (sizeof (cairo_recording_mapping_t));
+    if (unlikely (mapping == NULL))
+	return NULL;
+
+    mapping->blob = _cairo_recording_blob_reference (blob);
+    mapping->commands = NULL;
+    _cairo_array_init (&mapping->clips, sizeof (cairo_clip_t *));
+    _cairo_array_init (&mapping->surfaces, sizeof (cairo_surface_t *));
+    _cairo_array_init (&mapping->fonts, sizeof (cairo_scaled_font_t *));
+
+    return mapping;
+}
+
+void
+_cairo_recording_mapping_destroy (cairo_recording_mapping_t *mapping)
+{
+    unsigned int n;
+
+    for (n = 0; n < mapping->clips.num_elements; n++)
+	_cairo_clip_destroy (*(cairo_clip_t **) _cairo_array_index (&mapping->clips, n));
+    _cairo_array_fini (&mapping->clips);
+
+    for (n = 0; n < mapping->surfaces.num_elements; n++)
+	cairo_surface_destroy (*(cairo_surface_t **) _cairo_array_index (&mapping->surfaces, n));
+    _cairo_array_fini (&mapping->surfaces);
+
+    for (n = 0; n < mapping->fonts.num_elements; n++)
+	cairo_scaled_font_destroy (*(cairo_scaled_font_t **) _cairo_array_index (&mapping->fonts, n));
+    _cairo_array_fini (&mapping->fonts);
+
+    free (mapping->commands);
+    _cairo_recording_blob_destroy (mapping->blob);
+    free (mapping);
+}
+
+static cairo_status_t
+_cairo_recording_loader_load_recording (cairo_recording_loader_t *loader,
+					uint64_t		  offset,
+					cairo_surface_t		**surface_out)
+{
+    const cairo_recording_record_t *record;
+    const uint64_t *table;
+    cairo_recording_surface_t *recording;
+    cairo_recording_mapping_t *mapping;
+    cairo_rectangle_t extents;
+    cairo_surface_t *surface;
+    cairo_command_t **elements;
+    cairo_status_t status;
+    char *ptr;
+    size_t size;
+    unsigned int n;
+
+    record = _cairo_recording_loader_get (loader, offset, 1, sizeof (*record));
+    if (unlikely (record == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    if (! CAIRO_CONTENT_VALID (record->content))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    table = _cairo_recording_loader_get (loader, record->commands,
+					 record->num_commands,
+					 sizeof (uint64_t));
+    if (unlikely (table == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    /* Size the block for all the commands, checking each record */
+    size = 0;
+    for (n = 0; n < record->num_commands; n++) {
+	const cairo_recording_command_record_t *header;
+	size_t record_size;
+
+	header = _cairo_recording_loader_get (loader, table[n], 1,
+					      sizeof (*header));
+	if (unlikely (header == NULL))
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+	record_size = _cairo_recording_command_record_size (header->type);
+	if (unlikely (record_size == 0 ||
+		      _cairo_recording_loader_get (loader, table[n], 1,
+						   record_size) == NULL))
+	{
+	    return _cairo_error (CAIRO_STATUS_READ_ERROR);
+	}
+
+	size += _cairo_recording_command_size (header->type);
+    }
+
+    extents.x = record->extents[0];
+    extents.y = record->extents[1];
+    extents.width = record->extents[2];
+    extents.height = record->extents[3];
+    surface = cairo_recording_surface_create (record->content,
+					      record->unbounded ? NULL : &extents);
+    if (unlikely (surface->status))
+	return surface->status;
+
+    recording = (cairo_recording_surface_t *) surface;
+    _cairo_recording_device_transform_from_doubles (surface,
+						    record->device_transform);
+
+    mapping = _cairo_recording_mapping_create (loader->blob);
+    if (unlikely (mapping == NULL)) {
+	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	goto BAIL_SURFACE;
+    }
+
+    loader->current++;
+
+    if (size) {
+	mapping->commands = malloc (size);
+	if (unlikely (mapping->commands == NULL)) {
+	    status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	    goto BAIL_MAPPING;
+	}
+    }
+
+    status = _cairo_array_allocate (&recording->commands,
+				    record->num_commands,
+				    (void **) &elements);
+    if (unlikely (status))
+	goto BAIL_MAPPING;
+
+    ptr = mapping->commands;
+    for (n = 0; n < record->num_commands; n++) {
+	const cairo_recording_any_command_record_t *r =
+	    (const cairo_recording_any_command_record_t *) (loader->blob->data + table[n]);
+	cairo_command_t *command = (cairo_command_t *) ptr;
+
+	status = _cairo_recording_loader_init_command (loader, mapping,
+						       r, command);
+	if (unlikely (status)) {
+	    recording->commands.num_elements = 0;
+	    goto BAIL_MAPPING;
+	}
+
+	command->header.index = n;
+	elements[n] = command;
+	ptr += _cairo_recording_command_size (r->paint.type);
+
+	if (! _cairo_recording_command_is_thread_safe (command))
+	    recording->thread_safe = FALSE;
+    }
+
+    /* The commands are released along with the mapping */
+    recording->mapping = mapping;
+    recording->num_mapped = record->num_commands;
+    surface->is_clear = record->is_clear && record->num_commands == 0;
+
+    *surface_out = surface;
+    return CAIRO_STATUS_SUCCESS;
+
+BAIL_MAPPING:
+    _cairo_recording_mapping_destroy (mapping);
+BAIL_SURFACE:
+    cairo_surface_destroy (surface);
+    return status;
+}
+
+static cairo_status_t
+_cairo_recording_loader_load_surface (cairo_recording_loader_t *loader,
+				      uint64_t			offset,
+				      cairo_surface_t	      **surface_out)
+{
+    const cairo_recording_surface_record_t *record;
+    cairo_surface_t *surface;
+    cairo_status_t status;
+
+    record = _cairo_recording_loader_get (loader, offset, 1, sizeof (*record));
+    if (unlikely (record == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    switch (record->kind) {
+    case CAIRO_RECORDING_SURFACE_IMAGE:
+	status = _cairo_recording_loader_create_image (loader,
+						       record->format,
+						       record->width,
+						       record->height,
+						       record->stride,
+						       record->data,
+						       &surface);
+	if (unlikely (status))
+	    return status;
+
+	_cairo_recording_device_transform_from_doubles (surface,
+							record->device_transform);
+	break;
+
+    case CAIRO_RECORDING_SURFACE_RECORDING:
+	status = _cairo_recording_loader_load_recording (loader,
+							 record->data,
+							 &surface);
+	if (unlikely (status))
+	    return status;
+	break;
+
+    default:
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+    }
+
+    *surface_out = surface;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_loader_init (cairo_recording_loader_t *loader,
+			      cairo_recording_blob_t   *blob)
+{
+    const cairo_recording_file_header_t *header;
+
+    memset (loader, 0, sizeof (*loader));
+    loader->blob = blob;
+
+    header = _cairo_recording_loader_get (loader, 0, 1, sizeof (*header));
+    if (unlikely (header == NULL))
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+
+    if (memcmp (header->magic, CAIRO_RECORDING_FILE_MAGIC, sizeof (header->magic)) ||
+	header->version != CAIRO_RECORDING_FILE_VERSION ||
+	header->byte_order != CAIRO_RECORDING_FILE_BYTE_ORDER ||
+	header->stop_size != sizeof (cairo_gradient_stop_t) ||
+	header->patch_size != sizeof (cairo_mesh_patch_t) ||
+	header->glyph_size != sizeof (cairo_glyph_t) ||
+	header->length != blob->length)
+    {
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+    }
+
+    loader->header = header;
+    loader->surface_table = _cairo_recording_loader_get (loader,
+							 header->surfaces,
+							 header->num_surfaces,
+							 sizeof (uint64_t));
+    loader->font_table = _cairo_recording_loader_get (loader,
+						      header->fonts,
+						      header->num_fonts,
+						      sizeof (uint64_t));
+    loader->clip_table = _cairo_recording_loader_get (loader,
+						      header->clips,
+						      header->num_clips,
+						      sizeof (uint64_t));
+    if (unlikely (loader->surface_table == NULL ||
+		  loader->font_table == NULL ||
+		  loader->clip_table == NULL))
+    {
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
+    }
+
+    /* Each table is bounded by the size of the file, as is its count */
+    loader->surfaces = calloc (header->num_surfaces + 1, sizeof (cairo_surface_t *));
+    loader->surface_owner = calloc (header->num_surfaces + 1, sizeof (unsigned int));
+    loader->fonts = calloc (header->num_fonts + 1, sizeof (cairo_scaled_font_t *));
+    loader->font_owner = calloc (header->num_fonts + 1, sizeof (unsigned int));
+    loader->clips = calloc (header->num_clips + 1, sizeof (cairo_clip_t *));
+    loader->clip_owner = calloc (header->num_clips + 1, sizeof (unsigned int));
+    if (unlikely (loader->surfaces == NULL || loader->surface_owner == NULL ||
+		  loader->fonts == NULL || loader->font_owner == NULL ||
+		  loader->clips == NULL || loader->clip_owner == NULL))
+    {
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_recording_loader_fini (cairo_recording_loader_t *loader)
+{
+    unsigned int n;
+
+    if (loader->surfaces != NULL) {
+	for (n = 0; n < loader->num_surfaces; n++)
+	    cairo_surface_destroy (loader->surfaces[n]);
+	free (loader->surfaces);
+    }
+
+    if (loader->fonts != NULL) {
+	for (n = 0; n < loader->header->num_fonts; n++)
+	    cairo_scaled_font_destroy (loader->fonts[n]);
+	free (loader->fonts);
+    }
+
+    /* The clips belong to the mappings that created them */
+    free (loader->clips);
+
+    free (loader->surface_owner);
+    free (loader->font_owner);
+    free (loader->clip_owner);
+}
+
+static cairo_status_t
+_cairo_recording_loader_load (cairo_recording_loader_t *loader,
+			      cairo_surface_t	      **surface_out)
+{
+    cairo_status_t status;
+    unsigned int n;
+
+    for (n = 0; n < loader->header->num_fonts; n++) {
+	status = _cairo_recording_loader_load_font (loader,
+						    loader->font_table[n],
+						    &loader->fonts[n]);
+	if (unlikely (status))
+	    return status;
+    }
+
+    /* Nested recordings only refer to the surfaces before them */
+    for (n = 0; n < loader->header->num_surfaces; n++) {
+	status = _cairo_recording_loader_load_surface (loader,
+						       loader->surface_table[n],
+						       &loader->surfaces[n]);
+	if (unlikely (status))
+	    return status;
+
+	loader->num_surfaces++;
+    }
+
+    return _cairo_recording_loader_load_recording (loader,
+						   loader->header->root,
+						   surface_out);
+}
+
+/**
+ * cairo_recording_surface_create_from_file:
+ * @filename: name of a file written by
+ * cairo_recording_surface_write_to_file()
+ *
+ * Creates a new recording surface holding the commands stored in
+ * @filename.
+ *
+ * The file is read into memory in one piece, and the loaded commands,
+ * images and glyphs refer directly to that copy instead of being
+ * copied again, so loading a large recording is quick. The file may be
+ * modified or removed as soon as this function returns.
+ *
+ * The new surface may be drawn upon, replayed or used as a source
+ * just like a recording surface created by
+ * cairo_recording_surface_create().
+ *
+ * Return value: a pointer to the newly created surface. The caller
+ * owns the surface and should call cairo_surface_destroy() when done
+ * with it.
+ *
+ * This function always returns a valid pointer, but it will return a
+ * pointer to a "nil" surface if an error such as out of memory
+ * occurs. You can use cairo_surface_status() to check for this. The
+ * status is %CAIRO_STATUS_FILE_NOT_FOUND if the file does not exist,
+ * or %CAIRO_STATUS_READ_ERROR if it could not be read or was not
+ * written by a compatible version of cairo.
+ *
+ * Since: 1.14
+ **/
+cairo_surface_t *
+cairo_recording_surface_create_from_file (const char *filename)
+{
+    cairo_recording_blob_t *blob = NULL;
+    cairo_recording_loader_t loader;
+    cairo_surface_t *surface;
+    cairo_status_t status;
+
+    status = _cairo_recording_blob_create_from_file (filename, &blob);
+    if (unlikely (status))
+	return _cairo_surface_create_in_error (status);
+
+    status = _cairo_recording_loader_init (&loader, blob);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = _cairo_recording_loader_load (&loader, &surface);
+    _cairo_recording_loader_fini (&loader);
+    _cairo_recording_blob_destroy (blob);
+
+    if (unlikely (status))
+	return _cairo_surface_create_in_error (status);
+
+    return surface;
+}
@@ -83,12 +83,16 @@
 #include "cairo-clip-private.h"
 #include "cairo-combsort-inline.h"
 #include "cairo-composite-rectangles-private.h"
+#include "cairo-damage-private.h"
 #include "cairo-default-context-private.h"
 #include "cairo-error-private.h"
-#include "cairo-image-surface-private.h"
+#include "cairo-image-surface-inline.h"
+#include "cairo-list-inline.h"
 #include "cairo-recording-surface-inline.h"
+#include "cairo-region-private.h"
 #include "cairo-surface-snapshot-inline.h"
 #include "cairo-surface-wrapper-private.h"
+#include "cairo-thread-pool-private.h"
 #include "cairo-traps-private.h"
 
 typedef enum {
@@ -117,246 +121,324 @@ static const cairo_surface_backend_t cairo_recording_surface_backend;
  * according to the intended replay target).
  */
 
-static int bbtree_left_or_right (struct bbtree *bbt,
-				 const cairo_box_t *box)
-{
-    int left, right;
-
-    if (bbt->left) {
-	cairo_box_t *e = &bbt->left->extents;
-	cairo_box_t b;
-
-	b.p1.x = MIN (e->p1.x, box->p1.x);
-	b.p1.y = MIN (e->p1.y, box->p1.y);
-	b.p2.x = MAX (e->p2.x, box->p2.x);
-	b.p2.y = MAX (e->p2.y, box->p2.y);
-
-	left = _cairo_fixed_integer_part (b.p2.x - b.p1.x) * _cairo_fixed_integer_part (b.p2.y - b.p1.y);
-	left -= _cairo_fixed_integer_part (e->p2.x - e->p1.x) * _cairo_fixed_integer_part (e->p2.y - e->p1.y);
-    } else
-	left = 0;
-
-    if (bbt->right) {
-	cairo_box_t *e = &bbt->right->extents;
-	cairo_box_t b;
-
-	b.p1.x = MIN (e->p1.x, box->p1.x);
-	b.p1.y = MIN (e->p1.y, box->p1.y);
-	b.p2.x = MAX (e->p2.x, box->p2.x);
-	b.p2.y = MAX (e->p2.y, box->p2.y);
-
-	right = _cairo_fixed_integer_part (b.p2.x - b.p1.x) * _cairo_fixed_integer_part (b.p2.y - b.p1.y);
-	right -= _cairo_fixed_integer_part (e->p2.x - e->p1.x) * _cairo_fixed_integer_part (e->p2.y - e->p1.y);
-    } else
-	right = 0;
+/* The commands are indexed by a packed R-tree, bulk-loaded the first
+ * time a replay needs to find the commands visible in some area.
+ *
+ * The leaves hold the commands sorted along a Hilbert curve through
+ * the centres of their extents, RTREE_FANOUT at a time, and each level
+ * of nodes groups RTREE_FANOUT consecutive nodes of the level below.
+ * Neighbours along the curve are neighbours on the page, so the nodes
+ * stay tight even when the drawing jumps around (a chart drawing each
+ * series across the whole plot, say). The commands found by a query
+ * are then sorted back into recording order.
+ *
+ * Commands covering a large part of the drawing (backgrounds,
+ * unbounded operators) would inflate every node above them, so they
+ * are kept apart in a list of their own and merged into the result.
+ */
+#define RTREE_FANOUT 16
+#define RTREE_LARGE_FRACTION 8
 
-    return left <= right;
+static cairo_bool_t box_outside (const cairo_box_t *a, const cairo_box_t *b)
+{
+    return
+	a->p1.x >= b->p2.x || a->p1.y >= b->p2.y ||
+	a->p2.x <= b->p1.x || a->p2.y <= b->p1.y;
 }
 
-#define INVALID_CHAIN ((cairo_command_header_t *)-1)
+static void
+box_add_box (cairo_box_t *box, const cairo_box_t *other)
+{
+    box->p1.x = MIN (box->p1.x, other->p1.x);
+    box->p1.y = MIN (box->p1.y, other->p1.y);
+    box->p2.x = MAX (box->p2.x, other->p2.x);
+    box->p2.y = MAX (box->p2.y, other->p2.y);
+}
 
-static struct bbtree *
-bbtree_new (const cairo_box_t *box, cairo_command_header_t *chain)
+static void
+_cairo_recording_surface_destroy_rtree (cairo_recording_surface_t *surface)
 {
-    struct bbtree *bbt = malloc (sizeof (*bbt));
-    if (bbt == NULL)
-	return NULL;
-    bbt->extents = *box;
-    bbt->left = bbt->right = NULL;
-    bbt->chain = chain;
-    return bbt;
+    struct _cairo_recording_rtree *rtree = &surface->rtree;
+
+    free (rtree->entries);
+    rtree->entries = NULL;
+    free (rtree->boxes);
+    rtree->boxes = NULL;
+
+    rtree->valid = FALSE;
 }
 
 static void
-bbtree_init (struct bbtree *bbt, cairo_command_header_t *header)
+_cairo_recording_surface_destroy_occlusion (cairo_recording_surface_t *surface)
 {
-    _cairo_box_from_rectangle (&bbt->extents, &header->extents);
-    bbt->chain = header;
+    free (surface->occlusion.hidden);
+    surface->occlusion.hidden = NULL;
+    surface->occlusion.num_hidden = 0;
+    surface->occlusion.valid = FALSE;
 }
 
-static cairo_status_t
-bbtree_add (struct bbtree *bbt,
-	    cairo_command_header_t *header,
-	    const cairo_box_t *box)
+/* The area a command has to cover to be kept out of the tree */
+static double
+_cairo_recording_surface_large_area (cairo_recording_surface_t *surface)
 {
-    if (box->p1.x < bbt->extents.p1.x || box->p1.y < bbt->extents.p1.y ||
-	box->p2.x > bbt->extents.p2.x || box->p2.y > bbt->extents.p2.y)
-    {
-	if (bbt->chain) {
-	    if (bbtree_left_or_right (bbt, &bbt->extents)) {
-		if (bbt->left == NULL) {
-		    bbt->left = bbtree_new (&bbt->extents, bbt->chain);
-		    if (unlikely (bbt->left == NULL))
-			return _cairo_error (CAIRO_STATUS_NO_MEMORY);
-		} else
-		    bbtree_add (bbt->left, bbt->chain, &bbt->extents);
+    cairo_command_t **elements = _cairo_array_index (&surface->commands, 0);
+    cairo_rectangle_int_t extents;
+    unsigned int i, count;
+    cairo_bool_t empty;
+
+    if (! surface->unbounded) {
+	extents = surface->extents;
+    } else {
+	count = surface->commands.num_elements;
+	empty = TRUE;
+	for (i = 0; i < count; i++) {
+	    const cairo_rectangle_int_t *r = &elements[i]->header.extents;
+
+	    if (r->width == _cairo_unbounded_rectangle.width ||
+		r->height == _cairo_unbounded_rectangle.height)
+		continue;
+
+	    if (empty) {
+		extents = *r;
+		empty = FALSE;
 	    } else {
-		if (bbt->right == NULL) {
-		    bbt->right = bbtree_new (&bbt->extents, bbt->chain);
-		    if (unlikely (bbt->right == NULL))
-			return _cairo_error (CAIRO_STATUS_NO_MEMORY);
-		} else
-		    bbtree_add (bbt->right, bbt->chain, &bbt->extents);
+		_cairo_rectangle_union (&extents, r);
 	    }
-
-	    bbt->chain = NULL;
 	}
-
-	bbt->extents.p1.x = MIN (bbt->extents.p1.x, box->p1.x);
-	bbt->extents.p1.y = MIN (bbt->extents.p1.y, box->p1.y);
-	bbt->extents.p2.x = MAX (bbt->extents.p2.x, box->p2.x);
-	bbt->extents.p2.y = MAX (bbt->extents.p2.y, box->p2.y);
-    }
-
-    if (box->p1.x == bbt->extents.p1.x && box->p1.y == bbt->extents.p1.y &&
-	box->p2.x == bbt->extents.p2.x && box->p2.y == bbt->extents.p2.y)
-    {
-	cairo_command_header_t *last = header;
-	while (last->chain) /* expected to be infrequent */
-	    last = last->chain;
-	last->chain = bbt->chain;
-	bbt->chain = header;
-	return CAIRO_STATUS_SUCCESS;
-    }
-
-    if (bbtree_left_or_right (bbt, box)) {
-	if (bbt->left == NULL) {
-	    bbt->left = bbtree_new (box, header);
-	    if (unlikely (bbt->left == NULL))
-		return _cairo_error (CAIRO_STATUS_NO_MEMORY);
-	} else
-	    return bbtree_add (bbt->left, header, box);
-    } else {
-	if (bbt->right == NULL) {
-	    bbt->right = bbtree_new (box, header);
-	    if (unlikely (bbt->right == NULL))
-		return _cairo_error (CAIRO_STATUS_NO_MEMORY);
-	} else
-	    return bbtree_add (bbt->right, header, box);
+	if (empty)
+	    return 0;
     }
 
-    return CAIRO_STATUS_SUCCESS;
+    return (double) extents.width * extents.height / RTREE_LARGE_FRACTION;
 }
 
-static void bbtree_del (struct bbtree *bbt)
+#define RTREE_HILBERT_ORDER 16
+
+/* Distance along the Hilbert curve filling the 2^16 x 2^16 grid */
+static uint32_t
+_cairo_recording_hilbert_distance (uint32_t x, uint32_t y)
 {
-    if (bbt->left)
-	bbtree_del (bbt->left);
-    if (bbt->right)
-	bbtree_del (bbt->right);
+    const uint32_t last = (1 << RTREE_HILBERT_ORDER) - 1;
+    uint32_t s, d = 0;
 
-    free (bbt);
-}
+    for (s = 1 << (RTREE_HILBERT_ORDER - 1); s; s >>= 1) {
+	uint32_t rx = (x & s) != 0;
+	uint32_t ry = (y & s) != 0;
 
-static cairo_bool_t box_outside (const cairo_box_t *a, const cairo_box_t *b)
-{
-    return
-	a->p1.x >= b->p2.x || a->p1.y >= b->p2.y ||
-	a->p2.x <= b->p1.x || a->p2.y <= b->p1.y;
-}
+	d += s * s * ((3 * rx) ^ ry);
 
-static void
-bbtree_foreach_mark_visible (struct bbtree *bbt,
-			     const cairo_box_t *box,
-			     unsigned int **indices)
-{
-    cairo_command_header_t *chain;
+	/* rotate the quadrant so that the curve is continuous */
+	if (ry == 0) {
+	    uint32_t t;
 
-    for (chain = bbt->chain; chain; chain = chain->chain)
-	*(*indices)++ = chain->index;
+	    if (rx) {
+		x = last - x;
+		y = last - y;
+	    }
+	    t = x; x = y; y = t;
+	}
+    }
 
-    if (bbt->left && ! box_outside (box, &bbt->left->extents))
-	bbtree_foreach_mark_visible (bbt->left, box, indices);
-    if (bbt->right && ! box_outside (box, &bbt->right->extents))
-	bbtree_foreach_mark_visible (bbt->right, box, indices);
+    return d;
 }
 
-static inline int intcmp (const unsigned int a, const unsigned int b)
-{
-    return a - b;
-}
-CAIRO_COMBSORT_DECLARE (sort_indices, unsigned int, intcmp)
+typedef struct _cairo_recording_rtree_key {
+    uint32_t distance;
+    unsigned int index;
+} cairo_recording_rtree_key_t;
 
-static inline int sizecmp (unsigned int a, unsigned int b, cairo_command_header_t **elements)
+static inline int
+_cairo_recording_rtree_key_compare (cairo_recording_rtree_key_t a,
+				    cairo_recording_rtree_key_t b)
 {
-    const cairo_rectangle_int_t *r;
-
-    r = &elements[a]->extents;
-    a = r->width * r->height;
+    if (a.distance != b.distance)
+	return a.distance < b.distance ? -1 : 1;
+    return a.index < b.index ? -1 : a.index > b.index;
+}
 
-    r = &elements[b]->extents;
-    b = r->width * r->height;
+CAIRO_COMBSORT_DECLARE (_cairo_recording_rtree_key_sort,
+			cairo_recording_rtree_key_t,
+			_cairo_recording_rtree_key_compare)
 
-    return b - a;
+static inline int
+_cairo_recording_index_compare (unsigned int a, unsigned int b)
+{
+    return a < b ? -1 : a > b;
 }
-CAIRO_COMBSORT_DECLARE_WITH_DATA (sort_commands, unsigned int, sizecmp)
 
-static void
-_cairo_recording_surface_destroy_bbtree (cairo_recording_surface_t *surface)
+CAIRO_COMBSORT_DECLARE (_cairo_recording_index_sort,
+			unsigned int,
+			_cairo_recording_index_compare)
+
+/* Reorder the leaves of @rtree along the Hilbert curve */
+static cairo_status_t
+_cairo_recording_rtree_sort_leaves (struct _cairo_recording_rtree *rtree,
+				    cairo_command_t **elements)
 {
-    cairo_command_t **elements;
-    int i, num_elements;
+    cairo_recording_rtree_key_t *keys;
+    cairo_rectangle_int_t bounds;
+    unsigned int i, n = rtree->num_entries;
+    int64_t width, height;
 
-    if (surface->bbtree.chain == INVALID_CHAIN)
-	return;
+    if (n <= RTREE_FANOUT)
+	return CAIRO_STATUS_SUCCESS;
 
-    if (surface->bbtree.left) {
-	bbtree_del (surface->bbtree.left);
-	surface->bbtree.left = NULL;
-    }
-    if (surface->bbtree.right) {
-	bbtree_del (surface->bbtree.right);
-	surface->bbtree.right = NULL;
+    keys = _cairo_malloc_ab (n, sizeof (cairo_recording_rtree_key_t));
+    if (unlikely (keys == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    bounds = elements[rtree->entries[0]]->header.extents;
+    for (i = 1; i < n; i++)
+	_cairo_rectangle_union (&bounds, &elements[rtree->entries[i]]->header.extents);
+
+    /* Map twice the centres onto the grid, to stay in integers */
+    width = 2 * (int64_t) bounds.width + 1;
+    height = 2 * (int64_t) bounds.height + 1;
+    for (i = 0; i < n; i++) {
+	const cairo_rectangle_int_t *r = &elements[rtree->entries[i]]->header.extents;
+	int64_t x = 2 * ((int64_t) r->x - bounds.x) + r->width;
+	int64_t y = 2 * ((int64_t) r->y - bounds.y) + r->height;
+
+	keys[i].distance =
+	    _cairo_recording_hilbert_distance ((x << RTREE_HILBERT_ORDER) / width,
+					       (y << RTREE_HILBERT_ORDER) / height);
+	keys[i].index = rtree->entries[i];
     }
 
-    elements = _cairo_array_index (&surface->commands, 0);
-    num_elements = surface->commands.num_elements;
-    for (i = 0; i < num_elements; i++)
-	elements[i]->header.chain = NULL;
+    _cairo_recording_rtree_key_sort (keys, n);
+    for (i = 0; i < n; i++)
+	rtree->entries[i] = keys[i].index;
 
-    surface->bbtree.chain = INVALID_CHAIN;
+    free (keys);
+    return CAIRO_STATUS_SUCCESS;
 }
 
 static cairo_status_t
-_cairo_recording_surface_create_bbtree (cairo_recording_surface_t *surface)
+_cairo_recording_surface_create_rtree (cairo_recording_surface_t *surface)
 {
+    struct _cairo_recording_rtree *rtree = &surface->rtree;
     cairo_command_t **elements = _cairo_array_index (&surface->commands, 0);
-    unsigned int *indices;
+    unsigned int i, n, level, count, num_large, num_boxes;
+    cairo_box_t *boxes;
     cairo_status_t status;
-    unsigned int i, count;
+    double large_area;
 
     count = surface->commands.num_elements;
     if (count > surface->num_indices) {
 	free (surface->indices);
 	surface->indices = _cairo_malloc_ab (count, sizeof (int));
-	if (unlikely (surface->indices == NULL))
+	if (unlikely (surface->indices == NULL)) {
+	    surface->num_indices = 0;
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	}
 
 	surface->num_indices = count;
     }
 
-    indices = surface->indices;
-    for (i = 0; i < count; i++)
-	indices[i] = i;
+    rtree->entries = _cairo_malloc_ab (count, sizeof (unsigned int));
+    if (unlikely (rtree->entries == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    /* Split the commands between the leaves and the list of large
+     * ones, which is kept at the end of the entries. */
+    large_area = _cairo_recording_surface_large_area (surface);
+    rtree->num_entries = 0;
+    num_large = 0;
+    for (i = 0; i < count; i++) {
+	const cairo_rectangle_int_t *r = &elements[i]->header.extents;
+
+	if ((double) r->width * r->height > large_area)
+	    rtree->entries[count - ++num_large] = i;
+	else
+	    rtree->entries[rtree->num_entries++] = i;
+    }
+    for (i = 0; i < num_large / 2; i++) {
+	unsigned int t = rtree->entries[count - num_large + i];
+	rtree->entries[count - num_large + i] = rtree->entries[count - 1 - i];
+	rtree->entries[count - 1 - i] = t;
+    }
 
-    sort_commands (indices, count, elements);
+    status = _cairo_recording_rtree_sort_leaves (rtree, elements);
+    if (unlikely (status)) {
+	free (rtree->entries);
+	rtree->entries = NULL;
+	return status;
+    }
 
-    bbtree_init (&surface->bbtree, &elements[indices[0]]->header);
-    for (i = 1; i < count; i++) {
-	cairo_command_header_t *header = &elements[indices[i]]->header;
-	cairo_box_t box;
+    /* Lay out the levels, from the leaves up to a single root */
+    rtree->num_levels = 0;
+    num_boxes = 0;
+    n = rtree->num_entries;
+    while (n) {
+	assert (rtree->num_levels < CAIRO_RECORDING_RTREE_MAX_LEVELS);
+	rtree->level_start[rtree->num_levels] = num_boxes;
+	rtree->level_count[rtree->num_levels] = n;
+	rtree->num_levels++;
+	num_boxes += n;
+	if (n == 1)
+	    break;
+	n = (n + RTREE_FANOUT - 1) / RTREE_FANOUT;
+    }
 
-	_cairo_box_from_rectangle (&box, &header->extents);
-	status = bbtree_add (&surface->bbtree, header, &box);
-	if (unlikely (status))
-	    goto cleanup;
+    rtree->boxes = NULL;
+    if (num_boxes) {
+	rtree->boxes = _cairo_malloc_ab (num_boxes, sizeof (cairo_box_t));
+	if (unlikely (rtree->boxes == NULL)) {
+	    free (rtree->entries);
+	    rtree->entries = NULL;
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	}
+    }
+
+    boxes = rtree->boxes;
+    for (i = 0; i < rtree->num_entries; i++)
+	_cairo_box_from_rectangle (&boxes[i],
+				   &elements[rtree->entries[i]]->header.extents);
+
+    for (level = 1; level < rtree->num_levels; level++) {
+	const cairo_box_t *child = rtree->boxes + rtree->level_start[level - 1];
+	unsigned int num_children = rtree->level_count[level - 1];
+
+	boxes = rtree->boxes + rtree->level_start[level];
+	for (n = 0; n < rtree->level_count[level]; n++) {
+	    unsigned int last = MIN ((n + 1) * RTREE_FANOUT, num_children);
+
+	    i = n * RTREE_FANOUT;
+	    boxes[n] = child[i];
+	    while (++i < last)
+		box_add_box (&boxes[n], &child[i]);
+	}
     }
 
+    rtree->valid = TRUE;
     return CAIRO_STATUS_SUCCESS;
+}
 
-cleanup:
-    bbtree_del (&surface->bbtree);
-    return status;
+static void
+_cairo_recording_rtree_query (const struct _cairo_recording_rtree *rtree,
+			      unsigned int level,
+			      unsigned int first,
+			      unsigned int last,
+			      const cairo_box_t *box,
+			      unsigned int **indices)
+{
+    const cairo_box_t *boxes = rtree->boxes + rtree->level_start[level];
+    unsigned int i;
+
+    for (i = first; i < last; i++) {
+	if (box_outside (box, &boxes[i]))
+	    continue;
+
+	if (level == 0) {
+	    *(*indices)++ = rtree->entries[i];
+	} else {
+	    _cairo_recording_rtree_query (rtree, level - 1,
+					  i * RTREE_FANOUT,
+					  MIN ((i + 1) * RTREE_FANOUT,
+					       rtree->level_count[level - 1]),
+					  box, indices);
+	}
+    }
 }
 
 /**
@@ -415,14 +497,33 @@ cairo_recording_surface_create (cairo_content_t		 content,
 
     surface->base.is_clear = TRUE;
 
-    surface->bbtree.left = surface->bbtree.right = NULL;
-    surface->bbtree.chain = INVALID_CHAIN;
+    surface->rtree.valid = FALSE;
+    surface->rtree.entries = NULL;
+    surface->rtree.boxes = NULL;
+
+    surface->occlusion.valid = FALSE;
+    surface->occlusion.hidden = NULL;
+    surface->occlusion.num_hidden = 0;
+
+    surface->coalesce_commands = FALSE;
+    surface->cull_hidden_commands = FALSE;
+    surface->coalesced.valid = FALSE;
+    surface->coalesced.commands = NULL;
+    surface->coalesced.indices = NULL;
+    surface->coalesced.num_commands = 0;
+    surface->coalesced.merged = NULL;
+    surface->coalesced.num_merged = 0;
+
+    surface->rendering = NULL;
 
     surface->indices = NULL;
     surface->num_indices = 0;
+    surface->mapping = NULL;
+    surface->num_mapped = 0;
     surface->optimize_clears = TRUE;
     surface->has_bilevel_alpha = FALSE;
     surface->has_only_op_over = FALSE;
+    surface->thread_safe = TRUE;
 
     return &surface->base;
 }
@@ -441,6 +542,83 @@ _cairo_recording_surface_create_similar (void		       *abstract_surface,
     return cairo_recording_surface_create (content, &extents);
 }
 
+static void
+_cairo_recording_command_destroy (cairo_command_t *command)
+{
+    switch (command->header.type) {
+    case CAIRO_COMMAND_PAINT:
+	_cairo_pattern_fini (&command->paint.source.base);
+	break;
+
+    case CAIRO_COMMAND_MASK:
+	_cairo_pattern_fini (&command->mask.source.base);
+	_cairo_pattern_fini (&command->mask.mask.base);
+	break;
+
+    case CAIRO_COMMAND_STROKE:
+	_cairo_pattern_fini (&command->stroke.source.base);
+	_cairo_path_fixed_fini (&command->stroke.path);
+	_cairo_stroke_style_fini (&command->stroke.style);
+	break;
+
+    case CAIRO_COMMAND_FILL:
+	_cairo_pattern_fini (&command->fill.source.base);
+	_cairo_path_fixed_fini (&command->fill.path);
+	break;
+
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+	_cairo_pattern_fini (&command->show_text_glyphs.source.base);
+	free (command->show_text_glyphs.utf8);
+	free (command->show_text_glyphs.glyphs);
+	free (command->show_text_glyphs.clusters);
+	cairo_scaled_font_destroy (command->show_text_glyphs.scaled_font);
+	break;
+
+    default:
+	ASSERT_NOT_REACHED;
+    }
+
+    _cairo_clip_destroy (command->header.clip);
+    free (command);
+}
+
+static void
+_cairo_recording_surface_destroy_coalesced (cairo_recording_surface_t *surface)
+{
+    struct _cairo_recording_coalesced *coalesced = &surface->coalesced;
+    unsigned int i;
+
+    for (i = 0; i < coalesced->num_merged; i++)
+	_cairo_recording_command_destroy (coalesced->merged[i]);
+    free (coalesced->merged);
+    coalesced->merged = NULL;
+    coalesced->num_merged = 0;
+
+    free (coalesced->commands);
+    coalesced->commands = NULL;
+    free (coalesced->indices);
+    coalesced->indices = NULL;
+    coalesced->num_commands = 0;
+
+    coalesced->valid = FALSE;
+}
+
+/* Drop everything derived from the commands, after some have been
+ * recorded over @extents, and mark the cached rendering as damaged */
+static void
+_cairo_recording_surface_invalidate (cairo_recording_surface_t *surface,
+				     const cairo_rectangle_int_t *extents)
+{
+    _cairo_recording_surface_destroy_rtree (surface);
+    _cairo_recording_surface_destroy_occlusion (surface);
+    _cairo_recording_surface_destroy_coalesced (surface);
+
+    if (surface->base.damage != NULL) {
+	surface->base.damage = _cairo_damage_add_rectangle (surface->base.damage,
+							    extents);
+    }
+}
+
 static cairo_status_t
 _cairo_recording_surface_finish (void *abstract_surface)
 {
@@ -450,52 +628,27 @@ _cairo_recording_surface_finish (void *abstract_surface)
 
     num_elements = surface->commands.num_elements;
     elements = _cairo_array_index (&surface->commands, 0);
-    for (i = 0; i < num_elements; i++) {
-	cairo_command_t *command = elements[i];
-
-	switch (command->header.type) {
-	case CAIRO_COMMAND_PAINT:
-	    _cairo_pattern_fini (&command->paint.source.base);
-	    break;
-
-	case CAIRO_COMMAND_MASK:
-	    _cairo_pattern_fini (&command->mask.source.base);
-	    _cairo_pattern_fini (&command->mask.mask.base);
-	    break;
-
-	case CAIRO_COMMAND_STROKE:
-	    _cairo_pattern_fini (&command->stroke.source.base);
-	    _cairo_path_fixed_fini (&command->stroke.path);
-	    _cairo_stroke_style_fini (&command->stroke.style);
-	    break;
-
-	case CAIRO_COMMAND_FILL:
-	    _cairo_pattern_fini (&command->fill.source.base);
-	    _cairo_path_fixed_fini (&command->fill.path);
-	    break;
-
-	case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
-	    _cairo_pattern_fini (&command->show_text_glyphs.source.base);
-	    free (command->show_text_glyphs.utf8);
-	    free (command->show_text_glyphs.glyphs);
-	    free (command->show_text_glyphs.clusters);
-	    cairo_scaled_font_destroy (command->show_text_glyphs.scaled_font);
-	    break;
+    for (i = surface->num_mapped; i < num_elements; i++)
+	_cairo_recording_command_destroy (elements[i]);
 
-	default:
-	    ASSERT_NOT_REACHED;
-	}
+    _cairo_array_fini (&surface->commands);
 
-	_cairo_clip_destroy (command->header.clip);
-	free (command);
+    if (surface->mapping != NULL) {
+	_cairo_recording_mapping_destroy (surface->mapping);
+	surface->mapping = NULL;
+	surface->num_mapped = 0;
     }
 
-    _cairo_array_fini (&surface->commands);
+    _cairo_recording_surface_destroy_rtree (surface);
+    _cairo_recording_surface_destroy_occlusion (surface);
+    _cairo_recording_surface_destroy_coalesced (surface);
 
-    if (surface->bbtree.left)
-	bbtree_del (surface->bbtree.left);
-    if (surface->bbtree.right)
-	bbtree_del (surface->bbtree.right);
+    cairo_surface_destroy (surface->rendering);
+    surface->rendering = NULL;
+    if (surface->base.damage != NULL) {
+	_cairo_damage_destroy (surface->base.damage);
+	surface->base.damage = NULL;
+    }
 
     free (surface->indices);
 
@@ -639,7 +792,6 @@ _command_init (cairo_recording_surface_t *surface,
     command->region = CAIRO_RECORDING_REGION_ALL;
 
     command->extents = composite->unbounded;
-    command->chain = NULL;
     command->index = surface->commands.num_elements;
 
     /* steal the clip */
@@ -665,20 +817,50 @@ _cairo_recording_surface_commit (cairo_recording_surface_t *surface,
 				 cairo_command_header_t *command)
 {
     _cairo_recording_surface_break_self_copy_loop (surface);
+
+    if (! _cairo_recording_command_is_thread_safe ((cairo_command_t *) command))
+	surface->thread_safe = FALSE;
+
     return _cairo_array_append (&surface->commands, &command);
 }
 
 static void
 _cairo_recording_surface_reset (cairo_recording_surface_t *surface)
 {
-    /* Reset the commands and temporaries */
+    cairo_surface_t *rendering = surface->rendering;
+    cairo_damage_t *damage = surface->base.damage;
+
+    /* Reset the commands and temporaries, but keep the rendering */
+    surface->rendering = NULL;
+    surface->base.damage = NULL;
     _cairo_recording_surface_finish (surface);
 
-    surface->bbtree.left = surface->bbtree.right = NULL;
-    surface->bbtree.chain = INVALID_CHAIN;
+    surface->rtree.valid = FALSE;
+    surface->rtree.entries = NULL;
+    surface->rtree.boxes = NULL;
+
+    surface->occlusion.valid = FALSE;
+    surface->occlusion.hidden = NULL;
+    surface->occlusion.num_hidden = 0;
+
+    surface->coalesced.valid = FALSE;
+    surface->coalesced.commands = NULL;
+    surface->coalesced.indices = NULL;
+    surface->coalesced.num_commands = 0;
+    surface->coalesced.merged = NULL;
+    surface->coalesced.num_merged = 0;
+
+    /* All of which now needs to be drawn again */
+    surface->rendering = rendering;
+    surface->base.damage = damage;
+    if (damage != NULL) {
+	surface->base.damage = _cairo_damage_add_rectangle (damage,
+							    &surface->extents);
+    }
 
     surface->indices = NULL;
     surface->num_indices = 0;
+    surface->thread_safe = TRUE;
 
     _cairo_array_init (&surface->commands, sizeof (cairo_command_t *));
 }
@@ -757,7 +939,7 @@ _cairo_recording_surface_paint (void			  *abstract_surface,
     if (unlikely (status))
 	goto CLEANUP_SOURCE;
 
-    _cairo_recording_surface_destroy_bbtree (surface);
+    _cairo_recording_surface_invalidate (surface, &command->header.extents);
 
     _cairo_composite_rectangles_fini (&composite);
     return CAIRO_STATUS_SUCCESS;
@@ -817,7 +999,7 @@ _cairo_recording_surface_mask (void			*abstract_surface,
     if (unlikely (status))
 	goto CLEANUP_MASK;
 
-    _cairo_recording_surface_destroy_bbtree (surface);
+    _cairo_recording_surface_invalidate (surface, &command->header.extents);
 
     _cairo_composite_rectangles_fini (&composite);
     return CAIRO_STATUS_SUCCESS;
@@ -894,7 +1076,7 @@ _cairo_recording_surface_stroke (void			*abstract_surface,
     if (unlikely (status))
 	goto CLEANUP_STYLE;
 
-    _cairo_recording_surface_destroy_bbtree (surface);
+    _cairo_recording_surface_invalidate (surface, &command->header.extents);
 
     _cairo_composite_rectangles_fini (&composite);
     return CAIRO_STATUS_SUCCESS;
@@ -965,7 +1147,7 @@ _cairo_recording_surface_fill (void			*abstract_surface,
     if (unlikely (status))
 	goto CLEANUP_PATH;
 
-    _cairo_recording_surface_destroy_bbtree (surface);
+    _cairo_recording_surface_invalidate (surface, &command->header.extents);
 
     _cairo_composite_rectangles_fini (&composite);
     return CAIRO_STATUS_SUCCESS;
@@ -1075,6 +1257,8 @@ _cairo_recording_surface_show_text_glyphs (void				*abstract_surface,
     if (unlikely (status))
 	goto CLEANUP_SCALED_FONT;
 
+    _cairo_recording_surface_invalidate (surface, &command->header.extents);
+
     _cairo_composite_rectangles_fini (&composite);
     return CAIRO_STATUS_SUCCESS;
 
@@ -1104,7 +1288,6 @@ _command_init_copy (cairo_recording_surface_t *surface,
     dst->region = CAIRO_RECORDING_REGION_ALL;
 
     dst->extents = src->extents;
-    dst->chain = NULL;
     dst->index = surface->commands.num_elements;
 
     dst->clip = _cairo_clip_copy (src->clip);
@@ -1439,11 +1622,30 @@ _cairo_recording_surface_snapshot (void *abstract_other)
 
     surface->base.is_clear = other->base.is_clear;
 
-    surface->bbtree.left = surface->bbtree.right = NULL;
-    surface->bbtree.chain = INVALID_CHAIN;
+    surface->rtree.valid = FALSE;
+    surface->rtree.entries = NULL;
+    surface->rtree.boxes = NULL;
+
+    surface->occlusion.valid = FALSE;
+    surface->occlusion.hidden = NULL;
+    surface->occlusion.num_hidden = 0;
+
+    surface->coalesce_commands = other->coalesce_commands;
+    surface->cull_hidden_commands = other->cull_hidden_commands;
+    surface->thread_safe = TRUE;
+    surface->coalesced.valid = FALSE;
+    surface->coalesced.commands = NULL;
+    surface->coalesced.indices = NULL;
+    surface->coalesced.num_commands = 0;
+    surface->coalesced.merged = NULL;
+    surface->coalesced.num_merged = 0;
+
+    surface->rendering = NULL;
 
     surface->indices = NULL;
     surface->num_indices = 0;
+    surface->mapping = NULL;
+    surface->num_mapped = 0;
     surface->optimize_clears = TRUE;
 
     _cairo_array_init (&surface->commands, sizeof (cairo_command_t *));
@@ -1582,70 +1784,780 @@ _cairo_recording_surface_get_path (cairo_surface_t    *abstract_surface,
     return status;
 }
 
+/* Collect the indices of the commands intersecting @extents, in order,
+ * into *@visible, which defaults to the surface's own array. */
 static int
 _cairo_recording_surface_get_visible_commands (cairo_recording_surface_t *surface,
-					       const cairo_rectangle_int_t *extents)
+					       const cairo_rectangle_int_t *extents,
+					       unsigned int **visible)
 {
-    unsigned int num_visible, *indices;
+    struct _cairo_recording_rtree *rtree = &surface->rtree;
+    cairo_command_t **elements;
+    unsigned int *indices, *large;
+    unsigned int i, j, n, num_large, num_visible;
     cairo_box_t box;
 
     if (surface->commands.num_elements == 0)
 	    return 0;
 
+    if (! rtree->valid &&
+	_cairo_recording_surface_create_rtree (surface))
+	return surface->commands.num_elements;
+
+    if (*visible == NULL)
+	*visible = surface->indices;
+
     _cairo_box_from_rectangle (&box, extents);
 
-    if (surface->bbtree.chain == INVALID_CHAIN)
-	_cairo_recording_surface_create_bbtree (surface);
+    indices = *visible;
+    if (rtree->num_levels) {
+	unsigned int top = rtree->num_levels - 1;
+
+	_cairo_recording_rtree_query (rtree, top,
+				      0, rtree->level_count[top],
+				      &box, &indices);
+    }
+    n = indices - *visible;
+    if (n > 1)
+	_cairo_recording_index_sort (*visible, n);
+
+    /* Merge in the visible large commands, from the back so that the
+     * result can be built in place. */
+    elements = _cairo_array_index (&surface->commands, 0);
+    large = rtree->entries + rtree->num_entries;
+    num_large = surface->commands.num_elements - rtree->num_entries;
+    num_visible = n;
+    for (i = 0; i < num_large; i++) {
+	if (_cairo_rectangle_intersects (extents,
+					 &elements[large[i]]->header.extents))
+	    num_visible++;
+    }
+
+    indices = *visible;
+    j = num_visible;
+    i = num_large;
+    while (j > n) {
+	unsigned int index = large[--i];
 
-    indices = surface->indices;
-    bbtree_foreach_mark_visible (&surface->bbtree, &box, &indices);
-    num_visible = indices - surface->indices;
-    if (num_visible > 1)
-	sort_indices (surface->indices, num_visible);
+	if (! _cairo_rectangle_intersects (extents,
+					   &elements[index]->header.extents))
+	    continue;
+
+	while (n && indices[n - 1] > index)
+	    indices[--j] = indices[--n];
+	indices[--j] = index;
+    }
 
     return num_visible;
 }
 
-static void
-_cairo_recording_surface_merge_source_attributes (cairo_recording_surface_t  *surface,
-						  cairo_operator_t            op,
-						  const cairo_pattern_t      *source)
+/* Command coalescing.
+ *
+ * Charts and plots tend to record long runs of fills, or strokes, that
+ * differ only in their geometry: the same solid colour, operator, clip
+ * and rendering parameters. Before replaying, each such run is merged
+ * into a single command so that the target receives one path, and the
+ * scan converter one polygon, instead of thousands.
+ *
+ * Merging must not change the output, so the shapes in a run may not
+ * share a pixel. The exception is pixel-aligned boxes filled without a
+ * clip using CLEAR, SOURCE, or OVER with an opaque colour: painting
+ * their union gives exactly the same pixels as painting them in turn.
+ *
+ * Shapes are only merged with others taking the same path through the
+ * compositors, i.e. having the same rectilinear and region hints.
+ *
+ * The pass is enabled with cairo_recording_surface_set_coalesce_commands().
+ */
+#define COALESCE_MAX_RUN 1024
+
+struct coalesce_run {
+    unsigned int first;
+    unsigned int count;
+    cairo_bool_t overlap_boxes;
+    cairo_rectangle_int_t extents;
+    struct coalesce_member {
+	cairo_rectangle_int_t extents;
+	cairo_bool_t is_box;
+    } members[COALESCE_MAX_RUN];
+};
+
+static cairo_bool_t
+_cairo_stroke_style_equal (const cairo_stroke_style_t *a,
+			   const cairo_stroke_style_t *b)
 {
-    if (op != CAIRO_OPERATOR_OVER)
-	surface->has_only_op_over = FALSE;
+    return a->line_width == b->line_width &&
+	   a->line_cap == b->line_cap &&
+	   a->line_join == b->line_join &&
+	   a->miter_limit == b->miter_limit &&
+	   a->num_dashes == b->num_dashes &&
+	   a->dash_offset == b->dash_offset &&
+	   (a->num_dashes == 0 ||
+	    memcmp (a->dash, b->dash, a->num_dashes * sizeof (double)) == 0);
+}
 
-    if (source->type == CAIRO_PATTERN_TYPE_SURFACE) {
-	cairo_surface_pattern_t *surf_pat = (cairo_surface_pattern_t *) source;
-	cairo_surface_t *surf = surf_pat->surface;
-	cairo_surface_t *free_me = NULL;
+/* Can @command start a run? Operators that are not bounded by the mask
+ * also affect the pixels outside each shape, so depend on the order. */
+static cairo_bool_t
+_cairo_recording_command_can_coalesce (const cairo_command_t *command)
+{
+    const cairo_pattern_t *source;
 
-	if (_cairo_surface_is_snapshot (surf))
-	    free_me = surf = _cairo_surface_snapshot_get_target (surf);
+    switch (command->header.type) {
+    case CAIRO_COMMAND_FILL:
+	source = &command->fill.source.base;
+	break;
+    case CAIRO_COMMAND_STROKE:
+	source = &command->stroke.source.base;
+	break;
+    case CAIRO_COMMAND_PAINT:
+    case CAIRO_COMMAND_MASK:
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+    default:
+	return FALSE;
+    }
 
-	if (surf->type == CAIRO_SURFACE_TYPE_RECORDING) {
-	    cairo_recording_surface_t *rec_surf = (cairo_recording_surface_t *) surf;
+    return source->type == CAIRO_PATTERN_TYPE_SOLID &&
+	   _cairo_operator_bounded_by_mask (command->header.op);
+}
 
-	    if (! _cairo_recording_surface_has_only_bilevel_alpha (rec_surf))
-		surface->has_bilevel_alpha = FALSE;
+/* Do @a and @b differ only in their geometry? */
+static cairo_bool_t
+_cairo_recording_commands_similar (const cairo_command_t *a,
+				   const cairo_command_t *b)
+{
+    if (a->header.type != b->header.type ||
+	a->header.op != b->header.op ||
+	a->header.region != b->header.region)
+    {
+	return FALSE;
+    }
 
-	    if (! _cairo_recording_surface_has_only_op_over (rec_surf))
-		surface->has_only_op_over = FALSE;
+    if (! _cairo_clip_equal (a->header.clip, b->header.clip))
+	return FALSE;
 
-	} else if (surf->type == CAIRO_SURFACE_TYPE_IMAGE) {
-	    cairo_image_surface_t *img_surf = (cairo_image_surface_t *) surf;
+    switch (a->header.type) {
+    case CAIRO_COMMAND_FILL:
+	return a->fill.fill_rule == b->fill.fill_rule &&
+	       a->fill.path.fill_is_rectilinear == b->fill.path.fill_is_rectilinear &&
+	       a->fill.path.fill_maybe_region == b->fill.path.fill_maybe_region &&
+	       a->fill.tolerance == b->fill.tolerance &&
+	       a->fill.antialias == b->fill.antialias &&
+	       _cairo_pattern_equal (&a->fill.source.base,
+				     &b->fill.source.base);
 
-	    if (_cairo_image_analyze_transparency (img_surf) == CAIRO_IMAGE_HAS_ALPHA)
-		surface->has_bilevel_alpha = FALSE;
+    case CAIRO_COMMAND_STROKE:
+	return a->stroke.path.stroke_is_rectilinear == b->stroke.path.stroke_is_rectilinear &&
+	       a->stroke.tolerance == b->stroke.tolerance &&
+	       a->stroke.antialias == b->stroke.antialias &&
+	       memcmp (&a->stroke.ctm, &b->stroke.ctm,
+		       sizeof (cairo_matrix_t)) == 0 &&
+	       memcmp (&a->stroke.ctm_inverse, &b->stroke.ctm_inverse,
+		       sizeof (cairo_matrix_t)) == 0 &&
+	       _cairo_stroke_style_equal (&a->stroke.style,
+					  &b->stroke.style) &&
+	       _cairo_pattern_equal (&a->stroke.source.base,
+				     &b->stroke.source.base);
 
-	} else {
-	    if (!_cairo_pattern_is_clear (source) && !_cairo_pattern_is_opaque (source, NULL))
-		surface->has_bilevel_alpha = FALSE;
+    case CAIRO_COMMAND_PAINT:
+    case CAIRO_COMMAND_MASK:
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+    default:
+	return FALSE;
+    }
+}
+
+static cairo_bool_t
+_cairo_path_fixed_has_joins (const cairo_path_fixed_t *path)
+{
+    const cairo_path_buf_t *buf;
+    unsigned int i, num_lines = 0;
+
+    cairo_path_foreach_buf_start (buf, path) {
+	for (i = 0; i < buf->num_ops; i++) {
+	    switch (buf->op[i]) {
+	    case CAIRO_PATH_OP_MOVE_TO:
+		num_lines = 0;
+		break;
+	    case CAIRO_PATH_OP_LINE_TO:
+		if (++num_lines > 1)
+		    return TRUE;
+		break;
+	    case CAIRO_PATH_OP_CURVE_TO:
+	    case CAIRO_PATH_OP_CLOSE_PATH:
+	    default:
+		return TRUE;
+	    }
 	}
+    } cairo_path_foreach_buf_end (buf, path);
 
-	cairo_surface_destroy (free_me);
-	return;
+    return FALSE;
+}
 
-    } else if (source->type == CAIRO_PATTERN_TYPE_RASTER_SOURCE) {
+/* The pixels @command may touch. The recorded extents of a stroke
+ * allow for miters even when the path has no joins, which would keep
+ * separate line segments from ever being merged. */
+static void
+_cairo_recording_command_get_coalesce_extents (const cairo_command_t *command,
+					       cairo_rectangle_int_t *extents)
+{
+    *extents = command->header.extents;
+
+    if (command->header.type == CAIRO_COMMAND_STROKE &&
+	command->stroke.style.line_join == CAIRO_LINE_JOIN_MITER &&
+	! _cairo_path_fixed_has_joins (&command->stroke.path))
+    {
+	cairo_stroke_style_t style = command->stroke.style;
+	cairo_rectangle_int_t stroke_extents;
+
+	style.line_join = CAIRO_LINE_JOIN_ROUND;
+	_cairo_path_fixed_approximate_stroke_extents (&command->stroke.path,
+						      &style,
+						      &command->stroke.ctm,
+						      &stroke_extents);
+	_cairo_rectangle_intersect (extents, &stroke_extents);
+    }
+}
+
+static cairo_bool_t
+_cairo_recording_command_is_aligned_box (const cairo_command_t *command,
+					 cairo_box_t *box)
+{
+    return command->header.type == CAIRO_COMMAND_FILL &&
+	   _cairo_path_fixed_is_box (&command->fill.path, box) &&
+	   _cairo_fixed_is_integer (box->p1.x) &&
+	   _cairo_fixed_is_integer (box->p1.y) &&
+	   _cairo_fixed_is_integer (box->p2.x) &&
+	   _cairo_fixed_is_integer (box->p2.y);
+}
+
+static void
+_coalesce_run_start (struct coalesce_run *run,
+		     const cairo_command_t *command,
+		     unsigned int index)
+{
+    cairo_box_t box;
+
+    run->first = index;
+    run->count = 1;
+    _cairo_recording_command_get_coalesce_extents (command,
+						   &run->members[0].extents);
+    run->extents = run->members[0].extents;
+
+    run->overlap_boxes = FALSE;
+    if (command->header.type == CAIRO_COMMAND_FILL &&
+	command->header.clip == NULL &&
+	command->fill.fill_rule == CAIRO_FILL_RULE_WINDING)
+    {
+	switch (command->header.op) {
+	case CAIRO_OPERATOR_CLEAR:
+	case CAIRO_OPERATOR_SOURCE:
+	    run->overlap_boxes = TRUE;
+	    break;
+	case CAIRO_OPERATOR_OVER:
+	    run->overlap_boxes =
+		_cairo_pattern_is_opaque_solid (&command->fill.source.base);
+	    break;
+	case CAIRO_OPERATOR_IN:
+	case CAIRO_OPERATOR_OUT:
+	case CAIRO_OPERATOR_ATOP:
+	case CAIRO_OPERATOR_DEST:
+	case CAIRO_OPERATOR_DEST_OVER:
+	case CAIRO_OPERATOR_DEST_IN:
+	case CAIRO_OPERATOR_DEST_OUT:
+	case CAIRO_OPERATOR_DEST_ATOP:
+	case CAIRO_OPERATOR_XOR:
+	case CAIRO_OPERATOR_ADD:
+	case CAIRO_OPERATOR_SATURATE:
+	case CAIRO_OPERATOR_MULTIPLY:
+	case CAIRO_OPERATOR_SCREEN:
+	case CAIRO_OPERATOR_OVERLAY:
+	case CAIRO_OPERATOR_DARKEN:
+	case CAIRO_OPERATOR_LIGHTEN:
+	case CAIRO_OPERATOR_COLOR_DODGE:
+	case CAIRO_OPERATOR_COLOR_BURN:
+	case CAIRO_OPERATOR_HARD_LIGHT:
+	case CAIRO_OPERATOR_SOFT_LIGHT:
+	case CAIRO_OPERATOR_DIFFERENCE:
+	case CAIRO_OPERATOR_EXCLUSION:
+	case CAIRO_OPERATOR_HSL_HUE:
+	case CAIRO_OPERATOR_HSL_SATURATION:
+	case CAIRO_OPERATOR_HSL_COLOR:
+	case CAIRO_OPERATOR_HSL_LUMINOSITY:
+	default:
+	    break;
+	}
+    }
+
+    run->members[0].is_box = run->overlap_boxes &&
+	_cairo_recording_command_is_aligned_box (command, &box);
+}
+
+static cairo_bool_t
+_coalesce_run_add (struct coalesce_run *run,
+		   cairo_command_t **elements,
+		   const cairo_command_t *command)
+{
+    cairo_rectangle_int_t extents;
+    cairo_bool_t is_box;
+    cairo_box_t box;
+    unsigned int i;
+
+    if (run->count == COALESCE_MAX_RUN)
+	return FALSE;
+
+    if (! _cairo_recording_commands_similar (elements[run->first], command))
+	return FALSE;
+
+    _cairo_recording_command_get_coalesce_extents (command, &extents);
+
+    is_box = run->overlap_boxes &&
+	_cairo_recording_command_is_aligned_box (command, &box);
+
+    /* Runs are usually laid out in order, so most shapes miss the lot */
+    if (_cairo_rectangle_intersects (&run->extents, &extents)) {
+	for (i = 0; i < run->count; i++) {
+	    if (_cairo_rectangle_intersects (&run->members[i].extents,
+					     &extents) &&
+		! (is_box && run->members[i].is_box))
+	    {
+		return FALSE;
+	    }
+	}
+    }
+
+    run->members[run->count].extents = extents;
+    run->members[run->count].is_box = is_box;
+    run->count++;
+
+    _cairo_rectangle_union (&run->extents, &extents);
+    return TRUE;
+}
+
+/* Boxes are added with the same orientation, so that where they
+ * overlap the winding rule fills their union. */
+static cairo_status_t
+_coalesce_path_add_box (cairo_path_fixed_t *path,
+			const cairo_box_t *box)
+{
+    cairo_status_t status;
+
+    status = _cairo_path_fixed_move_to (path, box->p1.x, box->p1.y);
+    if (unlikely (status))
+	return status;
+
+    status = _cairo_path_fixed_line_to (path, box->p2.x, box->p1.y);
+    if (unlikely (status))
+	return status;
+
+    status = _cairo_path_fixed_line_to (path, box->p2.x, box->p2.y);
+    if (unlikely (status))
+	return status;
+
+    status = _cairo_path_fixed_line_to (path, box->p1.x, box->p2.y);
+    if (unlikely (status))
+	return status;
+
+    return _cairo_path_fixed_close_path (path);
+}
+
+static cairo_status_t
+_coalesce_run_merge (const struct coalesce_run *run,
+		     cairo_command_t **elements,
+		     cairo_command_t **out)
+{
+    const cairo_command_t *first = elements[run->first];
+    cairo_command_t *command;
+    cairo_path_fixed_t *path;
+    cairo_status_t status;
+    unsigned int i;
+
+    if (first->header.type == CAIRO_COMMAND_FILL)
+	command = malloc (sizeof (cairo_command_fill_t));
+    else
+	command = malloc (sizeof (cairo_command_stroke_t));
+    if (unlikely (command == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    command->header = first->header;
+    command->header.clip = _cairo_clip_copy (first->header.clip);
+    for (i = 1; i < run->count; i++) {
+	_cairo_rectangle_union (&command->header.extents,
+				&elements[run->first + i]->header.extents);
+    }
+
+    if (first->header.type == CAIRO_COMMAND_FILL) {
+	status = _cairo_pattern_init_copy (&command->fill.source.base,
+					   &first->fill.source.base);
+	if (unlikely (status))
+	    goto err_command;
+
+	command->fill.fill_rule = first->fill.fill_rule;
+	command->fill.tolerance = first->fill.tolerance;
+	command->fill.antialias = first->fill.antialias;
+	path = &command->fill.path;
+    } else {
+	status = _cairo_pattern_init_copy (&command->stroke.source.base,
+					   &first->stroke.source.base);
+	if (unlikely (status))
+	    goto err_command;
+
+	status = _cairo_stroke_style_init_copy (&command->stroke.style,
+						&first->stroke.style);
+	if (unlikely (status))
+	    goto err_source;
+
+	command->stroke.ctm = first->stroke.ctm;
+	command->stroke.ctm_inverse = first->stroke.ctm_inverse;
+	command->stroke.tolerance = first->stroke.tolerance;
+	command->stroke.antialias = first->stroke.antialias;
+	path = &command->stroke.path;
+    }
+
+    _cairo_path_fixed_init (path);
+    for (i = 0; i < run->count; i++) {
+	const cairo_command_t *member = elements[run->first + i];
+	cairo_box_t box;
+
+	if (run->members[i].is_box &&
+	    _cairo_path_fixed_is_box (&member->fill.path, &box))
+	{
+	    status = _coalesce_path_add_box (path, &box);
+	} else if (member->header.type == CAIRO_COMMAND_FILL) {
+	    status = _cairo_path_fixed_append (path, &member->fill.path, 0, 0);
+	} else {
+	    status = _cairo_path_fixed_append (path, &member->stroke.path, 0, 0);
+	}
+	if (unlikely (status)) {
+	    _cairo_recording_command_destroy (command);
+	    return status;
+	}
+    }
+
+    *out = command;
+    return CAIRO_STATUS_SUCCESS;
+
+err_source:
+    _cairo_pattern_fini (&command->stroke.source.base);
+err_command:
+    _cairo_clip_destroy (command->header.clip);
+    free (command);
+    return status;
+}
+
+static cairo_status_t
+_coalesce_run_flush (struct coalesce_run *run,
+		     cairo_command_t **elements,
+		     struct _cairo_recording_coalesced *coalesced)
+{
+    cairo_command_t *command = elements[run->first];
+    cairo_status_t status;
+
+    if (run->count > 1) {
+	status = _coalesce_run_merge (run, elements, &command);
+	if (unlikely (status))
+	    return status;
+
+	coalesced->merged[coalesced->num_merged++] = command;
+    }
+
+    coalesced->commands[coalesced->num_commands] = command;
+    coalesced->indices[coalesced->num_commands] = run->first;
+    coalesced->num_commands++;
+
+    run->count = 0;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_recording_surface_create_coalesced (cairo_recording_surface_t *surface)
+{
+    struct _cairo_recording_coalesced *coalesced = &surface->coalesced;
+    cairo_command_t **elements = _cairo_array_index (&surface->commands, 0);
+    unsigned int i, count = surface->commands.num_elements;
+    const unsigned char *hidden = NULL;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    struct coalesce_run *run;
+
+    coalesced->valid = TRUE;
+    if (count < 2)
+	return CAIRO_STATUS_SUCCESS;
+
+    /* Hidden commands are culled by index, so they must stay on their own */
+    if (surface->occlusion.valid)
+	hidden = surface->occlusion.hidden;
+
+    run = malloc (sizeof (struct coalesce_run));
+    coalesced->commands = _cairo_malloc_ab (count, sizeof (cairo_command_t *));
+    coalesced->indices = _cairo_malloc_ab (count, sizeof (unsigned int));
+    coalesced->merged = _cairo_malloc_ab (count / 2, sizeof (cairo_command_t *));
+    if (unlikely (run == NULL ||
+		  coalesced->commands == NULL ||
+		  coalesced->indices == NULL ||
+		  coalesced->merged == NULL))
+    {
+	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	goto BAIL;
+    }
+
+    run->count = 0;
+    for (i = 0; i < count; i++) {
+	cairo_command_t *command = elements[i];
+
+	if (hidden != NULL && hidden[i]) {
+	    command = NULL;
+	} else if (run->count && _coalesce_run_add (run, elements, command)) {
+	    continue;
+	}
+
+	if (run->count) {
+	    status = _coalesce_run_flush (run, elements, coalesced);
+	    if (unlikely (status))
+		goto BAIL;
+	}
+
+	if (command != NULL && _cairo_recording_command_can_coalesce (command)) {
+	    _coalesce_run_start (run, command, i);
+	} else {
+	    coalesced->commands[coalesced->num_commands] = elements[i];
+	    coalesced->indices[coalesced->num_commands] = i;
+	    coalesced->num_commands++;
+	}
+    }
+
+    if (run->count) {
+	status = _coalesce_run_flush (run, elements, coalesced);
+	if (unlikely (status))
+	    goto BAIL;
+    }
+
+    /* If nothing was merged, just replay the commands themselves */
+    if (coalesced->num_merged) {
+	free (run);
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+BAIL:
+    free (run);
+    _cairo_recording_surface_destroy_coalesced (surface);
+    coalesced->valid = status == CAIRO_STATUS_SUCCESS;
+    return status;
+}
+
+/* Occlusion culling.
+ *
+ * Walking the commands from the last to the first, the pixels that
+ * later commands are known to overwrite completely are accumulated
+ * into a region, and any command whose extents lie entirely within it
+ * cannot affect the result of a replay. Only unclipped paints, and
+ * fills of a single rectangle, using SOURCE or OVER with an opaque
+ * source are counted as covering; that catches backgrounds and panels
+ * without having to rasterise anything.
+ *
+ * The pass is enabled with cairo_recording_surface_set_cull_hidden_commands().
+ */
+#define OCCLUSION_MAX_RECTANGLES 256
+
+static unsigned long cull_replayed;
+static unsigned long cull_culled;
+
+/* Find the pixels that @command is certain to overwrite, whatever was
+ * beneath them. */
+static cairo_bool_t
+_cairo_recording_command_get_occluding_area (const cairo_command_t *command,
+					     cairo_rectangle_int_t *area)
+{
+    const cairo_pattern_t *source;
+    cairo_box_t box;
+
+    if (command->header.clip != NULL)
+	return FALSE;
+
+    switch (command->header.type) {
+    case CAIRO_COMMAND_PAINT:
+	source = &command->paint.source.base;
+	*area = command->header.extents;
+	break;
+
+    case CAIRO_COMMAND_FILL:
+	if (! _cairo_path_fixed_is_box (&command->fill.path, &box))
+	    return FALSE;
+
+	/* Only the pixels entirely inside the box */
+	source = &command->fill.source.base;
+	area->x = _cairo_fixed_integer_ceil (box.p1.x);
+	area->y = _cairo_fixed_integer_ceil (box.p1.y);
+	area->width = _cairo_fixed_integer_floor (box.p2.x) - area->x;
+	area->height = _cairo_fixed_integer_floor (box.p2.y) - area->y;
+	if (! _cairo_rectangle_intersect (area, &command->header.extents))
+	    return FALSE;
+	break;
+
+    case CAIRO_COMMAND_MASK:
+    case CAIRO_COMMAND_STROKE:
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+    default:
+	return FALSE;
+    }
+
+    switch (command->header.op) {
+    case CAIRO_OPERATOR_SOURCE:
+	return TRUE;
+    case CAIRO_OPERATOR_OVER:
+	return _cairo_pattern_is_opaque (source, area);
+    case CAIRO_OPERATOR_CLEAR:
+    case CAIRO_OPERATOR_IN:
+    case CAIRO_OPERATOR_OUT:
+    case CAIRO_OPERATOR_ATOP:
+    case CAIRO_OPERATOR_DEST:
+    case CAIRO_OPERATOR_DEST_OVER:
+    case CAIRO_OPERATOR_DEST_IN:
+    case CAIRO_OPERATOR_DEST_OUT:
+    case CAIRO_OPERATOR_DEST_ATOP:
+    case CAIRO_OPERATOR_XOR:
+    case CAIRO_OPERATOR_ADD:
+    case CAIRO_OPERATOR_SATURATE:
+    case CAIRO_OPERATOR_MULTIPLY:
+    case CAIRO_OPERATOR_SCREEN:
+    case CAIRO_OPERATOR_OVERLAY:
+    case CAIRO_OPERATOR_DARKEN:
+    case CAIRO_OPERATOR_LIGHTEN:
+    case CAIRO_OPERATOR_COLOR_DODGE:
+    case CAIRO_OPERATOR_COLOR_BURN:
+    case CAIRO_OPERATOR_HARD_LIGHT:
+    case CAIRO_OPERATOR_SOFT_LIGHT:
+    case CAIRO_OPERATOR_DIFFERENCE:
+    case CAIRO_OPERATOR_EXCLUSION:
+    case CAIRO_OPERATOR_HSL_HUE:
+    case CAIRO_OPERATOR_HSL_SATURATION:
+    case CAIRO_OPERATOR_HSL_COLOR:
+    case CAIRO_OPERATOR_HSL_LUMINOSITY:
+	return FALSE;
+    }
+
+    ASSERT_NOT_REACHED;
+    return FALSE;
+}
+
+static cairo_status_t
+_cairo_recording_surface_create_occlusion (cairo_recording_surface_t *surface)
+{
+    struct _cairo_recording_occlusion *occlusion = &surface->occlusion;
+    cairo_command_t **elements = _cairo_array_index (&surface->commands, 0);
+    unsigned int i, count = surface->commands.num_elements;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    cairo_region_t covered;
+
+    occlusion->hidden = calloc (count, 1);
+    if (unlikely (occlusion->hidden == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    _cairo_region_init (&covered);
+
+    for (i = count; i--; ) {
+	cairo_command_t *command = elements[i];
+	cairo_rectangle_int_t area;
+
+	if (cairo_region_contains_rectangle (&covered,
+					     &command->header.extents) ==
+	    CAIRO_REGION_OVERLAP_IN)
+	{
+	    occlusion->hidden[i] = TRUE;
+	    occlusion->num_hidden++;
+	    continue;
+	}
+
+	/* Keep the region simple enough for the tests to stay cheap */
+	if (cairo_region_num_rectangles (&covered) < OCCLUSION_MAX_RECTANGLES &&
+	    _cairo_recording_command_get_occluding_area (command, &area))
+	{
+	    status = cairo_region_union_rectangle (&covered, &area);
+	    if (unlikely (status))
+		break;
+	}
+    }
+
+    _cairo_region_fini (&covered);
+
+    if (unlikely (status)) {
+	free (occlusion->hidden);
+	occlusion->hidden = NULL;
+	occlusion->num_hidden = 0;
+	return status;
+    }
+
+    occlusion->valid = TRUE;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_recording_surface_add_cull_stats (unsigned long replayed,
+					 unsigned long culled)
+{
+    CAIRO_MUTEX_LOCK (_cairo_recording_cull_mutex);
+    cull_replayed += replayed;
+    cull_culled += culled;
+    CAIRO_MUTEX_UNLOCK (_cairo_recording_cull_mutex);
+}
+
+void
+_cairo_recording_surface_get_cull_stats (unsigned long *replayed,
+					 unsigned long *culled)
+{
+    CAIRO_MUTEX_LOCK (_cairo_recording_cull_mutex);
+    *replayed = cull_replayed;
+    *culled = cull_culled;
+    CAIRO_MUTEX_UNLOCK (_cairo_recording_cull_mutex);
+}
+
+void
+_cairo_recording_surface_reset_static_data (void)
+{
+    CAIRO_MUTEX_LOCK (_cairo_recording_cull_mutex);
+    cull_replayed = cull_culled = 0;
+    CAIRO_MUTEX_UNLOCK (_cairo_recording_cull_mutex);
+}
+
+static void
+_cairo_recording_surface_merge_source_attributes (cairo_recording_surface_t  *surface,
+						  cairo_operator_t            op,
+						  const cairo_pattern_t      *source)
+{
+    if (op != CAIRO_OPERATOR_OVER)
+	surface->has_only_op_over = FALSE;
+
+    if (source->type == CAIRO_PATTERN_TYPE_SURFACE) {
+	cairo_surface_pattern_t *surf_pat = (cairo_surface_pattern_t *) source;
+	cairo_surface_t *surf = surf_pat->surface;
+	cairo_surface_t *free_me = NULL;
+
+	if (_cairo_surface_is_snapshot (surf))
+	    free_me = surf = _cairo_surface_snapshot_get_target (surf);
+
+	if (surf->type == CAIRO_SURFACE_TYPE_RECORDING) {
+	    cairo_recording_surface_t *rec_surf = (cairo_recording_surface_t *) surf;
+
+	    if (! _cairo_recording_surface_has_only_bilevel_alpha (rec_surf))
+		surface->has_bilevel_alpha = FALSE;
+
+	    if (! _cairo_recording_surface_has_only_op_over (rec_surf))
+		surface->has_only_op_over = FALSE;
+
+	} else if (surf->type == CAIRO_SURFACE_TYPE_IMAGE) {
+	    cairo_image_surface_t *img_surf = (cairo_image_surface_t *) surf;
+
+	    if (_cairo_image_analyze_transparency (img_surf) == CAIRO_IMAGE_HAS_ALPHA)
+		surface->has_bilevel_alpha = FALSE;
+
+	} else {
+	    if (!_cairo_pattern_is_clear (source) && !_cairo_pattern_is_opaque (source, NULL))
+		surface->has_bilevel_alpha = FALSE;
+	}
+
+	cairo_surface_destroy (free_me);
+	return;
+
+    } else if (source->type == CAIRO_PATTERN_TYPE_RASTER_SOURCE) {
 	cairo_surface_t *image;
 	cairo_surface_t *raster;
 
@@ -1668,14 +2580,18 @@ _cairo_recording_surface_merge_source_attributes (cairo_recording_surface_t  *su
 	surface->has_bilevel_alpha = FALSE;
 }
 
+/* Replay the commands of @surface that are visible in @target.
+ * @indices must either have room for the index of every command, or
+ * be %NULL to use the array owned by the surface. */
 static cairo_status_t
-_cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
+_cairo_recording_surface_replay_commands (cairo_recording_surface_t	*surface,
 					  const cairo_rectangle_int_t *surface_extents,
 					  const cairo_matrix_t *surface_transform,
 					  cairo_surface_t	     *target,
 					  const cairo_clip_t *target_clip,
 					  cairo_recording_replay_type_t type,
-					  cairo_recording_region_type_t region)
+					  cairo_recording_region_type_t region,
+					  unsigned int *indices)
 {
     cairo_surface_wrapper_t wrapper;
     cairo_command_t **elements;
@@ -1686,22 +2602,12 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
     cairo_rectangle_int_t extents;
     cairo_bool_t use_indices = FALSE;
     const cairo_rectangle_int_t *r;
+    cairo_command_t **commands = NULL;
+    cairo_bool_t pixel_exact;
+    const unsigned char *hidden = NULL;
+    unsigned long num_replayed = 0, num_culled = 0;
     unsigned int i, num_elements;
 
-    if (unlikely (surface->base.status))
-	return surface->base.status;
-
-    if (unlikely (target->status))
-	return target->status;
-
-    if (unlikely (surface->base.finished))
-	return _cairo_error (CAIRO_STATUS_SURFACE_FINISHED);
-
-    if (surface->base.is_clear)
-	return CAIRO_STATUS_SUCCESS;
-
-    assert (_cairo_surface_is_recording (&surface->base));
-
     _cairo_surface_wrapper_init (&wrapper, target);
     if (surface_extents)
 	_cairo_surface_wrapper_intersect_extents (&wrapper, surface_extents);
@@ -1717,19 +2623,38 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
     if (! _cairo_surface_wrapper_get_target_extents (&wrapper, &extents))
 	goto done;
 
-    surface->has_bilevel_alpha = TRUE;
-    surface->has_only_op_over = TRUE;
-
     num_elements = surface->commands.num_elements;
     elements = _cairo_array_index (&surface->commands, 0);
     if (extents.width < r->width || extents.height < r->height) {
 	num_elements =
-	    _cairo_recording_surface_get_visible_commands (surface, &extents);
+	    _cairo_recording_surface_get_visible_commands (surface, &extents,
+							   &indices);
 	use_indices = num_elements != surface->commands.num_elements;
     }
 
+    /* The covered areas, and the pixels touched by each of the merged
+     * commands, are only exact under integer translations */
+    pixel_exact =
+	(surface_transform == NULL ||
+	 _cairo_matrix_is_integer_translation (surface_transform, NULL, NULL)) &&
+	_cairo_matrix_is_integer_translation (&target->device_transform,
+					      NULL, NULL);
+
+    if (replay_all && surface->occlusion.valid && pixel_exact)
+	hidden = surface->occlusion.hidden;
+
+    if (type == CAIRO_RECORDING_REPLAY && ! use_indices && pixel_exact &&
+	surface->coalesced.commands != NULL)
+    {
+	commands = surface->coalesced.commands;
+	indices = surface->coalesced.indices;
+	num_elements = surface->coalesced.num_commands;
+	use_indices = TRUE;
+    }
+
     for (i = 0; i < num_elements; i++) {
-	cairo_command_t *command = elements[use_indices ? surface->indices[i] : i];
+	unsigned int index = use_indices ? indices[i] : i;
+	cairo_command_t *command = commands ? commands[i] : elements[index];
 
 	if (! replay_all && command->header.region != region)
 	    continue;
@@ -1737,6 +2662,14 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
 	if (! _cairo_rectangle_intersects (&extents, &command->header.extents))
 	    continue;
 
+	if (hidden != NULL) {
+	    if (hidden[index]) {
+		num_culled++;
+		continue;
+	    }
+	    num_replayed++;
+	}
+
 	switch (command->header.type) {
 	case CAIRO_COMMAND_PAINT:
 	    status = _cairo_surface_wrapper_paint (&wrapper,
@@ -1790,8 +2723,14 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
 		cairo_command_t *stroke_command;
 
 		stroke_command = NULL;
-		if (type != CAIRO_RECORDING_CREATE_REGIONS && i < num_elements - 1)
-		    stroke_command = elements[i + 1];
+		if (type != CAIRO_RECORDING_CREATE_REGIONS && i < num_elements - 1) {
+		    if (commands != NULL)
+			stroke_command = commands[i + 1];
+		    else if (use_indices)
+			stroke_command = elements[indices[i + 1]];
+		    else
+			stroke_command = elements[i + 1];
+		}
 
 		if (stroke_command != NULL &&
 		    type == CAIRO_RECORDING_REPLAY &&
@@ -1887,8 +2826,332 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
 	    break;
     }
 
+    if (hidden != NULL)
+	_cairo_recording_surface_add_cull_stats (num_replayed, num_culled);
+
 done:
     _cairo_surface_wrapper_fini (&wrapper);
+    return status;
+}
+
+static cairo_bool_t
+_cairo_recording_pattern_is_thread_safe (const cairo_pattern_t *pattern)
+{
+    switch (pattern->type) {
+    case CAIRO_PATTERN_TYPE_SOLID:
+    case CAIRO_PATTERN_TYPE_LINEAR:
+    case CAIRO_PATTERN_TYPE_RADIAL:
+    case CAIRO_PATTERN_TYPE_MESH:
+	return TRUE;
+
+    /* Acquiring a surface may replay it, attach snapshots or take
+     * references on shared pixman images, none of which may be done
+     * concurrently. */
+    case CAIRO_PATTERN_TYPE_SURFACE:
+    case CAIRO_PATTERN_TYPE_RASTER_SOURCE:
+    default:
+	return FALSE;
+    }
+}
+
+/* Check whether @command only reads state that can be shared by
+ * several threads replaying it at the same time. */
+cairo_bool_t
+_cairo_recording_command_is_thread_safe (const cairo_command_t *command)
+{
+    const cairo_pattern_t *source, *mask = NULL;
+
+    switch (command->header.type) {
+    case CAIRO_COMMAND_PAINT:
+	source = &command->paint.source.base;
+	break;
+    case CAIRO_COMMAND_MASK:
+	source = &command->mask.source.base;
+	mask = &command->mask.mask.base;
+	break;
+    case CAIRO_COMMAND_STROKE:
+	source = &command->stroke.source.base;
+	break;
+    case CAIRO_COMMAND_FILL:
+	source = &command->fill.source.base;
+	break;
+    case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+	source = &command->show_text_glyphs.source.base;
+	break;
+    default:
+	ASSERT_NOT_REACHED;
+	return FALSE;
+    }
+
+    if (! _cairo_recording_pattern_is_thread_safe (source))
+	return FALSE;
+    if (mask != NULL && ! _cairo_recording_pattern_is_thread_safe (mask))
+	return FALSE;
+
+    return TRUE;
+}
+
+/* Large image targets are split into tiles that are replayed in
+ * parallel, each into its own image surface sharing the pixels of the
+ * target. Tiles are aligned to 64 pixels so that every tile starts on
+ * a 32-bit boundary whatever the format.
+ *
+ * Each tile clips the geometry to itself. Boxes, glyphs and sources
+ * come out exactly as from a single pass, but where a curved or sloped
+ * edge crosses a tile boundary the scan converter samples that row of
+ * pixels at its vertical resolution instead of computing its coverage
+ * exactly, and strokes culled outside a tile may join differently just
+ * inside it. The pixels there may differ from a single pass by up to
+ * 1/15 of full coverage for each edge crossing them. */
+#define REPLAY_TILE_ALIGN 64
+#define REPLAY_TILE_MIN_SIZE 128
+#define REPLAY_TILES_PER_THREAD 4
+#define REPLAY_MIN_COMMANDS 16
+
+typedef struct _cairo_recording_tile {
+    cairo_recording_surface_t *surface;
+    const cairo_rectangle_int_t *surface_extents;
+    const cairo_matrix_t *surface_transform;
+    cairo_image_surface_t *target;
+    cairo_rectangle_int_t extents;
+    cairo_status_t status;
+} cairo_recording_tile_t;
+
+static void
+_cairo_recording_surface_replay_tile (void *closure)
+{
+    cairo_recording_tile_t *tile = closure;
+    cairo_image_surface_t *target = tile->target;
+    cairo_surface_t *image;
+    unsigned int *indices;
+    unsigned char *data;
+
+    indices = _cairo_malloc_ab (tile->surface->commands.num_elements,
+				sizeof (unsigned int));
+    if (unlikely (indices == NULL)) {
+	tile->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	return;
+    }
+
+    data = target->data + tile->extents.y * target->stride +
+	tile->extents.x * (PIXMAN_FORMAT_BPP (target->pixman_format) / 8);
+    image = _cairo_image_surface_create_with_pixman_format (data,
+							    target->pixman_format,
+							    tile->extents.width,
+							    tile->extents.height,
+							    target->stride);
+    if (unlikely (image->status)) {
+	tile->status = image->status;
+	free (indices);
+	return;
+    }
+
+    image->is_clear = target->base.is_clear;
+    cairo_surface_set_device_scale (image,
+				    target->base.device_transform.xx,
+				    target->base.device_transform.yy);
+    cairo_surface_set_device_offset (image,
+				     target->base.device_transform.x0 - tile->extents.x,
+				     target->base.device_transform.y0 - tile->extents.y);
+
+    tile->status =
+	_cairo_recording_surface_replay_commands (tile->surface,
+						  tile->surface_extents,
+						  tile->surface_transform,
+						  image, NULL,
+						  CAIRO_RECORDING_REPLAY,
+						  CAIRO_RECORDING_REGION_ALL,
+						  indices);
+
+    cairo_surface_destroy (image);
+    free (indices);
+}
+
+/* Choose the size of the (square) tiles to split @target into, or
+ * return 0 if the replay should not be split. */
+static int
+_cairo_recording_surface_tile_size (cairo_recording_surface_t *surface,
+				    cairo_surface_t *target,
+				    const cairo_clip_t *target_clip,
+				    cairo_recording_replay_type_t type,
+				    cairo_recording_region_type_t region)
+{
+    cairo_image_surface_t *image;
+    cairo_rectangle_int_t extents;
+    int num_threads, size;
+
+    if (type != CAIRO_RECORDING_REPLAY ||
+	region != CAIRO_RECORDING_REGION_ALL)
+	return 0;
+
+    if (! _cairo_surface_is_image (target))
+	return 0;
+
+    /* The tiles are only clipped to themselves, so any other clip must
+     * cover the whole target (as when painting the recording as a source) */
+    image = (cairo_image_surface_t *) target;
+    extents.x = extents.y = 0;
+    extents.width  = image->width;
+    extents.height = image->height;
+    if (! _cairo_clip_contains_rectangle (target_clip, &extents))
+	return 0;
+
+    if (PIXMAN_FORMAT_BPP (image->pixman_format) < 8)
+	return 0;
+    if (image->width < 2 * REPLAY_TILE_MIN_SIZE &&
+	image->height < 2 * REPLAY_TILE_MIN_SIZE)
+	return 0;
+
+    if (target->device_transform.xy != 0. ||
+	target->device_transform.yx != 0.)
+	return 0;
+
+    if (surface->commands.num_elements < REPLAY_MIN_COMMANDS)
+	return 0;
+
+    num_threads = _cairo_image_surface_num_threads (image);
+    if (num_threads <= 1)
+	return 0;
+
+    if (! surface->thread_safe)
+	return 0;
+
+    size = sqrt ((double) image->width * image->height /
+		 (num_threads * REPLAY_TILES_PER_THREAD));
+    size = MAX (size, REPLAY_TILE_MIN_SIZE);
+    return (size + REPLAY_TILE_ALIGN - 1) & -REPLAY_TILE_ALIGN;
+}
+
+static cairo_status_t
+_cairo_recording_surface_replay_tiles (cairo_recording_surface_t *surface,
+				       const cairo_rectangle_int_t *surface_extents,
+				       const cairo_matrix_t *surface_transform,
+				       cairo_image_surface_t *target,
+				       int tile_size)
+{
+    cairo_recording_tile_t *tiles;
+    cairo_status_t status;
+    int x, y, i, num_tiles;
+
+    status = _cairo_surface_begin_modification (&target->base);
+    if (unlikely (status))
+	return status;
+
+    /* Build the spatial index up front, the tiles only query it */
+    if (! surface->rtree.valid) {
+	status = _cairo_recording_surface_create_rtree (surface);
+	if (unlikely (status))
+	    return status;
+    }
+
+    num_tiles = ((target->width + tile_size - 1) / tile_size) *
+		((target->height + tile_size - 1) / tile_size);
+    tiles = _cairo_malloc_ab (num_tiles, sizeof (cairo_recording_tile_t));
+    if (unlikely (tiles == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    i = 0;
+    for (y = 0; y < target->height; y += tile_size) {
+	for (x = 0; x < target->width; x += tile_size) {
+	    cairo_recording_tile_t *tile = &tiles[i++];
+
+	    tile->surface = surface;
+	    tile->surface_extents = surface_extents;
+	    tile->surface_transform = surface_transform;
+	    tile->target = target;
+	    tile->extents.x = x;
+	    tile->extents.y = y;
+	    tile->extents.width = MIN (tile_size, target->width - x);
+	    tile->extents.height = MIN (tile_size, target->height - y);
+	    tile->status = CAIRO_STATUS_SUCCESS;
+	}
+    }
+
+    _cairo_thread_pool_run (_cairo_recording_surface_replay_tile,
+			    tiles, num_tiles, sizeof (cairo_recording_tile_t));
+
+    target->base.is_clear = FALSE;
+    for (i = 0; i < num_tiles; i++) {
+	if (unlikely (tiles[i].status)) {
+	    status = tiles[i].status;
+	    break;
+	}
+    }
+
+    free (tiles);
+    return status;
+}
+
+static cairo_status_t
+_cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
+					  const cairo_rectangle_int_t *surface_extents,
+					  const cairo_matrix_t *surface_transform,
+					  cairo_surface_t	     *target,
+					  const cairo_clip_t *target_clip,
+					  cairo_recording_replay_type_t type,
+					  cairo_recording_region_type_t region)
+{
+    cairo_status_t status;
+    int tile_size;
+
+    if (unlikely (surface->base.status))
+	return surface->base.status;
+
+    if (unlikely (target->status))
+	return target->status;
+
+    if (unlikely (surface->base.finished))
+	return _cairo_error (CAIRO_STATUS_SURFACE_FINISHED);
+
+    if (surface->base.is_clear)
+	return CAIRO_STATUS_SUCCESS;
+
+    assert (_cairo_surface_is_recording (&surface->base));
+
+    surface->has_bilevel_alpha = TRUE;
+    surface->has_only_op_over = TRUE;
+
+    if (type == CAIRO_RECORDING_REPLAY &&
+	region == CAIRO_RECORDING_REGION_ALL &&
+	! surface->occlusion.valid &&
+	surface->cull_hidden_commands)
+    {
+	/* Rebuild the merged commands around the hidden ones */
+	_cairo_recording_surface_destroy_coalesced (surface);
+
+	status = _cairo_recording_surface_create_occlusion (surface);
+	if (unlikely (status))
+	    return _cairo_surface_set_error (&surface->base, status);
+    }
+
+    /* Creating the regions may change the region of any command */
+    if (type == CAIRO_RECORDING_CREATE_REGIONS) {
+	_cairo_recording_surface_destroy_coalesced (surface);
+    } else if (! surface->coalesced.valid && surface->coalesce_commands)
+    {
+	status = _cairo_recording_surface_create_coalesced (surface);
+	if (unlikely (status))
+	    return _cairo_surface_set_error (&surface->base, status);
+    }
+
+    tile_size = _cairo_recording_surface_tile_size (surface, target,
+						    target_clip,
+						    type, region);
+    if (tile_size) {
+	status = _cairo_recording_surface_replay_tiles (surface,
+							surface_extents,
+							surface_transform,
+							(cairo_image_surface_t *) target,
+							tile_size);
+    } else {
+	status = _cairo_recording_surface_replay_commands (surface,
+							   surface_extents,
+							   surface_transform,
+							   target, target_clip,
+							   type, region,
+							   NULL);
+    }
+
     return _cairo_surface_set_error (&surface->base, status);
 }
 
@@ -2175,6 +3438,254 @@ cairo_recording_surface_get_extents (cairo_surface_t *surface,
     return TRUE;
 }
 
+/* Replay @surface into its rendering, within @clip if not %NULL. A
+ * replay places the origin of the extents at that of the target,
+ * whereas the device offset of the rendering already lines it up with
+ * @surface, so take the extents back out of the replay. */
+static cairo_status_t
+_cairo_recording_surface_replay_rendering (cairo_recording_surface_t *surface,
+					   cairo_surface_t *image,
+					   const cairo_clip_t *clip)
+{
+    cairo_matrix_t m;
+
+    cairo_matrix_init_translate (&m, -surface->extents.x, -surface->extents.y);
+    return _cairo_recording_surface_replay_with_clip (&surface->base, &m,
+						      image, clip);
+}
+
+static cairo_status_t
+_cairo_recording_surface_update_rendering (cairo_recording_surface_t *surface,
+					   cairo_damage_t *damage)
+{
+    cairo_surface_t *image = surface->rendering;
+    cairo_region_t *region = NULL;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    int i, num_rects;
+
+    /* If the damage could not be tracked, draw everything again */
+    if (damage->status == CAIRO_STATUS_SUCCESS) {
+	region = damage->region;
+	if (region == NULL)
+	    return CAIRO_STATUS_SUCCESS;
+
+	num_rects = cairo_region_num_rectangles (region);
+    } else {
+	num_rects = 1;
+    }
+
+    for (i = 0; i < num_rects; i++) {
+	cairo_rectangle_int_t rect;
+	cairo_clip_t *clip;
+
+	rect = surface->extents;
+	if (region != NULL) {
+	    cairo_rectangle_int_t damaged;
+
+	    cairo_region_get_rectangle (region, i, &damaged);
+	    if (! _cairo_rectangle_intersect (&rect, &damaged))
+		continue;
+	}
+
+	/* The clip is in the pixels of the image, the damage is not */
+	rect.x -= surface->extents.x;
+	rect.y -= surface->extents.y;
+	clip = _cairo_clip_intersect_rectangle (NULL, &rect);
+
+	status = _cairo_surface_paint (image,
+				       CAIRO_OPERATOR_CLEAR,
+				       &_cairo_pattern_clear.base,
+				       clip);
+	if (status == CAIRO_STATUS_SUCCESS) {
+	    status = _cairo_recording_surface_replay_rendering (surface,
+								image,
+								clip);
+	}
+	_cairo_clip_destroy (clip);
+
+	if (unlikely (status))
+	    break;
+    }
+
+    return status;
+}
+
+static cairo_bool_t
+_extract_recording_surface (cairo_surface_t		   *surface,
+			    cairo_recording_surface_t **recording_surface)
+{
+    if (surface->status)
+	return FALSE;
+
+    if (surface->finished) {
+	_cairo_surface_set_error (surface, CAIRO_INT_STATUS_SURFACE_FINISHED);
+	return FALSE;
+    }
+
+    if (! _cairo_surface_is_recording (surface)) {
+	_cairo_surface_set_error (surface,
+				  CAIRO_INT_STATUS_SURFACE_TYPE_MISMATCH);
+	return FALSE;
+    }
+
+    *recording_surface = (cairo_recording_surface_t *) surface;
+    return TRUE;
+}
+
+/**
+ * cairo_recording_surface_set_coalesce_commands:
+ * @surface: a #cairo_recording_surface_t
+ * @coalesce: %TRUE to merge runs of similar commands when replaying
+ *
+ * Sets whether runs of fills, or of strokes, that differ only in their
+ * geometry are merged into a single command before @surface is
+ * replayed. Only shapes that do not overlap, or pixel-aligned boxes
+ * painted opaquely, are merged, so the result is unchanged; but the
+ * target receives one large path in place of many small ones, which
+ * speeds up replaying charts and plots made of thousands of shapes.
+ *
+ * The merged commands are built on the first replay after recording
+ * and kept until more commands are recorded, at the cost of a copy of
+ * the merged paths. The default is %FALSE.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_recording_surface_set_coalesce_commands (cairo_surface_t *abstract_surface,
+					       cairo_bool_t	coalesce)
+{
+    cairo_recording_surface_t *surface = NULL; /* hide compiler warning */
+
+    if (! _extract_recording_surface (abstract_surface, &surface))
+	return;
+
+    coalesce = coalesce != FALSE;
+    if (surface->coalesce_commands == coalesce)
+	return;
+
+    surface->coalesce_commands = coalesce;
+    _cairo_recording_surface_destroy_coalesced (surface);
+}
+
+/**
+ * cairo_recording_surface_set_cull_hidden_commands:
+ * @surface: a #cairo_recording_surface_t
+ * @cull: %TRUE to skip the commands that later ones hide
+ *
+ * Sets whether commands that are entirely covered by later opaque
+ * paints, or fills of a single rectangle, are skipped when replaying
+ * @surface. The result is unchanged, but drawings that are painted
+ * over again and again, such as a document whose background is redrawn
+ * for every page, are replayed faster.
+ *
+ * The hidden commands are found on the first replay after recording
+ * and kept until more commands are recorded. The default is %FALSE.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_recording_surface_set_cull_hidden_commands (cairo_surface_t *abstract_surface,
+						  cairo_bool_t	   cull)
+{
+    cairo_recording_surface_t *surface = NULL; /* hide compiler warning */
+
+    if (! _extract_recording_surface (abstract_surface, &surface))
+	return;
+
+    cull = cull != FALSE;
+    if (surface->cull_hidden_commands == cull)
+	return;
+
+    surface->cull_hidden_commands = cull;
+
+    /* The merged commands are built around the hidden ones */
+    _cairo_recording_surface_destroy_occlusion (surface);
+    _cairo_recording_surface_destroy_coalesced (surface);
+}
+
+/**
+ * cairo_recording_surface_get_image:
+ * @surface: a bounded #cairo_recording_surface_t
+ *
+ * Returns an image surface holding the result of replaying @surface
+ * over its extents. The image is kept up to date incrementally: each
+ * call only draws again the parts touched by the commands recorded
+ * since the previous one, or marked with
+ * cairo_surface_mark_dirty_rectangle(). This makes it cheap to show
+ * a recording that only ever changes in a small area.
+ *
+ * The image has a device offset so that it lines up with @surface.
+ * It belongs to @surface, and is drawn to in place by later calls;
+ * do not draw to it yourself, and call cairo_surface_reference() to
+ * keep it for longer than @surface.
+ *
+ * Return value: the image, or an error surface if @surface is
+ * unbounded, is not a recording surface, or could not be drawn. Use
+ * cairo_surface_status() to check.
+ *
+ * Since: 1.14
+ **/
+cairo_surface_t *
+cairo_recording_surface_get_image (cairo_surface_t *abstract_surface)
+{
+    cairo_recording_surface_t *surface;
+    cairo_surface_t *image;
+    cairo_damage_t *damage;
+    cairo_status_t status;
+
+    if (unlikely (abstract_surface->status))
+	return _cairo_surface_create_in_error (abstract_surface->status);
+
+    if (unlikely (abstract_surface->finished))
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_SURFACE_FINISHED));
+
+    if (! _cairo_surface_is_recording (abstract_surface))
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_SURFACE_TYPE_MISMATCH));
+
+    surface = (cairo_recording_surface_t *) abstract_surface;
+    if (surface->unbounded)
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_INVALID_SIZE));
+
+    if (surface->rendering == NULL) {
+	image = _cairo_image_surface_create_with_content (surface->base.content,
+							  surface->extents.width,
+							  surface->extents.height);
+	if (unlikely (image->status))
+	    return image;
+
+	cairo_surface_set_device_offset (image,
+					 -surface->extents.x,
+					 -surface->extents.y);
+
+	status = _cairo_recording_surface_replay_rendering (surface, image, NULL);
+	if (unlikely (status)) {
+	    cairo_surface_destroy (image);
+	    return _cairo_surface_create_in_error (status);
+	}
+
+	/* From now on, record where the surface changes */
+	surface->rendering = image;
+	surface->base.damage = _cairo_damage_create ();
+	return image;
+    }
+
+    damage = _cairo_damage_reduce (surface->base.damage);
+    surface->base.damage = _cairo_damage_create ();
+
+    status = _cairo_recording_surface_update_rendering (surface, damage);
+    _cairo_damage_destroy (damage);
+    if (unlikely (status)) {
+	/* Leave whatever is half drawn to be drawn again */
+	cairo_surface_destroy (surface->rendering);
+	surface->rendering = NULL;
+	_cairo_damage_destroy (surface->base.damage);
+	surface->base.damage = NULL;
+	return _cairo_surface_create_in_error (status);
+    }
+
+    return surface->rendering;
+}
+
 cairo_bool_t
 _cairo_recording_surface_has_only_bilevel_alpha (cairo_recording_surface_t *surface)
 {
@@ -113,6 +113,9 @@ struct _cairo_scaled_font {
     cairo_list_t glyph_pages;
     cairo_bool_t cache_frozen;
     cairo_bool_t global_cache_frozen;
+    /* glyph lookups not yet added to the statistics of the page cache */
+    unsigned long glyph_hits;
+    unsigned long glyph_misses;
 
     cairo_list_t dev_privates;
 
@@ -145,6 +148,8 @@ struct _cairo_scaled_glyph {
     const void		   *dev_private_key;
     void		   *dev_private;
     cairo_list_t            dev_privates;
+
+    cairo_scaled_glyph_page_t *page;			/* owning page */
 };
 
 struct _cairo_scaled_glyph_private {
@@ -76,11 +76,35 @@ _cairo_scaled_font_compute_hash (cairo_scaled_font_t *scaled_font);
  * The glyphs are allocated in pages, which are capped in the global pool.
  * Using pages means we can reduce the frequency at which we have to probe the
  * global pool and ameliorates the memory allocation pressure.
+ *
+ * The pool is split into shards, each with its own lock, so that threads
+ * rendering with different fonts do not serialise on a single mutex. All
+ * the pages of a font live in the same shard (chosen by hashing the font
+ * pointer), so freezing the cache for a font only holds up eviction within
+ * that shard. The cap remains global: a shard may grow into whatever part
+ * of the pool the other shards are not using. Once the pool is full, a
+ * shard holding less than its quota (an equal split of the pool) first
+ * reclaims a page from the largest shard above quota, so that fonts which
+ * have gone idle cannot starve the one in use; beyond its quota a shard
+ * makes room by evicting its own pages.
  */
 
 /* XXX: This number is arbitrary---we've never done any measurement of this. */
 #define MAX_GLYPH_PAGES_CACHED 512
-static cairo_cache_t cairo_scaled_glyph_page_cache;
+#define GLYPH_PAGE_CACHE_SHARDS 16
+#define GLYPH_PAGE_CACHE_SHARD_QUOTA (MAX_GLYPH_PAGES_CACHED / GLYPH_PAGE_CACHE_SHARDS)
+
+typedef struct _cairo_scaled_glyph_page_cache_shard {
+    cairo_mutex_t mutex;
+    cairo_cache_t cache;
+    unsigned long hits;
+    unsigned long misses;
+} cairo_scaled_glyph_page_cache_shard_t;
+
+static cairo_scaled_glyph_page_cache_shard_t
+cairo_scaled_glyph_page_cache[GLYPH_PAGE_CACHE_SHARDS];
+static cairo_atomic_int_t cairo_scaled_glyph_page_cache_initialized;
+static cairo_atomic_int_t cairo_scaled_glyph_pages_cached;
 
 #define CAIRO_SCALED_GLYPH_PAGE_SIZE 32
 struct _cairo_scaled_glyph_page {
@@ -253,6 +277,8 @@ static const cairo_scaled_font_t _cairo_scaled_font_nil = {
     { NULL, NULL },		/* pages */
     FALSE,			/* cache_frozen */
     FALSE,			/* global_cache_frozen */
+    0,				/* glyph_hits */
+    0,				/* glyph_misses */
     { NULL, NULL },		/* privates */
     NULL			/* backend */
 };
@@ -450,6 +476,16 @@ _cairo_scaled_font_map_destroy (void)
     CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
 }
 
+static cairo_scaled_glyph_page_cache_shard_t *
+_cairo_scaled_glyph_page_cache_shard (const cairo_scaled_font_t *scaled_font)
+{
+    uint32_t hash;
+
+    /* Fibonacci hashing of the pointer; the low bits are alignment. */
+    hash = (uint32_t) ((uintptr_t) scaled_font >> 4) * 2654435761u;
+    return &cairo_scaled_glyph_page_cache[hash >> 28];
+}
+
 static void
 _cairo_scaled_glyph_page_destroy (cairo_scaled_font_t *scaled_font,
 				  cairo_scaled_glyph_page_t *page)
@@ -467,6 +503,8 @@ _cairo_scaled_glyph_page_destroy (cairo_scaled_font_t *scaled_font,
 
     cairo_list_del (&page->link);
     free (page);
+
+    _cairo_atomic_int_dec (&cairo_scaled_glyph_pages_cached);
 }
 
 static void
@@ -484,6 +522,55 @@ _cairo_scaled_glyph_page_pluck (void *closure)
     CAIRO_MUTEX_UNLOCK (scaled_font->mutex);
 }
 
+/* Let the shard grow into the unused part of the global pool, or make
+ * it shed its share of any excess, the next time it shrinks.
+ */
+static void
+_cairo_scaled_glyph_page_cache_shard_budget (cairo_scaled_glyph_page_cache_shard_t *shard)
+{
+    long max_size;
+
+    max_size = (long) shard->cache.size + MAX_GLYPH_PAGES_CACHED -
+	       _cairo_atomic_int_get (&cairo_scaled_glyph_pages_cached);
+    shard->cache.max_size = MAX (max_size, GLYPH_PAGE_CACHE_SHARD_QUOTA);
+}
+
+/* With the pool full, take a page for @shard from the largest shard that
+ * holds more than its quota. The other shards' sizes are read unlocked as
+ * a hint only; the victim is checked again under its own lock. Must be
+ * called without holding the lock of @shard so that no two shard locks
+ * are ever held at once.
+ */
+static void
+_cairo_scaled_glyph_page_cache_shard_reclaim (cairo_scaled_glyph_page_cache_shard_t *shard)
+{
+    cairo_scaled_glyph_page_cache_shard_t *victim = NULL;
+    unsigned long largest = GLYPH_PAGE_CACHE_SHARD_QUOTA;
+    int n;
+
+    if (_cairo_atomic_int_get (&cairo_scaled_glyph_pages_cached) < MAX_GLYPH_PAGES_CACHED)
+	return;
+
+    if (shard->cache.size >= GLYPH_PAGE_CACHE_SHARD_QUOTA)
+	return;
+
+    for (n = 0; n < GLYPH_PAGE_CACHE_SHARDS; n++) {
+	cairo_scaled_glyph_page_cache_shard_t *other = &cairo_scaled_glyph_page_cache[n];
+
+	if (other != shard && other->cache.size > largest) {
+	    largest = other->cache.size;
+	    victim = other;
+	}
+    }
+    if (victim == NULL)
+	return;
+
+    CAIRO_MUTEX_LOCK (victim->mutex);
+    if (victim->cache.size > GLYPH_PAGE_CACHE_SHARD_QUOTA)
+	_cairo_cache_set_max_size (&victim->cache, victim->cache.size - 1);
+    CAIRO_MUTEX_UNLOCK (victim->mutex);
+}
+
 /* If a scaled font wants to unlock the font map while still being
  * created (needed for user-fonts), we need to take extra care not
  * ending up with multiple identical scaled fonts being created.
@@ -768,6 +855,8 @@ _cairo_scaled_font_init (cairo_scaled_font_t               *scaled_font,
     cairo_list_init (&scaled_font->glyph_pages);
     scaled_font->cache_frozen = FALSE;
     scaled_font->global_cache_frozen = FALSE;
+    scaled_font->glyph_hits = 0;
+    scaled_font->glyph_misses = 0;
 
     scaled_font->holdover = FALSE;
     scaled_font->finished = FALSE;
@@ -804,10 +893,25 @@ _cairo_scaled_font_thaw_cache (cairo_scaled_font_t *scaled_font)
 {
     assert (scaled_font->cache_frozen);
 
-    if (scaled_font->global_cache_frozen) {
-	CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
-	_cairo_cache_thaw (&cairo_scaled_glyph_page_cache);
-	CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+    /* The lookups are counted under the lock of the font, and only
+     * added to the statistics of the shard once per batch of glyphs. */
+    if (scaled_font->global_cache_frozen ||
+	scaled_font->glyph_hits || scaled_font->glyph_misses)
+    {
+	cairo_scaled_glyph_page_cache_shard_t *shard;
+
+	shard = _cairo_scaled_glyph_page_cache_shard (scaled_font);
+	CAIRO_MUTEX_LOCK (shard->mutex);
+	shard->hits += scaled_font->glyph_hits;
+	shard->misses += scaled_font->glyph_misses;
+	if (scaled_font->global_cache_frozen) {
+	    _cairo_scaled_glyph_page_cache_shard_budget (shard);
+	    _cairo_cache_thaw (&shard->cache);
+	}
+	CAIRO_MUTEX_UNLOCK (shard->mutex);
+
+	scaled_font->glyph_hits = 0;
+	scaled_font->glyph_misses = 0;
 	scaled_font->global_cache_frozen = FALSE;
     }
 
@@ -818,23 +922,34 @@ _cairo_scaled_font_thaw_cache (cairo_scaled_font_t *scaled_font)
 void
 _cairo_scaled_font_reset_cache (cairo_scaled_font_t *scaled_font)
 {
+    cairo_scaled_glyph_page_cache_shard_t *shard;
+
     CAIRO_MUTEX_LOCK (scaled_font->mutex);
     assert (! scaled_font->cache_frozen);
     assert (! scaled_font->global_cache_frozen);
-    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+
+    /* A font without pages may predate the creation of the shards. */
+    if (cairo_list_is_empty (&scaled_font->glyph_pages)) {
+	CAIRO_MUTEX_UNLOCK (scaled_font->mutex);
+	return;
+    }
+
+    shard = _cairo_scaled_glyph_page_cache_shard (scaled_font);
+    CAIRO_MUTEX_LOCK (shard->mutex);
     while (! cairo_list_is_empty (&scaled_font->glyph_pages)) {
 	cairo_scaled_glyph_page_t *page =
 	    cairo_list_first_entry (&scaled_font->glyph_pages,
 				    cairo_scaled_glyph_page_t,
 				    link);
 
-	cairo_scaled_glyph_page_cache.size -= page->cache_entry.size;
-	_cairo_hash_table_remove (cairo_scaled_glyph_page_cache.hash_table,
-				  (cairo_hash_entry_t *) &page->cache_entry);
+	/* Temporarily disconnect callback to avoid recursive locking */
+	shard->cache.entry_destroy = NULL;
+	_cairo_cache_remove (&shard->cache, &page->cache_entry);
+	shard->cache.entry_destroy = _cairo_scaled_glyph_page_pluck;
 
 	_cairo_scaled_glyph_page_destroy (scaled_font, page);
     }
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+    CAIRO_MUTEX_UNLOCK (shard->mutex);
     CAIRO_MUTEX_UNLOCK (scaled_font->mutex);
 }
 
@@ -1249,9 +1364,45 @@ _cairo_scaled_font_reset_static_data (void)
     CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_error_mutex);
 
     CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
-    if (cairo_scaled_glyph_page_cache.hash_table != NULL) {
-	_cairo_cache_fini (&cairo_scaled_glyph_page_cache);
-	cairo_scaled_glyph_page_cache.hash_table = NULL;
+    if (cairo_scaled_glyph_page_cache_initialized) {
+	int n;
+
+	for (n = 0; n < GLYPH_PAGE_CACHE_SHARDS; n++) {
+	    cairo_scaled_glyph_page_cache_shard_t *shard =
+		&cairo_scaled_glyph_page_cache[n];
+
+	    _cairo_cache_fini (&shard->cache);
+	    shard->cache.hash_table = NULL;
+	    shard->hits = shard->misses = 0;
+	    CAIRO_MUTEX_FINI (shard->mutex);
+	}
+
+	cairo_scaled_glyph_page_cache_initialized = FALSE;
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+}
+
+void
+_cairo_scaled_glyph_page_cache_get_stats (unsigned long *hits,
+					  unsigned long *misses,
+					  unsigned long *evictions)
+{
+    int n;
+
+    *hits = *misses = *evictions = 0;
+
+    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+    if (cairo_scaled_glyph_page_cache_initialized) {
+	for (n = 0; n < GLYPH_PAGE_CACHE_SHARDS; n++) {
+	    cairo_scaled_glyph_page_cache_shard_t *shard =
+		&cairo_scaled_glyph_page_cache[n];
+
+	    CAIRO_MUTEX_LOCK (shard->mutex);
+	    *hits += shard->hits;
+	    *misses += shard->misses;
+	    *evictions += shard->cache.evictions;
+	    CAIRO_MUTEX_UNLOCK (shard->mutex);
+	}
     }
     CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
 }
@@ -2828,10 +2979,57 @@ _cairo_scaled_glyph_page_can_remove (const void *closure)
     return scaled_font->cache_frozen == 0;
 }
 
+static cairo_status_t
+_cairo_scaled_glyph_page_cache_init (void)
+{
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    int n;
+
+    if (likely (_cairo_atomic_int_get (&cairo_scaled_glyph_page_cache_initialized)))
+	return CAIRO_STATUS_SUCCESS;
+
+    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+    if (! cairo_scaled_glyph_page_cache_initialized) {
+	for (n = 0; n < GLYPH_PAGE_CACHE_SHARDS; n++) {
+	    cairo_scaled_glyph_page_cache_shard_t *shard =
+		&cairo_scaled_glyph_page_cache[n];
+
+	    status = _cairo_cache_init (&shard->cache,
+					NULL,
+					_cairo_scaled_glyph_page_can_remove,
+					_cairo_scaled_glyph_page_pluck,
+					MAX_GLYPH_PAGES_CACHED);
+	    if (unlikely (status)) {
+		while (n--) {
+		    shard = &cairo_scaled_glyph_page_cache[n];
+		    _cairo_cache_fini (&shard->cache);
+		    shard->cache.hash_table = NULL;
+		    CAIRO_MUTEX_FINI (shard->mutex);
+		}
+		break;
+	    }
+
+	    /* Glyph lookups mark their page as used without taking the
+	     * lock of the shard, which only the CLOCK policy allows. */
+	    _cairo_cache_set_policy (&shard->cache, CAIRO_CACHE_POLICY_CLOCK);
+	    CAIRO_MUTEX_INIT (shard->mutex);
+	}
+
+	/* publish the shards only once they are all usable */
+	if (status == CAIRO_STATUS_SUCCESS)
+	    _cairo_atomic_int_cmpxchg (&cairo_scaled_glyph_page_cache_initialized,
+				       FALSE, TRUE);
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+
+    return status;
+}
+
 static cairo_status_t
 _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
 				   cairo_scaled_glyph_t **scaled_glyph)
 {
+    cairo_scaled_glyph_page_cache_shard_t *shard;
     cairo_scaled_glyph_page_t *page;
     cairo_status_t status;
 
@@ -2856,33 +3054,31 @@ _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
     page->cache_entry.size = 1; /* XXX occupancy weighting? */
     page->num_glyphs = 0;
 
-    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
-    if (scaled_font->global_cache_frozen == FALSE) {
-	if (unlikely (cairo_scaled_glyph_page_cache.hash_table == NULL)) {
-	    status = _cairo_cache_init (&cairo_scaled_glyph_page_cache,
-					NULL,
-					_cairo_scaled_glyph_page_can_remove,
-					_cairo_scaled_glyph_page_pluck,
-					MAX_GLYPH_PAGES_CACHED);
-	    if (unlikely (status)) {
-		CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
-		free (page);
-		return status;
-	    }
-	}
+    status = _cairo_scaled_glyph_page_cache_init ();
+    if (unlikely (status)) {
+	free (page);
+	return status;
+    }
+
+    shard = _cairo_scaled_glyph_page_cache_shard (scaled_font);
+    _cairo_scaled_glyph_page_cache_shard_reclaim (shard);
 
-	_cairo_cache_freeze (&cairo_scaled_glyph_page_cache);
+    CAIRO_MUTEX_LOCK (shard->mutex);
+    if (scaled_font->global_cache_frozen == FALSE) {
+	_cairo_cache_freeze (&shard->cache);
 	scaled_font->global_cache_frozen = TRUE;
     }
 
-    status = _cairo_cache_insert (&cairo_scaled_glyph_page_cache,
-				  &page->cache_entry);
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+    _cairo_scaled_glyph_page_cache_shard_budget (shard);
+    status = _cairo_cache_insert (&shard->cache, &page->cache_entry);
+    CAIRO_MUTEX_UNLOCK (shard->mutex);
     if (unlikely (status)) {
 	free (page);
 	return status;
     }
 
+    _cairo_atomic_int_inc (&cairo_scaled_glyph_pages_cached);
+
     cairo_list_add_tail (&page->link, &scaled_font->glyph_pages);
 
     *scaled_glyph = &page->glyphs[page->num_glyphs++];
@@ -2904,14 +3100,16 @@ _cairo_scaled_font_free_last_glyph (cairo_scaled_font_t *scaled_font,
     _cairo_scaled_glyph_fini (scaled_font, scaled_glyph);
 
     if (--page->num_glyphs == 0) {
-	CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+	cairo_scaled_glyph_page_cache_shard_t *shard;
+
+	shard = _cairo_scaled_glyph_page_cache_shard (scaled_font);
+	CAIRO_MUTEX_LOCK (shard->mutex);
 	/* Temporarily disconnect callback to avoid recursive locking */
-	cairo_scaled_glyph_page_cache.entry_destroy = NULL;
-	_cairo_cache_remove (&cairo_scaled_glyph_page_cache,
-		             &page->cache_entry);
+	shard->cache.entry_destroy = NULL;
+	_cairo_cache_remove (&shard->cache, &page->cache_entry);
 	_cairo_scaled_glyph_page_destroy (scaled_font, page);
-	cairo_scaled_glyph_page_cache.entry_destroy = _cairo_scaled_glyph_page_pluck;
-	CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+	shard->cache.entry_destroy = _cairo_scaled_glyph_page_pluck;
+	CAIRO_MUTEX_UNLOCK (shard->mutex);
     }
 }
 
@@ -2969,6 +3167,8 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
     scaled_glyph = _cairo_hash_table_lookup (scaled_font->glyphs,
 					     (cairo_hash_entry_t *) &index);
     if (scaled_glyph == NULL) {
+	scaled_font->glyph_misses++;
+
 	status = _cairo_scaled_font_allocate_glyph (scaled_font, &scaled_glyph);
 	if (unlikely (status))
 	    goto err;
@@ -2976,6 +3176,9 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
 	memset (scaled_glyph, 0, sizeof (cairo_scaled_glyph_t));
 	_cairo_scaled_glyph_set_index (scaled_glyph, index);
 	cairo_list_init (&scaled_glyph->dev_privates);
+	scaled_glyph->page = cairo_list_last_entry (&scaled_font->glyph_pages,
+						    cairo_scaled_glyph_page_t,
+						    link);
 
 	/* ask backend to initialize metrics and shape fields */
 	status =
@@ -2993,6 +3196,9 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
 	    _cairo_scaled_font_free_last_glyph (scaled_font, scaled_glyph);
 	    goto err;
 	}
+    } else {
+	scaled_font->glyph_hits++;
+	_cairo_cache_entry_set_referenced (&scaled_glyph->page->cache_entry);
     }
 
     /*
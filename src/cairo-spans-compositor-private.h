@@ -100,6 +100,14 @@ struct cairo_spans_compositor {
 
     void (*renderer_fini) (cairo_abstract_span_renderer_t *renderer,
 			   cairo_int_status_t status);
+
+    /* optional: split large polygons into bands rendered in parallel,
+     * returns the maximum number of bands to use for the surface */
+    int (*num_threads) (void *surface);
+
+    /* optional: whether fills onto the surface may be looked up in the
+     * tessellation cache */
+    cairo_bool_t (*cache_fills) (void *surface);
 };
 
 cairo_private void
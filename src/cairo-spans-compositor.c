@@ -44,7 +44,7 @@
 #include "cairo-compositor-private.h"
 #include "cairo-clip-inline.h"
 #include "cairo-clip-private.h"
-#include "cairo-image-surface-private.h"
+#include "cairo-image-surface-inline.h"
 #include "cairo-paginated-private.h"
 #include "cairo-pattern-inline.h"
 #include "cairo-region-private.h"
@@ -53,6 +53,7 @@
 #include "cairo-surface-subsurface-private.h"
 #include "cairo-surface-snapshot-private.h"
 #include "cairo-surface-observer-private.h"
+#include "cairo-thread-pool-private.h"
 
 typedef struct {
     cairo_polygon_t	*polygon;
@@ -746,6 +747,183 @@ cleanup_converter:
     return status;
 }
 
+/* Band-parallel rendering of a polygon.
+ *
+ * The destination rows are split into horizontal bands, each with its
+ * own scan converter and span renderer. The renderers are set up (and
+ * torn down) on the calling thread as that may involve acquiring the
+ * source, but the scan conversion and the compositing of the spans
+ * for each band is then run on the thread pool. Each band covers a
+ * disjoint set of rows, and as the tor converter walks the edges down
+ * from the top of the polygon before emitting the spans of its band,
+ * the result is identical to rendering the polygon in one pass.
+ */
+#define BAND_MIN_HEIGHT 32
+#define BAND_MIN_AREA (256*256)
+
+typedef struct {
+    cairo_composite_rectangles_t extents;
+    cairo_abstract_span_renderer_t renderer;
+    const cairo_polygon_t *polygon;
+    cairo_fill_rule_t fill_rule;
+    cairo_antialias_t antialias;
+    int ymin;
+    cairo_int_status_t status;
+} composite_band_t;
+
+static cairo_bool_t
+pattern_can_band (const cairo_pattern_t *pattern)
+{
+    cairo_surface_t *surface;
+
+    switch (pattern->type) {
+    case CAIRO_PATTERN_TYPE_SOLID:
+    case CAIRO_PATTERN_TYPE_LINEAR:
+    case CAIRO_PATTERN_TYPE_RADIAL:
+	return TRUE;
+
+    case CAIRO_PATTERN_TYPE_SURFACE:
+	/* Avoid replaying a recording, or similar, once per band */
+	surface = ((const cairo_surface_pattern_t *) pattern)->surface;
+	return _cairo_surface_is_image (surface);
+
+    case CAIRO_PATTERN_TYPE_MESH:
+    case CAIRO_PATTERN_TYPE_RASTER_SOURCE:
+    default:
+	return FALSE;
+    }
+}
+
+static int
+composite_num_bands (const cairo_spans_compositor_t	*compositor,
+		     const cairo_composite_rectangles_t	*extents,
+		     cairo_antialias_t			 antialias)
+{
+    const cairo_rectangle_int_t *r = &extents->unbounded;
+    int num_bands;
+
+    if (compositor->num_threads == NULL)
+	return 1;
+
+    /* Only the tor converter knows how to split a polygon exactly. */
+    if (antialias == CAIRO_ANTIALIAS_FAST || antialias == CAIRO_ANTIALIAS_NONE)
+	return 1;
+
+    if (! extents->is_bounded)
+	return 1;
+
+    if (r->height < 2 * BAND_MIN_HEIGHT ||
+	r->width * r->height < BAND_MIN_AREA)
+	return 1;
+
+    if (! pattern_can_band (&extents->source_pattern.base) ||
+	extents->mask_pattern.base.type != CAIRO_PATTERN_TYPE_SOLID)
+	return 1;
+
+    num_bands = compositor->num_threads (extents->surface);
+    if (num_bands > r->height / BAND_MIN_HEIGHT)
+	num_bands = r->height / BAND_MIN_HEIGHT;
+
+    return num_bands;
+}
+
+static void
+composite_band (void *closure)
+{
+    composite_band_t *band = closure;
+    const cairo_rectangle_int_t *r = &band->extents.unbounded;
+    cairo_scan_converter_t *converter;
+    cairo_int_status_t status;
+
+    converter = _cairo_tor_scan_converter_create_for_band (r->x, band->ymin,
+							   r->x + r->width,
+							   r->y + r->height,
+							   r->y,
+							   band->fill_rule,
+							   band->antialias);
+    status = _cairo_tor_scan_converter_add_polygon (converter, band->polygon);
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	status = converter->generate (converter, &band->renderer.base);
+    converter->destroy (converter);
+
+    band->status = status;
+}
+
+static cairo_int_status_t
+composite_polygon_bands (const cairo_spans_compositor_t	*compositor,
+			 cairo_composite_rectangles_t		*extents,
+			 cairo_polygon_t			*polygon,
+			 cairo_fill_rule_t			 fill_rule,
+			 cairo_antialias_t			 antialias,
+			 int					 num_bands)
+{
+    const cairo_rectangle_int_t *r = &extents->unbounded;
+    composite_band_t *bands;
+    cairo_int_status_t status;
+    int i, n, y;
+
+    TRACE ((stderr, "%s - num_bands=%d\n", __FUNCTION__, num_bands));
+
+    bands = _cairo_malloc_ab (num_bands, sizeof (composite_band_t));
+    if (unlikely (bands == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    status = CAIRO_INT_STATUS_SUCCESS;
+    for (i = n = 0, y = r->y; i < num_bands; i++) {
+	composite_band_t *band = &bands[n];
+	cairo_rectangle_int_t rows;
+
+	rows.x = r->x;
+	rows.width = r->width;
+	rows.y = y;
+	rows.height = r->y + (i + 1) * r->height / num_bands - y;
+	y += rows.height;
+
+	band->extents = *extents;
+	band->extents.unbounded = rows;
+	if (! _cairo_rectangle_intersect (&band->extents.bounded, &rows))
+	    continue;
+
+	band->polygon = polygon;
+	band->fill_rule = fill_rule;
+	band->antialias = antialias;
+	band->ymin = r->y;
+	band->status = CAIRO_INT_STATUS_SUCCESS;
+
+	status = compositor->renderer_init (&band->renderer, &band->extents,
+					    antialias, FALSE);
+	if (unlikely (status)) {
+	    compositor->renderer_fini (&band->renderer, status);
+	    break;
+	}
+
+	n++;
+    }
+
+    /* The renderers may share the destination and source images, e.g.
+     * the image compositor hands every band dst->pixman_image and the
+     * cached solid colours. This is safe as everything that creates,
+     * references or releases them happens here and in renderer_fini(),
+     * on this thread; the workers only composite into the disjoint rows
+     * of their own band and read the sources. */
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	_cairo_thread_pool_run (composite_band, bands, n, sizeof (*bands));
+
+    for (i = 0; i < n; i++) {
+	cairo_int_status_t band_status = status;
+
+	if (band_status == CAIRO_INT_STATUS_SUCCESS)
+	    band_status = bands[i].status;
+	compositor->renderer_fini (&bands[i].renderer, band_status);
+
+	if (status == CAIRO_INT_STATUS_SUCCESS)
+	    status = band_status;
+    }
+
+    free (bands);
+    return status;
+}
+
 static cairo_int_status_t
 composite_polygon (const cairo_spans_compositor_t	*compositor,
 		   cairo_composite_rectangles_t		 *extents,
@@ -757,6 +935,7 @@ composite_polygon (const cairo_spans_compositor_t	*compositor,
     cairo_scan_converter_t *converter;
     cairo_bool_t needs_clip;
     cairo_int_status_t status;
+    int num_bands;
 
     if (extents->is_bounded)
 	needs_clip = extents->clip->path != NULL;
@@ -772,6 +951,11 @@ composite_polygon (const cairo_spans_compositor_t	*compositor,
     } else {
 	const cairo_rectangle_int_t *r = &extents->unbounded;
 
+	num_bands = composite_num_bands (compositor, extents, antialias);
+	if (num_bands > 1)
+	    return composite_polygon_bands (compositor, extents, polygon,
+					    fill_rule, antialias, num_bands);
+
 	if (antialias == CAIRO_ANTIALIAS_FAST) {
 	    converter = _cairo_tor22_scan_converter_create (r->x, r->y,
 							    r->x + r->width,
@@ -1058,6 +1242,7 @@ _cairo_spans_compositor_stroke (const cairo_compositor_t	*_compositor,
 	{
 	    _cairo_polygon_init (&polygon, NULL, 0);
 	}
+	_cairo_polygon_use_arena (&polygon);
 	status = _cairo_path_fixed_stroke_to_polygon (path,
 						      style,
 						      ctm, ctm_inverse,
@@ -1103,10 +1288,14 @@ _cairo_spans_compositor_fill (const cairo_compositor_t		*_compositor,
 			      cairo_antialias_t			 antialias)
 {
     const cairo_spans_compositor_t *compositor = (cairo_spans_compositor_t*)_compositor;
+    cairo_bool_t cache_fills;
     cairo_int_status_t status;
 
     TRACE((stderr, "%s op=%d, antialias=%d\n", __FUNCTION__, extents->op, antialias));
 
+    cache_fills = compositor->cache_fills != NULL &&
+		  compositor->cache_fills (extents->surface);
+
     status = CAIRO_INT_STATUS_UNSUPPORTED;
     if (_cairo_path_fixed_fill_is_rectilinear (path)) {
 	cairo_boxes_t boxes;
@@ -1118,10 +1307,17 @@ _cairo_spans_compositor_fill (const cairo_compositor_t		*_compositor,
 	    _cairo_boxes_limit (&boxes,
 				extents->clip->boxes,
 				extents->clip->num_boxes);
-	status = _cairo_path_fixed_fill_rectilinear_to_boxes (path,
-							      fill_rule,
-							      antialias,
-							      &boxes);
+	if (cache_fills) {
+	    status = _cairo_path_fixed_fill_rectilinear_to_boxes_cached (path,
+									 fill_rule,
+									 antialias,
+									 &boxes);
+	} else {
+	    status = _cairo_path_fixed_fill_rectilinear_to_boxes (path,
+								  fill_rule,
+								  antialias,
+								  &boxes);
+	}
 	if (likely (status == CAIRO_INT_STATUS_SUCCESS))
 	    status = clip_and_composite_boxes (compositor, extents, &boxes);
 	_cairo_boxes_fini (&boxes);
@@ -1147,8 +1343,12 @@ _cairo_spans_compositor_fill (const cairo_compositor_t		*_compositor,
 	{
 	    _cairo_polygon_init (&polygon, NULL, 0);
 	}
+	_cairo_polygon_use_arena (&polygon);
 
-	status = _cairo_path_fixed_fill_to_polygon (path, tolerance, &polygon);
+	if (cache_fills)
+	    status = _cairo_path_fixed_fill_to_polygon_cached (path, tolerance, &polygon);
+	else
+	    status = _cairo_path_fixed_fill_to_polygon (path, tolerance, &polygon);
 	TRACE_ (_cairo_debug_print_polygon (stderr, &polygon));
 	polygon.num_limits = 0;
 
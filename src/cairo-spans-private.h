@@ -90,6 +90,14 @@ _cairo_tor_scan_converter_create (int			xmin,
 				  int			ymax,
 				  cairo_fill_rule_t	fill_rule,
 				  cairo_antialias_t	antialias);
+cairo_private cairo_scan_converter_t *
+_cairo_tor_scan_converter_create_for_band (int			xmin,
+					   int			ymin,
+					   int			xmax,
+					   int			ymax,
+					   int			ystart,
+					   cairo_fill_rule_t	fill_rule,
+					   cairo_antialias_t	antialias);
 cairo_private cairo_status_t
 _cairo_tor_scan_converter_add_polygon (void		*converter,
 				       const cairo_polygon_t *polygon);
@@ -0,0 +1,76 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is agent.
+ *
+ * Contributor(s):
+ *	agent <agent@local>
+ */
+
+#ifndef CAIRO_THREAD_POOL_PRIVATE_H
+#define CAIRO_THREAD_POOL_PRIVATE_H
+
+#include "cairo-compiler-private.h"
+#include "cairo-types-private.h"
+
+CAIRO_BEGIN_DECLS
+
+/* A process-wide pool of worker threads used to split a single large
+ * operation (e.g. the rasterisation of a polygon covering a large image)
+ * into independent jobs.
+ *
+ * The pool only offers a "parallel for": _cairo_thread_pool_run() calls
+ * func() once for each of the num_jobs elements of the jobs array and
+ * returns only when all of them have completed. The calling thread takes
+ * part in executing the jobs, so nested calls cannot deadlock, and in
+ * builds without real thread support the jobs are simply run in order.
+ *
+ * Jobs must not touch any cairo state that is not otherwise safe to use
+ * from multiple threads; the caller is responsible for partitioning the
+ * work so that the jobs are independent.
+ */
+typedef void (*cairo_thread_pool_func_t) (void *job);
+
+#define CAIRO_THREAD_POOL_MAX_THREADS 32
+
+cairo_private int
+_cairo_thread_pool_get_num_threads (void);
+
+cairo_private void
+_cairo_thread_pool_run (cairo_thread_pool_func_t func,
+			void *jobs,
+			int num_jobs,
+			size_t job_size);
+
+cairo_private void
+_cairo_thread_pool_reset_static_data (void);
+
+CAIRO_END_DECLS
+
+#endif /* CAIRO_THREAD_POOL_PRIVATE_H */
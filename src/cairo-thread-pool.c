@@ -0,0 +1,285 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is agent.
+ *
+ * Contributor(s):
+ *	agent <agent@local>
+ */
+
+#include "cairoint.h"
+
+#include "cairo-list-inline.h"
+#include "cairo-thread-pool-private.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+static void
+run_serial (cairo_thread_pool_func_t func,
+	    char *jobs, int num_jobs, size_t job_size)
+{
+    int i;
+
+    for (i = 0; i < num_jobs; i++)
+	func (jobs + i * job_size);
+}
+
+#if CAIRO_HAS_REAL_PTHREAD
+
+#include <pthread.h>
+
+typedef struct _cairo_thread_pool_batch {
+    cairo_list_t link;
+
+    cairo_thread_pool_func_t func;
+    char *jobs;
+    size_t job_size;
+    int num_jobs;
+
+    int next;
+    int completed;
+    pthread_cond_t done;
+} cairo_thread_pool_batch_t;
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeup;
+
+    cairo_list_t pending;
+    cairo_bool_t shutdown;
+
+    int num_cpus;
+    int num_workers;
+    pthread_t workers[CAIRO_THREAD_POOL_MAX_THREADS];
+} pool = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    { &pool.pending, &pool.pending },
+};
+
+/* Claims the next unstarted job of the batch, must be called with the
+ * pool mutex held. A batch is only kept on the pending list whilst it
+ * still has jobs to hand out. */
+static void *
+batch_claim (cairo_thread_pool_batch_t *batch)
+{
+    void *job;
+
+    job = batch->jobs + batch->next * batch->job_size;
+    if (++batch->next == batch->num_jobs)
+	cairo_list_del (&batch->link);
+
+    return job;
+}
+
+static void
+batch_complete (cairo_thread_pool_batch_t *batch)
+{
+    if (++batch->completed == batch->num_jobs)
+	pthread_cond_signal (&batch->done);
+}
+
+static void *
+worker_main (void *arg)
+{
+    pthread_mutex_lock (&pool.mutex);
+    while (! pool.shutdown) {
+	cairo_thread_pool_batch_t *batch;
+	void *job;
+
+	if (cairo_list_is_empty (&pool.pending)) {
+	    pthread_cond_wait (&pool.wakeup, &pool.mutex);
+	    continue;
+	}
+
+	batch = cairo_list_first_entry (&pool.pending,
+					cairo_thread_pool_batch_t,
+					link);
+	job = batch_claim (batch);
+	pthread_mutex_unlock (&pool.mutex);
+
+	batch->func (job);
+
+	pthread_mutex_lock (&pool.mutex);
+	batch_complete (batch);
+    }
+    pthread_mutex_unlock (&pool.mutex);
+
+    return NULL;
+}
+
+static int
+count_cpus (void)
+{
+    long n = 1;
+
+#if defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1)
+	n = 1;
+    if (n > CAIRO_THREAD_POOL_MAX_THREADS)
+	n = CAIRO_THREAD_POOL_MAX_THREADS;
+
+    return n;
+}
+
+/* Called with the pool mutex held. */
+static void
+start_workers (void)
+{
+    if (pool.num_cpus == 0)
+	pool.num_cpus = count_cpus ();
+
+    /* The thread submitting the work makes up the numbers. */
+    while (pool.num_workers < pool.num_cpus - 1) {
+	if (pthread_create (&pool.workers[pool.num_workers], NULL,
+			    worker_main, NULL))
+	    break;
+
+	pool.num_workers++;
+    }
+}
+
+int
+_cairo_thread_pool_get_num_threads (void)
+{
+    int n;
+
+    pthread_mutex_lock (&pool.mutex);
+    if (pool.num_cpus == 0)
+	pool.num_cpus = count_cpus ();
+    n = pool.num_cpus;
+    pthread_mutex_unlock (&pool.mutex);
+
+    return n;
+}
+
+void
+_cairo_thread_pool_run (cairo_thread_pool_func_t func,
+			void *jobs,
+			int num_jobs,
+			size_t job_size)
+{
+    cairo_thread_pool_batch_t batch;
+
+    if (num_jobs <= 1) {
+	run_serial (func, jobs, num_jobs, job_size);
+	return;
+    }
+
+    pthread_mutex_lock (&pool.mutex);
+    start_workers ();
+    if (pool.num_workers == 0) {
+	pthread_mutex_unlock (&pool.mutex);
+	run_serial (func, jobs, num_jobs, job_size);
+	return;
+    }
+
+    batch.func = func;
+    batch.jobs = jobs;
+    batch.job_size = job_size;
+    batch.num_jobs = num_jobs;
+    batch.next = 0;
+    batch.completed = 0;
+    pthread_cond_init (&batch.done, NULL);
+
+    cairo_list_add_tail (&batch.link, &pool.pending);
+    if (num_jobs - 1 < pool.num_workers) {
+	int n;
+
+	for (n = 0; n < num_jobs - 1; n++)
+	    pthread_cond_signal (&pool.wakeup);
+    } else {
+	pthread_cond_broadcast (&pool.wakeup);
+    }
+
+    /* Help out with our own jobs rather than sit idle. */
+    while (batch.next < batch.num_jobs) {
+	void *job = batch_claim (&batch);
+
+	pthread_mutex_unlock (&pool.mutex);
+	func (job);
+	pthread_mutex_lock (&pool.mutex);
+
+	batch.completed++;
+    }
+
+    while (batch.completed < batch.num_jobs)
+	pthread_cond_wait (&batch.done, &pool.mutex);
+    pthread_mutex_unlock (&pool.mutex);
+
+    pthread_cond_destroy (&batch.done);
+}
+
+void
+_cairo_thread_pool_reset_static_data (void)
+{
+    int n, num_workers;
+
+    pthread_mutex_lock (&pool.mutex);
+    pool.shutdown = TRUE;
+    num_workers = pool.num_workers;
+    pthread_cond_broadcast (&pool.wakeup);
+    pthread_mutex_unlock (&pool.mutex);
+
+    for (n = 0; n < num_workers; n++)
+	pthread_join (pool.workers[n], NULL);
+
+    pthread_mutex_lock (&pool.mutex);
+    pool.num_workers = 0;
+    pool.shutdown = FALSE;
+    pthread_mutex_unlock (&pool.mutex);
+}
+
+#else
+
+int
+_cairo_thread_pool_get_num_threads (void)
+{
+    return 1;
+}
+
+void
+_cairo_thread_pool_run (cairo_thread_pool_func_t func,
+			void *jobs,
+			int num_jobs,
+			size_t job_size)
+{
+    run_serial (func, jobs, num_jobs, job_size);
+}
+
+void
+_cairo_thread_pool_reset_static_data (void)
+{
+}
+
+#endif
@@ -102,6 +102,10 @@
 #include <limits.h>
 #include <setjmp.h>
 
+/* Enable to check every row computed by the vector coverage kernels
+ * against the scalar reference. */
+#define DEBUG_TOR_KERNELS 0
+
 /*-------------------------------------------------------------------------
  * cairo specific config
  */
@@ -354,6 +358,13 @@ struct polygon {
     struct edge **y_buckets;
     struct edge *y_buckets_embedded[64];
 
+    /* When the polygon is a band of a taller one, the edges that have
+     * already started above ymin are kept here, unsorted, and are put
+     * straight onto the active list rather than into the first bucket,
+     * just as if the rows above had been scan converted. */
+    struct edge *carried;
+    int carry_edges;
+
     struct {
 	struct pool base[1];
 	struct edge embedded[32];
@@ -424,6 +435,9 @@ struct cell_list {
 	struct pool base[1];
 	struct cell embedded[32];
     } cell_pool;
+
+    /* Number of cells on the current row */
+    int num_cells;
 };
 
 struct cell_pair {
@@ -445,6 +459,25 @@ struct active_list {
     int is_vertical;
 };
 
+/* The cells of a pixel row unpacked into arrays, so that the running
+ * coverage can be computed several cells at a time. */
+struct coverage_row {
+    int *x;
+    int16_t *covered_height;
+    int16_t *uncovered_area;
+
+    /* The coverage to the right of each cell, and within it. */
+    int16_t *cover;
+    int16_t *area;
+    uint8_t *cover_alpha;
+    uint8_t *area_alpha;
+};
+
+/* Computes cover, area and their alpha values for cells [i, n) given
+ * the coverage to the left of cell i. */
+typedef void
+(*coverage_kernel_t) (struct coverage_row *row, int i, int n, int16_t cover);
+
 struct glitter_scan_converter {
     struct polygon	polygon[1];
     struct active_list	active[1];
@@ -453,9 +486,16 @@ struct glitter_scan_converter {
     cairo_half_open_span_t *spans;
     cairo_half_open_span_t spans_embedded[64];
 
+    /* Vectorised conversion of the cells to spans, if the cpu supports
+     * it; otherwise kernel is NULL and row is unused. */
+    coverage_kernel_t kernel;
+    struct coverage_row row;
+    void *row_data;
+
     /* Clip box. */
     grid_scaled_x_t xmin, xmax;
     grid_scaled_y_t ymin, ymax;
+
 };
 
 /* Compute the floored division a/b. Assumes / and % perform symmetric
@@ -650,6 +690,7 @@ cell_list_init(struct cell_list *cells, jmp_buf *jmp)
     cells->tail.x = INT_MAX;
     cells->head.x = INT_MIN;
     cells->head.next = &cells->tail;
+    cells->num_cells = 0;
     cell_list_rewind (cells);
 }
 
@@ -666,6 +707,7 @@ cell_list_reset (struct cell_list *cells)
 {
     cell_list_rewind (cells);
     cells->head.next = &cells->tail;
+    cells->num_cells = 0;
     pool_reset (cells->cell_pool.base);
 }
 
@@ -681,6 +723,7 @@ cell_list_alloc (struct cell_list *cells,
     tail->next = cell;
     cell->x = x;
     *(uint32_t *)&cell->uncovered_area = 0;
+    cells->num_cells++;
 
     return cell;
 }
@@ -914,6 +957,8 @@ polygon_init (struct polygon *polygon, jmp_buf *jmp)
 {
     polygon->ymin = polygon->ymax = 0;
     polygon->y_buckets = polygon->y_buckets_embedded;
+    polygon->carried = NULL;
+    polygon->carry_edges = FALSE;
     pool_init (polygon->edge_pool.base, jmp,
 	       8192 - sizeof (struct _pool_chunk),
 	       sizeof (polygon->edge_pool.embedded));
@@ -955,6 +1000,8 @@ polygon_reset (struct polygon *polygon,
 	    goto bail_no_mem;
     }
     memset (polygon->y_buckets, 0, num_buckets * sizeof (struct edge *));
+    polygon->carried = NULL;
+    polygon->carry_edges = FALSE;
 
     polygon->ymin = ymin;
     polygon->ymax = ymax;
@@ -1029,7 +1076,14 @@ polygon_add_edge (struct polygon *polygon,
 	}
     }
 
-    _polygon_insert_edge_into_its_y_bucket (polygon, e);
+    if (edge->top < ymin && polygon->carry_edges) {
+	if (polygon->carried)
+	    polygon->carried->prev = e;
+	e->next = polygon->carried;
+	e->prev = NULL;
+	polygon->carried = e;
+    } else
+	_polygon_insert_edge_into_its_y_bucket (polygon, e);
 
     e->x.rem -= dy;		/* Bias the remainder for faster
 				 * edge advancement. */
@@ -1376,6 +1430,258 @@ full_row (struct active_list *active,
     }
 }
 
+/*-------------------------------------------------------------------------
+ * Coverage kernels
+ *
+ * Converting a row of cells into spans means summing the coverage
+ * deltas from left to right. When there are many cells on a row (for
+ * instance along a shallow edge) we unpack the cells into arrays and
+ * compute the prefix sum, and the alpha values, several cells at a
+ * time. The scalar kernel is the reference for the vector kernels:
+ * as everything is done in the same 16-bit wrapping arithmetic as
+ * blit_a8(), they produce identical spans.
+ *
+ * Rows with only a few cells (the two sides of a glyph stem, say) are
+ * cheaper to walk directly than to unpack, so they are left to blit_a8().
+ */
+#define COVERAGE_KERNEL_MIN_CELLS 16
+
+static void
+coverage_row_scalar (struct coverage_row *row, int i, int n, int16_t cover)
+{
+    for (; i < n; i++) {
+	int16_t area;
+
+	cover += row->covered_height[i]*GRID_X*2;
+	area = cover - row->uncovered_area[i];
+
+	row->cover[i] = cover;
+	row->area[i] = area;
+	row->cover_alpha[i] = GRID_AREA_TO_ALPHA (cover);
+	row->area_alpha[i] = GRID_AREA_TO_ALPHA (area);
+    }
+}
+
+#if (defined(__i386__) || defined(__x86_64__)) && GRID_XY == 2*256*15 && \
+    ((defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+     defined(__clang__))
+#define HAVE_X86_COVERAGE_KERNELS 1
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target ("sse2")))
+#define AVX2 __attribute__((target ("avx2")))
+
+/* GRID_AREA_TO_ALPHA() of 8 areas, truncated to 8 bits. */
+static inline SSE2 __m128i
+area_to_alpha_sse2 (__m128i area)
+{
+    __m128i lo, hi;
+
+    lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (area, area), 16);
+    hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (area, area), 16);
+
+    lo = _mm_add_epi32 (_mm_add_epi32 (lo, _mm_slli_epi32 (lo, 4)),
+			_mm_set1_epi32 (256));
+    hi = _mm_add_epi32 (_mm_add_epi32 (hi, _mm_slli_epi32 (hi, 4)),
+			_mm_set1_epi32 (256));
+
+    lo = _mm_and_si128 (_mm_srai_epi32 (lo, 9), _mm_set1_epi32 (255));
+    hi = _mm_and_si128 (_mm_srai_epi32 (hi, 9), _mm_set1_epi32 (255));
+
+    lo = _mm_packs_epi32 (lo, hi);
+    return _mm_packus_epi16 (lo, lo);
+}
+
+static SSE2 void
+coverage_row_sse2 (struct coverage_row *row, int i, int n, int16_t cover)
+{
+    __m128i carry = _mm_set1_epi16 (cover);
+
+    for (; i + 8 <= n; i += 8) {
+	__m128i h, c, a;
+
+	h = _mm_loadu_si128 ((const __m128i *) (row->covered_height + i));
+	h = _mm_slli_epi16 (h, 9); /* *GRID_X*2 */
+	h = _mm_add_epi16 (h, _mm_slli_si128 (h, 2));
+	h = _mm_add_epi16 (h, _mm_slli_si128 (h, 4));
+	h = _mm_add_epi16 (h, _mm_slli_si128 (h, 8));
+
+	c = _mm_add_epi16 (h, carry);
+	a = _mm_sub_epi16 (c,
+			   _mm_loadu_si128 ((const __m128i *) (row->uncovered_area + i)));
+
+	_mm_storeu_si128 ((__m128i *) (row->cover + i), c);
+	_mm_storeu_si128 ((__m128i *) (row->area + i), a);
+	_mm_storel_epi64 ((__m128i *) (row->cover_alpha + i),
+			  area_to_alpha_sse2 (c));
+	_mm_storel_epi64 ((__m128i *) (row->area_alpha + i),
+			  area_to_alpha_sse2 (a));
+
+	carry = _mm_shufflehi_epi16 (c, 0xff);
+	carry = _mm_unpackhi_epi64 (carry, carry);
+	cover = row->cover[i + 7];
+    }
+
+    coverage_row_scalar (row, i, n, cover);
+}
+
+static AVX2 void
+coverage_row_avx2 (struct coverage_row *row, int i, int n, int16_t cover)
+{
+    __m256i carry = _mm256_set1_epi16 (cover);
+
+    for (; i + 16 <= n; i += 16) {
+	__m256i h, t, c, a;
+
+	/* Prefix sum within each 128-bit lane... */
+	h = _mm256_loadu_si256 ((const __m256i *) (row->covered_height + i));
+	h = _mm256_slli_epi16 (h, 9); /* *GRID_X*2 */
+	h = _mm256_add_epi16 (h, _mm256_slli_si256 (h, 2));
+	h = _mm256_add_epi16 (h, _mm256_slli_si256 (h, 4));
+	h = _mm256_add_epi16 (h, _mm256_slli_si256 (h, 8));
+
+	/* ...then carry the sum of the low lane into the high lane. */
+	t = _mm256_permute2x128_si256 (h, h, 0x08);
+	t = _mm256_shufflehi_epi16 (t, 0xff);
+	h = _mm256_add_epi16 (h, _mm256_unpackhi_epi64 (t, t));
+
+	c = _mm256_add_epi16 (h, carry);
+	a = _mm256_sub_epi16 (c,
+			      _mm256_loadu_si256 ((const __m256i *) (row->uncovered_area + i)));
+
+	_mm256_storeu_si256 ((__m256i *) (row->cover + i), c);
+	_mm256_storeu_si256 ((__m256i *) (row->area + i), a);
+	_mm_storeu_si128 ((__m128i *) (row->cover_alpha + i),
+			  _mm_unpacklo_epi64 (area_to_alpha_sse2 (_mm256_castsi256_si128 (c)),
+					      area_to_alpha_sse2 (_mm256_extracti128_si256 (c, 1))));
+	_mm_storeu_si128 ((__m128i *) (row->area_alpha + i),
+			  _mm_unpacklo_epi64 (area_to_alpha_sse2 (_mm256_castsi256_si128 (a)),
+					      area_to_alpha_sse2 (_mm256_extracti128_si256 (a, 1))));
+
+	t = _mm256_shufflehi_epi16 (c, 0xff);
+	t = _mm256_unpackhi_epi64 (t, t);
+	carry = _mm256_permute2x128_si256 (t, t, 0x11);
+	cover = row->cover[i + 15];
+    }
+
+    coverage_row_sse2 (row, i, n, cover);
+}
+
+#undef SSE2
+#undef AVX2
+#endif
+
+#if DEBUG_TOR_KERNELS
+static coverage_kernel_t coverage_kernel_checked;
+
+static void
+coverage_row_check (struct coverage_row *row, int i, int n, int16_t cover)
+{
+    struct coverage_row ref;
+    int16_t *buf;
+    uint8_t *alpha;
+    int j;
+
+    buf = _cairo_malloc_ab (2 * n + 1, sizeof (int16_t));
+    alpha = _cairo_malloc_ab (2, n + 1);
+    assert (buf != NULL && alpha != NULL);
+
+    ref = *row;
+    ref.cover = buf;
+    ref.area = buf + n;
+    ref.cover_alpha = alpha;
+    ref.area_alpha = alpha + n;
+
+    coverage_row_scalar (&ref, i, n, cover);
+    coverage_kernel_checked (row, i, n, cover);
+
+    for (j = i; j < n; j++) {
+	assert (row->cover[j] == ref.cover[j]);
+	assert (row->area[j] == ref.area[j]);
+	assert (row->cover_alpha[j] == ref.cover_alpha[j]);
+	assert (row->area_alpha[j] == ref.area_alpha[j]);
+    }
+
+    free (buf);
+    free (alpha);
+}
+#endif
+
+static coverage_kernel_t coverage_kernel;
+static cairo_bool_t coverage_kernel_initialized;
+
+/* Picks the widest coverage kernel supported by the cpu. Setting
+ * CAIRO_DEBUG_TOR_KERNEL to "scalar", "sse2" or "avx2" limits the
+ * choice, e.g. to compare the output against the scalar code; it is
+ * read again after cairo_debug_reset_static_data(). */
+static coverage_kernel_t
+coverage_kernel_get (void)
+{
+    if (! coverage_kernel_initialized) {
+	coverage_kernel_t best = NULL;
+#if HAVE_X86_COVERAGE_KERNELS
+	const char *env = getenv ("CAIRO_DEBUG_TOR_KERNEL");
+
+	__builtin_cpu_init ();
+	if (env == NULL || strcmp (env, "avx2") == 0) {
+	    if (__builtin_cpu_supports ("avx2"))
+		best = coverage_row_avx2;
+	}
+	if (best == NULL && (env == NULL || strcmp (env, "scalar") != 0)) {
+	    if (__builtin_cpu_supports ("sse2"))
+		best = coverage_row_sse2;
+	}
+#endif
+#if DEBUG_TOR_KERNELS
+	coverage_kernel_checked = best ? best : coverage_row_scalar;
+	best = coverage_row_check;
+#endif
+	/* Racing threads all make the same choice. */
+	coverage_kernel = best;
+	coverage_kernel_initialized = TRUE;
+    }
+
+    return coverage_kernel;
+}
+
+void
+_cairo_tor_scan_converter_reset_static_data (void)
+{
+    coverage_kernel = NULL;
+    coverage_kernel_initialized = FALSE;
+}
+
+static glitter_status_t
+coverage_row_init (struct coverage_row *row, void **data, int width)
+{
+    char *ptr;
+
+    if (width <= 0)
+	width = 1;
+
+    ptr = _cairo_malloc_ab (width,
+			    sizeof (int) + 4*sizeof (int16_t) + 2*sizeof (uint8_t));
+    if (unlikely (ptr == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    *data = ptr;
+
+    row->x = (int *) ptr;
+    ptr += width * sizeof (int);
+    row->covered_height = (int16_t *) ptr;
+    ptr += width * sizeof (int16_t);
+    row->uncovered_area = (int16_t *) ptr;
+    ptr += width * sizeof (int16_t);
+    row->cover = (int16_t *) ptr;
+    ptr += width * sizeof (int16_t);
+    row->area = (int16_t *) ptr;
+    ptr += width * sizeof (int16_t);
+    row->cover_alpha = (uint8_t *) ptr;
+    ptr += width;
+    row->area_alpha = (uint8_t *) ptr;
+
+    return GLITTER_STATUS_SUCCESS;
+}
+
 static void
 _glitter_scan_converter_init(glitter_scan_converter_t *converter, jmp_buf *jmp)
 {
@@ -1386,6 +1692,8 @@ _glitter_scan_converter_init(glitter_scan_converter_t *converter, jmp_buf *jmp)
     converter->ymin=0;
     converter->xmax=0;
     converter->ymax=0;
+    converter->kernel = NULL;
+    converter->row_data = NULL;
 }
 
 static void
@@ -1393,6 +1701,7 @@ _glitter_scan_converter_fini(glitter_scan_converter_t *self)
 {
     if (self->spans != self->spans_embedded)
 	free (self->spans);
+    free (self->row_data);
 
     polygon_fini(self->polygon);
     cell_list_fini(self->coverages);
@@ -1443,6 +1752,15 @@ glitter_scan_converter_reset(
     } else
 	converter->spans = converter->spans_embedded;
 
+    /* There is at most one cell per pixel within the clip box. */
+    converter->kernel = coverage_kernel_get ();
+    if (converter->kernel) {
+	status = coverage_row_init (&converter->row, &converter->row_data,
+				    xmax - xmin);
+	if (unlikely (status))
+	    return status;
+    }
+
     xmin = int_to_grid_scaled_x(xmin);
     ymin = int_to_grid_scaled_y(ymin);
     xmax = int_to_grid_scaled_x(xmax);
@@ -1600,6 +1918,89 @@ blit_a8 (struct cell_list *cells,
     return renderer->render_rows (renderer, y, height, spans, num_spans);
 }
 
+/* As blit_a8(), but computing the coverages with a vector kernel. */
+static glitter_status_t
+blit_a8_kernel (struct cell_list *cells,
+		struct coverage_row *row,
+		coverage_kernel_t kernel,
+		cairo_span_renderer_t *renderer,
+		cairo_half_open_span_t *spans,
+		int y, int height,
+		int xmin, int xmax)
+{
+    struct cell *cell = cells->head.next;
+    int prev_x = xmin, last_x = -1;
+    int16_t cover = 0, last_cover = 0;
+    uint8_t cover_alpha;
+    unsigned num_spans;
+    int i, n;
+
+    if (cell == &cells->tail)
+	return CAIRO_STATUS_SUCCESS;
+
+    /* Skip cells to the left of the clip region. */
+    while (cell->x < xmin) {
+	cover += cell->covered_height;
+	cell = cell->next;
+    }
+    cover *= GRID_X*2;
+    cover_alpha = GRID_AREA_TO_ALPHA (cover);
+
+    /* Unpack the remaining cells and sum their coverages. */
+    for (n = 0; cell->x < xmax; cell = cell->next, n++) {
+	row->x[n] = cell->x;
+	row->covered_height[n] = cell->covered_height;
+	row->uncovered_area[n] = cell->uncovered_area;
+    }
+    kernel (row, 0, n, cover);
+
+    /* Form the spans from the coverages and areas. */
+    num_spans = 0;
+    for (i = 0; i < n; i++) {
+	int x = row->x[i];
+	int16_t area;
+
+	if (x > prev_x && cover != last_cover) {
+	    spans[num_spans].x = prev_x;
+	    spans[num_spans].coverage = cover_alpha;
+	    last_cover = cover;
+	    last_x = prev_x;
+	    ++num_spans;
+	}
+
+	cover = row->cover[i];
+	cover_alpha = row->cover_alpha[i];
+	area = row->area[i];
+
+	if (area != last_cover) {
+	    spans[num_spans].x = x;
+	    spans[num_spans].coverage = row->area_alpha[i];
+	    last_cover = area;
+	    last_x = x;
+	    ++num_spans;
+	}
+
+	prev_x = x+1;
+    }
+
+    if (prev_x <= xmax && cover != last_cover) {
+	spans[num_spans].x = prev_x;
+	spans[num_spans].coverage = cover_alpha;
+	last_cover = cover;
+	last_x = prev_x;
+	++num_spans;
+    }
+
+    if (last_x < xmax && last_cover) {
+	spans[num_spans].x = xmax;
+	spans[num_spans].coverage = 0;
+	++num_spans;
+    }
+
+    /* Dump them into the renderer. */
+    return renderer->render_rows (renderer, y, height, spans, num_spans);
+}
+
 #define GRID_AREA_TO_A1(A)  ((GRID_AREA_TO_ALPHA (A) > 127) ? 255 : 0)
 static glitter_status_t
 blit_a1 (struct cell_list *cells,
@@ -1691,6 +2092,12 @@ glitter_scan_converter_render(glitter_scan_converter_t *converter,
     if (xmin_i >= xmax_i)
 	return;
 
+    if (polygon->carried) {
+	active_list_merge_edges_from_bucket (active, polygon->carried);
+	polygon->carried = NULL;
+	active->min_height = -1;
+    }
+
     /* Render each pixel row. */
     for (i = 0; i < h; i = j) {
 	int do_full_row = 0;
@@ -1745,7 +2152,12 @@ glitter_scan_converter_render(glitter_scan_converter_t *converter,
 	    }
 	}
 
-	if (antialias)
+	if (antialias && converter->kernel &&
+	    coverages->num_cells >= COVERAGE_KERNEL_MIN_CELLS)
+	    blit_a8_kernel (coverages, &converter->row, converter->kernel,
+			    renderer, converter->spans,
+			    i+ymin_i, j-i, xmin_i, xmax_i);
+	else if (antialias)
 	    blit_a8 (coverages, renderer, converter->spans,
 		     i+ymin_i, j-i, xmin_i, xmax_i);
 	else
@@ -1823,6 +2235,28 @@ _cairo_tor_scan_converter_create (int			xmin,
 				  int			ymax,
 				  cairo_fill_rule_t	fill_rule,
 				  cairo_antialias_t	antialias)
+{
+    return _cairo_tor_scan_converter_create_for_band (xmin, ymin, xmax, ymax,
+						      ymin,
+						      fill_rule, antialias);
+}
+
+/* Creates a converter that only generates the spans for the rows
+ * ystart <= y < ymax of the polygon clipped to [ymin, ymax). Edges
+ * ending above ystart are dropped and those crossing it start on the
+ * active list with their exact x at ystart, so that each band is
+ * rasterised identically to the corresponding rows of a single
+ * converter covering the whole extents without walking the rows
+ * above. This allows horizontal bands of the one polygon to be
+ * converted concurrently. */
+cairo_scan_converter_t *
+_cairo_tor_scan_converter_create_for_band (int			xmin,
+					   int			ymin,
+					   int			xmax,
+					   int			ymax,
+					   int			ystart,
+					   cairo_fill_rule_t	fill_rule,
+					   cairo_antialias_t	antialias)
 {
     cairo_tor_scan_converter_t *self;
     cairo_status_t status;
@@ -1838,10 +2272,12 @@ _cairo_tor_scan_converter_create (int			xmin,
 
     _glitter_scan_converter_init (self->converter, &self->jmp);
     status = glitter_scan_converter_reset (self->converter,
-					   xmin, ymin, xmax, ymax);
+					   xmin, ystart, xmax, ymax);
     if (unlikely (status))
 	goto bail;
 
+    self->converter->polygon->carry_edges = ystart > ymin;
+
     self->fill_rule = fill_rule;
     self->antialias = antialias;
 
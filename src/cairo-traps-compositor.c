@@ -1551,11 +1551,19 @@ clip_and_composite_polygon (const cairo_traps_compositor_t *compositor,
     }
 
     _cairo_traps_init (&traps.traps);
+    _cairo_traps_use_arena (&traps.traps);
 
     if (antialias == CAIRO_ANTIALIAS_NONE && curvy) {
 	status = _cairo_rasterise_polygon_to_traps (polygon, fill_rule, antialias, &traps.traps);
     } else {
-	status = _cairo_bentley_ottmann_tessellate_polygon (&traps.traps, polygon, fill_rule);
+	int num_threads = 1;
+
+	if (compositor->num_threads != NULL)
+	    num_threads = compositor->num_threads (extents->surface);
+	status = _cairo_bentley_ottmann_tessellate_polygon_parallel (&traps.traps,
+								     polygon,
+								     fill_rule,
+								     num_threads);
     }
     if (unlikely (status))
 	goto CLEANUP_TRAPS;
@@ -2159,6 +2167,7 @@ _cairo_traps_compositor_stroke (const cairo_compositor_t *_compositor,
 	cairo_polygon_t polygon;
 
 	_cairo_polygon_init_with_clip (&polygon, extents->clip);
+	_cairo_polygon_use_arena (&polygon);
 	status = _cairo_path_fixed_stroke_to_polygon (path, style,
 						      ctm, ctm_inverse,
 						      tolerance,
@@ -2192,6 +2201,7 @@ _cairo_traps_compositor_stroke (const cairo_compositor_t *_compositor,
 
 	info.antialias = antialias;
 	_cairo_traps_init_with_clip (&info.traps, extents->clip);
+	_cairo_traps_use_arena (&info.traps);
 	status = func (path, style, ctm, ctm_inverse, tolerance, &info.traps);
 	if (likely (status == CAIRO_INT_STATUS_SUCCESS))
 	    status = clip_and_composite_traps (compositor, extents, &info, flags);
@@ -2210,6 +2220,7 @@ _cairo_traps_compositor_fill (const cairo_compositor_t *_compositor,
 			      cairo_antialias_t		 antialias)
 {
     const cairo_traps_compositor_t *compositor = (cairo_traps_compositor_t *)_compositor;
+    cairo_bool_t cache_fills;
     cairo_int_status_t status;
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
@@ -2218,15 +2229,25 @@ _cairo_traps_compositor_fill (const cairo_compositor_t *_compositor,
     if (unlikely (status))
 	return status;
 
+    cache_fills = compositor->cache_fills != NULL &&
+		  compositor->cache_fills (extents->surface);
+
     status = CAIRO_INT_STATUS_UNSUPPORTED;
     if (_cairo_path_fixed_fill_is_rectilinear (path)) {
 	cairo_boxes_t boxes;
 
 	_cairo_boxes_init_with_clip (&boxes, extents->clip);
-	status = _cairo_path_fixed_fill_rectilinear_to_boxes (path,
-							      fill_rule,
-							      antialias,
-							      &boxes);
+	if (cache_fills) {
+	    status = _cairo_path_fixed_fill_rectilinear_to_boxes_cached (path,
+									 fill_rule,
+									 antialias,
+									 &boxes);
+	} else {
+	    status = _cairo_path_fixed_fill_rectilinear_to_boxes (path,
+								  fill_rule,
+								  antialias,
+								  &boxes);
+	}
 	if (likely (status == CAIRO_INT_STATUS_SUCCESS))
 	    status = clip_and_composite_boxes (compositor, extents, &boxes);
 	_cairo_boxes_fini (&boxes);
@@ -2256,7 +2277,11 @@ _cairo_traps_compositor_fill (const cairo_compositor_t *_compositor,
 	}
 #else
 	_cairo_polygon_init_with_clip (&polygon, extents->clip);
-	status = _cairo_path_fixed_fill_to_polygon (path, tolerance, &polygon);
+	_cairo_polygon_use_arena (&polygon);
+	if (cache_fills)
+	    status = _cairo_path_fixed_fill_to_polygon_cached (path, tolerance, &polygon);
+	else
+	    status = _cairo_path_fixed_fill_to_polygon (path, tolerance, &polygon);
 #endif
 	if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
 	    status = clip_and_composite_polygon (compositor, extents, &polygon,
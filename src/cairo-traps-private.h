@@ -60,6 +60,8 @@ struct _cairo_traps {
     int traps_size;
     cairo_trapezoid_t *traps;
     cairo_trapezoid_t  traps_embedded[16];
+
+    cairo_arena_t *arena;
 };
 
 /* cairo-traps.c */
@@ -82,6 +84,9 @@ _cairo_traps_init_boxes (cairo_traps_t	    *traps,
 cairo_private void
 _cairo_traps_clear (cairo_traps_t *traps);
 
+cairo_private void
+_cairo_traps_use_arena (cairo_traps_t *traps);
+
 cairo_private void
 _cairo_traps_fini (cairo_traps_t *traps);
 
@@ -39,6 +39,7 @@
 
 #include "cairoint.h"
 
+#include "cairo-arena-private.h"
 #include "cairo-box-inline.h"
 #include "cairo-boxes-private.h"
 #include "cairo-error-private.h"
@@ -64,6 +65,7 @@ _cairo_traps_init (cairo_traps_t *traps)
 
     traps->traps_size = ARRAY_LENGTH (traps->traps_embedded);
     traps->traps = traps->traps_embedded;
+    traps->arena = NULL;
 
     traps->num_limits = 0;
     traps->has_intersections = FALSE;
@@ -106,10 +108,20 @@ _cairo_traps_clear (cairo_traps_t *traps)
     traps->has_intersections = FALSE;
 }
 
+/* Let @traps grow within the arena of the current operation, if any,
+ * under the same conditions as _cairo_polygon_use_arena(). */
+void
+_cairo_traps_use_arena (cairo_traps_t *traps)
+{
+    assert (traps->traps == traps->traps_embedded);
+
+    traps->arena = _cairo_arena_get_current ();
+}
+
 void
 _cairo_traps_fini (cairo_traps_t *traps)
 {
-    if (traps->traps != traps->traps_embedded)
+    if (traps->traps != traps->traps_embedded && traps->arena == NULL)
 	free (traps->traps);
 
     VG (VALGRIND_MAKE_MEM_NOACCESS (traps, sizeof (cairo_traps_t)));
@@ -127,10 +139,31 @@ _cairo_traps_grow (cairo_traps_t *traps)
 	return FALSE;
     }
 
-    if (traps->traps == traps->traps_embedded) {
+    new_traps = NULL;
+    if (traps->arena) {
+	if (traps->traps == traps->traps_embedded) {
+	    new_traps = _cairo_arena_alloc_ab (traps->arena,
+					       new_size, sizeof (cairo_trapezoid_t));
+	    if (new_traps != NULL)
+		memcpy (new_traps, traps->traps, sizeof (traps->traps_embedded));
+	} else if (_cairo_arena_extend_ab (traps->arena, traps->traps,
+					   new_size, sizeof (cairo_trapezoid_t)))
+	{
+	    new_traps = traps->traps;
+	}
+    }
+
+    if (new_traps != NULL) {
+	/* grown within the arena */
+    } else if (traps->traps == traps->traps_embedded || traps->arena) {
+	/* Leave the arena for good rather than abandon block after block,
+	 * or fall back to the heap if the arena could not get a chunk. */
 	new_traps = _cairo_malloc_ab (new_size, sizeof (cairo_trapezoid_t));
-	if (new_traps != NULL)
-	    memcpy (new_traps, traps->traps, sizeof (traps->traps_embedded));
+	if (new_traps != NULL) {
+	    memcpy (new_traps, traps->traps,
+		    traps->traps_size * sizeof (cairo_trapezoid_t));
+	    traps->arena = NULL;
+	}
     } else {
 	new_traps = _cairo_realloc_ab (traps->traps,
 	                               new_size, sizeof (cairo_trapezoid_t));
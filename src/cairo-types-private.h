@@ -54,6 +54,7 @@ CAIRO_BEGIN_DECLS
  * This section lists generic data types used in the cairo API.
  **/
 
+typedef struct _cairo_arena cairo_arena_t;
 typedef struct _cairo_array cairo_array_t;
 typedef struct _cairo_backend cairo_backend_t;
 typedef struct _cairo_boxes_t cairo_boxes_t;
@@ -327,6 +328,8 @@ typedef struct _cairo_polygon {
     int edges_size;
     cairo_edge_t *edges;
     cairo_edge_t  edges_embedded[32];
+
+    cairo_arena_t *arena;
 } cairo_polygon_t;
 
 typedef cairo_warn cairo_status_t
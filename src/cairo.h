@@ -2414,6 +2414,73 @@ cairo_surface_write_to_png_stream (cairo_surface_t	*surface,
 				   cairo_write_func_t	write_func,
 				   void			*closure);
 
+typedef struct _cairo_png_options cairo_png_options_t;
+
+/**
+ * cairo_png_filter_t:
+ * @CAIRO_PNG_FILTER_DEFAULT: Choose the filter of every row
+ *   adaptively, as libpng does by default (Since 1.14)
+ * @CAIRO_PNG_FILTER_NONE: Do not filter the rows, the fastest choice
+ *   (Since 1.14)
+ * @CAIRO_PNG_FILTER_SUB: Predict each byte from the byte to its left
+ *   (Since 1.14)
+ * @CAIRO_PNG_FILTER_UP: Predict each byte from the byte above it
+ *   (Since 1.14)
+ * @CAIRO_PNG_FILTER_AVERAGE: Predict each byte from the average of the
+ *   bytes to its left and above it (Since 1.14)
+ * @CAIRO_PNG_FILTER_PAETH: Predict each byte with the Paeth predictor
+ *   (Since 1.14)
+ *
+ * Specifies how the rows of an image are filtered before they are
+ * compressed, see cairo_png_options_set_filter().
+ *
+ * Since: 1.14
+ **/
+typedef enum _cairo_png_filter {
+    CAIRO_PNG_FILTER_DEFAULT,
+    CAIRO_PNG_FILTER_NONE,
+    CAIRO_PNG_FILTER_SUB,
+    CAIRO_PNG_FILTER_UP,
+    CAIRO_PNG_FILTER_AVERAGE,
+    CAIRO_PNG_FILTER_PAETH
+} cairo_png_filter_t;
+
+cairo_public cairo_png_options_t *
+cairo_png_options_create (void);
+
+cairo_public void
+cairo_png_options_destroy (cairo_png_options_t *options);
+
+cairo_public cairo_status_t
+cairo_png_options_status (cairo_png_options_t *options);
+
+cairo_public void
+cairo_png_options_set_compression_level (cairo_png_options_t *options,
+					 int                  level);
+
+cairo_public int
+cairo_png_options_get_compression_level (const cairo_png_options_t *options);
+
+cairo_public void
+cairo_png_options_set_filter (cairo_png_options_t *options,
+			      cairo_png_filter_t   filter);
+
+cairo_public cairo_png_filter_t
+cairo_png_options_get_filter (const cairo_png_options_t *options);
+
+cairo_public void
+cairo_png_options_set_strip_height (cairo_png_options_t *options,
+				    int                  strip_height);
+
+cairo_public int
+cairo_png_options_get_strip_height (const cairo_png_options_t *options);
+
+cairo_public cairo_status_t
+cairo_surface_write_to_png_stream_with_options (cairo_surface_t		  *surface,
+						cairo_write_func_t	   write_func,
+						void			  *closure,
+						const cairo_png_options_t *options);
+
 #endif
 
 cairo_public void *
@@ -2542,6 +2609,34 @@ cairo_image_surface_get_height (cairo_surface_t *surface);
 cairo_public int
 cairo_image_surface_get_stride (cairo_surface_t *surface);
 
+cairo_public void
+cairo_image_surface_set_threads (cairo_surface_t *surface,
+				 int		  num_threads);
+
+cairo_public int
+cairo_image_surface_get_threads (cairo_surface_t *surface);
+
+cairo_public void
+cairo_image_surface_set_mipmap (cairo_surface_t *surface,
+				cairo_bool_t	 mipmap);
+
+cairo_public cairo_bool_t
+cairo_image_surface_get_mipmap (cairo_surface_t *surface);
+
+cairo_public void
+cairo_image_surface_set_gradient_ramps (cairo_surface_t *surface,
+					cairo_bool_t	 gradient_ramps);
+
+cairo_public cairo_bool_t
+cairo_image_surface_get_gradient_ramps (cairo_surface_t *surface);
+
+cairo_public void
+cairo_image_surface_set_tessellation_cache (cairo_surface_t *surface,
+					    cairo_bool_t     tessellation_cache);
+
+cairo_public cairo_bool_t
+cairo_image_surface_get_tessellation_cache (cairo_surface_t *surface);
+
 #if CAIRO_HAS_PNG_FUNCTIONS
 
 cairo_public cairo_surface_t *
@@ -2551,6 +2646,22 @@ cairo_public cairo_surface_t *
 cairo_image_surface_create_from_png_stream (cairo_read_func_t	read_func,
 					    void		*closure);
 
+cairo_public cairo_status_t
+cairo_image_surface_read_png_stream (cairo_surface_t	*surface,
+				     int		 x,
+				     int		 y,
+				     cairo_read_func_t	 read_func,
+				     void		*closure);
+
+cairo_public cairo_status_t
+cairo_png_read_stream_to_data (cairo_read_func_t	 read_func,
+			       void			*closure,
+			       unsigned char		*data,
+			       cairo_format_t		 format,
+			       int			 width,
+			       int			 height,
+			       int			 stride);
+
 #endif
 
 /* Recording-surface functions */
@@ -2570,6 +2681,29 @@ cairo_public cairo_bool_t
 cairo_recording_surface_get_extents (cairo_surface_t *surface,
 				     cairo_rectangle_t *extents);
 
+cairo_public void
+cairo_recording_surface_set_coalesce_commands (cairo_surface_t *surface,
+					       cairo_bool_t	coalesce);
+
+cairo_public void
+cairo_recording_surface_set_cull_hidden_commands (cairo_surface_t *surface,
+						  cairo_bool_t	   cull);
+
+cairo_public cairo_surface_t *
+cairo_recording_surface_get_image (cairo_surface_t *surface);
+
+cairo_public cairo_status_t
+cairo_recording_surface_write_to_file (cairo_surface_t	*surface,
+				       const char	*filename);
+
+cairo_public cairo_status_t
+cairo_recording_surface_write_to_stream (cairo_surface_t	*surface,
+					 cairo_write_func_t	 write_func,
+					 void			*closure);
+
+cairo_public cairo_surface_t *
+cairo_recording_surface_create_from_file (const char *filename);
+
 /* raster-source pattern (callback) functions */
 
 /**
@@ -3147,6 +3281,36 @@ cairo_region_xor_rectangle (cairo_region_t *dst,
 cairo_public void
 cairo_debug_reset_static_data (void);
 
+cairo_public void
+cairo_debug_get_freed_pool_stats (unsigned long *hits,
+				  unsigned long *misses);
+
+cairo_public void
+cairo_debug_get_tessellation_cache_stats (unsigned long *hits,
+					  unsigned long *misses,
+					  unsigned long *evictions);
+
+cairo_public void
+cairo_debug_get_mesh_cache_stats (unsigned long *hits,
+				  unsigned long *misses,
+				  unsigned long *evictions,
+				  unsigned long *bytes);
+
+cairo_public void
+cairo_debug_get_gradient_cache_stats (unsigned long *hits,
+				      unsigned long *misses,
+				      unsigned long *evictions,
+				      unsigned long *bytes);
+
+cairo_public void
+cairo_debug_get_glyph_cache_stats (unsigned long *hits,
+				   unsigned long *misses,
+				   unsigned long *evictions);
+
+cairo_public void
+cairo_debug_get_recording_cull_stats (unsigned long *replayed,
+				      unsigned long *culled);
+
 
 CAIRO_END_DECLS
 
@@ -416,6 +416,11 @@ _cairo_ft_font_reset_static_data (void);
 cairo_private void
 _cairo_win32_font_reset_static_data (void);
 
+#if CAIRO_HAS_PNG_FUNCTIONS
+cairo_private void
+_cairo_png_reset_static_data (void);
+#endif
+
 #if CAIRO_HAS_COGL_SURFACE
 void
 _cairo_cogl_context_reset_static_data (void);
@@ -1027,6 +1032,25 @@ _cairo_path_fixed_fill_to_polygon (const cairo_path_fixed_t *path,
 				   double              tolerance,
 				   cairo_polygon_t      *polygon);
 
+cairo_private cairo_status_t
+_cairo_path_fixed_fill_to_polygon_cached (const cairo_path_fixed_t *path,
+					  double	       tolerance,
+					  cairo_polygon_t      *polygon);
+
+cairo_private cairo_status_t
+_cairo_path_fixed_fill_rectilinear_to_boxes_cached (const cairo_path_fixed_t *path,
+						    cairo_fill_rule_t fill_rule,
+						    cairo_antialias_t antialias,
+						    cairo_boxes_t *boxes);
+
+cairo_private void
+_cairo_path_fill_cache_get_stats (unsigned long *hits,
+				  unsigned long *misses,
+				  unsigned long *evictions);
+
+cairo_private void
+_cairo_path_fill_cache_reset_static_data (void);
+
 cairo_private cairo_status_t
 _cairo_path_fixed_fill_rectilinear_to_polygon (const cairo_path_fixed_t *path,
 					       cairo_antialias_t antialias,
@@ -1134,6 +1158,11 @@ _cairo_scaled_font_create_in_error (cairo_status_t status);
 cairo_private void
 _cairo_scaled_font_reset_static_data (void);
 
+cairo_private void
+_cairo_scaled_glyph_page_cache_get_stats (unsigned long *hits,
+					  unsigned long *misses,
+					  unsigned long *evictions);
+
 cairo_private cairo_status_t
 _cairo_scaled_font_register_placeholder_and_unlock_font_map (cairo_scaled_font_t *scaled_font);
 
@@ -1506,6 +1535,24 @@ _cairo_image_scaled_glyph_fini (cairo_scaled_font_t *scaled_font,
 cairo_private void
 _cairo_image_reset_static_data (void);
 
+cairo_private void
+_cairo_image_mesh_cache_get_stats (unsigned long *hits,
+				   unsigned long *misses,
+				   unsigned long *evictions,
+				   unsigned long *bytes);
+
+cairo_private void
+_cairo_image_mesh_cache_reset_static_data (void);
+
+cairo_private void
+_cairo_image_gradient_cache_get_stats (unsigned long *hits,
+				       unsigned long *misses,
+				       unsigned long *evictions,
+				       unsigned long *bytes);
+
+cairo_private void
+_cairo_image_gradient_cache_reset_static_data (void);
+
 cairo_private cairo_surface_t *
 _cairo_image_surface_create_with_pixman_format (unsigned char		*data,
 						pixman_format_code_t	 pixman_format,
@@ -1606,6 +1653,9 @@ cairo_private void
 _cairo_polygon_limit_to_clip (cairo_polygon_t *polygon,
 			      const cairo_clip_t *clip);
 
+cairo_private void
+_cairo_polygon_use_arena (cairo_polygon_t *polygon);
+
 cairo_private void
 _cairo_polygon_fini (cairo_polygon_t *polygon);
 
@@ -1759,6 +1809,12 @@ _cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t         *traps,
 					   const cairo_polygon_t *polygon,
 					   cairo_fill_rule_t      fill_rule);
 
+cairo_private cairo_status_t
+_cairo_bentley_ottmann_tessellate_polygon_parallel (cairo_traps_t         *traps,
+						    const cairo_polygon_t *polygon,
+						    cairo_fill_rule_t      fill_rule,
+						    int                    max_threads);
+
 cairo_private cairo_status_t
 _cairo_bentley_ottmann_tessellate_traps (cairo_traps_t *traps,
 					 cairo_fill_rule_t fill_rule);
@@ -1801,6 +1857,9 @@ _cairo_clip_reset_static_data (void);
 cairo_private void
 _cairo_pattern_reset_static_data (void);
 
+cairo_private void
+_cairo_tor_scan_converter_reset_static_data (void);
+
 /* cairo-unicode.c */
 
 cairo_private int
@@ -2003,6 +2062,7 @@ slim_hidden_proto (cairo_region_xor_rectangle);
 #if CAIRO_HAS_PNG_FUNCTIONS
 
 slim_hidden_proto (cairo_surface_write_to_png_stream);
+slim_hidden_proto (cairo_png_options_status);
 
 #endif
 
@@ -0,0 +1,127 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+
+/*
+ * Fill a polygon with many thousands of overlapping edges on an image
+ * surface that may use threads, and on one that may not. The first
+ * sweeps the polygon in bands on the thread pool, the second in one
+ * go; the trapezoids differ only where they are split at the band
+ * boundaries, on whole pixel rows, so the results must be identical.
+ *
+ * An unbounded operator under a clip path sends the fill to the
+ * trapezoid compositor, which is the one tessellating the polygon.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 256
+#define NUM_TRIANGLES 3000 /* 9000 edges */
+
+static void
+triangles (cairo_t *cr)
+{
+    uint32_t seed = 0x12345678;
+    int i, j;
+
+    for (i = 0; i < NUM_TRIANGLES; i++) {
+	double x, y;
+
+	seed = seed * 1103515245 + 12345;
+	x = (seed >> 8) % (SIZE * 16) / 16.;
+	seed = seed * 1103515245 + 12345;
+	y = (seed >> 8) % (SIZE * 16) / 16.;
+
+	cairo_move_to (cr, x, y);
+	for (j = 0; j < 2; j++) {
+	    seed = seed * 1103515245 + 12345;
+	    cairo_line_to (cr,
+			   x + ((seed >> 8) & 0xff) / 16. - 8,
+			   y + ((seed >> 16) & 0xff) / 16. - 8);
+	}
+	cairo_close_path (cr);
+    }
+}
+
+static cairo_surface_t *
+render (int num_threads, cairo_fill_rule_t fill_rule)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    cairo_set_source_rgb (cr, 0.2, 0.4, 0.8);
+    cairo_paint (cr);
+
+    cairo_arc (cr, SIZE / 2, SIZE / 2, SIZE / 2 - 8, 0, 2 * M_PI);
+    cairo_clip (cr);
+
+    triangles (cr);
+    cairo_set_fill_rule (cr, fill_rule);
+    cairo_set_operator (cr, CAIRO_OPERATOR_IN);
+    cairo_set_source_rgba (cr, 0.9, 0.6, 0.1, 0.75);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const cairo_fill_rule_t fill_rules[] = {
+	CAIRO_FILL_RULE_WINDING,
+	CAIRO_FILL_RULE_EVEN_ODD,
+    };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    int i;
+
+    for (i = 0; i < ARRAY_LENGTH (fill_rules); i++) {
+	cairo_surface_t *serial, *banded;
+
+	serial = render (1, fill_rules[i]);
+	banded = render (0, fill_rules[i]);
+
+	if (! cairo_test_images_equal (ctx, serial, banded, 0,
+				       "banded sweep with fill rule %d",
+				       fill_rules[i]))
+	{
+	    result = CAIRO_TEST_FAILURE;
+	}
+
+	cairo_surface_destroy (serial);
+	cairo_surface_destroy (banded);
+    }
+
+    return result;
+}
+
+CAIRO_TEST (bentley_ottmann_bands,
+	    "Check that sweeping large polygons in bands gives the same fill",
+	    "fill, thread", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
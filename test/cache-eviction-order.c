@@ -0,0 +1,255 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Checks the order in which the caches make room. The mesh cache is a
+ * segmented LRU: a mesh painted twice is protected, and one-off meshes
+ * are ejected before it, oldest first. The glyph cache is a CLOCK: a
+ * page of glyphs looked up again since the hand last passed it is
+ * skipped, and the next page in the ring is ejected instead.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 256
+#define NUM_MESHES 100
+
+/* The limit in cairo-scaled-font.c */
+#define MAX_GLYPH_PAGES_CACHED 512
+#define GLYPH_PAGE_SIZE 32
+#define NUM_GLYPHS (MAX_GLYPH_PAGES_CACHED * GLYPH_PAGE_SIZE)
+
+static cairo_pattern_t *
+create_mesh (double shade)
+{
+    cairo_pattern_t *pattern;
+
+    pattern = cairo_pattern_create_mesh ();
+    cairo_mesh_pattern_begin_patch (pattern);
+    cairo_mesh_pattern_move_to (pattern, 0, 0);
+    cairo_mesh_pattern_line_to (pattern, SIZE, 0);
+    cairo_mesh_pattern_line_to (pattern, SIZE, SIZE);
+    cairo_mesh_pattern_line_to (pattern, 0, SIZE);
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 0, 1, 0, shade);
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 1, 0, 1, 0);
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 2, shade, 0, 1);
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 3, 1, 1, 0);
+    cairo_mesh_pattern_end_patch (pattern);
+
+    return pattern;
+}
+
+/* Paints the mesh of the given shade and reports whether the cache
+ * already held its rasterisation. */
+static int
+paint_mesh (double shade)
+{
+    cairo_surface_t *surface;
+    cairo_pattern_t *pattern;
+    cairo_t *cr;
+    unsigned long hits[2];
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (surface);
+    pattern = create_mesh (shade);
+    cairo_set_source (cr, pattern);
+
+    cairo_debug_get_mesh_cache_stats (&hits[0], NULL, NULL, NULL);
+    cairo_paint (cr);
+    cairo_debug_get_mesh_cache_stats (&hits[1], NULL, NULL, NULL);
+
+    cairo_pattern_destroy (pattern);
+    cairo_destroy (cr);
+    cairo_surface_destroy (surface);
+
+    return hits[1] != hits[0];
+}
+
+static cairo_test_status_t
+check_slru (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    unsigned long evictions;
+    int n;
+
+    paint_mesh (0);
+    if (! paint_mesh (0)) {
+	cairo_test_log (ctx, "Error: painting a mesh twice missed the cache\n");
+	return CAIRO_TEST_FAILURE;
+    }
+    paint_mesh (1);
+
+    /* Each rasterised mesh takes a quarter of a megabyte, so these
+     * overflow the cache by a third. */
+    for (n = 0; n < NUM_MESHES; n++)
+	paint_mesh ((n + 1.) / (NUM_MESHES + 2));
+
+    cairo_debug_get_mesh_cache_stats (NULL, NULL, &evictions, NULL);
+    if (evictions == 0) {
+	cairo_test_log (ctx, "Error: no meshes were evicted\n");
+	return CAIRO_TEST_FAILURE;
+    }
+
+    /* check the survivors first, as every miss inserts another mesh */
+    if (! paint_mesh (0)) {
+	cairo_test_log (ctx, "Error: the mesh painted twice was evicted\n");
+	status = CAIRO_TEST_FAILURE;
+    }
+    if (! paint_mesh ((double) NUM_MESHES / (NUM_MESHES + 2))) {
+	cairo_test_log (ctx, "Error: the newest mesh was evicted\n");
+	status = CAIRO_TEST_FAILURE;
+    }
+    if (paint_mesh (1)) {
+	cairo_test_log (ctx, "Error: the mesh painted once outlived %lu evictions\n",
+			evictions);
+	status = CAIRO_TEST_FAILURE;
+    }
+    if (paint_mesh (1. / (NUM_MESHES + 2))) {
+	cairo_test_log (ctx, "Error: the oldest one-off mesh outlived %lu evictions\n",
+			evictions);
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    return status;
+}
+
+static cairo_status_t
+render_glyph (cairo_scaled_font_t *scaled_font,
+	      unsigned long glyph,
+	      cairo_t *cr,
+	      cairo_text_extents_t *extents)
+{
+    extents->x_advance = 1;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_scaled_font_t *
+create_scaled_font (cairo_font_face_t *face, double size)
+{
+    cairo_font_options_t *options;
+    cairo_scaled_font_t *scaled_font;
+    cairo_matrix_t font_matrix, ctm;
+
+    cairo_matrix_init_scale (&font_matrix, size, size);
+    cairo_matrix_init_identity (&ctm);
+    options = cairo_font_options_create ();
+    scaled_font = cairo_scaled_font_create (face, &font_matrix, &ctm, options);
+    cairo_font_options_destroy (options);
+
+    return scaled_font;
+}
+
+/* Looks up one glyph and reports whether the cache already held it. */
+static int
+lookup_glyph (cairo_scaled_font_t *scaled_font, unsigned long index)
+{
+    cairo_text_extents_t extents;
+    cairo_glyph_t glyph = { index, 0, 0 };
+    unsigned long hits[2];
+
+    cairo_debug_get_glyph_cache_stats (&hits[0], NULL, NULL);
+    cairo_scaled_font_glyph_extents (scaled_font, &glyph, 1, &extents);
+    cairo_debug_get_glyph_cache_stats (&hits[1], NULL, NULL);
+
+    return hits[1] != hits[0];
+}
+
+static cairo_test_status_t
+check_clock (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_font_face_t *face;
+    cairo_scaled_font_t *filler, *other;
+    cairo_text_extents_t extents;
+    cairo_glyph_t *glyphs;
+    unsigned long evictions[2];
+    int n;
+
+    glyphs = xmalloc (NUM_GLYPHS * sizeof (cairo_glyph_t));
+    for (n = 0; n < NUM_GLYPHS; n++) {
+	glyphs[n].index = n;
+	glyphs[n].x = glyphs[n].y = 0;
+    }
+
+    face = cairo_user_font_face_create ();
+    cairo_user_font_face_set_render_glyph_func (face, render_glyph);
+    filler = create_scaled_font (face, 10);
+    other = create_scaled_font (face, 20);
+
+    /* Glyphs fill the pages in the order they are first looked up, so
+     * this fills the whole pool, page by page, in glyph order. */
+    cairo_scaled_font_glyph_extents (filler, glyphs, NUM_GLYPHS, &extents);
+    free (glyphs);
+
+    /* Use the first page again, then make the other font take a page. */
+    lookup_glyph (filler, 0);
+    cairo_debug_get_glyph_cache_stats (NULL, NULL, &evictions[0]);
+    lookup_glyph (other, 0);
+    cairo_debug_get_glyph_cache_stats (NULL, NULL, &evictions[1]);
+    if (evictions[1] - evictions[0] != 1) {
+	cairo_test_log (ctx, "Error: a page for another font made %lu evictions\n",
+			evictions[1] - evictions[0]);
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    if (! lookup_glyph (filler, 0)) {
+	cairo_test_log (ctx, "Error: the page looked up again was evicted\n");
+	status = CAIRO_TEST_FAILURE;
+    }
+    if (! lookup_glyph (filler, 2 * GLYPH_PAGE_SIZE)) {
+	cairo_test_log (ctx, "Error: the third page was evicted\n");
+	status = CAIRO_TEST_FAILURE;
+    }
+    if (lookup_glyph (filler, GLYPH_PAGE_SIZE)) {
+	cairo_test_log (ctx, "Error: the second page was not evicted\n");
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    cairo_scaled_font_destroy (other);
+    cairo_scaled_font_destroy (filler);
+    cairo_font_face_destroy (face);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status;
+
+    cairo_debug_reset_static_data ();
+
+    status = check_slru (ctx);
+    if (status == CAIRO_TEST_SUCCESS)
+	status = check_clock (ctx);
+
+    return status;
+}
+
+CAIRO_TEST (cache_eviction_order,
+	    "Check which entries the mesh and glyph caches evict first",
+	    "cache, mesh, font", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
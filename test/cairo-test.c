@@ -1805,3 +1805,85 @@ cairo_test_status_from_status (const cairo_test_context_t *ctx,
 
     return CAIRO_TEST_FAILURE;
 }
+
+/* Compares two image surfaces of the same format and size, allowing
+ * each byte of their pixels to differ by up to @tolerance, and logs the
+ * first row in which they differ, naming the comparison after @fmt.
+ * Surfaces in an error state never compare equal. */
+cairo_bool_t
+cairo_test_images_equal (const cairo_test_context_t *ctx,
+			 cairo_surface_t *a,
+			 cairo_surface_t *b,
+			 unsigned int tolerance,
+			 const char *fmt, ...)
+{
+    const unsigned char *data_a, *data_b;
+    int width, height, row_bytes, x, y;
+    cairo_format_t format;
+    cairo_status_t status;
+    char what[256];
+    va_list va;
+
+    va_start (va, fmt);
+    vsnprintf (what, sizeof (what), fmt, va);
+    va_end (va);
+
+    status = cairo_surface_status (a);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (b);
+    if (status) {
+	cairo_test_log (ctx, "Error: %s failed: %s\n",
+			what, cairo_status_to_string (status));
+	return FALSE;
+    }
+
+    cairo_surface_flush (a);
+    cairo_surface_flush (b);
+
+    format = cairo_image_surface_get_format (a);
+    width = cairo_image_surface_get_width (a);
+    height = cairo_image_surface_get_height (a);
+    if (format != cairo_image_surface_get_format (b) ||
+	width != cairo_image_surface_get_width (b) ||
+	height != cairo_image_surface_get_height (b))
+    {
+	cairo_test_log (ctx, "Error: %s has the wrong format or size\n", what);
+	return FALSE;
+    }
+
+    switch (format) {
+    case CAIRO_FORMAT_A1:
+	row_bytes = (width + 7) / 8;
+	break;
+    case CAIRO_FORMAT_A8:
+	row_bytes = width;
+	break;
+    case CAIRO_FORMAT_RGB16_565:
+	row_bytes = 2 * width;
+	break;
+    case CAIRO_FORMAT_INVALID:
+    case CAIRO_FORMAT_RGB24:
+    case CAIRO_FORMAT_ARGB32:
+    case CAIRO_FORMAT_RGB30:
+    default:
+	row_bytes = 4 * width;
+	break;
+    }
+
+    for (y = 0; y < height; y++) {
+	data_a = cairo_image_surface_get_data (a) +
+		 y * cairo_image_surface_get_stride (a);
+	data_b = cairo_image_surface_get_data (b) +
+		 y * cairo_image_surface_get_stride (b);
+
+	for (x = 0; x < row_bytes; x++) {
+	    if ((unsigned int) abs (data_a[x] - data_b[x]) > tolerance) {
+		cairo_test_log (ctx, "Error: %s differs by %d on row %d\n",
+				what, abs (data_a[x] - data_b[x]), y);
+		return FALSE;
+	    }
+	}
+    }
+
+    return TRUE;
+}
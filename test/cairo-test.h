@@ -303,6 +303,13 @@ cairo_test_status_t
 cairo_test_status_from_status (const cairo_test_context_t *ctx,
 			       cairo_status_t status);
 
+cairo_bool_t
+cairo_test_images_equal (const cairo_test_context_t *ctx,
+			 cairo_surface_t *a,
+			 cairo_surface_t *b,
+			 unsigned int tolerance,
+			 const char *fmt, ...) CAIRO_BOILERPLATE_PRINTF_FORMAT(5, 6);
+
 char *
 cairo_test_reference_filename (const cairo_test_context_t *ctx,
 			       const char *base_name,
@@ -0,0 +1,161 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+
+/*
+ * Recycle patterns from several threads and check the counters of
+ * cairo_debug_get_freed_pool_stats(): after a reset, each thread has to
+ * allocate its first pattern and then reuses it. A second reset, while
+ * the threads are still alive, must also empty the objects they keep
+ * aside for themselves, so that each of them misses once more.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#define N_THREADS 4
+#define N_PATTERNS 100
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int waiting;
+    int generation;
+} barrier = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    0, 0
+};
+
+/* Waits until all the workers and the main thread have arrived */
+static void
+wait_for_all (void)
+{
+    int generation;
+
+    pthread_mutex_lock (&barrier.mutex);
+    generation = barrier.generation;
+    if (++barrier.waiting == N_THREADS + 1) {
+	barrier.waiting = 0;
+	barrier.generation++;
+	pthread_cond_broadcast (&barrier.cond);
+    } else {
+	while (generation == barrier.generation)
+	    pthread_cond_wait (&barrier.cond, &barrier.mutex);
+    }
+    pthread_mutex_unlock (&barrier.mutex);
+}
+
+static void
+create_patterns (int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+	cairo_pattern_destroy (cairo_pattern_create_rgb (0, 0, i));
+}
+
+static void *
+thread_func (void *arg)
+{
+    create_patterns (N_PATTERNS);
+
+    /* the main thread resets the pools in between */
+    wait_for_all ();
+    wait_for_all ();
+
+    create_patterns (1);
+
+    /* and those of exiting threads go back to the shared array */
+    wait_for_all ();
+
+    return NULL;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    pthread_t threads[N_THREADS];
+    unsigned long hits, misses;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    const char *depth;
+    int i;
+
+    depth = getenv ("CAIRO_FREED_POOL_DEPTH");
+    if (depth != NULL && atoi (depth) <= 0)
+	return CAIRO_TEST_UNTESTED;
+
+    cairo_debug_reset_static_data ();
+    cairo_debug_get_freed_pool_stats (&hits, &misses);
+    if (hits == 0 && misses == 0) {
+	/* either not counted in this build, or no lookup has been made */
+	create_patterns (1);
+	cairo_debug_get_freed_pool_stats (&hits, &misses);
+	if (hits == 0 && misses == 0)
+	    return CAIRO_TEST_UNTESTED;
+	cairo_debug_reset_static_data ();
+    }
+
+    for (i = 0; i < N_THREADS; i++) {
+	if (pthread_create (&threads[i], NULL, thread_func, NULL) != 0) {
+	    cairo_test_log (ctx, "Failed to create a thread\n");
+	    return CAIRO_TEST_FAILURE;
+	}
+    }
+
+    wait_for_all ();
+    cairo_debug_reset_static_data ();
+    wait_for_all ();
+    wait_for_all ();
+
+    for (i = 0; i < N_THREADS; i++)
+	pthread_join (threads[i], NULL);
+
+    {
+	unsigned long new_hits, new_misses;
+
+	cairo_debug_get_freed_pool_stats (&new_hits, &new_misses);
+	new_hits -= hits;
+	new_misses -= misses;
+
+	if (new_misses != 2 * N_THREADS ||
+	    new_hits != N_THREADS * (N_PATTERNS - 1))
+	{
+	    cairo_test_log (ctx, "Expected %d hits and %d misses, got %lu and %lu\n",
+			    N_THREADS * (N_PATTERNS - 1), 2 * N_THREADS,
+			    new_hits, new_misses);
+	    result = CAIRO_TEST_FAILURE;
+	}
+    }
+
+    return result;
+}
+
+CAIRO_TEST (freed_pool_threads,
+	    "Check the counters and resets of the per-thread freed pools",
+	    "thread", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
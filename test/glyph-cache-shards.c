@@ -0,0 +1,220 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Checks that the glyph cache keeps to its global limit of pages
+ * although it is split into shards that each grow into whatever the
+ * others leave unused, and that a font starting out in an empty shard
+ * once the pool is full takes its pages from the other shards.
+ *
+ * Every glyph is looked up once, so the fonts fill their pages one
+ * after the other and the number of pages held follows from the
+ * statistics: a page for every 32 misses, less those evicted.
+ */
+
+#include "cairo-test.h"
+
+/* The limits in cairo-scaled-font.c */
+#define MAX_GLYPH_PAGES_CACHED 512
+#define GLYPH_PAGE_CACHE_SHARD_QUOTA 32
+#define GLYPH_PAGE_SIZE 32
+
+#define NUM_FONTS 48
+#define NUM_LATE_FONTS 4
+#define LATE_FONT_PAGES 8
+
+static cairo_status_t
+render_glyph (cairo_scaled_font_t *scaled_font,
+	      unsigned long glyph,
+	      cairo_t *cr,
+	      cairo_text_extents_t *extents)
+{
+    extents->x_advance = 1;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_scaled_font_t *
+create_scaled_font (cairo_font_face_t *face, double size)
+{
+    cairo_font_options_t *options;
+    cairo_scaled_font_t *scaled_font;
+    cairo_matrix_t font_matrix, ctm;
+
+    cairo_matrix_init_scale (&font_matrix, size, size);
+    cairo_matrix_init_identity (&ctm);
+    options = cairo_font_options_create ();
+    scaled_font = cairo_scaled_font_create (face, &font_matrix, &ctm, options);
+    cairo_font_options_destroy (options);
+
+    return scaled_font;
+}
+
+/* Looks up the first glyphs of the font, all in one go, to fill
+ * @num_pages pages of the cache. */
+static void
+fill_pages (cairo_scaled_font_t *scaled_font, int num_pages)
+{
+    cairo_text_extents_t extents;
+    cairo_glyph_t *glyphs;
+    int n;
+
+    glyphs = xmalloc (num_pages * GLYPH_PAGE_SIZE * sizeof (cairo_glyph_t));
+    for (n = 0; n < num_pages * GLYPH_PAGE_SIZE; n++) {
+	glyphs[n].index = n;
+	glyphs[n].x = glyphs[n].y = 0;
+    }
+    cairo_scaled_font_glyph_extents (scaled_font, glyphs,
+				     num_pages * GLYPH_PAGE_SIZE, &extents);
+    free (glyphs);
+}
+
+static unsigned long
+pages_cached (void)
+{
+    unsigned long misses, evictions;
+
+    cairo_debug_get_glyph_cache_stats (NULL, &misses, &evictions);
+    return misses / GLYPH_PAGE_SIZE - evictions;
+}
+
+static cairo_test_status_t
+check_global_limit (cairo_test_context_t *ctx, cairo_font_face_t *face)
+{
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_scaled_font_t *fonts[NUM_FONTS];
+    unsigned long pages;
+    int n;
+
+    cairo_debug_reset_static_data ();
+
+    /* Each font fills its shard up to the quota; together they ask for
+     * three times the pages the pool holds, spread over the shards. */
+    for (n = 0; n < NUM_FONTS; n++) {
+	fonts[n] = create_scaled_font (face, n + 1);
+	fill_pages (fonts[n], GLYPH_PAGE_CACHE_SHARD_QUOTA);
+
+	pages = pages_cached ();
+	if (pages > MAX_GLYPH_PAGES_CACHED) {
+	    cairo_test_log (ctx,
+			    "Error: the glyph cache holds %lu pages after %d fonts\n",
+			    pages, n + 1);
+	    status = CAIRO_TEST_FAILURE;
+	    break;
+	}
+    }
+
+    while (n--)
+	cairo_scaled_font_destroy (fonts[n]);
+
+    return status;
+}
+
+static cairo_test_status_t
+check_reclaim (cairo_test_context_t *ctx, cairo_font_face_t *face)
+{
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_scaled_font_t *filler, *fonts[NUM_LATE_FONTS];
+    unsigned long hits[2], evictions[2], pages;
+    int n, page;
+
+    cairo_debug_reset_static_data ();
+
+    /* A single font grows its shard into the whole pool... */
+    filler = create_scaled_font (face, 100);
+    fill_pages (filler, MAX_GLYPH_PAGES_CACHED);
+    cairo_debug_get_glyph_cache_stats (NULL, NULL, &evictions[0]);
+
+    /* ...then fonts that mostly land in other, empty, shards have to
+     * take their pages back from it. */
+    for (n = 0; n < NUM_LATE_FONTS; n++) {
+	fonts[n] = create_scaled_font (face, 200 + n);
+	fill_pages (fonts[n], LATE_FONT_PAGES);
+
+	pages = pages_cached ();
+	if (pages > MAX_GLYPH_PAGES_CACHED) {
+	    cairo_test_log (ctx,
+			    "Error: the glyph cache holds %lu pages after %d late fonts\n",
+			    pages, n + 1);
+	    status = CAIRO_TEST_FAILURE;
+	}
+    }
+
+    cairo_debug_get_glyph_cache_stats (NULL, NULL, &evictions[1]);
+    if (evictions[1] - evictions[0] != NUM_LATE_FONTS * LATE_FONT_PAGES) {
+	cairo_test_log (ctx,
+			"Error: %d pages for the late fonts made %lu evictions\n",
+			NUM_LATE_FONTS * LATE_FONT_PAGES,
+			evictions[1] - evictions[0]);
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    /* None of the pages of the late fonts may have been given up. */
+    for (n = 0; n < NUM_LATE_FONTS; n++) {
+	for (page = 0; page < LATE_FONT_PAGES; page++) {
+	    cairo_text_extents_t extents;
+	    cairo_glyph_t glyph = { page * GLYPH_PAGE_SIZE, 0, 0 };
+
+	    cairo_debug_get_glyph_cache_stats (&hits[0], NULL, NULL);
+	    cairo_scaled_font_glyph_extents (fonts[n], &glyph, 1, &extents);
+	    cairo_debug_get_glyph_cache_stats (&hits[1], NULL, NULL);
+	    if (hits[1] == hits[0]) {
+		cairo_test_log (ctx,
+				"Error: page %d of late font %d was evicted\n",
+				page, n);
+		status = CAIRO_TEST_FAILURE;
+	    }
+	}
+    }
+
+    for (n = 0; n < NUM_LATE_FONTS; n++)
+	cairo_scaled_font_destroy (fonts[n]);
+    cairo_scaled_font_destroy (filler);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status;
+    cairo_font_face_t *face;
+
+    face = cairo_user_font_face_create ();
+    cairo_user_font_face_set_render_glyph_func (face, render_glyph);
+
+    status = check_global_limit (ctx, face);
+    if (status == CAIRO_TEST_SUCCESS)
+	status = check_reclaim (ctx, face);
+
+    cairo_font_face_destroy (face);
+
+    return status;
+}
+
+CAIRO_TEST (glyph_cache_shards,
+	    "Check that the shards of the glyph cache share its limit",
+	    "font", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,218 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/*
+ * Check that compositing a run of glyphs in a single call gives exactly
+ * the same pixels as compositing its glyphs one at a time, for bitmap,
+ * alpha and subpixel (component-alpha) glyphs, and for runs that are
+ * cut by the edges of the surface and by a clip.
+ *
+ * When the glyphs do not overlap, the run must match drawing each glyph
+ * with its own call. When they do, the run is composited through a mask,
+ * which we rebuild by ADDing the glyphs one at a time into a group.
+ *
+ * The subpixel glyphs of the builtin font are rendered in white, so
+ * component alpha and unified alpha agree on them.
+ */
+
+#include "cairo-test.h"
+
+#define WIDTH 128
+#define HEIGHT 72
+#define FONT_SIZE 16
+
+#define MAX_GLYPHS 64
+
+static int
+layout (cairo_t *cr, cairo_glyph_t *glyphs, cairo_bool_t overlap)
+{
+    const char *text = "W@M#g&Q%HxAwyOB";
+    cairo_scaled_font_t *font = cairo_get_scaled_font (cr);
+    cairo_glyph_t *run = NULL;
+    int num_run = 0;
+    int num_glyphs = 0;
+    double x, y;
+
+    cairo_scaled_font_text_to_glyphs (font, 0, 0, text, -1,
+				      &run, &num_run, NULL, NULL, NULL);
+    if (num_run == 0)
+	return 0;
+
+    if (overlap) {
+	/* A grid of glyphs closer than their size, starting above and
+	 * to the left of the surface and finishing beyond it, so that
+	 * some straddle each edge. */
+	for (y = 4; y < HEIGHT + FONT_SIZE; y += FONT_SIZE / 2) {
+	    for (x = -FONT_SIZE / 2; x < WIDTH; x += FONT_SIZE / 2) {
+		if (num_glyphs == MAX_GLYPHS)
+		    break;
+
+		glyphs[num_glyphs].index = run[num_glyphs % num_run].index;
+		glyphs[num_glyphs].x = x;
+		glyphs[num_glyphs].y = y;
+		num_glyphs++;
+	    }
+	}
+    } else {
+	/* A single row of glyphs with disjoint extents, cut by the top,
+	 * left and right edges of the surface. */
+	x = -FONT_SIZE / 2;
+	y = FONT_SIZE / 2;
+	while (x < WIDTH && num_glyphs < MAX_GLYPHS) {
+	    cairo_text_extents_t extents;
+
+	    glyphs[num_glyphs].index = run[num_glyphs % num_run].index;
+	    glyphs[num_glyphs].x = x;
+	    glyphs[num_glyphs].y = y;
+	    cairo_scaled_font_glyph_extents (font, &glyphs[num_glyphs], 1,
+					     &extents);
+	    glyphs[num_glyphs].x -= extents.x_bearing;
+	    x = glyphs[num_glyphs].x + extents.x_bearing + extents.width + 2;
+	    num_glyphs++;
+	}
+    }
+
+    cairo_glyph_free (run);
+    return num_glyphs;
+}
+
+static cairo_surface_t *
+draw (cairo_antialias_t antialias, cairo_bool_t overlap, cairo_bool_t clip,
+      cairo_bool_t one_at_a_time)
+{
+    cairo_glyph_t glyphs[MAX_GLYPHS];
+    cairo_font_options_t *options;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    int num_glyphs, i;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cr = cairo_create (surface);
+
+    cairo_set_source_rgb (cr, .9, .8, .7);
+    cairo_paint (cr);
+
+    if (clip) {
+	cairo_rectangle (cr, 11, 9, WIDTH - 29, HEIGHT - 23);
+	cairo_clip (cr);
+    }
+
+    cairo_select_font_face (cr, "@cairo:",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size (cr, FONT_SIZE);
+    options = cairo_font_options_create ();
+    cairo_font_options_set_antialias (options, antialias);
+    cairo_set_font_options (cr, options);
+    cairo_font_options_destroy (options);
+
+    num_glyphs = layout (cr, glyphs, overlap);
+
+    if (! one_at_a_time) {
+	cairo_set_source_rgba (cr, .1, .2, .8, .75);
+	cairo_show_glyphs (cr, glyphs, num_glyphs);
+    } else if (! overlap) {
+	cairo_set_source_rgba (cr, .1, .2, .8, .75);
+	for (i = 0; i < num_glyphs; i++)
+	    cairo_show_glyphs (cr, &glyphs[i], 1);
+    } else {
+	cairo_pattern_t *mask;
+
+	cairo_push_group_with_content (cr,
+				       antialias == CAIRO_ANTIALIAS_SUBPIXEL ?
+				       CAIRO_CONTENT_COLOR_ALPHA :
+				       CAIRO_CONTENT_ALPHA);
+	cairo_set_operator (cr, CAIRO_OPERATOR_ADD);
+	cairo_set_source_rgb (cr, 1, 1, 1);
+	for (i = 0; i < num_glyphs; i++)
+	    cairo_show_glyphs (cr, &glyphs[i], 1);
+	mask = cairo_pop_group (cr);
+
+	cairo_set_source_rgba (cr, .1, .2, .8, .75);
+	cairo_mask (cr, mask);
+	cairo_pattern_destroy (mask);
+    }
+
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+compare (cairo_test_context_t *ctx,
+	 cairo_antialias_t antialias, cairo_bool_t overlap, cairo_bool_t clip)
+{
+    cairo_surface_t *run, *glyphs;
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+
+    run = draw (antialias, overlap, clip, 0);
+    glyphs = draw (antialias, overlap, clip, 1);
+
+    if (! cairo_test_images_equal (ctx, run, glyphs, 0,
+				   "%s glyph run (antialias %d%s)",
+				   overlap ? "overlapping" : "disjoint",
+				   antialias, clip ? ", clipped" : ""))
+    {
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    cairo_surface_destroy (run);
+    cairo_surface_destroy (glyphs);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const cairo_antialias_t antialias[] = {
+	CAIRO_ANTIALIAS_NONE,
+	CAIRO_ANTIALIAS_GRAY,
+	CAIRO_ANTIALIAS_SUBPIXEL,
+    };
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    int i, overlap, clip;
+
+    for (i = 0; i < ARRAY_LENGTH (antialias); i++) {
+	for (overlap = 0; overlap <= 1; overlap++) {
+	    for (clip = 0; clip <= 1; clip++) {
+		cairo_test_status_t s;
+
+		s = compare (ctx, antialias[i], overlap, clip);
+		if (s)
+		    status = s;
+	    }
+	}
+    }
+
+    return status;
+}
+
+CAIRO_TEST (glyph_runs,
+	    "Check that glyph runs match compositing their glyphs one at a time",
+	    "text, glyphs", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
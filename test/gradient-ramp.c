@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+#include "cairo-test.h"
+
+/* Compares the gradients filled from cairo's cached color ramps with
+ * pixman's own evaluation of the same gradients, for each extend mode.
+ *
+ * The ramps are only used on surfaces that allow them, see
+ * cairo_image_surface_set_gradient_ramps(); elsewhere pixman evaluates
+ * every gradient as before. Either way, painting the surface at once
+ * or tile by tile must take the same path.
+ *
+ * The ramp has 1024 entries and the nearest one is used, so with the
+ * steepest segment below (0.3 of the parameter for a full swing of a
+ * channel) the lookup is off by less than half a level. Rounding of
+ * the premultiplied colors on either side adds at most one more, hence
+ * a tolerance of TOLERANCE per channel.
+ *
+ * The stops are transparent at both ends, so that repeating, reflecting
+ * and clipping the gradient are all continuous and a pixel centre
+ * falling right on a boundary cannot flip to a different color. The
+ * radial gradients use nested circles, which cover the whole plane.
+ */
+
+#define SIZE 400
+#define TILE 100
+#define TOLERANCE 2
+
+static cairo_pattern_t *
+create_gradient (int shape)
+{
+    cairo_pattern_t *pattern;
+
+    switch (shape) {
+    default:
+    case 0: /* horizontal */
+	pattern = cairo_pattern_create_linear (20, 0, 120, 0);
+	break;
+    case 1: /* vertical */
+	pattern = cairo_pattern_create_linear (0, 30, 0, 160);
+	break;
+    case 2:
+	pattern = cairo_pattern_create_linear (20, 20, 120, 70);
+	break;
+    case 3: /* concentric */
+	pattern = cairo_pattern_create_radial (200, 200, 10, 200, 200, 150);
+	break;
+    case 4:
+	pattern = cairo_pattern_create_radial (170, 190, 15, 200, 210, 160);
+	break;
+    }
+
+    cairo_pattern_add_color_stop_rgba (pattern, 0.0, 1, 0, 0, 0);
+    cairo_pattern_add_color_stop_rgba (pattern, 0.3, 1, .5, 0, 1);
+    cairo_pattern_add_color_stop_rgba (pattern, 0.7, 0, .2, 1, .8);
+    cairo_pattern_add_color_stop_rgba (pattern, 1.0, 0, 0, 1, 0);
+
+    return pattern;
+}
+
+static unsigned long
+gradient_cache_lookups (void)
+{
+    unsigned long hits, misses, bytes;
+
+    cairo_debug_get_gradient_cache_stats (&hits, &misses, NULL, &bytes);
+    return hits + misses;
+}
+
+static cairo_surface_t *
+paint (cairo_pattern_t *pattern, int ramps, int tiled)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    int x, y;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_gradient_ramps (surface, ramps);
+    cr = cairo_create (surface);
+    cairo_set_source (cr, pattern);
+    if (tiled) {
+	for (y = 0; y < SIZE; y += TILE) {
+	    for (x = 0; x < SIZE; x += TILE) {
+		cairo_save (cr);
+		cairo_rectangle (cr, x, y, TILE, TILE);
+		cairo_clip (cr);
+		cairo_paint (cr);
+		cairo_restore (cr);
+	    }
+	}
+    } else {
+	cairo_paint (cr);
+    }
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const cairo_extend_t extends[] = {
+	CAIRO_EXTEND_NONE,
+	CAIRO_EXTEND_REPEAT,
+	CAIRO_EXTEND_REFLECT,
+	CAIRO_EXTEND_PAD,
+    };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    int shape, e;
+
+    for (shape = 0; shape < 5; shape++) {
+	for (e = 0; e < 4; e++) {
+	    cairo_pattern_t *pattern = create_gradient (shape);
+	    cairo_surface_t *reference, *image;
+	    unsigned long lookups;
+	    int ramps, tiled;
+
+	    cairo_pattern_set_extend (pattern, extends[e]);
+	    reference = paint (pattern, 0, 0);
+
+	    for (ramps = 0; ramps <= 1; ramps++) {
+		for (tiled = 0; tiled <= 1; tiled++) {
+		    lookups = gradient_cache_lookups ();
+		    image = paint (pattern, ramps, tiled);
+		    if ((gradient_cache_lookups () != lookups) != ramps) {
+			cairo_test_log (ctx,
+					"gradient %d, extend %d, %s: %s from a ramp\n",
+					shape, extends[e],
+					tiled ? "tiled" : "whole",
+					ramps ? "not filled" : "filled");
+			result = CAIRO_TEST_FAILURE;
+		    }
+
+		    if (ramps &&
+			! cairo_test_images_equal (ctx, image, reference, TOLERANCE,
+						   "gradient %d, extend %d, %s ramp",
+						   shape, extends[e],
+						   tiled ? "tiled" : "whole"))
+		    {
+			result = CAIRO_TEST_FAILURE;
+		    }
+
+		    cairo_surface_destroy (image);
+		}
+	    }
+
+	    cairo_surface_destroy (reference);
+	    cairo_pattern_destroy (pattern);
+	}
+    }
+
+    return result;
+}
+
+CAIRO_TEST (gradient_ramp,
+	    "Compare gradients filled from cached color ramps with pixman's",
+	    "gradient, linear, radial, extend", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+#include "cairo-test.h"
+
+/* Shrinks an opaque image with odd dimensions by 8 with and without
+ * the mipmap pyramid, and checks that the painted coverage matches the
+ * area of the scaled image in both cases: the partially covered pixels
+ * along the right and bottom edges of each level must not make the
+ * image any larger.
+ */
+
+#define SRC_WIDTH 129
+#define SRC_HEIGHT 97
+#define SCALE 8
+#define SIZE 32
+
+static double
+paint_coverage (cairo_surface_t *source)
+{
+    cairo_surface_t *image;
+    const unsigned char *data;
+    double coverage = 0;
+    int stride, x, y;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_translate (cr, 4, 4);
+    cairo_scale (cr, 1. / SCALE, 1. / SCALE);
+    cairo_set_source_surface (cr, source, 0, 0);
+    cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (image);
+    data = cairo_image_surface_get_data (image);
+    stride = cairo_image_surface_get_stride (image);
+    for (y = 0; y < SIZE; y++) {
+	const uint32_t *row = (const uint32_t *) (data + y * stride);
+
+	for (x = 0; x < SIZE; x++)
+	    coverage += (row[x] >> 24) / 255.;
+    }
+
+    cairo_surface_destroy (image);
+    return coverage;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    const double area = (SRC_WIDTH / (double) SCALE) *
+			(SRC_HEIGHT / (double) SCALE);
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *source;
+    int mipmap;
+    cairo_t *cr;
+
+    source = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					 SRC_WIDTH, SRC_HEIGHT);
+    cr = cairo_create (source);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    if (cairo_image_surface_get_mipmap (source)) {
+	cairo_test_log (ctx, "The mipmap pyramid is enabled by default\n");
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    for (mipmap = 0; mipmap <= 1; mipmap++) {
+	double coverage;
+
+	cairo_image_surface_set_mipmap (source, mipmap);
+	coverage = paint_coverage (source);
+	if (fabs (coverage - area) > .02 * area) {
+	    cairo_test_log (ctx,
+			    "Coverage with mipmap %s is %g pixels, expected %g\n",
+			    mipmap ? "on" : "off", coverage, area);
+	    result = CAIRO_TEST_FAILURE;
+	}
+    }
+
+    cairo_surface_destroy (source);
+    return result;
+}
+
+CAIRO_TEST (image_mipmap,
+	    "Check that the mipmap pyramid preserves the extents of odd-sized images",
+	    "image, filter", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
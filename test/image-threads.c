@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/*
+ * Check that splitting the rasterisation of a large fill across
+ * several threads gives exactly the same pixels as rendering it in
+ * a single pass.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 512
+
+static void
+draw_star (cairo_t *cr, int points)
+{
+    int i;
+
+    cairo_translate (cr, SIZE / 2., SIZE / 2.);
+    for (i = 0; i < 2 * points; i++) {
+	double r = i & 1 ? SIZE / 5. : SIZE / 2. - 3;
+	double a = i * M_PI / points;
+
+	cairo_line_to (cr, r * cos (a), r * sin (a));
+    }
+    cairo_close_path (cr);
+}
+
+static cairo_surface_t *
+render (int num_threads, cairo_fill_rule_t fill_rule)
+{
+    cairo_surface_t *surface;
+    cairo_pattern_t *pattern;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    pattern = cairo_pattern_create_linear (0, 0, SIZE, SIZE);
+    cairo_pattern_add_color_stop_rgba (pattern, 0, 1, 0, 0, .8);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, .6);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+
+    cairo_set_fill_rule (cr, fill_rule);
+    draw_star (cr, 37);
+    cairo_fill (cr);
+
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+compare (cairo_test_context_t *ctx, cairo_fill_rule_t fill_rule)
+{
+    cairo_surface_t *serial, *threaded;
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+
+    serial = render (1, fill_rule);
+    threaded = render (0, fill_rule);
+
+    if (cairo_image_surface_get_threads (serial) != 1 ||
+	cairo_image_surface_get_threads (threaded) != 0)
+    {
+	cairo_test_log (ctx, "Error: number of threads not recorded\n");
+	status = CAIRO_TEST_FAILURE;
+	goto out;
+    }
+
+    if (! cairo_test_images_equal (ctx, serial, threaded, 0,
+				   "threaded rendering"))
+	status = CAIRO_TEST_FAILURE;
+
+out:
+    cairo_surface_destroy (serial);
+    cairo_surface_destroy (threaded);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status;
+
+    status = compare (ctx, CAIRO_FILL_RULE_WINDING);
+    if (status)
+	return status;
+
+    return compare (ctx, CAIRO_FILL_RULE_EVEN_ODD);
+}
+
+CAIRO_TEST (image_threads,
+	    "Check that threaded rasterisation matches a single pass",
+	    "image, threads", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
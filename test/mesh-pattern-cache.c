@@ -0,0 +1,194 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Checks that painting the same mesh again reuses its rasterisation,
+ * even from a new but equal pattern, and gives the same pixels; that
+ * editing the patches, changing the matrix or painting different
+ * extents rasterises it anew; and that the cache stays within its size
+ * limit, by evicting meshes, however many are drawn.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 256
+#define NUM_MESHES 160
+
+/* The limit in cairo-image-source.c */
+#define MAX_MESH_CACHE_SIZE (16 << 20)
+
+static void
+add_patch (cairo_pattern_t *pattern, double x, double y, double shade)
+{
+    cairo_mesh_pattern_begin_patch (pattern);
+
+    cairo_mesh_pattern_move_to (pattern, x, y);
+    cairo_mesh_pattern_curve_to (pattern, x + 60, y - 30, x + 120, y + 30, x + 160, y);
+    cairo_mesh_pattern_line_to (pattern, x + 160, y + 160);
+    cairo_mesh_pattern_curve_to (pattern, x + 120, y + 100, x + 60, y + 220, x, y + 160);
+    cairo_mesh_pattern_line_to (pattern, x, y);
+
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 0, 1, 0, shade);
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 1, 0, 1, 0);
+    cairo_mesh_pattern_set_corner_color_rgba (pattern, 2, shade, 0, 1, .5);
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 3, 1, 1, 0);
+
+    cairo_mesh_pattern_end_patch (pattern);
+}
+
+static cairo_pattern_t *
+create_mesh (double shade)
+{
+    cairo_pattern_t *pattern;
+
+    pattern = cairo_pattern_create_mesh ();
+    add_patch (pattern, 40, 40, shade);
+
+    return pattern;
+}
+
+static cairo_surface_t *
+paint (cairo_pattern_t *pattern, int clip_size)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (surface);
+    cairo_rectangle (cr, 0, 0, clip_size, clip_size);
+    cairo_clip (cr);
+    cairo_set_source (cr, pattern);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static int
+check_paint (cairo_test_context_t *ctx,
+	     cairo_pattern_t *pattern,
+	     int clip_size,
+	     int expect_hit,
+	     const char *what)
+{
+    unsigned long hits[2], misses[2];
+
+    cairo_debug_get_mesh_cache_stats (&hits[0], &misses[0], NULL, NULL);
+    cairo_surface_destroy (paint (pattern, clip_size));
+    cairo_debug_get_mesh_cache_stats (&hits[1], &misses[1], NULL, NULL);
+
+    if (hits[1] - hits[0] != (expect_hit ? 1 : 0) ||
+	misses[1] - misses[0] != (expect_hit ? 0 : 1))
+    {
+	cairo_test_log (ctx,
+			"Error: %s gave %lu hits and %lu misses, expected a %s\n",
+			what, hits[1] - hits[0], misses[1] - misses[0],
+			expect_hit ? "hit" : "miss");
+	return 0;
+    }
+
+    return 1;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *first, *second;
+    cairo_pattern_t *pattern, *equal;
+    cairo_matrix_t matrix;
+    unsigned long hits, misses, evictions, bytes;
+    int n;
+
+    cairo_debug_reset_static_data ();
+
+    pattern = create_mesh (0);
+    first = paint (pattern, SIZE);
+    second = paint (pattern, SIZE);
+    cairo_debug_get_mesh_cache_stats (&hits, &misses, NULL, NULL);
+    if (hits != 1 || misses != 1) {
+	cairo_test_log (ctx,
+			"Error: painting a mesh twice gave %lu hits and %lu misses\n",
+			hits, misses);
+	status = CAIRO_TEST_FAILURE;
+    }
+    if (! cairo_test_images_equal (ctx, second, first, 0, "the cached mesh"))
+	status = CAIRO_TEST_FAILURE;
+    cairo_surface_destroy (first);
+    cairo_surface_destroy (second);
+
+    equal = create_mesh (0);
+    if (! check_paint (ctx, equal, SIZE, 1, "an equal mesh"))
+	status = CAIRO_TEST_FAILURE;
+    cairo_pattern_destroy (equal);
+
+    if (! check_paint (ctx, pattern, SIZE / 2, 0, "smaller extents"))
+	status = CAIRO_TEST_FAILURE;
+
+    cairo_matrix_init_translate (&matrix, 5, 0);
+    cairo_pattern_set_matrix (pattern, &matrix);
+    if (! check_paint (ctx, pattern, SIZE, 0, "a translated mesh"))
+	status = CAIRO_TEST_FAILURE;
+    cairo_matrix_init_identity (&matrix);
+    cairo_pattern_set_matrix (pattern, &matrix);
+    if (! check_paint (ctx, pattern, SIZE, 1, "restoring the matrix"))
+	status = CAIRO_TEST_FAILURE;
+
+    add_patch (pattern, 100, 60, 1);
+    if (! check_paint (ctx, pattern, SIZE, 0, "an added patch"))
+	status = CAIRO_TEST_FAILURE;
+    if (! check_paint (ctx, pattern, SIZE, 1, "the edited mesh again"))
+	status = CAIRO_TEST_FAILURE;
+    cairo_pattern_destroy (pattern);
+
+    /* Each rasterised mesh takes a quarter of a megabyte, so these
+     * fill the cache more than twice over. */
+    for (n = 0; n < NUM_MESHES; n++) {
+	pattern = create_mesh ((n + 1.) / NUM_MESHES);
+	cairo_surface_destroy (paint (pattern, SIZE));
+	cairo_pattern_destroy (pattern);
+
+	cairo_debug_get_mesh_cache_stats (NULL, NULL, &evictions, &bytes);
+	if (bytes == 0 || bytes > MAX_MESH_CACHE_SIZE) {
+	    cairo_test_log (ctx,
+			    "Error: the mesh cache holds %lu bytes after %d meshes\n",
+			    bytes, n + 1);
+	    status = CAIRO_TEST_FAILURE;
+	    break;
+	}
+    }
+    if (evictions == 0) {
+	cairo_test_log (ctx, "Error: no meshes were evicted\n");
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    return status;
+}
+
+CAIRO_TEST (mesh_pattern_cache,
+	    "Check that rasterised meshes are reused only when unchanged",
+	    "mesh, pattern", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Rasterises a mesh pattern onto an image surface that is large enough
+ * to be split into bands, once on the calling thread alone and once
+ * with a thread per processor, and checks that both are identical.
+ * The patches fold over themselves and overlap each other across the
+ * band boundaries, so drawing them out of order in any band would show.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 384
+
+static cairo_pattern_t *
+create_mesh (void)
+{
+    cairo_pattern_t *pattern;
+    int i;
+
+    pattern = cairo_pattern_create_mesh ();
+
+    for (i = 0; i < 3; i++) {
+	double x = 40 + 90 * i, y = 30 + 100 * i;
+
+	cairo_mesh_pattern_begin_patch (pattern);
+
+	cairo_mesh_pattern_move_to (pattern, x, y);
+	cairo_mesh_pattern_curve_to (pattern, x + 60, y - 60, x + 120, y + 60, x + 200, y);
+	cairo_mesh_pattern_curve_to (pattern, x + 260, y + 280, x + 120, y - 80, x + 200, y + 200);
+	cairo_mesh_pattern_curve_to (pattern, x + 120, y + 140, x + 60, y + 260, x, y + 200);
+	cairo_mesh_pattern_curve_to (pattern, x - 60, y - 80, x + 60, y + 280, x, y);
+
+	cairo_mesh_pattern_set_corner_color_rgba (pattern, 0, 1, 0, 0, 1);
+	cairo_mesh_pattern_set_corner_color_rgba (pattern, 1, 0, 1, 0, .8);
+	cairo_mesh_pattern_set_corner_color_rgba (pattern, 2, 0, 0, 1, .6);
+	cairo_mesh_pattern_set_corner_color_rgba (pattern, 3, i & 1, 1, 0, 1);
+
+	cairo_mesh_pattern_end_patch (pattern);
+    }
+
+    return pattern;
+}
+
+static cairo_surface_t *
+render (int num_threads)
+{
+    cairo_surface_t *surface;
+    cairo_pattern_t *pattern;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    pattern = create_mesh ();
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *serial, *threaded;
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    unsigned long hits, misses, bytes;
+
+    serial = render (1);
+
+    /* Drop the rasterised mesh so that it is drawn again */
+    cairo_debug_reset_static_data ();
+
+    threaded = render (0);
+
+    cairo_debug_get_mesh_cache_stats (&hits, &misses, NULL, &bytes);
+    if (hits != 0) {
+	cairo_test_log (ctx, "Error: threaded mesh taken from the cache\n");
+	status = CAIRO_TEST_FAILURE;
+	goto out;
+    }
+
+    if (! cairo_test_images_equal (ctx, serial, threaded, 0,
+				   "threaded rendering"))
+	status = CAIRO_TEST_FAILURE;
+
+out:
+    cairo_surface_destroy (serial);
+    cairo_surface_destroy (threaded);
+
+    return status;
+}
+
+CAIRO_TEST (mesh_pattern_threads,
+	    "Check that a mesh rasterised in bands matches a single pass",
+	    "mesh, pattern, threads", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
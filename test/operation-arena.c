@@ -0,0 +1,264 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Fills and strokes take the edges and trapezoids they build from an
+ * arena that belongs to the context and lasts for the operation. Checks
+ * that they draw the same as when no arena is in use, which is the case
+ * when a recording surface is replayed from a paint:
+ *
+ * - a polygon that grows in place within the arena, one that outgrows
+ *   its chunk and moves to the heap, and a stroke building trapezoids;
+ * - a fill whose source replays many fills, which all take their edges
+ *   from the arena of the outer fill, so that it needs more chunks, and
+ *   one of which has a source that draws with a context of its own, so
+ *   entering and leaving another arena in the middle of the operation.
+ */
+
+#include "cairo-test.h"
+
+#include <math.h>
+
+#define SIZE 200
+#define NUM_INNER 40
+
+static void
+star_path (cairo_t *cr, double cx, double cy, double radius, int num_points)
+{
+    int n;
+
+    for (n = 0; n < num_points; n++) {
+	double angle = 2 * M_PI * n / num_points;
+	double r = n & 1 ? radius / 2 : radius;
+
+	cairo_line_to (cr, cx + r * cos (angle), cy + r * sin (angle));
+    }
+    cairo_close_path (cr);
+}
+
+static void
+draw_grow_in_place (cairo_t *cr)
+{
+    cairo_set_source_rgb (cr, 0, 0, .5);
+    star_path (cr, SIZE / 2, SIZE / 2, SIZE / 2 - 10, 300);
+    cairo_fill (cr);
+}
+
+static void
+draw_leave_arena (cairo_t *cr)
+{
+    cairo_set_source_rgb (cr, .5, 0, 0);
+    star_path (cr, SIZE / 2, SIZE / 2, SIZE / 2 - 10, 5000);
+    cairo_fill (cr);
+}
+
+static void
+draw_stroke (cairo_t *cr)
+{
+    cairo_set_source_rgb (cr, 0, .5, 0);
+    cairo_set_line_width (cr, 3);
+    star_path (cr, SIZE / 2, SIZE / 2, SIZE / 2 - 10, 200);
+    cairo_stroke (cr);
+}
+
+static void
+draw_inner (cairo_t *cr)
+{
+    int n;
+
+    for (n = 0; n < NUM_INNER; n++) {
+	cairo_set_source_rgba (cr, (n & 3) / 3., (n & 4) / 4., 1, .5);
+	star_path (cr, 20 + 4 * n, 20 + 4 * n, 40, 300);
+	cairo_fill (cr);
+    }
+}
+
+static cairo_surface_t *
+acquire (cairo_pattern_t *pattern, void *closure,
+	 cairo_surface_t *target,
+	 const cairo_rectangle_int_t *extents)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (image);
+    draw_inner (cr);
+    cairo_destroy (cr);
+
+    return image;
+}
+
+static void
+release (cairo_pattern_t *pattern, void *closure,
+	 cairo_surface_t *surface)
+{
+    cairo_surface_destroy (surface);
+}
+
+/* The raster source draws with a context of its own, entering and
+ * leaving the arena of that context, before more fills follow. */
+static void
+draw_nested (cairo_t *cr)
+{
+    cairo_pattern_t *pattern;
+
+    pattern = cairo_pattern_create_raster_source (NULL,
+						  CAIRO_CONTENT_COLOR_ALPHA,
+						  SIZE, SIZE);
+    cairo_raster_source_pattern_set_acquire (pattern, acquire, release);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+
+    star_path (cr, SIZE / 2, SIZE / 2, SIZE / 2 - 10, 300);
+    cairo_fill (cr);
+
+    draw_inner (cr);
+}
+
+static cairo_surface_t *
+record (void (*draw) (cairo_t *cr))
+{
+    cairo_rectangle_t extents = { 0, 0, SIZE, SIZE };
+    cairo_surface_t *recording;
+    cairo_t *cr;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						&extents);
+    cr = cairo_create (recording);
+    draw (cr);
+    cairo_destroy (cr);
+
+    return recording;
+}
+
+static cairo_surface_t *
+create_image (void)
+{
+    return cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+}
+
+/* Draws directly, within the arena of the context, and through the
+ * replay of a recording from a paint, outside of any arena. */
+static cairo_test_status_t
+check_draw (cairo_test_context_t *ctx,
+	    void (*draw) (cairo_t *cr),
+	    const char *what)
+{
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *direct, *replayed, *recording;
+    cairo_t *cr;
+
+    direct = create_image ();
+    cr = cairo_create (direct);
+    draw (cr);
+    status = cairo_test_status_from_status (ctx, cairo_status (cr));
+    cairo_destroy (cr);
+
+    recording = record (draw);
+    replayed = create_image ();
+    cr = cairo_create (replayed);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+    cairo_surface_destroy (recording);
+
+    if (status == CAIRO_TEST_SUCCESS &&
+	! cairo_test_images_equal (ctx, direct, replayed, 0,
+				   "%s within the arena", what))
+    {
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    cairo_surface_destroy (direct);
+    cairo_surface_destroy (replayed);
+
+    return status;
+}
+
+/* The fills of the recording are replayed while the outer fill is in
+ * its arena, and so take their edges from it; the reference clips a
+ * paint instead. */
+static cairo_test_status_t
+check_nested_replay (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status;
+    cairo_surface_t *direct, *replayed, *recording;
+    cairo_t *cr;
+
+    recording = record (draw_nested);
+
+    direct = create_image ();
+    cr = cairo_create (direct);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_rectangle (cr, 10, 10, SIZE - 20, SIZE - 20);
+    cairo_fill (cr);
+    status = cairo_test_status_from_status (ctx, cairo_status (cr));
+    cairo_destroy (cr);
+
+    replayed = create_image ();
+    cr = cairo_create (replayed);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_rectangle (cr, 10, 10, SIZE - 20, SIZE - 20);
+    cairo_clip (cr);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_destroy (recording);
+
+    if (status == CAIRO_TEST_SUCCESS &&
+	! cairo_test_images_equal (ctx, direct, replayed, 0,
+				   "the fills replayed within a fill"))
+    {
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    cairo_surface_destroy (direct);
+    cairo_surface_destroy (replayed);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status;
+
+    status = check_draw (ctx, draw_grow_in_place, "a polygon grown in place");
+    if (status == CAIRO_TEST_SUCCESS)
+	status = check_draw (ctx, draw_leave_arena, "a polygon moved to the heap");
+    if (status == CAIRO_TEST_SUCCESS)
+	status = check_draw (ctx, draw_stroke, "a stroke");
+    if (status == CAIRO_TEST_SUCCESS)
+	status = check_nested_replay (ctx);
+
+    return status;
+}
+
+CAIRO_TEST (operation_arena,
+	    "Check that fills and strokes draw the same within their arena",
+	    "fill, stroke", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
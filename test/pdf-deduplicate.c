@@ -0,0 +1,214 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+#include "cairo-test.h"
+
+#include <string.h>
+#include <cairo-pdf.h>
+
+/* This test checks that, with content deduplication enabled, two
+ * separately decoded copies of the same image are embedded in the PDF
+ * only once, while two images differing in a single pixel are both
+ * embedded.
+ */
+
+#define SIZE 32
+
+typedef struct _buffer {
+    unsigned char *data;
+    unsigned int length;
+    unsigned int size;
+    unsigned int offset;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	unsigned int size = MAX (2 * buffer->size, buffer->length + length);
+	unsigned char *grown = realloc (buffer->data, size);
+
+	if (grown == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+
+	buffer->data = grown;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+read_buffer (void *closure, unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->offset + length > buffer->length)
+	return CAIRO_STATUS_READ_ERROR;
+
+    memcpy (data, buffer->data + buffer->offset, length);
+    buffer->offset += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+decode (buffer_t *png)
+{
+    png->offset = 0;
+    return cairo_image_surface_create_from_png_stream (read_buffer, png);
+}
+
+static unsigned int
+count_images (const buffer_t *pdf)
+{
+    const char *needle = "/Subtype /Image";
+    size_t needle_length = strlen (needle);
+    unsigned int count = 0;
+    unsigned int i;
+
+    for (i = 0; i + needle_length <= pdf->length; i++) {
+	if (memcmp (pdf->data + i, needle, needle_length) == 0)
+	    count++;
+    }
+
+    return count;
+}
+
+static cairo_test_status_t
+write_pdf (const cairo_test_context_t *ctx,
+	   cairo_surface_t *a,
+	   cairo_surface_t *b,
+	   unsigned int *num_images)
+{
+    cairo_surface_t *surface;
+    buffer_t pdf = { NULL, 0, 0, 0 };
+    cairo_status_t status;
+    cairo_t *cr;
+
+    surface = cairo_pdf_surface_create_for_stream (write_buffer, &pdf,
+						   3 * SIZE, SIZE);
+    cairo_pdf_surface_set_deduplicate_content (surface, 1);
+
+    cr = cairo_create (surface);
+    cairo_set_source_surface (cr, a, 0, 0);
+    cairo_paint (cr);
+    cairo_set_source_surface (cr, b, 2 * SIZE, 0);
+    cairo_paint (cr);
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    if (status) {
+	free (pdf.data);
+	cairo_test_log (ctx, "Failed to write pdf: %s\n",
+			cairo_status_to_string (status));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    *num_images = count_images (&pdf);
+    free (pdf.data);
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *image, *a, *b;
+    buffer_t png = { NULL, 0, 0, 0 };
+    cairo_test_status_t result;
+    unsigned int num_images;
+    cairo_status_t status;
+    cairo_t *cr;
+
+    if (! cairo_test_is_target_enabled (ctx, "pdf"))
+	return CAIRO_TEST_UNTESTED;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+    cairo_set_source_rgb (cr, 0, 0, 1);
+    cairo_arc (cr, SIZE / 2, SIZE / 2, SIZE / 3, 0, 2 * M_PI);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    status = cairo_surface_write_to_png_stream (image, write_buffer, &png);
+    cairo_surface_destroy (image);
+    if (status) {
+	free (png.data);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    /* Two independent decodes of the same file: distinct surfaces
+     * with identical pixels. */
+    a = decode (&png);
+    b = decode (&png);
+    result = write_pdf (ctx, a, b, &num_images);
+    if (result == CAIRO_TEST_SUCCESS && num_images != 1) {
+	cairo_test_log (ctx,
+			"Identical images embedded %u times, expected once\n",
+			num_images);
+	result = CAIRO_TEST_FAILURE;
+    }
+    cairo_surface_destroy (b);
+
+    /* Change a single pixel of the second copy. */
+    if (result == CAIRO_TEST_SUCCESS) {
+	b = decode (&png);
+	cairo_surface_flush (b);
+	*(uint32_t *) cairo_image_surface_get_data (b) ^= 0x00010000;
+	cairo_surface_mark_dirty (b);
+
+	result = write_pdf (ctx, a, b, &num_images);
+	if (result == CAIRO_TEST_SUCCESS && num_images != 2) {
+	    cairo_test_log (ctx,
+			    "Differing images embedded %u times, expected twice\n",
+			    num_images);
+	    result = CAIRO_TEST_FAILURE;
+	}
+	cairo_surface_destroy (b);
+    }
+
+    cairo_surface_destroy (a);
+    free (png.data);
+
+    return result;
+}
+
+CAIRO_TEST (pdf_deduplicate,
+	    "Check that identical images are embedded only once",
+	    "pdf", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
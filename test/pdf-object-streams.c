@@ -0,0 +1,231 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+#include "cairo-test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <cairo-pdf.h>
+
+/* This test writes the same multi-page document twice, with and
+ * without cairo_pdf_surface_set_object_streams(). It checks that only
+ * the first packs objects into object streams, and that every page of
+ * both files opens and renders to identical pixels.
+ */
+
+#define WIDTH 120
+#define HEIGHT 90
+#define NUM_PAGES 3
+
+static void
+draw_page (cairo_t *cr, cairo_surface_t *image, int page)
+{
+    cairo_pattern_t *pattern;
+    int i;
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    for (i = 0; i <= page; i++) {
+	cairo_set_source_rgba (cr, 0.3 * i, 0.2 * page, 0.5, 0.8);
+	cairo_rectangle (cr, 10 + 20 * i, 10, 15, 30);
+	cairo_fill (cr);
+    }
+
+    pattern = cairo_pattern_create_radial (WIDTH / 2, 60, 0,
+					   WIDTH / 2, 60, 25);
+    cairo_pattern_add_color_stop_rgb (pattern, 0, 1, 0, 0);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, 0.5);
+    cairo_set_source (cr, pattern);
+    cairo_arc (cr, WIDTH / 2, 60, 25, 0, 2 * M_PI);
+    cairo_fill (cr);
+    cairo_pattern_destroy (pattern);
+
+    /* A translucent image, for a soft mask */
+    cairo_set_source_surface (cr, image, WIDTH - 30, HEIGHT - 30);
+    cairo_paint_with_alpha (cr, 0.7);
+
+    cairo_select_font_face (cr, "@cairo:",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size (cr, 12);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_move_to (cr, 10, HEIGHT - 10);
+    cairo_show_text (cr, page == 0 ? "first" : page == 1 ? "second" : "third");
+}
+
+static cairo_test_status_t
+write_pdf (const cairo_test_context_t *ctx,
+	   const char *filename,
+	   cairo_surface_t *image,
+	   cairo_bool_t object_streams)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+    int page;
+
+    surface = cairo_pdf_surface_create (filename, WIDTH, HEIGHT);
+    cairo_pdf_surface_restrict_to_version (surface, CAIRO_PDF_VERSION_1_5);
+    cairo_pdf_surface_set_object_streams (surface, object_streams);
+
+    cr = cairo_create (surface);
+    for (page = 0; page < NUM_PAGES; page++) {
+	draw_page (cr, image, page);
+	cairo_show_page (cr);
+    }
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    if (status) {
+	cairo_test_log (ctx, "Failed to write %s: %s\n",
+			filename, cairo_status_to_string (status));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_bool_t
+file_contains (const char *filename, const char *needle)
+{
+    size_t needle_length = strlen (needle);
+    cairo_bool_t found = 0;
+    char *data;
+    long length, i;
+    FILE *file;
+
+    file = fopen (filename, "rb");
+    if (file == NULL)
+	return 0;
+
+    fseek (file, 0, SEEK_END);
+    length = ftell (file);
+    fseek (file, 0, SEEK_SET);
+
+    data = malloc (length);
+    if (data != NULL && fread (data, 1, length, file) == (size_t) length) {
+	for (i = 0; i + (long) needle_length <= length; i++) {
+	    if (memcmp (data + i, needle, needle_length) == 0) {
+		found = 1;
+		break;
+	    }
+	}
+    }
+
+    free (data);
+    fclose (file);
+    return found;
+}
+
+static cairo_test_status_t
+compare_pages (const cairo_test_context_t *ctx,
+	       const char *packed, const char *unpacked)
+{
+    int page;
+
+    for (page = 1; page <= NUM_PAGES; page++) {
+	cairo_surface_t *a, *b;
+	cairo_bool_t equal;
+
+	a = cairo_boilerplate_convert_to_image (packed, page);
+	b = cairo_boilerplate_convert_to_image (unpacked, page);
+	if (cairo_surface_status (a) || cairo_surface_status (b)) {
+	    cairo_test_log (ctx, "Failed to render page %d: %s, %s\n", page,
+			    cairo_status_to_string (cairo_surface_status (a)),
+			    cairo_status_to_string (cairo_surface_status (b)));
+	    cairo_surface_destroy (a);
+	    cairo_surface_destroy (b);
+	    return CAIRO_TEST_FAILURE;
+	}
+
+	equal = cairo_test_images_equal (ctx, a, b, 0,
+					 "page %d with object streams", page);
+	cairo_surface_destroy (a);
+	cairo_surface_destroy (b);
+
+	if (! equal)
+	    return CAIRO_TEST_FAILURE;
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    const char *path = cairo_test_mkdir (CAIRO_TEST_OUTPUT_DIR) ? CAIRO_TEST_OUTPUT_DIR : ".";
+    char *packed, *unpacked;
+    cairo_surface_t *image;
+    cairo_test_status_t result;
+    cairo_t *cr;
+
+    if (! cairo_test_is_target_enabled (ctx, "pdf"))
+	return CAIRO_TEST_UNTESTED;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 20, 20);
+    cr = cairo_create (image);
+    cairo_set_source_rgba (cr, 0, 0.6, 0, 0.5);
+    cairo_arc (cr, 10, 10, 9, 0, 2 * M_PI);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    xasprintf (&packed, "%s/pdf-object-streams.packed.pdf", path);
+    xasprintf (&unpacked, "%s/pdf-object-streams.unpacked.pdf", path);
+
+    result = write_pdf (ctx, packed, image, 1);
+    if (result == CAIRO_TEST_SUCCESS)
+	result = write_pdf (ctx, unpacked, image, 0);
+    cairo_surface_destroy (image);
+
+    if (result == CAIRO_TEST_SUCCESS &&
+	(! file_contains (packed, "/Type /ObjStm") ||
+	 file_contains (unpacked, "/Type /ObjStm")))
+    {
+	cairo_test_log (ctx, "Object streams not used as requested\n");
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    if (result == CAIRO_TEST_SUCCESS)
+	result = compare_pages (ctx, packed, unpacked);
+
+    free (packed);
+    free (unpacked);
+
+    return result;
+}
+
+CAIRO_TEST (pdf_object_streams,
+	    "Check that object streams do not change how a PDF renders",
+	    "pdf", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,297 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+
+/*
+ * Write an image large enough to be compressed in blocks to a PDF file
+ * at several compression levels, with and without
+ * cairo_pdf_surface_set_threads(), and inflate its stream back with
+ * zlib: it must give the original pixels in every case. The compressed
+ * stream must also be the same whatever the number of threads, and
+ * only streams written with more than one thread are split into blocks.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <cairo-pdf.h>
+
+/* Large enough for three 128KiB blocks and a partial one */
+#define WIDTH 400
+#define HEIGHT 400
+
+typedef struct _buffer {
+    unsigned char *data;
+    unsigned long length, size;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	unsigned long size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+
+	if (new_data == NULL)
+	    return CAIRO_STATUS_WRITE_ERROR;
+
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* Some noise over smooth ramps, so that each level compresses
+ * differently. */
+static cairo_surface_t *
+create_image (unsigned char *rgb)
+{
+    cairo_surface_t *image;
+    uint32_t *row, seed = 1;
+    int x, y, stride;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, WIDTH, HEIGHT);
+    stride = cairo_image_surface_get_stride (image);
+    for (y = 0; y < HEIGHT; y++) {
+	row = (uint32_t *) (cairo_image_surface_get_data (image) + y * stride);
+	for (x = 0; x < WIDTH; x++) {
+	    uint8_t r, g, b;
+
+	    seed = seed * 1103515245 + 12345;
+	    r = x * 255 / WIDTH;
+	    g = y * 255 / HEIGHT;
+	    b = (seed >> 16) & 0x3f;
+	    row[x] = 0xff000000 | r << 16 | g << 8 | b;
+
+	    *rgb++ = r;
+	    *rgb++ = g;
+	    *rgb++ = b;
+	}
+    }
+    cairo_surface_mark_dirty (image);
+
+    return image;
+}
+
+static cairo_status_t
+write_pdf (buffer_t *pdf, cairo_surface_t *image, int level, int num_threads)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+
+    memset (pdf, 0, sizeof (*pdf));
+    surface = cairo_pdf_surface_create_for_stream (write_buffer, pdf,
+						   WIDTH, HEIGHT);
+    cairo_pdf_surface_set_compression_level (surface, level);
+    cairo_pdf_surface_set_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    cairo_set_source_surface (cr, image, 0, 0);
+    cairo_paint (cr);
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    return status;
+}
+
+/* Find the stream of the image XObject, and return its start. */
+static const unsigned char *
+find_image_stream (const buffer_t *pdf)
+{
+    const char *subtype = "/Subtype /Image";
+    const char *stream = "stream";
+    unsigned long i;
+
+    for (i = 0; i + strlen (subtype) <= pdf->length; i++) {
+	if (memcmp (pdf->data + i, subtype, strlen (subtype)) == 0)
+	    break;
+    }
+
+    for (; i + strlen (stream) + 1 <= pdf->length; i++) {
+	if (memcmp (pdf->data + i, stream, strlen (stream)) == 0) {
+	    i += strlen (stream);
+	    if (pdf->data[i] == '\r')
+		i++;
+	    if (pdf->data[i] == '\n')
+		return pdf->data + i + 1;
+	}
+    }
+
+    return NULL;
+}
+
+/* Inflate the image stream into @rgb, and return the length of its
+ * compressed form, or 0 on failure. */
+static unsigned long
+inflate_image (const buffer_t *pdf, unsigned char *rgb, unsigned long size)
+{
+    const unsigned char *data;
+    z_stream stream;
+    unsigned long length = 0;
+
+    data = find_image_stream (pdf);
+    if (data == NULL)
+	return 0;
+
+    memset (&stream, 0, sizeof (stream));
+    if (inflateInit (&stream) != Z_OK)
+	return 0;
+
+    stream.next_in = (Bytef *) data;
+    stream.avail_in = pdf->data + pdf->length - data;
+    stream.next_out = rgb;
+    stream.avail_out = size;
+    if (inflate (&stream, Z_FINISH) == Z_STREAM_END && stream.total_out == size)
+	length = stream.total_in;
+
+    inflateEnd (&stream);
+    return length;
+}
+
+/* A sync flush ends with an empty stored block, 00 00 ff ff. */
+static cairo_bool_t
+has_sync_flush (const unsigned char *data, unsigned long length)
+{
+    unsigned long i;
+
+    for (i = 0; i + 4 <= length; i++) {
+	if (data[i] == 0 && data[i + 1] == 0 &&
+	    data[i + 2] == 0xff && data[i + 3] == 0xff)
+	    return 1;
+    }
+
+    return 0;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const int levels[] = { 0, 1, 6, 9 };
+    static const int threads[] = { 1, 2, 0 };
+    unsigned long size = WIDTH * HEIGHT * 3;
+    unsigned char *expected, *rgb;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *image;
+    int i, j;
+
+    if (! cairo_test_is_target_enabled (ctx, "pdf"))
+	return CAIRO_TEST_UNTESTED;
+
+    expected = malloc (size);
+    rgb = malloc (size);
+    if (expected == NULL || rgb == NULL) {
+	free (expected);
+	free (rgb);
+	return CAIRO_TEST_NO_MEMORY;
+    }
+
+    image = create_image (expected);
+
+    for (i = 0; i < ARRAY_LENGTH (levels); i++) {
+	buffer_t blocks = { NULL, 0, 0 };
+	const unsigned char *blocks_stream = NULL;
+	unsigned long blocks_length = 0;
+
+	for (j = 0; j < ARRAY_LENGTH (threads); j++) {
+	    buffer_t pdf;
+	    cairo_status_t status;
+	    unsigned long length;
+
+	    status = write_pdf (&pdf, image, levels[i], threads[j]);
+	    if (status) {
+		cairo_test_log (ctx, "Failed to write level %d, %d threads: %s\n",
+				levels[i], threads[j],
+				cairo_status_to_string (status));
+		result = CAIRO_TEST_FAILURE;
+		free (pdf.data);
+		continue;
+	    }
+
+	    memset (rgb, 0, size);
+	    length = inflate_image (&pdf, rgb, size);
+	    if (length == 0 || memcmp (rgb, expected, size)) {
+		cairo_test_log (ctx, "Level %d, %d threads: the image does not inflate back\n",
+				levels[i], threads[j]);
+		result = CAIRO_TEST_FAILURE;
+		free (pdf.data);
+		continue;
+	    }
+
+	    if (threads[j] == 1) {
+		/* zlib emits no sync flush of its own */
+		if (has_sync_flush (find_image_stream (&pdf), length)) {
+		    cairo_test_log (ctx, "Level %d: compressed in blocks by default\n",
+				    levels[i]);
+		    result = CAIRO_TEST_FAILURE;
+		}
+		free (pdf.data);
+	    } else if (blocks_stream == NULL) {
+		if (! has_sync_flush (find_image_stream (&pdf), length)) {
+		    cairo_test_log (ctx, "Level %d, %d threads: not compressed in blocks\n",
+				    levels[i], threads[j]);
+		    result = CAIRO_TEST_FAILURE;
+		}
+		blocks = pdf;
+		blocks_stream = find_image_stream (&blocks);
+		blocks_length = length;
+	    } else {
+		if (length != blocks_length ||
+		    memcmp (find_image_stream (&pdf), blocks_stream, length))
+		{
+		    cairo_test_log (ctx, "Level %d: the stream depends on the number of threads\n",
+				    levels[i]);
+		    result = CAIRO_TEST_FAILURE;
+		}
+		free (pdf.data);
+	    }
+	}
+
+	free (blocks.data);
+    }
+
+    cairo_surface_destroy (image);
+    free (expected);
+    free (rgb);
+
+    return result;
+}
+
+CAIRO_TEST (pdf_parallel_deflate,
+	    "Check that streams compressed in blocks inflate back, at several levels",
+	    "pdf", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
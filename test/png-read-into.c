@@ -0,0 +1,399 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Decodes PNG images into existing pixel data, with
+ * cairo_image_surface_read_png_stream() and
+ * cairo_png_read_stream_to_data(), and checks that:
+ *
+ *  - the image lands at the requested offset and nothing outside it
+ *    is touched,
+ *  - an image that does not fit returns CAIRO_STATUS_INVALID_SIZE
+ *    without writing a single pixel,
+ *  - the premultiplication of RGBA and the conversion of RGB match
+ *    the exact rounding of the scalar code for every alpha and color
+ *    value. The images are wider than a multiple of four pixels so
+ *    that both the vectorised loops and their scalar tails are run.
+ *
+ * The PNG files are built here from uncompressed deflate blocks, as
+ * cairo itself only ever writes premultiplied data back out.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_WIDTH 259
+#define IMAGE_HEIGHT 256
+#define SURFACE_SIZE 300
+#define SENTINEL 0x5a
+
+typedef struct {
+    unsigned char *data;
+    unsigned int length;
+    unsigned int size;
+    unsigned int offset;
+} buffer_t;
+
+static void
+buffer_append (buffer_t *buffer, const void *data, unsigned int length)
+{
+    if (length == 0)
+	return;
+
+    if (buffer->length + length > buffer->size) {
+	buffer->size = 2 * (buffer->length + length);
+	buffer->data = realloc (buffer->data, buffer->size);
+    }
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static void
+buffer_append_be32 (buffer_t *buffer, uint32_t v)
+{
+    unsigned char bytes[4];
+
+    bytes[0] = v >> 24;
+    bytes[1] = v >> 16;
+    bytes[2] = v >> 8;
+    bytes[3] = v;
+    buffer_append (buffer, bytes, 4);
+}
+
+static uint32_t
+crc32_update (uint32_t crc, const unsigned char *data, unsigned int length)
+{
+    unsigned int i, k;
+
+    crc = ~crc;
+    for (i = 0; i < length; i++) {
+	crc ^= data[i];
+	for (k = 0; k < 8; k++)
+	    crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static void
+png_chunk (buffer_t *png, const char *type,
+	   const unsigned char *data, unsigned int length)
+{
+    uint32_t crc;
+
+    buffer_append_be32 (png, length);
+    buffer_append (png, type, 4);
+    buffer_append (png, data, length);
+
+    crc = crc32_update (0, (const unsigned char *) type, 4);
+    crc = crc32_update (crc, data, length);
+    buffer_append_be32 (png, crc);
+}
+
+/* The red, green and blue of pixel x, with the alpha taken from the row */
+static void
+pixel_color (int x, unsigned char rgb[3])
+{
+    rgb[0] = x;
+    rgb[1] = x * 7;
+    rgb[2] = 255 - x;
+}
+
+/* Builds an RGBA (or RGB) PNG whose row y has alpha y */
+static void
+build_png (buffer_t *png, cairo_bool_t has_alpha)
+{
+    static const unsigned char signature[8] = {
+	0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+    int bpp = has_alpha ? 4 : 3;
+    unsigned int row_length = 1 + bpp * IMAGE_WIDTH;
+    unsigned int raw_length = row_length * IMAGE_HEIGHT;
+    unsigned char *raw;
+    unsigned char header[13];
+    buffer_t zdata = { NULL, 0, 0, 0 };
+    uint32_t a, b;
+    unsigned int i;
+    int x, y;
+
+    raw = malloc (raw_length);
+    for (y = 0; y < IMAGE_HEIGHT; y++) {
+	unsigned char *row = raw + y * row_length;
+
+	row[0] = 0; /* no filter */
+	for (x = 0; x < IMAGE_WIDTH; x++) {
+	    pixel_color (x, row + 1 + bpp * x);
+	    if (has_alpha)
+		row[1 + bpp * x + 3] = y;
+	}
+    }
+
+    /* zlib stream of stored deflate blocks */
+    buffer_append (&zdata, "\x78\x01", 2);
+    for (i = 0; i < raw_length; i += 0xffff) {
+	unsigned int length = raw_length - i < 0xffff ? raw_length - i : 0xffff;
+	unsigned char block[5];
+
+	block[0] = i + length == raw_length;
+	block[1] = length;
+	block[2] = length >> 8;
+	block[3] = ~length;
+	block[4] = ~length >> 8;
+	buffer_append (&zdata, block, 5);
+	buffer_append (&zdata, raw + i, length);
+    }
+    a = 1, b = 0;
+    for (i = 0; i < raw_length; i++) {
+	a = (a + raw[i]) % 65521;
+	b = (b + a) % 65521;
+    }
+    buffer_append_be32 (&zdata, (b << 16) | a);
+    free (raw);
+
+    header[0] = 0; header[1] = 0;
+    header[2] = IMAGE_WIDTH >> 8; header[3] = IMAGE_WIDTH & 0xff;
+    header[4] = 0; header[5] = 0;
+    header[6] = IMAGE_HEIGHT >> 8; header[7] = IMAGE_HEIGHT & 0xff;
+    header[8] = 8; /* bit depth */
+    header[9] = has_alpha ? 6 : 2; /* RGBA or RGB */
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    buffer_append (png, signature, sizeof (signature));
+    png_chunk (png, "IHDR", header, sizeof (header));
+    png_chunk (png, "IDAT", zdata.data, zdata.length);
+    png_chunk (png, "IEND", NULL, 0);
+
+    free (zdata.data);
+}
+
+static cairo_status_t
+read_png_from_buffer (void *closure, unsigned char *data, unsigned int length)
+{
+    buffer_t *png = closure;
+
+    if (png->offset + length > png->length)
+	return CAIRO_STATUS_READ_ERROR;
+
+    memcpy (data, png->data + png->offset, length);
+    png->offset += length;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static inline int
+multiply_alpha (int alpha, int color)
+{
+    int temp = (alpha * color) + 0x80;
+    return ((temp + (temp >> 8)) >> 8);
+}
+
+static uint32_t
+expected_pixel (int x, int y, cairo_bool_t has_alpha)
+{
+    unsigned char rgb[3];
+
+    pixel_color (x, rgb);
+    if (! has_alpha)
+	return 0xff000000 | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+
+    if (y == 0)
+	return 0;
+
+    return ((uint32_t) y << 24) |
+	   (multiply_alpha (y, rgb[0]) << 16) |
+	   (multiply_alpha (y, rgb[1]) << 8) |
+	   (multiply_alpha (y, rgb[2]) << 0);
+}
+
+/* Checks the image at (ox, oy) and the sentinel everywhere else */
+static cairo_test_status_t
+check_pixels (const cairo_test_context_t *ctx, const char *what,
+	      const unsigned char *data, int stride,
+	      int width, int height, int ox, int oy,
+	      cairo_bool_t has_alpha)
+{
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+	const uint32_t *row = (const uint32_t *) (data + y * stride);
+
+	for (x = 0; x < width; x++) {
+	    uint32_t expected;
+
+	    if (x >= ox && x < ox + IMAGE_WIDTH &&
+		y >= oy && y < oy + IMAGE_HEIGHT)
+	    {
+		expected = expected_pixel (x - ox, y - oy, has_alpha);
+	    }
+	    else
+	    {
+		memset (&expected, SENTINEL, sizeof (expected));
+	    }
+
+	    if (row[x] != expected) {
+		cairo_test_log (ctx,
+				"%s: pixel (%d, %d) is %08x, expected %08x\n",
+				what, x, y, row[x], expected);
+		return CAIRO_TEST_FAILURE;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+test_surface (const cairo_test_context_t *ctx, cairo_bool_t has_alpha)
+{
+    cairo_format_t format = has_alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24;
+    const char *what = has_alpha ? "ARGB32 surface" : "RGB24 surface";
+    buffer_t png = { NULL, 0, 0, 0 };
+    cairo_surface_t *surface;
+    cairo_test_status_t result;
+    cairo_status_t status;
+    unsigned char *data;
+    int stride;
+
+    build_png (&png, has_alpha);
+
+    surface = cairo_image_surface_create (format, SURFACE_SIZE, SURFACE_SIZE);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+    memset (data, SENTINEL, stride * SURFACE_SIZE);
+    cairo_surface_mark_dirty (surface);
+
+    /* Too far right: nothing may be written */
+    status = cairo_image_surface_read_png_stream (surface,
+						  SURFACE_SIZE - IMAGE_WIDTH + 1, 0,
+						  read_png_from_buffer, &png);
+    if (status != CAIRO_STATUS_INVALID_SIZE) {
+	cairo_test_log (ctx, "%s: oversized read returned %s\n",
+			what, cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+	goto out;
+    }
+    result = check_pixels (ctx, what, data, stride,
+			   SURFACE_SIZE, SURFACE_SIZE, SURFACE_SIZE, SURFACE_SIZE,
+			   has_alpha);
+    if (result != CAIRO_TEST_SUCCESS)
+	goto out;
+
+    png.offset = 0;
+    status = cairo_image_surface_read_png_stream (surface, 17, 23,
+						  read_png_from_buffer, &png);
+    if (status) {
+	cairo_test_log (ctx, "%s: read failed: %s\n",
+			what, cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+	goto out;
+    }
+    cairo_surface_flush (surface);
+    result = check_pixels (ctx, what, data, stride,
+			   SURFACE_SIZE, SURFACE_SIZE, 17, 23,
+			   has_alpha);
+
+out:
+    cairo_surface_destroy (surface);
+    free (png.data);
+    return result;
+}
+
+static cairo_test_status_t
+test_data (const cairo_test_context_t *ctx)
+{
+    buffer_t png = { NULL, 0, 0, 0 };
+    cairo_test_status_t result;
+    cairo_status_t status;
+    int stride = 4 * SURFACE_SIZE;
+    unsigned char *data;
+
+    build_png (&png, 1);
+
+    data = malloc (stride * SURFACE_SIZE);
+    memset (data, SENTINEL, stride * SURFACE_SIZE);
+
+    /* One row short: nothing may be written */
+    status = cairo_png_read_stream_to_data (read_png_from_buffer, &png,
+					    data + 5 * stride + 4 * 11,
+					    CAIRO_FORMAT_ARGB32,
+					    IMAGE_WIDTH, IMAGE_HEIGHT - 1,
+					    stride);
+    if (status != CAIRO_STATUS_INVALID_SIZE) {
+	cairo_test_log (ctx, "data: oversized read returned %s\n",
+			cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+	goto out;
+    }
+    result = check_pixels (ctx, "data", data, stride,
+			   SURFACE_SIZE, SURFACE_SIZE, SURFACE_SIZE, SURFACE_SIZE,
+			   1);
+    if (result != CAIRO_TEST_SUCCESS)
+	goto out;
+
+    png.offset = 0;
+    status = cairo_png_read_stream_to_data (read_png_from_buffer, &png,
+					    data + 5 * stride + 4 * 11,
+					    CAIRO_FORMAT_ARGB32,
+					    SURFACE_SIZE - 11, SURFACE_SIZE - 5,
+					    stride);
+    if (status) {
+	cairo_test_log (ctx, "data: read failed: %s\n",
+			cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+	goto out;
+    }
+    result = check_pixels (ctx, "data", data, stride,
+			   SURFACE_SIZE, SURFACE_SIZE, 11, 5,
+			   1);
+
+out:
+    free (data);
+    free (png.data);
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t result;
+
+    result = test_surface (ctx, 1);
+    if (result == CAIRO_TEST_SUCCESS)
+	result = test_surface (ctx, 0);
+    if (result == CAIRO_TEST_SUCCESS)
+	result = test_data (ctx);
+
+    return result;
+}
+
+CAIRO_TEST (png_read_into,
+	    "Check decoding PNG images into existing pixel data",
+	    "png", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
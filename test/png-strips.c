@@ -0,0 +1,247 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Encodes images in strips, with cairo_png_options_set_strip_height()
+ * and cairo_surface_write_to_png_stream_with_options(), for every
+ * filter at compression levels 0 and 9, decodes them again and checks
+ * that the pixels match those of the serial encoding. The strip
+ * height does not divide the image height, so the last strip is a
+ * short one.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH 53
+#define HEIGHT 61
+#define STRIP_HEIGHT 7
+
+typedef struct {
+    unsigned char *data;
+    unsigned int length;
+    unsigned int size;
+    unsigned int offset;
+} buffer_t;
+
+static cairo_status_t
+write_png_to_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	unsigned char *tmp;
+
+	buffer->size = 2 * (buffer->length + length);
+	tmp = realloc (buffer->data, buffer->size);
+	if (tmp == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+	buffer->data = tmp;
+    }
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+read_png_from_buffer (void *closure, unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->offset + length > buffer->length)
+	return CAIRO_STATUS_READ_ERROR;
+
+    memcpy (data, buffer->data + buffer->offset, length);
+    buffer->offset += length;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* Fills the image with smooth ramps, for the predictors to work on,
+ * overlaid with noise in some of the rows. */
+static cairo_surface_t *
+create_source (cairo_format_t format)
+{
+    cairo_surface_t *surface;
+    unsigned char *data;
+    uint32_t seed = 0x12345678;
+    int stride, x, y;
+
+    surface = cairo_image_surface_create (format, WIDTH, HEIGHT);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+
+    for (y = 0; y < HEIGHT; y++) {
+	for (x = 0; x < WIDTH; x++) {
+	    uint32_t a, r, g, b;
+
+	    seed = seed * 1103515245 + 12345;
+	    if (y % 3 == 0) {
+		a = seed >> 24;
+		r = (seed >> 16) & 0xff;
+		g = (seed >> 8) & 0xff;
+		b = (seed >> 0) & 0xff;
+	    } else {
+		a = 4 * y;
+		r = 4 * x;
+		g = 2 * (x + y);
+		b = 255 - 4 * y;
+	    }
+
+	    if (format == CAIRO_FORMAT_A8) {
+		data[y * stride + x] = a;
+	    } else {
+		if (format == CAIRO_FORMAT_RGB24)
+		    a = 0xff;
+		r = r * a / 255;
+		g = g * a / 255;
+		b = b * a / 255;
+		((uint32_t *) (data + y * stride))[x] =
+		    (a << 24) | (r << 16) | (g << 8) | b;
+	    }
+	}
+    }
+    cairo_surface_mark_dirty (surface);
+
+    return surface;
+}
+
+static cairo_surface_t *
+encode_and_decode (cairo_surface_t *source,
+		   int level, cairo_png_filter_t filter, int strip_height,
+		   cairo_status_t *status)
+{
+    cairo_png_options_t *options;
+    cairo_surface_t *decoded;
+    buffer_t buffer = { NULL, 0, 0, 0 };
+
+    options = cairo_png_options_create ();
+    cairo_png_options_set_compression_level (options, level);
+    cairo_png_options_set_filter (options, filter);
+    cairo_png_options_set_strip_height (options, strip_height);
+
+    *status = cairo_surface_write_to_png_stream_with_options (source,
+							      write_png_to_buffer,
+							      &buffer,
+							      options);
+    cairo_png_options_destroy (options);
+    if (*status) {
+	free (buffer.data);
+	return NULL;
+    }
+
+    decoded = cairo_image_surface_create_from_png_stream (read_png_from_buffer,
+							  &buffer);
+    free (buffer.data);
+
+    *status = cairo_surface_status (decoded);
+    if (*status) {
+	cairo_surface_destroy (decoded);
+	return NULL;
+    }
+
+    return decoded;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const cairo_format_t formats[] = {
+	CAIRO_FORMAT_ARGB32,
+	CAIRO_FORMAT_RGB24,
+	CAIRO_FORMAT_A8,
+    };
+    static const cairo_png_filter_t filters[] = {
+	CAIRO_PNG_FILTER_DEFAULT,
+	CAIRO_PNG_FILTER_NONE,
+	CAIRO_PNG_FILTER_SUB,
+	CAIRO_PNG_FILTER_UP,
+	CAIRO_PNG_FILTER_AVERAGE,
+	CAIRO_PNG_FILTER_PAETH,
+    };
+    static const int levels[] = { 0, 9 };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    unsigned int f, i, l;
+
+    for (f = 0; f < ARRAY_LENGTH (formats); f++) {
+	cairo_surface_t *source, *reference;
+	cairo_status_t status;
+
+	source = create_source (formats[f]);
+
+	/* The serial encoding is the reference */
+	reference = encode_and_decode (source, -1, CAIRO_PNG_FILTER_DEFAULT, 0,
+				       &status);
+	if (reference == NULL) {
+	    cairo_test_log (ctx, "format %d: serial encoding failed: %s\n",
+			    formats[f], cairo_status_to_string (status));
+	    cairo_surface_destroy (source);
+	    return CAIRO_TEST_FAILURE;
+	}
+
+	for (i = 0; i < ARRAY_LENGTH (filters); i++) {
+	    for (l = 0; l < ARRAY_LENGTH (levels); l++) {
+		cairo_surface_t *decoded;
+
+		decoded = encode_and_decode (source, levels[l], filters[i],
+					     STRIP_HEIGHT, &status);
+		if (decoded == NULL) {
+		    cairo_test_log (ctx,
+				    "format %d, filter %d, level %d: "
+				    "strip encoding failed: %s\n",
+				    formats[f], filters[i], levels[l],
+				    cairo_status_to_string (status));
+		    result = CAIRO_TEST_FAILURE;
+		    continue;
+		}
+
+		if (! cairo_test_images_equal (ctx, decoded, reference, 0,
+					       "format %d, filter %d, level %d: "
+					       "the image decoded from strips",
+					       formats[f], filters[i], levels[l]))
+		{
+		    result = CAIRO_TEST_FAILURE;
+		}
+
+		cairo_surface_destroy (decoded);
+	    }
+	}
+
+	cairo_surface_destroy (reference);
+	cairo_surface_destroy (source);
+    }
+
+    return result;
+}
+
+CAIRO_TEST (png_strips,
+	    "Check that PNG images encoded in strips decode correctly",
+	    "png", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,223 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+#include "cairo-test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <cairo-ps.h>
+
+/* This test writes the same two-page document twice, with and without
+ * cairo_ps_surface_set_deduplicate_content(). The document paints one
+ * image several times on both pages, along with a separate copy of it
+ * and a second image. It checks that with deduplication each distinct
+ * image is defined only once, as a procedure shared by every paint,
+ * and that both files render to identical pixels.
+ */
+
+#define WIDTH 120
+#define HEIGHT 90
+#define NUM_PAGES 2
+
+static cairo_surface_t *
+create_image (double red)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, 20, 20);
+    cr = cairo_create (image);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+    cairo_set_source_rgb (cr, red, 0.6, 0);
+    cairo_arc (cr, 10, 10, 9, 0, 2 * M_PI);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    return image;
+}
+
+static cairo_test_status_t
+write_ps (const cairo_test_context_t *ctx,
+	  const char *filename,
+	  cairo_bool_t deduplicate)
+{
+    cairo_surface_t *surface, *image, *copy, *other;
+    cairo_status_t status;
+    cairo_t *cr;
+    int page, i;
+
+    image = create_image (0);
+    copy = create_image (0);
+    other = create_image (1);
+
+    surface = cairo_ps_surface_create (filename, WIDTH, HEIGHT);
+    cairo_ps_surface_set_deduplicate_content (surface, deduplicate);
+
+    cr = cairo_create (surface);
+    for (page = 0; page < NUM_PAGES; page++) {
+	for (i = 0; i < 3; i++) {
+	    cairo_set_source_surface (cr, image, 10 + 25 * i, 10 + 10 * page);
+	    cairo_paint (cr);
+	}
+
+	cairo_set_source_surface (cr, copy, 10, 50);
+	cairo_paint (cr);
+	cairo_set_source_surface (cr, other, 40 + 20 * page, 50);
+	cairo_paint (cr);
+
+	cairo_show_page (cr);
+    }
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    cairo_surface_destroy (other);
+    cairo_surface_destroy (copy);
+    cairo_surface_destroy (image);
+
+    if (status) {
+	cairo_test_log (ctx, "Failed to write %s: %s\n",
+			filename, cairo_status_to_string (status));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static int
+file_count (const char *filename, const char *needle)
+{
+    size_t needle_length = strlen (needle);
+    int count = 0;
+    char *data;
+    long length, i;
+    FILE *file;
+
+    file = fopen (filename, "rb");
+    if (file == NULL)
+	return -1;
+
+    fseek (file, 0, SEEK_END);
+    length = ftell (file);
+    fseek (file, 0, SEEK_SET);
+
+    data = malloc (length);
+    if (data != NULL && fread (data, 1, length, file) == (size_t) length) {
+	for (i = 0; i + (long) needle_length <= length; i++) {
+	    if (memcmp (data + i, needle, needle_length) == 0)
+		count++;
+	}
+    } else {
+	count = -1;
+    }
+
+    free (data);
+    fclose (file);
+    return count;
+}
+
+static cairo_test_status_t
+compare_pages (const cairo_test_context_t *ctx,
+	       const char *shared, const char *inline_)
+{
+    int page;
+
+    for (page = 1; page <= NUM_PAGES; page++) {
+	cairo_surface_t *a, *b;
+	cairo_bool_t equal;
+
+	a = cairo_boilerplate_convert_to_image (shared, page);
+	b = cairo_boilerplate_convert_to_image (inline_, page);
+	if (cairo_surface_status (a) || cairo_surface_status (b)) {
+	    cairo_test_log (ctx, "Failed to render page %d: %s, %s\n", page,
+			    cairo_status_to_string (cairo_surface_status (a)),
+			    cairo_status_to_string (cairo_surface_status (b)));
+	    cairo_surface_destroy (a);
+	    cairo_surface_destroy (b);
+	    return CAIRO_TEST_FAILURE;
+	}
+
+	equal = cairo_test_images_equal (ctx, a, b, 0,
+					 "page %d when deduplicated", page);
+	cairo_surface_destroy (a);
+	cairo_surface_destroy (b);
+
+	if (! equal)
+	    return CAIRO_TEST_FAILURE;
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    const char *path = cairo_test_mkdir (CAIRO_TEST_OUTPUT_DIR) ? CAIRO_TEST_OUTPUT_DIR : ".";
+    char *shared, *inline_;
+    cairo_test_status_t result;
+    int defined, inlined;
+
+    if (! cairo_test_is_target_enabled (ctx, "ps3"))
+	return CAIRO_TEST_UNTESTED;
+
+    xasprintf (&shared, "%s/ps-deduplicate.shared.ps", path);
+    xasprintf (&inline_, "%s/ps-deduplicate.inline.ps", path);
+
+    result = write_ps (ctx, shared, 1);
+    if (result == CAIRO_TEST_SUCCESS)
+	result = write_ps (ctx, inline_, 0);
+
+    if (result == CAIRO_TEST_SUCCESS) {
+	/* Only the definitions name the procedures with a slash */
+	defined = file_count (shared, "/cairo_surface_");
+	inlined = file_count (inline_, "/cairo_surface_");
+	if (defined != 2 || inlined != 0) {
+	    cairo_test_log (ctx,
+			    "Defined %d and %d shared images, expected 2 and 0\n",
+			    defined, inlined);
+	    result = CAIRO_TEST_FAILURE;
+	}
+    }
+
+    if (result == CAIRO_TEST_SUCCESS)
+	result = compare_pages (ctx, shared, inline_);
+
+    free (shared);
+    free (inline_);
+
+    return result;
+}
+
+CAIRO_TEST (ps_deduplicate,
+	    "Check that identical images are defined only once in PostScript",
+	    "ps", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,151 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+#include "cairo-test.h"
+
+/* Replays a recording made of long runs of similar fills and strokes,
+ * as a chart would produce, with and without command coalescing, and
+ * checks that both give exactly the same pixels.
+ */
+
+#define WIDTH 256
+#define HEIGHT 256
+
+static void
+record (cairo_t *cr)
+{
+    int i, j;
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    /* Pixel-aligned, overlapping opaque boxes */
+    cairo_set_source_rgb (cr, 0.2, 0.4, 0.8);
+    for (i = 0; i < 32; i++) {
+	cairo_rectangle (cr, 4 * i, 2 * i, 12, 16);
+	cairo_fill (cr);
+    }
+
+    /* Unaligned translucent boxes that do not overlap */
+    cairo_set_source_rgba (cr, 0.8, 0.2, 0.1, 0.5);
+    for (i = 0; i < 16; i++) {
+	cairo_rectangle (cr, 136.5 + 7 * (i % 4) * 1.5, 4.25 + 10 * (i / 4), 6.5, 7.75);
+	cairo_fill (cr);
+    }
+
+    /* Alternating rectilinear and curved shapes */
+    cairo_set_source_rgb (cr, 0.1, 0.6, 0.2);
+    for (i = 0; i < 8; i++) {
+	for (j = 0; j < 8; j++) {
+	    double x = 8 + 16 * i, y = 96 + 16 * j;
+
+	    if ((i + j) & 1)
+		cairo_arc (cr, x + 6, y + 6, 5.5, 0, 2 * M_PI);
+	    else
+		cairo_rectangle (cr, x, y, 11, 11);
+	    cairo_fill (cr);
+	}
+    }
+
+    /* Overlapping translucent circles, which must not be merged */
+    cairo_set_source_rgba (cr, 0.5, 0, 0.5, 0.4);
+    for (i = 0; i < 12; i++) {
+	cairo_arc (cr, 150 + 6 * i, 120 + 3 * i, 12, 0, 2 * M_PI);
+	cairo_fill (cr);
+    }
+
+    /* Polyline segments, horizontal and slanted */
+    cairo_set_line_width (cr, 1.5);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    for (i = 0; i < 40; i++) {
+	cairo_move_to (cr, 140 + 2.5 * i, 200 + ((i & 1) ? 0 : 12));
+	if (i & 2)
+	    cairo_line_to (cr, 140 + 2.5 * i, 240);
+	else
+	    cairo_line_to (cr, 142 + 2.5 * i, 250);
+	cairo_stroke (cr);
+    }
+
+    /* A clipped run */
+    cairo_rectangle (cr, 10, 230, 100, 20);
+    cairo_clip (cr);
+    cairo_set_source_rgb (cr, 0.9, 0.6, 0);
+    for (i = 0; i < 20; i++) {
+	cairo_rectangle (cr, 5 + 6 * i, 225 + (i % 3), 5, 30);
+	cairo_fill (cr);
+    }
+}
+
+static cairo_surface_t *
+replay (cairo_surface_t *recording, cairo_bool_t coalesce)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    cairo_recording_surface_set_coalesce_commands (recording, coalesce);
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cr = cairo_create (image);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    return image;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *recording, *reference, *coalesced;
+    cairo_test_status_t result;
+    cairo_t *cr;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						NULL);
+    cr = cairo_create (recording);
+    record (cr);
+    cairo_destroy (cr);
+
+    reference = replay (recording, 0);
+    coalesced = replay (recording, 1);
+    result = CAIRO_TEST_SUCCESS;
+    if (! cairo_test_images_equal (ctx, coalesced, reference, 0,
+				   "coalesced replay"))
+	result = CAIRO_TEST_FAILURE;
+
+    cairo_surface_destroy (coalesced);
+    cairo_surface_destroy (reference);
+    cairo_surface_destroy (recording);
+
+    return result;
+}
+
+CAIRO_TEST (recording_surface_coalesce,
+	    "Check that coalescing similar commands does not change a replay",
+	    "recording", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,183 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+#include "cairo-test.h"
+
+/* Replays a recording where opaque backgrounds and panels hide some of
+ * the earlier commands, with and without culling the hidden commands,
+ * checks that both give exactly the same pixels and that exactly the
+ * hidden commands were skipped. The panels overlap, so some commands
+ * are only hidden by their union, and the ones that merely touch the
+ * partially covered edge of a fractional panel, or lie under a clipped
+ * or translucent panel, must still be drawn.
+ */
+
+#define WIDTH 200
+#define HEIGHT 200
+
+#define NUM_COMMANDS 14
+#define NUM_HIDDEN 5
+
+static void
+record (cairo_t *cr)
+{
+    /* Hidden by the following background. That is drawn in two
+     * halves, as a single opaque paint, or a fill of the whole surface,
+     * would make the recording discard the commands before it. */
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_rgb (cr, 0.9, 0.9, 0.9);
+    cairo_rectangle (cr, 0, 0, WIDTH, HEIGHT / 2);
+    cairo_fill (cr);
+    cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+    cairo_set_source_rgb (cr, 0.8, 0.8, 0.8);
+    cairo_rectangle (cr, 0, HEIGHT / 2, WIDTH, HEIGHT / 2);
+    cairo_fill (cr);
+
+    /* Hidden by the first panel */
+    cairo_set_source_rgb (cr, 0, 0, 1);
+    cairo_arc (cr, 60, 60, 20, 0, 2 * M_PI);
+    cairo_fill (cr);
+
+    cairo_set_line_width (cr, 2);
+    cairo_move_to (cr, 70, 70);
+    cairo_line_to (cr, 80, 80);
+    cairo_stroke (cr);
+
+    cairo_rectangle (cr, 11, 11, 5, 5);
+    cairo_fill (cr);
+
+    /* Only hidden by both panels together */
+    cairo_set_source_rgba (cr, 1, 0, 0, 0.5);
+    cairo_rectangle (cr, 20, 60, 120, 20);
+    cairo_fill (cr);
+
+    /* Reaches into the partially covered pixels of the first panel */
+    cairo_rectangle (cr, 10, 10, 6, 6);
+    cairo_fill (cr);
+
+    /* Beneath a clipped panel */
+    cairo_rectangle (cr, 130, 15, 10, 10);
+    cairo_fill (cr);
+
+    cairo_save (cr);
+    cairo_rectangle (cr, 120, 10, 60, 30);
+    cairo_clip (cr);
+    cairo_set_source_rgb (cr, 0, 1, 0);
+    cairo_rectangle (cr, 115, 5, 70, 40);
+    cairo_fill (cr);
+    cairo_restore (cr);
+
+    /* Beneath a translucent panel */
+    cairo_rectangle (cr, 160, 160, 10, 10);
+    cairo_fill (cr);
+
+    /* SOURCE replaces the pixels even with a translucent colour */
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_rgba (cr, 0, 0.5, 0, 0.5);
+    cairo_rectangle (cr, 10.5, 10.5, 100, 100);
+    cairo_fill (cr);
+    cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+
+    cairo_set_source_rgb (cr, 0.5, 0.5, 0);
+    cairo_rectangle (cr, 50, 50, 100, 100);
+    cairo_fill (cr);
+
+    cairo_set_source_rgba (cr, 0, 0, 0, 0.5);
+    cairo_rectangle (cr, 150, 150, 40, 40);
+    cairo_fill (cr);
+}
+
+static cairo_surface_t *
+replay (cairo_bool_t cull)
+{
+    cairo_rectangle_t extents = { 0, 0, WIDTH, HEIGHT };
+    cairo_surface_t *recording, *image;
+    cairo_t *cr;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						&extents);
+    cairo_recording_surface_set_cull_hidden_commands (recording, cull);
+    cr = cairo_create (recording);
+    record (cr);
+    cairo_destroy (cr);
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cr = cairo_create (image);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_destroy (recording);
+    return image;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *reference, *culled;
+    cairo_test_status_t result;
+    unsigned long replayed[2], hidden[2];
+
+    cairo_debug_get_recording_cull_stats (&replayed[0], &hidden[0]);
+    reference = replay (0);
+    cairo_debug_get_recording_cull_stats (&replayed[1], &hidden[1]);
+    if (replayed[1] != replayed[0] || hidden[1] != hidden[0]) {
+	cairo_test_log (ctx, "Counted a replay without culling\n");
+	cairo_surface_destroy (reference);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    culled = replay (1);
+    cairo_debug_get_recording_cull_stats (&replayed[1], &hidden[1]);
+
+    result = CAIRO_TEST_SUCCESS;
+    if (! cairo_test_images_equal (ctx, culled, reference, 0, "culled replay"))
+	result = CAIRO_TEST_FAILURE;
+    if (hidden[1] - hidden[0] != NUM_HIDDEN ||
+	replayed[1] - replayed[0] != NUM_COMMANDS - NUM_HIDDEN)
+    {
+	cairo_test_log (ctx,
+			"Culled %lu of %lu commands, expected %d of %d\n",
+			hidden[1] - hidden[0],
+			hidden[1] - hidden[0] + replayed[1] - replayed[0],
+			NUM_HIDDEN, NUM_COMMANDS);
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    cairo_surface_destroy (culled);
+    cairo_surface_destroy (reference);
+
+    return result;
+}
+
+CAIRO_TEST (recording_surface_cull,
+	    "Check that culling hidden commands does not change a replay",
+	    "recording", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
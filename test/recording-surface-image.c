@@ -0,0 +1,210 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Check that cairo_recording_surface_get_image() gives the same pixels
+ * as replaying the recording onto a fresh image, both the first time
+ * and after each batch of further drawing, which it only draws again
+ * where the recording changed. The image must also match drawing the
+ * same shapes directly, which checks that it lines up with extents
+ * that do not start at the origin. An unbounded recording has no image.
+ *
+ * The updates are clipped to the changed areas, which may round curved
+ * edges differently, so the drawing sticks to rectilinear shapes.
+ */
+
+#include "cairo-test.h"
+
+#define X -10
+#define Y -5
+#define WIDTH 200
+#define HEIGHT 150
+
+static void
+draw_batch (cairo_t *cr, int batch)
+{
+    cairo_pattern_t *pattern;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+	double x = X + (i * 37 + batch * 23) % WIDTH + .25;
+	double y = Y + (i * 29 + batch * 41) % HEIGHT + .5;
+
+	cairo_set_source_rgba (cr, i / 8., batch / 4., 1 - i / 8., .6);
+	cairo_rectangle (cr, x, y, 20 + i * 3, 15 + batch * 4);
+	if (i & 1) {
+	    cairo_fill (cr);
+	} else {
+	    cairo_set_line_width (cr, 1 + i);
+	    cairo_stroke (cr);
+	}
+    }
+
+    pattern = cairo_pattern_create_linear (X, 0, X + WIDTH, 0);
+    cairo_pattern_add_color_stop_rgba (pattern, 0, 1, 0, 0, .5);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, .8);
+    cairo_set_source (cr, pattern);
+    cairo_rectangle (cr, X + 10 * batch, Y + 20 * batch, 60, 25);
+    cairo_fill (cr);
+    cairo_pattern_destroy (pattern);
+
+    /* Punch a hole through everything drawn so far */
+    cairo_save (cr);
+    cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+    cairo_rectangle (cr, X + 30 + 40 * batch, Y + 60, 12, 12);
+    cairo_fill (cr);
+    cairo_restore (cr);
+}
+
+static cairo_surface_t *
+replay (cairo_surface_t *recording)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    /* A recording surface pattern starts at the origin of its extents */
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cr = cairo_create (image);
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    return image;
+}
+
+/* Draw the same batches straight onto an image lined up with the
+ * recording, as the image of the recording should be */
+static cairo_surface_t *
+draw_direct (int num_batches)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+    int batch;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cairo_surface_set_device_offset (image, -X, -Y);
+
+    cr = cairo_create (image);
+    for (batch = 0; batch < num_batches; batch++)
+	draw_batch (cr, batch);
+    cairo_destroy (cr);
+
+    return image;
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_surface_t *recording, int batch)
+{
+    cairo_surface_t *image, *expected;
+    cairo_test_status_t result;
+    double x_offset, y_offset;
+
+    image = cairo_recording_surface_get_image (recording);
+    if (cairo_surface_status (image)) {
+	cairo_test_log (ctx, "batch %d: get_image failed: %s\n", batch,
+			cairo_status_to_string (cairo_surface_status (image)));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    cairo_surface_get_device_offset (image, &x_offset, &y_offset);
+    if (cairo_image_surface_get_width (image) != WIDTH ||
+	cairo_image_surface_get_height (image) != HEIGHT ||
+	x_offset != -X || y_offset != -Y)
+    {
+	cairo_test_log (ctx, "batch %d: image does not cover the extents\n",
+			batch);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    result = CAIRO_TEST_SUCCESS;
+
+    expected = replay (recording);
+    if (! cairo_test_images_equal (ctx, image, expected, 0,
+				   "batch %d: the image of a replay", batch))
+	result = CAIRO_TEST_FAILURE;
+    cairo_surface_destroy (expected);
+
+    if (result == CAIRO_TEST_SUCCESS) {
+	expected = draw_direct (batch + 1);
+	if (! cairo_test_images_equal (ctx, image, expected, 0,
+				       "batch %d: the image of drawing directly",
+				       batch))
+	    result = CAIRO_TEST_FAILURE;
+	cairo_surface_destroy (expected);
+    }
+
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_rectangle_t extents = { X, Y, WIDTH, HEIGHT };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *recording, *image;
+    cairo_status_t status;
+    cairo_t *cr;
+    int batch;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						&extents);
+    cr = cairo_create (recording);
+    for (batch = 0; batch < 4 && result == CAIRO_TEST_SUCCESS; batch++) {
+	draw_batch (cr, batch);
+	result = compare (ctx, recording, batch);
+    }
+    cairo_destroy (cr);
+    cairo_surface_destroy (recording);
+
+    if (result != CAIRO_TEST_SUCCESS)
+	return result;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						NULL);
+    cr = cairo_create (recording);
+    draw_batch (cr, 0);
+    cairo_destroy (cr);
+
+    image = cairo_recording_surface_get_image (recording);
+    status = cairo_surface_status (image);
+    if (status != CAIRO_STATUS_INVALID_SIZE) {
+	cairo_test_log (ctx, "unbounded recording: get_image returned %s\n",
+			cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+    }
+    cairo_surface_destroy (image);
+    cairo_surface_destroy (recording);
+
+    return result;
+}
+
+CAIRO_TEST (recording_surface_image,
+	    "Check that the image of a recording surface matches a replay",
+	    "recording", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,388 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+#include "cairo-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Writes a recording to a stream and to a file, checks that both hold
+ * the same bytes and that the loaded recording replays exactly like
+ * the original. Then loads damaged copies of the file: truncated, with
+ * a bad header, and with stroke parameters that cairo_set_line_width(),
+ * cairo_set_dash() and cairo_set_tolerance() would have refused. All
+ * of them must fail with CAIRO_STATUS_READ_ERROR.
+ */
+
+#define BASENAME "recording-surface-serialize.out"
+#define FILENAME CAIRO_TEST_OUTPUT_DIR "/" BASENAME ".rec"
+#define CORRUPT_FILENAME CAIRO_TEST_OUTPUT_DIR "/" BASENAME "-corrupt.rec"
+
+#define SIZE 64
+
+/* Distinctive values to find the stroke in the file */
+#define LINE_WIDTH 7.25
+#define DASH 3.375
+
+typedef struct _buffer {
+    unsigned char *data;
+    unsigned int length;
+    unsigned int size;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	unsigned int size = MAX (2 * buffer->size, buffer->length + length);
+	unsigned char *grown = realloc (buffer->data, size);
+
+	if (grown == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+
+	buffer->data = grown;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+record (void)
+{
+    const double dashes[] = { DASH, 1.5 };
+    cairo_surface_t *recording, *image;
+    cairo_pattern_t *gradient;
+    cairo_rectangle_t extents = { 0, 0, SIZE, SIZE };
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 8, 8);
+    cr = cairo_create (image);
+    cairo_set_source_rgba (cr, 0, 0.5, 1, 0.75);
+    cairo_paint (cr);
+    cairo_set_source_rgb (cr, 1, 1, 0);
+    cairo_rectangle (cr, 2, 2, 4, 4);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						&extents);
+    cr = cairo_create (recording);
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    gradient = cairo_pattern_create_linear (0, 0, SIZE, SIZE);
+    cairo_pattern_add_color_stop_rgb (gradient, 0, 1, 0, 0);
+    cairo_pattern_add_color_stop_rgba (gradient, 1, 0, 0, 1, 0.5);
+    cairo_set_source (cr, gradient);
+    cairo_pattern_destroy (gradient);
+    cairo_arc (cr, SIZE / 2, SIZE / 2, SIZE / 3, 0, 2 * M_PI);
+    cairo_fill (cr);
+
+    cairo_save (cr);
+    cairo_scale (cr, 3, 3);
+    cairo_set_source_surface (cr, image, 2, 2);
+    cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_REPEAT);
+    cairo_rectangle (cr, 2, 2, 10, 6);
+    cairo_fill (cr);
+    cairo_restore (cr);
+
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_set_line_width (cr, LINE_WIDTH);
+    cairo_set_dash (cr, dashes, 2, 0.5);
+    cairo_move_to (cr, 4, SIZE - 8);
+    cairo_curve_to (cr, SIZE / 3, 8, 2 * SIZE / 3, SIZE, SIZE - 4, 8);
+    cairo_stroke (cr);
+
+    cairo_destroy (cr);
+    cairo_surface_destroy (image);
+
+    return recording;
+}
+
+static cairo_surface_t *
+replay (cairo_surface_t *recording)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (image);
+    return image;
+}
+
+static cairo_bool_t
+write_file (const char *filename, const unsigned char *data, unsigned int length)
+{
+    FILE *file;
+    cairo_bool_t ret;
+
+    file = fopen (filename, "wb");
+    if (file == NULL)
+	return 0;
+
+    ret = fwrite (data, 1, length, file) == length;
+    ret &= fclose (file) == 0;
+    return ret;
+}
+
+static buffer_t
+read_file (const char *filename)
+{
+    buffer_t buffer = { NULL, 0, 0 };
+    unsigned char block[4096];
+    size_t length;
+    FILE *file;
+
+    file = fopen (filename, "rb");
+    if (file == NULL)
+	return buffer;
+
+    while ((length = fread (block, 1, sizeof (block), file)) > 0) {
+	if (write_buffer (&buffer, block, length))
+	    break;
+    }
+    fclose (file);
+
+    return buffer;
+}
+
+static long
+find_double (const buffer_t *buffer, double value)
+{
+    unsigned int i;
+
+    /* Records keep their doubles 8-byte aligned */
+    for (i = 0; i + sizeof (double) <= buffer->length; i += sizeof (double)) {
+	if (memcmp (buffer->data + i, &value, sizeof (double)) == 0)
+	    return i;
+    }
+
+    return -1;
+}
+
+static cairo_test_status_t
+expect_read_error (const cairo_test_context_t *ctx,
+		   const char *what,
+		   const unsigned char *data,
+		   unsigned int length)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+
+    if (! write_file (CORRUPT_FILENAME, data, length)) {
+	cairo_test_log (ctx, "Failed to write %s\n", CORRUPT_FILENAME);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    surface = cairo_recording_surface_create_from_file (CORRUPT_FILENAME);
+    status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    if (status != CAIRO_STATUS_READ_ERROR) {
+	cairo_test_log (ctx, "Loading a file with %s gave \"%s\"\n",
+			what, cairo_status_to_string (status));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+corrupt_double (const cairo_test_context_t *ctx,
+		const char *what,
+		const buffer_t *file,
+		long offset,
+		double value)
+{
+    cairo_test_status_t result;
+    unsigned char *data;
+
+    data = malloc (file->length);
+    memcpy (data, file->data, file->length);
+    memcpy (data + offset, &value, sizeof (double));
+    result = expect_read_error (ctx, what, data, file->length);
+    free (data);
+
+    return result;
+}
+
+static cairo_test_status_t
+test_corrupt (const cairo_test_context_t *ctx, const buffer_t *file)
+{
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    unsigned char *data;
+    unsigned int length;
+    long line_width, dash;
+    double zero = 0.;
+
+    /* Every truncation must be caught, rather than read past the end */
+    for (length = 0; length < file->length; length += 1 + length / 8) {
+	if (expect_read_error (ctx, "a truncated body",
+			       file->data, length))
+	{
+	    cairo_test_log (ctx, "Truncated to %u of %u bytes\n",
+			    length, file->length);
+	    return CAIRO_TEST_FAILURE;
+	}
+    }
+
+    data = malloc (file->length);
+    memcpy (data, file->data, file->length);
+    data[0] ^= 0xff;
+    if (expect_read_error (ctx, "a bad magic number",
+			   data, file->length))
+	result = CAIRO_TEST_FAILURE;
+    free (data);
+
+    /* The stroke record stores, in order, its line width, miter limit,
+     * dash offset, tolerance, ctm and inverse ctm. */
+    line_width = find_double (file, LINE_WIDTH);
+    dash = find_double (file, DASH);
+    if (line_width < 0 || dash < 0) {
+	cairo_test_log (ctx, "Could not find the stroke in the file\n");
+	return CAIRO_TEST_FAILURE;
+    }
+
+    if (corrupt_double (ctx, "a negative line width",
+			file, line_width, -1.))
+	result = CAIRO_TEST_FAILURE;
+    if (corrupt_double (ctx, "an infinite line width",
+			file, line_width, 1. / zero))
+	result = CAIRO_TEST_FAILURE;
+    if (corrupt_double (ctx, "a NaN miter limit",
+			file, line_width + 8, zero / zero))
+	result = CAIRO_TEST_FAILURE;
+    if (corrupt_double (ctx, "a zero tolerance",
+			file, line_width + 24, 0.))
+	result = CAIRO_TEST_FAILURE;
+    if (corrupt_double (ctx, "a negative dash",
+			file, dash, -DASH))
+	result = CAIRO_TEST_FAILURE;
+
+    /* Only zero dashes */
+    data = malloc (file->length);
+    memcpy (data, file->data, file->length);
+    memset (data + dash, 0, 2 * sizeof (double));
+    if (expect_read_error (ctx, "all dashes zero",
+			   data, file->length))
+	result = CAIRO_TEST_FAILURE;
+
+    /* A singular ctm */
+    memcpy (data, file->data, file->length);
+    memset (data + line_width + 32, 0, 4 * sizeof (double));
+    if (expect_read_error (ctx, "a singular ctm",
+			   data, file->length))
+	result = CAIRO_TEST_FAILURE;
+    free (data);
+
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *recording, *loaded, *expected, *image;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    buffer_t stream = { NULL, 0, 0 };
+    buffer_t file;
+    cairo_status_t status;
+
+    if (! cairo_test_mkdir (CAIRO_TEST_OUTPUT_DIR))
+	return CAIRO_TEST_UNTESTED;
+
+    recording = record ();
+    expected = replay (recording);
+
+    status = cairo_recording_surface_write_to_stream (recording,
+						      write_buffer, &stream);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_recording_surface_write_to_file (recording, FILENAME);
+    cairo_surface_destroy (recording);
+    if (status) {
+	cairo_test_log (ctx, "Failed to write the recording: %s\n",
+			cairo_status_to_string (status));
+	cairo_surface_destroy (expected);
+	free (stream.data);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    file = read_file (FILENAME);
+    if (file.length != stream.length ||
+	memcmp (file.data, stream.data, file.length))
+    {
+	cairo_test_log (ctx, "The file and the stream differ\n");
+	result = CAIRO_TEST_FAILURE;
+    }
+    free (stream.data);
+
+    loaded = cairo_recording_surface_create_from_file (FILENAME);
+    status = cairo_surface_status (loaded);
+    if (status) {
+	cairo_test_log (ctx, "Failed to load the recording: %s\n",
+			cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+    } else {
+	image = replay (loaded);
+	if (! cairo_test_images_equal (ctx, image, expected, 0,
+				       "the replay of the loaded recording"))
+	    result = CAIRO_TEST_FAILURE;
+	cairo_surface_destroy (image);
+    }
+    cairo_surface_destroy (loaded);
+    cairo_surface_destroy (expected);
+
+    loaded = cairo_recording_surface_create_from_file (CAIRO_TEST_OUTPUT_DIR "/" BASENAME "-missing.rec");
+    if (cairo_surface_status (loaded) != CAIRO_STATUS_FILE_NOT_FOUND) {
+	cairo_test_log (ctx, "Loading a missing file gave \"%s\"\n",
+			cairo_status_to_string (cairo_surface_status (loaded)));
+	result = CAIRO_TEST_FAILURE;
+    }
+    cairo_surface_destroy (loaded);
+
+    if (result == CAIRO_TEST_SUCCESS)
+	result = test_corrupt (ctx, &file);
+    free (file.data);
+
+    return result;
+}
+
+CAIRO_TEST (recording_surface_serialize,
+	    "Check that recordings survive being written and loaded, and that corrupt files are refused",
+	    "recording", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,222 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Check that replaying a recording surface onto an image surface that
+ * opted in to threads, which splits the replay into tiles drawn in
+ * parallel, gives the same pixels as replaying it in a single pass.
+ * Rectilinear shapes must match exactly. The second recording uses a
+ * surface pattern, which is not thread safe and so is always replayed
+ * serially. The last one draws curves, strokes and text across the tile
+ * boundaries, where the scan converter may sample the rows crossing a
+ * boundary differently: each edge through a pixel may then change its
+ * coverage by up to 1/15, so allow for two edges.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 512
+#define CURVES_TOLERANCE (2 * 255 / 15)
+
+enum {
+    SHAPES,
+    SHAPES_WITH_IMAGE,
+    CURVES
+};
+
+static void
+record_shapes (cairo_t *cr, cairo_bool_t with_image)
+{
+    cairo_pattern_t *pattern;
+    int i;
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    /* Enough commands, straddling the tile boundaries, to be split.
+     * Each tile clips the geometry to itself, which may round curved
+     * edges differently, so stick to rectilinear shapes which are
+     * rasterised exactly whatever the clip. */
+    for (i = 0; i < 40; i++) {
+	double x = (i * 97) % SIZE + .25;
+	double y = (i * 61) % SIZE + .5;
+
+	cairo_set_source_rgba (cr, i / 40., .5, 1 - i / 40., .7);
+	cairo_rectangle (cr, x, y, 30 + i % 90, 50 + i % 70);
+	if (i & 1) {
+	    cairo_fill (cr);
+	} else {
+	    cairo_set_line_width (cr, 1 + i % 7);
+	    cairo_stroke (cr);
+	}
+    }
+
+    pattern = cairo_pattern_create_linear (100, 0, 250, 0);
+    cairo_pattern_add_color_stop_rgba (pattern, 0, 1, 0, 0, .8);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, .4);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+    cairo_rectangle (cr, 100.5, 60, 150, 150);
+    cairo_fill (cr);
+
+    pattern = cairo_pattern_create_radial (320, 320, 10, 320, 320, 90);
+    cairo_pattern_add_color_stop_rgba (pattern, 0, 0, 1, 0, .8);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, 0);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+    cairo_rectangle (cr, 240, 240, 160, 160);
+    cairo_fill (cr);
+
+    if (with_image) {
+	cairo_surface_t *image;
+	cairo_t *cr2;
+
+	image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 64, 64);
+	cr2 = cairo_create (image);
+	cairo_set_source_rgba (cr2, 1, 0, 0, .5);
+	cairo_paint (cr2);
+	cairo_destroy (cr2);
+
+	cairo_set_source_surface (cr, image, 100, 100);
+	cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_REPEAT);
+	cairo_rectangle (cr, 50, 300, 200, 150);
+	cairo_fill (cr);
+	cairo_surface_destroy (image);
+    }
+}
+
+static void
+record_curves (cairo_t *cr)
+{
+    int i;
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    for (i = 0; i < 24; i++) {
+	double x = (i * 89) % SIZE + .3;
+	double y = (i * 53) % SIZE + .7;
+
+	cairo_set_source_rgba (cr, i / 24., .3, 1 - i / 24., .8);
+	cairo_arc (cr, x, y, 20 + i % 50, 0, 2 * M_PI);
+	if (i & 1) {
+	    cairo_fill (cr);
+	} else {
+	    cairo_set_line_width (cr, 1.5 + i % 9);
+	    cairo_stroke (cr);
+	}
+
+	cairo_move_to (cr, x - 40, y + 10);
+	cairo_curve_to (cr, x, y - 60, x + 20, y + 70, x + 90, y - 5);
+	cairo_set_line_width (cr, 3.25);
+	cairo_stroke (cr);
+    }
+
+    cairo_select_font_face (cr, "@cairo:",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    for (i = 0; i < 12; i++) {
+	cairo_set_font_size (cr, 12 + 3 * i);
+	cairo_move_to (cr, (i * 41) % (SIZE / 2) + .5, (i * 43) % SIZE + 20.25);
+	cairo_show_text (cr, "Tiles, seams & glyphs");
+    }
+}
+
+static cairo_surface_t *
+replay (cairo_surface_t *recording, int num_threads)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+compare (cairo_test_context_t *ctx, int scene)
+{
+    cairo_surface_t *recording, *serial, *tiled;
+    cairo_rectangle_t extents = { 0, 0, SIZE, SIZE };
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_t *cr;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+						&extents);
+    cr = cairo_create (recording);
+    if (scene == CURVES)
+	record_curves (cr);
+    else
+	record_shapes (cr, scene == SHAPES_WITH_IMAGE);
+    cairo_destroy (cr);
+
+    serial = replay (recording, 1);
+    tiled = replay (recording, 0);
+
+    if (! cairo_test_images_equal (ctx, serial, tiled,
+				   scene == CURVES ? CURVES_TOLERANCE : 0,
+				   "tiled replay%s",
+				   scene == CURVES ? " of curves" :
+				   scene == SHAPES_WITH_IMAGE ? " (with image)" : ""))
+    {
+	status = CAIRO_TEST_FAILURE;
+    }
+
+    cairo_surface_destroy (serial);
+    cairo_surface_destroy (tiled);
+    cairo_surface_destroy (recording);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status;
+
+    status = compare (ctx, SHAPES);
+    if (status)
+	return status;
+
+    status = compare (ctx, SHAPES_WITH_IMAGE);
+    if (status)
+	return status;
+
+    return compare (ctx, CURVES);
+}
+
+CAIRO_TEST (recording_surface_tiles,
+	    "Check that a tiled recording replay matches a single pass",
+	    "recording, threads", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
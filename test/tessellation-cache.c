@@ -0,0 +1,183 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: agent <agent@local>
+
+/*
+ * Fill the same shapes at several positions onto a surface that opted
+ * in to the tessellation cache, and onto one that did not. The cached
+ * outlines replayed under translation must render exactly the same, and
+ * cairo_debug_get_tessellation_cache_stats() must count a hit for every
+ * translated copy, for curved paths as well as rectilinear ones that
+ * reduce to boxes. Then fill enough one-off paths to overflow the cache,
+ * which must evict the shapes used once but keep those used again.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 128
+#define NUM_ONE_OFF 80
+#define ONE_OFF_EDGES 4000
+
+static void
+curve (cairo_t *cr, double x, double y)
+{
+    cairo_move_to (cr, x, y);
+    cairo_curve_to (cr, x + 30, y - 10, x + 40, y + 30, x + 20, y + 25);
+    cairo_curve_to (cr, x + 10, y + 40, x - 15, y + 20, x, y);
+    cairo_close_path (cr);
+    cairo_arc (cr, x + 15, y + 12, 8, 0, 2 * M_PI);
+}
+
+/* Overlapping rectangles, so not a single box */
+static void
+rectilinear (cairo_t *cr, double x, double y)
+{
+    cairo_rectangle (cr, x, y, 20, 10);
+    cairo_rectangle (cr, x + 5, y + 5, 10, 12.5);
+    cairo_rectangle (cr, x + 12.25, y - 3, 4, 20);
+}
+
+static void
+one_off (cairo_t *cr, int n)
+{
+    int i;
+
+    cairo_move_to (cr, 0, 0);
+    for (i = 1; i < ONE_OFF_EDGES; i++)
+	cairo_line_to (cr, (i * 7 + n) % 64, (i * 13 + 3 * n) % 61 + 0.5);
+    cairo_close_path (cr);
+}
+
+static cairo_bool_t
+check_stats (const cairo_test_context_t *ctx,
+	     const char *what,
+	     unsigned long expected_hits,
+	     unsigned long expected_misses)
+{
+    unsigned long hits, misses;
+
+    cairo_debug_get_tessellation_cache_stats (&hits, &misses, NULL);
+    if (hits == expected_hits && misses == expected_misses)
+	return 1;
+
+    cairo_test_log (ctx, "%s: expected %lu hits and %lu misses, got %lu and %lu\n",
+		    what, expected_hits, expected_misses, hits, misses);
+    return 0;
+}
+
+static void
+draw (cairo_t *cr)
+{
+    cairo_set_source_rgba (cr, 0.2, 0.4, 0.8, 0.75);
+
+    curve (cr, 10.25, 20.5);
+    cairo_fill (cr);
+    curve (cr, 60.75, 70.125);
+    cairo_fill (cr);
+
+    rectilinear (cr, 5, 5);
+    cairo_fill (cr);
+    rectilinear (cr, 70.5, 40.25);
+    cairo_fill (cr);
+
+    cairo_set_antialias (cr, CAIRO_ANTIALIAS_NONE);
+    rectilinear (cr, 5, 80);
+    cairo_fill (cr);
+    rectilinear (cr, 40, 100);
+    cairo_fill (cr);
+    /* rounds differently, so is not a translated copy */
+    rectilinear (cr, 80.5, 90.5);
+    cairo_fill (cr);
+    cairo_set_antialias (cr, CAIRO_ANTIALIAS_DEFAULT);
+
+    cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+    cairo_set_tolerance (cr, 0.5);
+    curve (cr, 90, 10);
+    cairo_fill (cr);
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *cached, *uncached;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_t *cr;
+    int n;
+
+    cairo_debug_reset_static_data ();
+
+    uncached = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (uncached);
+    draw (cr);
+    cairo_destroy (cr);
+    if (! check_stats (ctx, "Without the cache", 0, 0))
+	result = CAIRO_TEST_FAILURE;
+
+    cached = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_tessellation_cache (cached, 1);
+    cr = cairo_create (cached);
+    draw (cr);
+    if (! check_stats (ctx, "Translated copies", 3, 5))
+	result = CAIRO_TEST_FAILURE;
+
+    if (! cairo_test_images_equal (ctx, cached, uncached, 0, "replayed fills"))
+	result = CAIRO_TEST_FAILURE;
+
+    /* used once, then pushed out by the one-off paths */
+    cairo_set_tolerance (cr, 0.25);
+    curve (cr, 30.125, 30);
+    cairo_fill (cr);
+    for (n = 0; n < NUM_ONE_OFF; n++) {
+	one_off (cr, n);
+	cairo_fill (cr);
+    }
+    if (! check_stats (ctx, "One-off paths", 3, 6 + NUM_ONE_OFF))
+	result = CAIRO_TEST_FAILURE;
+
+    curve (cr, 30.125, 30);
+    cairo_fill (cr);
+    if (! check_stats (ctx, "Evicted shape", 3, 7 + NUM_ONE_OFF))
+	result = CAIRO_TEST_FAILURE;
+
+    cairo_set_fill_rule (cr, CAIRO_FILL_RULE_WINDING);
+    cairo_set_tolerance (cr, 0.1);
+    curve (cr, 40, 40);
+    cairo_fill (cr);
+    if (! check_stats (ctx, "Shape used again", 4, 7 + NUM_ONE_OFF))
+	result = CAIRO_TEST_FAILURE;
+
+    cairo_destroy (cr);
+    cairo_surface_destroy (cached);
+    cairo_surface_destroy (uncached);
+
+    cairo_debug_reset_static_data ();
+
+    return result;
+}
+
+CAIRO_TEST (tessellation_cache,
+	    "Check that fills replayed from the tessellation cache are unchanged",
+	    "fill", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
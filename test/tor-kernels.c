@@ -0,0 +1,138 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Author: agent <agent@local>
+ */
+
+/* Check that the vector kernels the tor scan converter uses to turn
+ * dense rows of cells into spans give exactly the same coverage as the
+ * scalar code. Each kernel is selected in turn with the
+ * CAIRO_DEBUG_TOR_KERNEL environment variable; one the cpu does not
+ * support falls back to a narrower one, which must match as well.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SIZE 256
+
+#if HAVE_SETENV
+static const char *kernels[] = { "scalar", "sse2", "avx2" };
+
+static cairo_surface_t *
+render (const char *kernel)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    int i;
+
+    setenv ("CAIRO_DEBUG_TOR_KERNEL", kernel, 1);
+    cairo_debug_reset_static_data ();
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, SIZE, SIZE);
+    cr = cairo_create (surface);
+
+    /* Shallow edges cross many pixels on each row, so that the rows
+     * are dense enough to go through the kernels. */
+    cairo_translate (cr, SIZE / 2., SIZE / 2.);
+    for (i = 0; i < 2 * 61; i++) {
+	double r = i & 1 ? SIZE / 7. : SIZE / 2. - 2;
+	double a = i * M_PI / 61 + .01;
+
+	cairo_line_to (cr, r * cos (a), r * sin (a));
+    }
+    cairo_close_path (cr);
+    cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+    cairo_fill (cr);
+
+    cairo_identity_matrix (cr);
+    cairo_set_line_width (cr, 1.3);
+    for (i = 0; i < 24; i++) {
+	cairo_move_to (cr, -10, i * 10.7 + .3);
+	cairo_line_to (cr, SIZE + 10, i * 11.3 + 4.9);
+    }
+    cairo_stroke (cr);
+
+    cairo_arc (cr, SIZE / 3., SIZE / 3., SIZE / 4. + .4, 0, 2 * M_PI);
+    cairo_set_operator (cr, CAIRO_OPERATOR_XOR);
+    cairo_fill (cr);
+
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *reference;
+    const char *env;
+    char *saved = NULL;
+    int n;
+
+    env = getenv ("CAIRO_DEBUG_TOR_KERNEL");
+    if (env != NULL)
+	saved = strdup (env);
+
+    reference = render (kernels[0]);
+    for (n = 1; n < ARRAY_LENGTH (kernels); n++) {
+	cairo_surface_t *surface = render (kernels[n]);
+
+	if (! cairo_test_images_equal (ctx, reference, surface, 0,
+				       "%s kernel", kernels[n]))
+	    status = CAIRO_TEST_FAILURE;
+
+	cairo_surface_destroy (surface);
+    }
+    cairo_surface_destroy (reference);
+
+    if (saved != NULL)
+	setenv ("CAIRO_DEBUG_TOR_KERNEL", saved, 1);
+    else
+	unsetenv ("CAIRO_DEBUG_TOR_KERNEL");
+    free (saved);
+    cairo_debug_reset_static_data ();
+
+    return status;
+}
+#else
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    return CAIRO_TEST_UNTESTED;
+}
+#endif
+
+CAIRO_TEST (tor_kernels,
+	    "Check that the scan converter's vector kernels match the scalar code",
+	    "raster", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)